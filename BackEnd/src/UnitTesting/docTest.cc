@@ -4,7 +4,15 @@
 #include "../functions.cc"
 #include "../functionsCSR.cc"
 #include "../functionsCSC.cc"
+#include "../functionsAMG.cc"
+#include "../functionsOrdering.cc"
+#include "../functionsSparseLU.cc"
+#include "../functionsConversion.cc"
+#include "../functionsElementwise.cc"
+#include "../functionsExpression.cc"
+#include "../functionsBatched.cc"
 #include "fstream"
+#include <set>
 const int numWidth = 10;
 const char separator = ' ';
 // Basic Unit tests for CSR add, multiply, and transpose
@@ -16,7 +24,7 @@ Takes a CSRMatrix and a dense matrix and makes sure they have the same elements
 /// @brief Ensure compressed sparse row matrix is the same as expected dense matrix
 /// @param mResult The CSR matrix to compare to
 /// @param mCheck The dense matrix to compare to
-void CHECKCSR(CSRMatrix<int> mResult, vector<vector<int>> mCheck)
+void CHECKCSR(const CSRMatrix<int> &mResult, const vector<vector<int>> &mCheck)
 {
     CHECK(mResult.numRows == mCheck.size());
     for (size_t i = 0; i < mResult.numRows; i++)
@@ -29,7 +37,7 @@ void CHECKCSR(CSRMatrix<int> mResult, vector<vector<int>> mCheck)
     }
 }
 
-void CHECKCSR(CSRMatrix<double> mResult, vector<vector<double>> mCheck)
+void CHECKCSR(const CSRMatrix<double> &mResult, const vector<vector<double>> &mCheck)
 {
     CHECK(mResult.numRows == mCheck.size());
     for (size_t i = 0; i < mResult.numRows; i++)
@@ -282,7 +290,7 @@ TEST_CASE("testing CSR find min value 2")
 /// @brief Ensure compressed sparse column matrix is the same as expected dense matrix
 /// @param mResult The CSC matrix to compare to
 /// @param mCheck The dense matrix to compare to
-void CHECKCSC(CSCMatrix<int> mResult, vector<vector<int>> mCheck)
+void CHECKCSC(const CSCMatrix<int> &mResult, const vector<vector<int>> &mCheck)
 {
     CHECK(mResult.numRows == mCheck.size());
     for (size_t j = 0; j < mResult.numColumns; j++)
@@ -1029,4 +1037,974 @@ TEST_CASE("Conjugate Gradient CSR 0") {
     std::vector<double> expected = {17.8000, 30.6000, 33.4000, 21.2000 };
 
     CHECK_VECTOR_EQ(result, expected, 1e-6);
-}
\ No newline at end of file
+}
+TEST_CASE("CSR SSOR Preconditioned Conjugate Gradient") {
+    const size_t n = 50;
+    std::vector<std::vector<double>> A(n, std::vector<double>(n, 0.0));
+    for (size_t i = 0; i < n; i++) {
+        A[i][i] = 2.0;
+        if (i > 0) A[i][i - 1] = -1.0;
+        if (i < n - 1) A[i][i + 1] = -1.0;
+    }
+    auto CSR_A = from_vector_CSR<double>(A);
+    std::vector<double> b(n, 1.0);
+    std::vector<double> x0(n, 0.0);
+
+    auto M = make_ssor_preconditioner_CSR(CSR_A, 1.2);
+    auto x = preconditioned_conjugate_gradient_CSR(CSR_A, b, x0, 200, 1e-10, M);
+    auto Ax = matrix_vector_product_CSR(CSR_A, x);
+
+    CHECK_VECTOR_EQ(Ax, b, 1e-8);
+}
+
+TEST_CASE("Weighted Jacobi Iteration CSR")
+{
+    std::vector<std::vector<double>> A = {{3.0, 1.0, 1.0}, {1.0, 5.0, 2.0}, {2.0, 3.0, 6.0}};
+    auto CSR_A = from_vector_CSR<double>(A);
+    const std::vector<double> b = {5.0, 10.0, 15.0};
+    const double tol = 1e-6;
+    const int max_iter = 500;
+
+    std::vector<double> x_expected = {0.714286, 1.190476, 1.666667};
+    std::vector<double> x = jacobi_method_CSR(CSR_A, b, 1e-9, max_iter, 0.8);
+    CHECK_VECTOR_EQ(x, x_expected, tol);
+
+    // only checking for convergence every 5 iterations must give the same answer
+    x = jacobi_method_CSR(CSR_A, b, 1e-9, max_iter, 0.8, 5);
+    CHECK_VECTOR_EQ(x, x_expected, tol);
+}
+
+/// @brief Tridiagonal convection-diffusion matrix, a small nonsymmetric test problem
+CSRMatrix<double> convection_diffusion_CSR(size_t n)
+{
+    CSRMatrix<double> A;
+    A.numRows = n;
+    A.numColumns = n;
+    A.row_ptr.push_back(0);
+    for (size_t i = 0; i < n; i++) {
+        if (i > 0) { A.val.push_back(-1.3); A.col_ind.push_back(i - 1); }
+        A.val.push_back(2.0); A.col_ind.push_back(i);
+        if (i < n - 1) { A.val.push_back(-0.7); A.col_ind.push_back(i + 1); }
+        A.row_ptr.push_back(A.val.size());
+    }
+    return A;
+}
+
+TEST_CASE("GMRES(m) CSR nonsymmetric") {
+    const size_t n = 100;
+    CSRMatrix<double> A = convection_diffusion_CSR(n);
+    std::vector<double> b(n, 1.0);
+    std::vector<double> x0(n, 0.0);
+
+    SolverInfo info;
+    auto x = gmres_CSR(A, b, x0, 20, 2000, 1e-10, PreconditionerCSR<double>(), &info);
+    auto Ax = matrix_vector_product_CSR(A, x);
+    CHECK(info.converged);
+    CHECK(info.residuals.size() == size_t(info.iterations) + 1);
+    CHECK_VECTOR_EQ(Ax, b, 1e-8);
+
+    SolverInfo precInfo;
+    auto M = make_ssor_preconditioner_CSR(A, 1.0);
+    x = gmres_CSR(A, b, x0, 20, 2000, 1e-10, M, &precInfo);
+    Ax = matrix_vector_product_CSR(A, x);
+    CHECK(precInfo.converged);
+    CHECK(precInfo.iterations < info.iterations);
+    CHECK_VECTOR_EQ(Ax, b, 1e-8);
+}
+
+TEST_CASE("BiCGSTAB CSR nonsymmetric") {
+    const size_t n = 100;
+    CSRMatrix<double> A = convection_diffusion_CSR(n);
+    std::vector<double> b(n, 1.0);
+    std::vector<double> x0(n, 0.0);
+
+    SolverInfo info;
+    auto x = bicgstab_CSR(A, b, x0, 1000, 1e-10, PreconditionerCSR<double>(), &info);
+    auto Ax = matrix_vector_product_CSR(A, x);
+    CHECK(info.converged);
+    CHECK(info.residuals.size() == size_t(info.iterations) + 1);
+    CHECK_VECTOR_EQ(Ax, b, 1e-8);
+
+    auto M = make_ssor_preconditioner_CSR(A, 1.0);
+    x = bicgstab_CSR(A, b, x0, 1000, 1e-10, M, &info);
+    Ax = matrix_vector_product_CSR(A, x);
+    CHECK(info.converged);
+    CHECK_VECTOR_EQ(Ax, b, 1e-8);
+}
+
+TEST_CASE("IDR(s) CSR nonsymmetric") {
+    const size_t n = 100;
+    CSRMatrix<double> A = convection_diffusion_CSR(n);
+    std::vector<double> b(n, 1.0);
+    std::vector<double> x0(n, 0.0);
+
+    for (int s : {1, 4}) {
+        SolverInfo info;
+        auto x = idrs_CSR(A, b, x0, s, 2000, 1e-10, PreconditionerCSR<double>(), &info);
+        auto Ax = matrix_vector_product_CSR(A, x);
+        CHECK(info.converged);
+        CHECK(info.residuals.size() == size_t(info.iterations) + 1);
+        CHECK_VECTOR_EQ(Ax, b, 1e-8);
+    }
+
+    SolverInfo info;
+    auto M = make_ssor_preconditioner_CSR(A, 1.0);
+    auto x = idrs_CSR(A, b, x0, 4, 2000, 1e-10, M, &info);
+    auto Ax = matrix_vector_product_CSR(A, x);
+    CHECK(info.converged);
+    CHECK_VECTOR_EQ(Ax, b, 1e-8);
+}
+
+/// @brief 5-point finite difference Laplacian on a k x k grid with Dirichlet boundary
+CSRMatrix<double> poisson2D_CSR(size_t k)
+{
+    CSRMatrix<double> A;
+    A.numRows = k * k;
+    A.numColumns = k * k;
+    A.row_ptr.push_back(0);
+    for (size_t i = 0; i < k; i++) {
+        for (size_t j = 0; j < k; j++) {
+            const size_t row = i * k + j;
+            if (i > 0) { A.col_ind.push_back(row - k); A.val.push_back(-1.0); }
+            if (j > 0) { A.col_ind.push_back(row - 1); A.val.push_back(-1.0); }
+            A.col_ind.push_back(row); A.val.push_back(4.0);
+            if (j + 1 < k) { A.col_ind.push_back(row + 1); A.val.push_back(-1.0); }
+            if (i + 1 < k) { A.col_ind.push_back(row + k); A.val.push_back(-1.0); }
+            A.row_ptr.push_back(A.col_ind.size());
+        }
+    }
+    return A;
+}
+
+TEST_CASE("Multiply CSR Gustavson matches dense") {
+    CSRMatrix<double> A = convection_diffusion_CSR(20);
+    CSRMatrix<double> A2 = multiply_matrixCSR(A, A);
+    std::vector<double> x(20), y;
+    for (size_t i = 0; i < x.size(); i++) x[i] = 1.0 + i;
+    y = matrix_vector_product_CSR(A2, x);
+    std::vector<double> check = matrix_vector_product_CSR(A, matrix_vector_product_CSR(A, x));
+    CHECK_VECTOR_EQ(y, check, 1e-9);
+    // pentadiagonal pattern, with sorted columns in every row
+    CHECK(A2.val.size() == 5 * 20 - 6);
+    for (size_t i = 0; i < A2.numRows; i++)
+        for (size_t k = A2.row_ptr[i] + 1; k < A2.row_ptr[i + 1]; k++)
+            CHECK(A2.col_ind[k - 1] < A2.col_ind[k]);
+}
+
+TEST_CASE("AMG preconditioned CG on 2D Poisson") {
+    std::vector<int> iterations;
+    for (size_t k : {16, 32, 64}) {
+        CSRMatrix<double> A = poisson2D_CSR(k);
+        AMGHierarchy<double> H = amg_setup_CSR(A);
+        CHECK(H.levels.size() > 1);
+        CHECK(H.levels.back().A.numRows <= H.options.coarseSize);
+
+        std::vector<double> b(k * k, 1.0), x0(k * k, 0.0);
+        SolverInfo info;
+        auto x = preconditioned_conjugate_gradient_CSR(A, b, x0, 200, 1e-8, make_amg_preconditioner_CSR(H), &info);
+        auto Ax = matrix_vector_product_CSR(A, x);
+        CHECK(info.converged);
+        CHECK_VECTOR_EQ(Ax, b, 1e-6);
+        iterations.push_back(info.iterations);
+    }
+    // mesh independent: the iteration count barely grows as the grid is refined
+    CHECK(iterations.back() < 30);
+    CHECK(iterations.back() <= iterations.front() + 6);
+
+    // Jacobi smoother and the stand-alone V-cycle iteration
+    CSRMatrix<double> A = poisson2D_CSR(32);
+    AMGOptions options;
+    options.smoother = AMGSmoother::Jacobi;
+    options.preSweeps = 2;
+    options.postSweeps = 2;
+    AMGHierarchy<double> H = amg_setup_CSR(A, options);
+    std::vector<double> b(32 * 32, 1.0);
+    SolverInfo info;
+    auto x = amg_solve_CSR(H, b, 1e-8, 200, &info);
+    auto Ax = matrix_vector_product_CSR(A, x);
+    CHECK(info.converged);
+    CHECK_VECTOR_EQ(Ax, b, 1e-6);
+}
+
+TEST_CASE("Lanczos eigenvalue bounds and Chebyshev iteration CSR") {
+    // D^-1 A of the 1D Laplacian has eigenvalues 1 - cos(k pi / (n + 1))
+    const size_t n = 50;
+    CSRMatrix<double> L;
+    L.numRows = n;
+    L.numColumns = n;
+    L.row_ptr.push_back(0);
+    for (size_t i = 0; i < n; i++) {
+        if (i > 0) { L.col_ind.push_back(i - 1); L.val.push_back(-1.0); }
+        L.col_ind.push_back(i); L.val.push_back(2.0);
+        if (i + 1 < n) { L.col_ind.push_back(i + 1); L.val.push_back(-1.0); }
+        L.row_ptr.push_back(L.col_ind.size());
+    }
+    const double pi = std::acos(-1.0);
+    auto bounds = lanczos_eigenvalue_bounds_CSR(L, inverse_diagonal_CSR(L), (int)n);
+    CHECK(bounds.first == doctest::Approx(1.0 - std::cos(pi / (n + 1))).epsilon(1e-6));
+    CHECK(bounds.second == doctest::Approx(1.0 - std::cos(n * pi / (n + 1))).epsilon(1e-6));
+    bounds = lanczos_eigenvalue_bounds_CSR(L, inverse_diagonal_CSR(L), 10);
+    CHECK(bounds.second <= 2.0);
+    CHECK(bounds.second > 1.8);
+
+    CSRMatrix<double> A = poisson2D_CSR(16);
+    std::vector<double> b(A.numRows, 1.0), x0(A.numRows, 0.0);
+    SolverInfo info;
+    auto x = chebyshev_iteration_CSR(A, b, x0, 2000, 1e-8, 10, &info);
+    auto Ax = matrix_vector_product_CSR(A, x);
+    CHECK(info.converged);
+    CHECK_VECTOR_EQ(Ax, b, 1e-7);
+}
+
+TEST_CASE("Chebyshev polynomial preconditioner CSR") {
+    CSRMatrix<double> A = poisson2D_CSR(32);
+    std::vector<double> b(A.numRows, 1.0), x0(A.numRows, 0.0);
+    SolverInfo plain, cheb;
+    preconditioned_conjugate_gradient_CSR(A, b, x0, 1000, 1e-8, PreconditionerCSR<double>(
+        [](const std::vector<double> &r, std::vector<double> &z) { z = r; }), &plain);
+    ChebyshevCSR<double> C = chebyshev_setup_CSR(A, 8, 30.0);
+    auto x = preconditioned_conjugate_gradient_CSR(A, b, x0, 1000, 1e-8, make_chebyshev_preconditioner_CSR(A, C), &cheb);
+    auto Ax = matrix_vector_product_CSR(A, x);
+    CHECK(plain.converged);
+    CHECK(cheb.converged);
+    CHECK(4 * cheb.iterations < plain.iterations);
+    CHECK_VECTOR_EQ(Ax, b, 1e-7);
+}
+
+TEST_CASE("Pipelined and s-step CG CSR") {
+    CSRMatrix<double> A = poisson2D_CSR(32);
+    std::vector<double> b(A.numRows), x0(A.numRows, 0.0);
+    for (size_t i = 0; i < b.size(); i++) b[i] = 1.0 + std::sin(0.3 * i);
+    SolverInfo cg;
+    preconditioned_conjugate_gradient_CSR(A, b, x0, 1000, 1e-8, PreconditionerCSR<double>(
+        [](const std::vector<double> &r, std::vector<double> &z) { z = r; }), &cg);
+
+    SolverInfo pipelined;
+    auto x = pipelined_conjugate_gradient_CSR(A, b, x0, 1000, 1e-8, &pipelined);
+    auto Ax = matrix_vector_product_CSR(A, x);
+    CHECK(pipelined.converged);
+    CHECK(std::abs(pipelined.iterations - cg.iterations) <= 3);
+    CHECK_VECTOR_EQ(Ax, b, 1e-7);
+
+    for (int s : {1, 3, 5}) {
+        SolverInfo sStep;
+        x = s_step_conjugate_gradient_CSR(A, b, x0, s, 1000, 1e-8, &sStep);
+        Ax = matrix_vector_product_CSR(A, x);
+        CHECK(sStep.converged);
+        CHECK(sStep.iterations <= cg.iterations + 2 * s);
+        CHECK_VECTOR_EQ(Ax, b, 1e-7);
+    }
+}
+
+TEST_CASE("Sparse matrix times dense block CSR") {
+    CSRMatrix<double> A = convection_diffusion_CSR(30);
+    DenseBlock<double> X(30, 3);
+    for (size_t i = 0; i < 30; i++)
+        for (size_t j = 0; j < 3; j++) X(i, j) = std::cos(1.0 * i + 7.0 * j);
+    DenseBlock<double> Y = multiply_block_CSR(A, X);
+    CHECK(Y.numRows == 30);
+    CHECK(Y.numColumns == 3);
+    for (size_t j = 0; j < 3; j++) {
+        std::vector<double> x(30), y(30);
+        for (size_t i = 0; i < 30; i++) { x[i] = X(i, j); y[i] = Y(i, j); }
+        std::vector<double> check = matrix_vector_product_CSR(A, x);
+        CHECK_VECTOR_EQ(y, check, 1e-12);
+    }
+
+    // column-major layout and A^T X against the explicit transpose
+    ColumnMajorBlock<double> Xc(30, 3);
+    for (size_t i = 0; i < 30; i++)
+        for (size_t j = 0; j < 3; j++) Xc(i, j) = X(i, j);
+    ColumnMajorBlock<double> Yc = multiply_block_CSR(A, Xc);
+    ColumnMajorBlock<double> Ytc = multiply_block_transpose_CSR(A, Xc);
+    DenseBlock<double> Yt = multiply_block_transpose_CSR(A, X);
+    DenseBlock<double> YtCheck = multiply_block_CSR(transpose_matrixCSR(A), X);
+    for (size_t i = 0; i < 30; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            CHECK(Yc(i, j) == doctest::Approx(Y(i, j)));
+            CHECK(Yt(i, j) == doctest::Approx(YtCheck(i, j)));
+            CHECK(Ytc(i, j) == doctest::Approx(YtCheck(i, j)));
+        }
+    }
+}
+
+/// @brief Checks that every column of A X matches B
+void CHECK_BLOCK_SOLUTION(const CSRMatrix<double> &A, const DenseBlock<double> &X, const DenseBlock<double> &B, double tol)
+{
+    DenseBlock<double> AX = multiply_block_CSR(A, X);
+    CHECK_VECTOR_EQ(AX.val, const_cast<DenseBlock<double> &>(B).val, tol);
+}
+
+TEST_CASE("Block CG CSR many right hand sides") {
+    CSRMatrix<double> A = poisson2D_CSR(24);
+    const size_t n = A.numRows, k = 4;
+    DenseBlock<double> B(n, k);
+    for (size_t i = 0; i < n; i++)
+        for (size_t j = 0; j < k; j++) B(i, j) = 1.0 + std::sin(0.1 * (j + 1) * i);
+
+    SolverInfo single;
+    std::vector<double> b(n), x0(n, 0.0);
+    for (size_t i = 0; i < n; i++) b[i] = B(i, 0);
+    preconditioned_conjugate_gradient_CSR(A, b, x0, 1000, 1e-8, PreconditionerCSR<double>(
+        [](const std::vector<double> &r, std::vector<double> &z) { z = r; }), &single);
+
+    SolverInfo info;
+    DenseBlock<double> X = block_conjugate_gradient_CSR(A, B, DenseBlock<double>(), 1000, 1e-8, PreconditionerCSR<double>(), &info);
+    CHECK(info.converged);
+    CHECK(info.iterations <= single.iterations);
+    CHECK_BLOCK_SOLUTION(A, X, B, 1e-7);
+
+    // dependent right hand sides are deflated instead of breaking down
+    for (size_t i = 0; i < n; i++) B(i, 3) = 2.0 * B(i, 1);
+    auto M = make_ssor_preconditioner_CSR(A, 1.0);
+    X = block_conjugate_gradient_CSR(A, B, DenseBlock<double>(), 1000, 1e-8, M, &info);
+    CHECK(info.converged);
+    CHECK_BLOCK_SOLUTION(A, X, B, 1e-7);
+
+    // an initial guess must be n x k
+    CHECK_THROWS_AS(block_conjugate_gradient_CSR(A, B, DenseBlock<double>(n, k + 1), 10, 1e-8), std::invalid_argument);
+    CHECK_THROWS_AS(block_conjugate_gradient_CSR(A, B, DenseBlock<double>(n, k - 1), 10, 1e-8), std::invalid_argument);
+    CHECK_THROWS_AS(block_conjugate_gradient_CSR(A, B, DenseBlock<double>(n - 1, k), 10, 1e-8), std::invalid_argument);
+}
+
+TEST_CASE("Block GMRES CSR many right hand sides") {
+    const size_t n = 100, k = 3;
+    CSRMatrix<double> A = convection_diffusion_CSR(n);
+    DenseBlock<double> B(n, k);
+    for (size_t i = 0; i < n; i++)
+        for (size_t j = 0; j < k; j++) B(i, j) = j == 0 ? 1.0 : std::cos(0.2 * j * i);
+
+    SolverInfo info;
+    DenseBlock<double> X = block_gmres_CSR(A, B, DenseBlock<double>(), 20, 2000, 1e-10, PreconditionerCSR<double>(), &info);
+    CHECK(info.converged);
+    CHECK_BLOCK_SOLUTION(A, X, B, 1e-8);
+
+    auto M = make_ssor_preconditioner_CSR(A, 1.0);
+    X = block_gmres_CSR(A, B, DenseBlock<double>(), 10, 2000, 1e-10, M, &info);
+    CHECK(info.converged);
+    CHECK_BLOCK_SOLUTION(A, X, B, 1e-8);
+
+    // an initial guess must be n x k; the solution is one
+    CHECK_THROWS_AS(block_gmres_CSR(A, B, DenseBlock<double>(n, k + 1), 10, 10, 1e-10), std::invalid_argument);
+    CHECK_THROWS_AS(block_gmres_CSR(A, B, DenseBlock<double>(n, k - 1), 10, 10, 1e-10), std::invalid_argument);
+    X = block_gmres_CSR(A, B, X, 10, 2000, 1e-10, M, &info);
+    CHECK(info.converged);
+    CHECK_BLOCK_SOLUTION(A, X, B, 1e-8);
+}
+
+// nonzeros of the Cholesky factor of a symmetric pattern, by symbolic elimination
+size_t cholesky_fill_count(const CSRMatrix<double> &A) {
+    const size_t n = A.numRows;
+    vector<std::set<size_t>> lower(n);
+    for (size_t i = 0; i < n; i++)
+        for (size_t e = A.row_ptr[i]; e < A.row_ptr[i + 1]; e++)
+            if (A.col_ind[e] > i) lower[i].insert(A.col_ind[e]);
+    size_t count = n;
+    for (size_t j = 0; j < n; j++) {
+        count += lower[j].size();
+        if (lower[j].empty()) continue;
+        const size_t parent = *lower[j].begin();
+        for (size_t r : lower[j])
+            if (r != parent) lower[parent].insert(r);
+    }
+    return count;
+}
+
+TEST_CASE("RCM and nested dissection orderings CSR") {
+    // 2D Poisson scrambled by a fixed random permutation
+    const size_t k = 20, n = k * k;
+    CSRMatrix<double> P = poisson2D_CSR(k);
+    vector<size_t> scramble(n);
+    std::iota(scramble.begin(), scramble.end(), 0);
+    std::mt19937 generator(3);
+    std::shuffle(scramble.begin(), scramble.end(), generator);
+    CSRMatrix<double> A = permute_symmetric_CSR(P, scramble);
+
+    for (Ordering ordering : {Ordering::ReverseCuthillMcKee, Ordering::NestedDissection}) {
+        vector<size_t> perm = compute_ordering_CSR(A, ordering);
+        REQUIRE(perm.size() == n);
+        CHECK_NOTHROW(inverse_permutation(perm));
+
+        // (P A P^T) (P x) = P (A x)
+        CSRMatrix<double> B = permute_symmetric_CSR(A, perm);
+        CHECK(B.val.size() == A.val.size());
+        vector<double> x(n);
+        for (size_t i = 0; i < n; i++) x[i] = std::sin(0.1 * i);
+        vector<double> Ax = permute_vector(matrix_vector_product_CSR(A, x), perm);
+        vector<double> BPx = matrix_vector_product_CSR(B, permute_vector(x, perm));
+        CHECK_VECTOR_EQ(BPx, Ax, 1e-12);
+        CHECK(unpermute_vector(permute_vector(x, perm), perm) == x);
+    }
+
+    // RCM recovers a band close to the grid width
+    CSRMatrix<double> R = permute_symmetric_CSR(A, reverse_cuthill_mckee_CSR(A));
+    CHECK(bandwidth_CSR(R) <= k + 1);
+    CHECK(profile_CSR(R) < profile_CSR(A) / 5);
+    CHECK(bandwidth_CSR(A) > 5 * k);
+
+    // nested dissection gives less Cholesky fill than the banded grid numbering
+    CHECK(cholesky_fill_count(permute_symmetric_CSR(A, nested_dissection_CSR(A, 16))) < cholesky_fill_count(P));
+    CHECK(cholesky_fill_count(R) < cholesky_fill_count(A));
+}
+
+TEST_CASE("Reordered solve CSR") {
+    CSRMatrix<double> A = symmetric_from_triangle_CSR(load_fileCSR<double>("../../../data/matrices/1138_bus.mtx"));
+    const size_t n = A.numRows;
+    vector<double> b(n, 1.0), x0(n, 0.0);
+    auto pcg = [](const CSRMatrix<double> &B, const vector<double> &rhs, const vector<double> &guess) {
+        return preconditioned_conjugate_gradient_CSR(B, rhs, guess, 5000, 1e-8, make_ssor_preconditioner_CSR(B, 1.0));
+    };
+    OrderingReport report;
+    vector<double> x = reordered_solve_CSR<double>(A, b, x0, reverse_cuthill_mckee_CSR(A), pcg, &report);
+    CHECK(report.bandwidthAfter < report.bandwidthBefore);
+    CHECK(report.profileAfter < report.profileBefore);
+    vector<double> Ax = matrix_vector_product_CSR(A, x);
+    CHECK_VECTOR_EQ(Ax, b, 1e-6);
+
+    vector<double> direct = pcg(A, b, x0);
+    CHECK_VECTOR_EQ(x, direct, 1e-4);
+}
+
+TEST_CASE("Sparse LU CSC with pivoting and refactorization") {
+    // unsymmetric 2D operator with its rows reversed, so most diagonal entries are
+    // zero and every column needs a row exchange
+    const size_t k = 15, n = k * k;
+    CSRMatrix<double> P = poisson2D_CSR(k);
+    for (size_t e = 0; e < P.val.size(); e++)
+        if (P.val[e] < 0) P.val[e] += 0.6 * std::sin(1.0 + e);
+    CSRMatrix<double> A;
+    A.numRows = A.numColumns = n;
+    A.row_ptr.push_back(0);
+    for (size_t i = 0; i < n; i++) {
+        const size_t r = n - 1 - i;
+        for (size_t e = P.row_ptr[r]; e < P.row_ptr[r + 1]; e++) {
+            A.col_ind.push_back(P.col_ind[e]);
+            A.val.push_back(P.val[e]);
+        }
+        A.row_ptr.push_back(A.col_ind.size());
+    }
+    CSCMatrix<double> C = convert_CSR_to_CSC(A);
+    vector<double> b(n);
+    for (size_t i = 0; i < n; i++) b[i] = std::cos(0.3 * i);
+
+    SparseLUSymbolic S = sparse_lu_analyze_CSC(C);
+    SparseLUNumeric<double> F = sparse_lu_factor_CSC(C, S, 1.0);
+    vector<double> x = sparse_lu_solve_CSC(F, b);
+    vector<double> Ax = matrix_vector_product_CSR(A, x);
+    CHECK_VECTOR_EQ(Ax, b, 1e-10);
+    CHECK(sparse_lu_solve_CSC(C, b) == sparse_lu_solve_CSC(sparse_lu_factor_CSC(C, S), b));
+
+    // same pattern, new values: refactor reuses pivots and patterns
+    CSCMatrix<double> C2 = C;
+    for (size_t e = 0; e < C2.val.size(); e++) C2.val[e] *= 1.0 + 0.1 * std::cos(3.0 * e);
+    CSRMatrix<double> A2t = transpose_matrixCSR(A);
+    A2t.val = C2.val;
+    CSRMatrix<double> A2 = transpose_matrixCSR(A2t);
+    sparse_lu_refactor_CSC(C2, F);
+    x = sparse_lu_solve_CSC(F, b);
+    Ax = matrix_vector_product_CSR(A2, x);
+    CHECK_VECTOR_EQ(Ax, b, 1e-9);
+
+    CSCMatrix<double> other = convert_CSR_to_CSC(poisson2D_CSR(k));
+    CHECK_THROWS_AS(sparse_lu_refactor_CSC(other, F), std::invalid_argument);
+}
+
+TEST_CASE("Sparse LU CSC ordering and singular matrices") {
+    CSCMatrix<double> C = convert_CSR_to_CSC(poisson2D_CSR(20));
+    SparseLUNumeric<double> natural = sparse_lu_factor_CSC(C, sparse_lu_analyze_CSC(C, ColumnOrdering::Natural));
+    SparseLUNumeric<double> ordered = sparse_lu_factor_CSC(C, sparse_lu_analyze_CSC(C, ColumnOrdering::MinimumDegree));
+    CHECK(ordered.L.val.size() + ordered.U.val.size() < natural.L.val.size() + natural.U.val.size());
+    vector<double> b(C.numRows, 1.0);
+    vector<double> x1 = sparse_lu_solve_CSC(natural, b), x2 = sparse_lu_solve_CSC(ordered, b);
+    CHECK_VECTOR_EQ(x1, x2, 1e-10);
+
+    vector<vector<double>> singular = {{1, 2, 0}, {3, 4, 0}, {0, 0, 0}};
+    CSCMatrix<double> Z = from_vector_CSC(singular);
+    CHECK_THROWS_AS(sparse_lu_factor_CSC(Z, sparse_lu_analyze_CSC(Z)), std::runtime_error);
+    vector<vector<double>> dependent = {{1, 2, 3}, {2, 4, 6}, {0, 1, 1}};
+    CSCMatrix<double> D = from_vector_CSC(dependent);
+    CHECK_THROWS_AS(sparse_lu_factor_CSC(D, sparse_lu_analyze_CSC(D)), std::runtime_error);
+}
+
+TEST_CASE("Sparse format conversions and triplet assembly") {
+    // unsorted COO with duplicates against the dense sum of its entries
+    COO::COOMatrix<double> A;
+    A.numRows = 7; A.numCols = 9;
+    vector<vector<double>> dense(7, vector<double>(9, 0.0));
+    for (size_t k = 0; k < 60; k++) {
+        A.rowCoord.push_back((k * 5 + 3) % 7);
+        A.colCoord.push_back((k * 7 + k / 9) % 9);
+        A.values.push_back(1.0 + k % 4);
+        dense[A.rowCoord.back()][A.colCoord.back()] += A.values.back();
+    }
+    A.nnz = A.values.size();
+    CSRMatrix<double> R = convert_COO_to_CSR(A);
+    CSRMatrix<double> expected = from_vector_CSR(dense);
+    CHECK(R.row_ptr == expected.row_ptr);
+    CHECK(R.col_ind == expected.col_ind);
+    CHECK(R.val == expected.val);
+
+    CSCMatrix<double> C = convert_COO_to_CSC(A);
+    CSCMatrix<double> expectedC = from_vector_CSC(dense);
+    CHECK(C.col_ptr == expectedC.col_ptr);
+    CHECK(C.row_ind == expectedC.row_ind);
+    CHECK(C.val == expectedC.val);
+
+    // round trips
+    CSCMatrix<double> C2 = convert_CSR_to_CSC(R);
+    CHECK(C2.col_ptr == C.col_ptr);
+    CHECK(C2.row_ind == C.row_ind);
+    CHECK(C2.val == C.val);
+    CSRMatrix<double> R2 = convert_CSC_to_CSR(C);
+    CHECK(R2.row_ptr == R.row_ptr);
+    CHECK(R2.col_ind == R.col_ind);
+    CHECK(R2.val == R.val);
+    COO::COOMatrix<double> B = convert_CSR_to_COO(R);
+    CHECK(B.nnz == R.val.size());
+    CHECK(B.colCoord == R.col_ind);
+    CSRMatrix<double> R3 = convert_COO_to_CSR(B);
+    CHECK(R3.row_ptr == R.row_ptr);
+    CHECK(R3.val == R.val);
+
+    // 1D linear finite elements: the element matrices sum to the 1D Laplacian
+    const size_t n = 50;
+    TripletAssemblerCSR<double> assembler(n, n);
+    assembler.reserve(4 * (n - 1));
+    for (size_t e = 0; e + 1 < n; e++) assembler.add_element({e + 1, e}, {1.0, -1.0, -1.0, 1.0});
+    CHECK(assembler.size() == 4 * (n - 1));
+    CSRMatrix<double> K = assembler.assemble();
+    CHECK(K.val.size() == 3 * n - 2);
+    for (size_t i = 0; i < n; i++) {
+        CHECK(get_matrixCSR(K, i, i) == ((i == 0 || i == n - 1) ? 1.0 : 2.0));
+        if (i + 1 < n) CHECK(get_matrixCSR(K, i, i + 1) == -1.0);
+        for (size_t p = K.row_ptr[i] + 1; p < K.row_ptr[i + 1]; p++) CHECK(K.col_ind[p - 1] < K.col_ind[p]);
+    }
+
+    CHECK_THROWS_AS(assembler.add(n, 0, 1.0), std::invalid_argument);
+    A.colCoord[3] = 9;
+    CHECK_THROWS_AS(convert_COO_to_CSR(A), std::invalid_argument);
+}
+
+TEST_CASE("CSR and CSC lookups and row views") {
+    CSRMatrix<double> A = poisson2D_CSR(12);
+    CSCMatrix<double> C = convert_CSR_to_CSC(A);
+    const size_t n = A.numRows;
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < n; j++) {
+            double expected = 0;
+            for (size_t p = A.row_ptr[i]; p < A.row_ptr[i + 1]; p++)
+                if (A.col_ind[p] == j) expected = A.val[p];
+            CHECK(get_matrixCSR(A, i, j) == expected);
+            CHECK(get_matrixCSC(C, i, j) == expected);
+            const size_t index = entry_index_CSR(A, i, j);
+            CHECK((index == A.val.size()) == (expected == 0));
+        }
+    }
+
+    // row views visit the stored entries in order
+    size_t visited = 0;
+    for (size_t i = 0; i < n; i++) {
+        CSRRowView<double> row = row_view_CSR(A, i);
+        CHECK(row.size() == A.row_ptr[i + 1] - A.row_ptr[i]);
+        size_t p = A.row_ptr[i];
+        for (auto entry : row) {
+            CHECK(entry.col == A.col_ind[p]);
+            CHECK(&entry.value == &A.val[p]);
+            p++;
+            visited++;
+        }
+    }
+    CHECK(visited == A.val.size());
+    double columnSum = 0;
+    for (auto entry : column_view_CSC(C, 13)) columnSum += entry.value * (entry.row + 1);
+    double expectedSum = 0;
+    for (size_t i = 0; i < n; i++) expectedSum += get_matrixCSR(A, i, 13) * (i + 1);
+    CHECK(columnSum == expectedSum);
+
+    CHECK_THROWS_AS(get_matrixCSR(A, n, 0), std::invalid_argument);
+    CHECK_THROWS_AS(get_matrixCSC(C, 0, n), std::invalid_argument);
+    CHECK_THROWS_AS(row_view_CSR(A, n), std::invalid_argument);
+}
+
+TEST_CASE("Output overloads and move-aware factories") {
+    vector<vector<double>> a = {{1, 0, 2}, {0, 3, 0}};
+    vector<vector<double>> b = {{0, 4, 0}, {5, 0, 6}};
+    vector<vector<double>> bt = {{0, 5}, {4, 0}, {0, 6}};
+    CSRMatrix<double> A = from_vector_CSR(a), B = from_vector_CSR(b), Bt = from_vector_CSR(bt);
+
+    // the output keeps its storage across calls
+    CSRMatrix<double> C;
+    add_into(C, A, B);
+    CHECKCSR(C, {{1, 4, 2}, {5, 3, 6}});
+    const double *storage = C.val.data();
+    subtract_into(C, A, B);
+    CHECKCSR(C, {{1, -4, 2}, {-5, 3, -6}});
+    CHECK(C.val.data() == storage);
+    multiply_into(C, A, Bt);
+    CHECKCSR(C, {{0, 17}, {12, 0}});
+    transpose_into(C, B);
+    CHECKCSR(C, bt);
+    CHECK_THROWS_AS(add_into(A, A, B), std::invalid_argument);
+
+    CSCMatrix<double> Ac = from_vector_CSC(a), Bc = from_vector_CSC(b), Btc = from_vector_CSC(bt), Cc;
+    multiply_into(Cc, Ac, Btc);
+    CHECK(Cc.numRows == 2);
+    CHECK(Cc.numColumns == 2);
+    CHECK(get_matrixCSC(Cc, 0, 1) == 17);
+    CHECK(get_matrixCSC(Cc, 1, 0) == 12);
+    CSCMatrix<double> product = multiply_matrixCSC(Btc, Ac);
+    CHECK(product.numRows == 3);
+    CHECK(product.numColumns == 3);
+    CHECK(get_matrixCSC(product, 1, 2) == 8);
+    subtract_into(Cc, Ac, Bc);
+    CHECK(get_matrixCSC(Cc, 1, 2) == -6);
+    CHECK_THROWS_AS(transpose_into(Ac, Ac), std::invalid_argument);
+
+    vector<vector<double>> dense;
+    multiply_into(dense, a, bt);
+    vector<vector<double>> expected = {{0, 17}, {12, 0}};
+    CHECK_MATRIX_EQ(dense, expected, 1e-12);
+    transpose_into(dense, a);
+    CHECK(dense == vector<vector<double>>{{1, 0}, {0, 3}, {2, 0}});
+    add_into(a, a, b);
+    CHECK(a == vector<vector<double>>{{1, 4, 2}, {5, 3, 6}});
+    CHECK_THROWS_AS(multiply_into(bt, bt, b), std::invalid_argument);
+
+    // the factories take over the arrays
+    vector<size_t> row_ptr = {0, 2, 3}, col_ind = {0, 2, 1};
+    vector<double> val = {1, 2, 3};
+    const double *data = val.data();
+    CSRMatrix<double> M = make_CSR(2, 3, std::move(row_ptr), std::move(col_ind), std::move(val));
+    CHECK(M.val.data() == data);
+    CHECK(get_matrixCSR(M, 0, 2) == 2);
+    CHECK_THROWS_AS(make_CSR<double>(2, 3, {0, 2, 1}, {0, 2, 1}, {1, 2, 3}), std::invalid_argument);
+    CHECK_THROWS_AS(make_CSR<double>(2, 3, {0, 1, 2}, {0, 3}, {1, 2}), std::invalid_argument);
+    CSCMatrix<double> N = make_CSC<double>(2, 3, {0, 1, 2, 3}, {0, 1, 0}, {1, 3, 2});
+    CHECK(get_matrixCSC(N, 0, 2) == 2);
+    CHECK_THROWS_AS(make_CSC<double>(2, 3, {0, 1, 2}, {0, 1}, {1, 3}), std::invalid_argument);
+}
+
+TEST_CASE("Elementwise and scalar kernels") {
+    vector<vector<double>> a = {{1, 0, -2}, {0, -3.5, 0}};
+    CSRMatrix<double> A = from_vector_CSR(a);
+    CSCMatrix<double> Ac = convert_CSR_to_CSC(A);
+    COO::COOMatrix<double> Ao = convert_CSR_to_COO(A);
+
+    // out of place: the pattern is copied and only the values are computed
+    CSRMatrix<double> C;
+    axpb_into(C, A, 2.0, 1.0);
+    CHECK(C.col_ind == A.col_ind);
+    CHECK(C.val == vector<double>{3, -3, -6});
+    CHECK(A.val == vector<double>{1, -2, -3.5});
+    scale_into(C, A, 0.5);
+    CHECK(C.val == vector<double>{0.5, -1, -1.75});
+    abs_into(C, A);
+    CHECK(C.val == vector<double>{1, 2, 3.5});
+    clamp_into(C, A, -2.0, 0.5);
+    CHECK(C.val == vector<double>{0.5, -2, -2});
+    multiply_elementwise_into(C, A, A);
+    CHECK(C.val == vector<double>{1, 4, 12.25});
+    CHECK_THROWS_AS(clamp_into(C, A, 1.0, 0.0), std::invalid_argument);
+    CHECK_THROWS_AS(multiply_elementwise_into(C, A, from_vector_CSR(vector<vector<double>>{{1, 1, 0}, {0, 1, 0}})),
+                    std::invalid_argument);
+
+    // in place, every format, the implicit zeros left alone
+    shift_in_place(Ac, 1.0);
+    CHECK(get_matrixCSC(Ac, 0, 2) == -1);
+    CHECK(get_matrixCSC(Ac, 0, 1) == 0);
+    axpb_in_place(Ao, -1.0, 0.5);
+    CHECK(Ao.values == vector<double>{-0.5, 2.5, 4});
+    abs_in_place(a);
+    CHECK(a == vector<vector<double>>{{1, 0, 2}, {0, 3.5, 0}});
+    vector<vector<double>> b = {{2, 2, 2}, {1, 1, 1}}, d;
+    multiply_elementwise_into(d, a, b);
+    CHECK(d == vector<vector<double>>{{2, 0, 4}, {0, 3.5, 0}});
+    clamp_in_place(d, 0.0, 3.0);
+    CHECK(d == vector<vector<double>>{{2, 0, 3}, {0, 3, 0}});
+
+    // any scalar type
+    CSRMatrix<int> I = from_vector_CSR(vector<vector<int>>{{-3, 0}, {0, 4}});
+    scale_in_place(I, -2);
+    CHECK(I.val == vector<int>{6, -8});
+    abs_in_place(I);
+    CHECK(I.val == vector<int>{6, 8});
+
+    // the scalar functions no longer truncate to int
+    COO::COOMatrix<double> B = convert_CSR_to_COO(A);
+    COO::scalar_mult_matrixCOO(B, 0.5);
+    COO::scalar_add_matrixCOO(B, 0.25);
+    CHECK(B.values == vector<double>{0.75, -0.75, -1.5});
+    // the scalar converts to the value type, so integer scalars still work on a double matrix
+    COO::scalar_mult_matrixCOO(B, 4);
+    COO::scalar_div_matrixCOO(B, 2);
+    COO::scalar_sub_matrixCOO(B, 1);
+    CHECK(B.values == vector<double>{0.5, -2.5, -4});
+    CHECK(scalar_multiply_CSR(A, 0.5).val == vector<double>{0.5, -1, -1.75});
+    CHECK(scalar_multiply(vector<vector<double>>{{1, 2}}, 0.5) == vector<vector<double>>{{0.5, 1}});
+}
+
+TEST_CASE("Fused matrix statistics") {
+    CSRMatrix<double> A = poisson2D_CSR(10);
+    vector<vector<double>> dense(A.numRows, vector<double>(A.numColumns, 0.0));
+    for (size_t i = 0; i < A.numRows; i++)
+        for (size_t p = A.row_ptr[i]; p < A.row_ptr[i + 1]; p++)
+            dense[i][A.col_ind[p]] = A.val[p];
+
+    MatrixStatistics<double> s = statistics_CSR(A);
+    MatrixStatistics<double> d = matrix_statistics(dense);
+    CHECK(s.nnz == A.val.size());
+    CHECK(d.nnz == A.val.size());
+    CHECK(s.min == -1);
+    CHECK(s.max == 4);
+    CHECK(d.min == -1);
+    CHECK(s.sum == doctest::Approx(d.sum));
+    CHECK(s.frobeniusNorm == doctest::Approx(d.frobeniusNorm));
+    CHECK(s.infNorm == 8);
+    CHECK(s.oneNorm == 8);
+    CHECK(d.infNorm == 8);
+    CHECK(s.dominanceRatio == 1);
+    CHECK(s.diagonallyDominant);
+    CHECK(s.patternSymmetric);
+    CHECK(d.patternSymmetric);
+    CHECK(diagonally_dominant(A));
+
+    // nothing is kept on the matrix, so copies and direct writes to val are seen
+    CSRMatrix<double> E = A;
+    E.val[1] = 10;
+    CHECK_FALSE(diagonally_dominant(E));
+    CHECK_FALSE(statistics_CSR(E).diagonallyDominant);
+    CHECK(find_max_CSR(E) == 10);
+    CHECK_THROWS_AS(jacobi_method_CSR(E, vector<double>(E.numRows, 1.0), 1e-9, 10), std::invalid_argument);
+    COO::COOMatrix<double> F = convert_CSR_to_COO(E);
+    F.values[0] = -20;
+    CHECK(COO::find_min_COO(F) == -20);
+    CHECK(COO::statistics_COO(F).min == -20);
+    A.val[0] = -2;
+    CHECK(find_min_CSR(A) == -2);
+    CHECK(statistics_CSR(A).min == -2);
+    CHECK(s.min == -1);
+    A.val[0] = 4;
+    CHECK(diagonally_dominant(A));
+    CHECK(find_max_CSR(A) == 4);
+    scale_in_place(A, 0.5);
+    CHECK(find_max_CSR(A) == 2);
+    CSRMatrix<double> sum = add_matrixCSR(A, A);
+    CHECK(find_max_CSR(sum) == 4);
+    add_into(sum, A, scalar_multiply_CSR(A, 2.0));
+    CHECK(find_max_CSR(sum) == 6);
+
+    // a non-symmetric pattern, not diagonally dominant
+    vector<vector<double>> b = {{1, 2, 0}, {0, 5, 0}, {0, 1, -3}};
+    CSRMatrix<double> B = from_vector_CSR(b);
+    s = statistics_CSR(B);
+    CHECK_FALSE(s.patternSymmetric);
+    CHECK_FALSE(s.diagonallyDominant);
+    CHECK_FALSE(diagonally_dominant(B));
+    CHECK(s.dominanceRatio == 0.5);
+    CHECK(s.oneNorm == 8);
+    CHECK(s.infNorm == 5);
+    CHECK(s.sum == 6);
+    MatrixStatistics<double> c = statistics_CSC(from_vector_CSC(b));
+    CHECK(c.oneNorm == 8);
+    CHECK(c.infNorm == 5);
+    CHECK(c.dominanceRatio == 0.5);
+    CHECK_FALSE(c.patternSymmetric);
+    MatrixStatistics<double> o = COO::statistics_COO(convert_CSR_to_COO(B));
+    CHECK(o.min == -3);
+    CHECK(o.nnz == 5);
+    CHECK(o.oneNorm == 8);
+    CHECK_FALSE(o.patternSymmetric);
+    d = matrix_statistics(b);
+    CHECK(d.nnz == 5);
+    CHECK(d.min == -3);
+    CHECK(d.dominanceRatio == 0.5);
+    CHECK_FALSE(d.patternSymmetric);
+
+    // rectangular matrices have no symmetric pattern; rows past the diagonal have none
+    s = statistics_CSR(from_vector_CSR(vector<vector<double>>{{2, 1}, {1, 2}, {0, 0}}));
+    CHECK_FALSE(s.patternSymmetric);
+    CHECK(s.diagonallyDominant);
+    CHECK(s.oneNorm == 3);
+}
+
+TEST_CASE("Expression templates for dense arithmetic") {
+    using expr::term;
+    vector<vector<double>> A = generate_random_matrix(7, 5, -1, 1);
+    vector<vector<double>> B = generate_random_matrix(7, 5, -1, 1);
+    vector<vector<double>> C = generate_random_matrix(7, 5, -1, 1);
+    vector<vector<double>> S = generate_random_matrix(5, 5, -1, 1);
+
+    // one fused pass, no temporaries
+    vector<vector<double>> D;
+    expr::assign(D, 2.0 * term(A) + term(B) * 3.0 - term(C));
+    vector<vector<double>> check = sub_matrix(sum_matrix(scalar_multiply(A, 2.0), scalar_multiply(B, 3.0)), C);
+    CHECK_MATRIX_EQ(D, check, 1e-12);
+    D = expr::evaluate(-term(A) - term(B));
+    check = scalar_multiply(sum_matrix(A, B), -1.0);
+    CHECK_MATRIX_EQ(D, check, 1e-12);
+
+    // products go to the GEMM kernel, scaled operands and compound operands included
+    expr::assign(D, 0.5 * term(A) * term(S) + term(C));
+    check = sum_matrix(scalar_multiply(mult_matrix(A, S), 0.5), C);
+    CHECK_MATRIX_EQ(D, check, 1e-12);
+    expr::assign(D, term(C) - (term(A) + term(B)) * (2.0 * term(S)));
+    check = sub_matrix(C, scalar_multiply(mult_matrix(sum_matrix(A, B), S), 2.0));
+    CHECK_MATRIX_EQ(D, check, 1e-12);
+    vector<vector<double>> big = generate_random_matrix(300, 260, -1, 1), bigS = generate_random_matrix(260, 270, -1, 1);
+    vector<vector<double>> bigD = expr::evaluate(term(big) * term(bigS));
+    check = mult_matrix(big, bigS);
+    CHECK_MATRIX_EQ(bigD, check, 1e-10);
+
+    // the destination may be an operand, of a product too
+    D = A;
+    expr::assign(D, term(D) + term(B));
+    check = sum_matrix(A, B);
+    CHECK_MATRIX_EQ(D, check, 1e-12);
+    D = A;
+    expr::assign(D, term(D) * term(S) + term(D));
+    check = sum_matrix(mult_matrix(A, S), A);
+    CHECK_MATRIX_EQ(D, check, 1e-12);
+
+    CHECK_THROWS_AS(term(A) + term(S), std::invalid_argument);
+    CHECK_THROWS_AS(term(A) * term(B), std::invalid_argument);
+}
+
+TEST_CASE("Fixed-size small matrix kernels") {
+    FixedMatrix<double, 3, 3> A = {{4, -2, 1, -2, 4, -2, 1, -2, 4}};
+    FixedMatrix<double, 3, 2> B = {{1, 2, 3, 4, 5, 6}};
+    vector<vector<double>> a = to_dense(A), b = to_dense(B);
+    vector<vector<double>> product = to_dense(A * B), check = mult_matrix(a, b);
+    CHECK_MATRIX_EQ(product, check, 1e-14);
+    CHECK(transpose_fixed(transpose_fixed(B)) == B);
+    CHECK(to_fixed<double, 3, 2>(b) == B);
+    CHECK_THROWS_AS((to_fixed<double, 2, 3>(b)), std::invalid_argument);
+
+    // LU with pivoting, solve, inverse and determinant
+    FixedVector<double, 3> x = {1, -1, 2};
+    FixedVector<double, 3> rhs = A * x;
+    FixedVector<double, 3> solved = solve_fixed(A, rhs);
+    for (size_t i = 0; i < 3; i++)
+        CHECK(abs(solved[i] - x[i]) < 1e-12);
+    vector<vector<double>> identity = to_dense(A * inverse_fixed(A)), I = identity_matrix(3);
+    CHECK_MATRIX_EQ(identity, I, 1e-12);
+    CHECK(abs(determinant_fixed(A) - find_matrix_determinant(a)) < 1e-10);
+    FixedMatrix<double, 2, 2> swapped = {{0, 1, 1, 0}};
+    CHECK(determinant_fixed(swapped) == -1);
+    CHECK(determinant_fixed(FixedMatrix<double, 2, 2>{{1, 2, 2, 4}}) == 0);
+    CHECK_THROWS_AS(lu_fixed(FixedMatrix<double, 2, 2>{{1, 2, 2, 4}}), std::runtime_error);
+    FixedMatrix<double, 3, 2> X = lu_solve_fixed(lu_fixed(A), A * B);
+    vector<vector<double>> x2 = to_dense(X);
+    CHECK_MATRIX_EQ(x2, b, 1e-12);
+
+    // Cholesky matches the dense factorization
+    vector<vector<double>> L = to_dense(cholesky_fixed(A)), Ld = cholesky_factorization(a);
+    CHECK_MATRIX_EQ(L, Ld, 1e-14);
+    solved = cholesky_solve_fixed(cholesky_fixed(A), rhs);
+    for (size_t i = 0; i < 3; i++)
+        CHECK(abs(solved[i] - x[i]) < 1e-12);
+    CHECK_THROWS_AS(cholesky_fixed(FixedMatrix<double, 2, 2>{{1, 2, 2, 1}}), std::invalid_argument);
+
+    // blocks stored inside a larger array
+    vector<double> blocks = {1, 2, 3, 4, 5, 6, 7, 8}, y = {1, 1};
+    block_multiply_add<2, 2>(blocks.data() + 4, x.data(), y.data());
+    CHECK(y[0] == 1 + 5 - 6);
+    CHECK(y[1] == 1 + 7 - 8);
+    FixedMatrix<double, 2, 2> block;
+    load_fixed(block, blocks.data() + 4);
+    store_fixed(2.0 * block, blocks.data());
+    CHECK(blocks[3] == 16);
+
+    // gaussian_elimination takes the fixed path up to 16x16 and the general one above
+    for (int n : {1, 2, 7, 16, 17})
+    {
+        vector<vector<double>> M = generate_random_matrix(n, n, -1, 1);
+        for (int i = 0; i < n; i++)
+            M[i][i] += n;
+        vector<double> truth(n, 1.0), rhsDense = left_mult_vector(M, truth);
+        CHECK(gaussian_elimination(M, rhsDense));
+        CHECK_VECTOR_EQ(rhsDense, truth, 1e-10);
+    }
+    int calls = 0;
+    CHECK(dispatch_fixed_size(5, [&](auto size) { calls += decltype(size)::value; }));
+    CHECK_FALSE(dispatch_fixed_size(17, [&](auto) { calls++; }));
+    CHECK_FALSE(dispatch_fixed_size(0, [&](auto) { calls++; }));
+    CHECK(calls == 5);
+}
+
+TEST_CASE("Batched small matrix GEMM, LU and solve") {
+    const size_t count = 37;
+    vector<vector<vector<double>>> a, b, rhs;
+    for (size_t m = 0; m < count; m++)
+    {
+        a.push_back(generate_random_matrix(4, 4, -1, 1));
+        for (size_t i = 0; i < 4; i++)
+            a[m][i][i] += 4;
+        b.push_back(generate_random_matrix(4, 3, -1, 1));
+        rhs.push_back(generate_random_matrix(4, 2, -1, 1));
+    }
+    BatchedMatrices<double> A = pack_batched(a), B = pack_batched(b);
+    CHECK(A(5, 2, 1) == a[5][2][1]);
+
+    // interleaved GEMM, overwriting and then accumulating
+    BatchedMatrices<double> C;
+    batched_gemm(C, 2.0, A, B, 0.0);
+    batched_gemm(C, 3.0, A, B, -1.0);
+    for (size_t m = 0; m < count; m++)
+    {
+        vector<vector<double>> c = unpack_batched(C, m), check = mult_matrix(a[m], b[m]);
+        CHECK_MATRIX_EQ(c, check, 1e-12);
+    }
+    CHECK_THROWS_AS(batched_gemm(C, 1.0, B, A, 0.0), std::invalid_argument);
+    CHECK_THROWS_AS(batched_gemm(C, 1.0, A, C, 0.0), std::invalid_argument);
+    // square members take the kernel with every dimension fixed
+    BatchedMatrices<double> S;
+    batched_gemm(S, 1.0, A, A, 0.0);
+    for (size_t m = 0; m < count; m++)
+    {
+        vector<vector<double>> s = unpack_batched(S, m), check = mult_matrix(a[m], a[m]);
+        CHECK_MATRIX_EQ(s, check, 1e-12);
+    }
+
+    // LU matches the dense factorization, and solve recovers the right hand sides
+    BatchedLU<double> f = batched_lu(A);
+    vector<vector<double>> lu = a[3];
+    lu_factorization_inplace(lu);
+    vector<vector<double>> lu3 = unpack_batched(f.lu, 3);
+    CHECK_MATRIX_EQ(lu3, lu, 1e-12);
+    BatchedMatrices<double> X = pack_batched(rhs);
+    batched_lu_solve(f, X);
+    BatchedMatrices<double> AX;
+    batched_gemm(AX, 1.0, A, X, 0.0);
+    for (size_t m = 0; m < count; m++)
+    {
+        CHECK(f.info[m] == 0);
+        vector<vector<double>> ax = unpack_batched(AX, m);
+        CHECK_MATRIX_EQ(ax, rhs[m], 1e-10);
+    }
+
+    // above 16 x 16 the kernels take the size at run time; a singular member is reported
+    vector<vector<vector<double>>> big = {generate_random_matrix(18, 18, -1, 1), vector<vector<double>>(18, vector<double>(18, 1.0))};
+    for (size_t i = 0; i < 18; i++)
+        big[0][i][i] += 18;
+    BatchedMatrices<double> ones = make_batched<double>(2, 18, 1);
+    for (size_t i = 0; i < 18; i++)
+        ones(0, i, 0) = ones(1, i, 0) = 1;
+    BatchedMatrices<double> x = ones;
+    vector<int> info = batched_solve(pack_batched(big), x);
+    CHECK(info[0] == 0);
+    CHECK(info[1] == 2);
+    vector<double> x0(18), one(18, 1.0);
+    for (size_t i = 0; i < 18; i++)
+        x0[i] = x(0, i, 0);
+    vector<double> back = left_mult_vector(big[0], x0);
+    CHECK_VECTOR_EQ(back, one, 1e-10);
+
+    // members move to and from fixed matrices
+    FixedMatrix<double, 4, 4> member;
+    load_fixed(member, A, 7);
+    CHECK(to_dense(member) == a[7]);
+    store_fixed(2.0 * member, A, 7);
+    CHECK(A(7, 3, 3) == 2 * a[7][3][3]);
+    CHECK_THROWS_AS(load_fixed(member, B, 0), std::invalid_argument);
+    CHECK_THROWS_AS(pack_batched(vector<vector<vector<double>>>{a[0], b[0]}), std::invalid_argument);
+}
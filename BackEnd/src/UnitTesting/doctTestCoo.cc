@@ -6,7 +6,7 @@
 
 using namespace std;
 
-void CHECKCOO(COO::COOMatrix<int> mResult, std::vector<std::vector<int>> mCheck) {
+void CHECKCOO(const COO::COOMatrix<int>& mResult, const std::vector<std::vector<int>>& mCheck) {
     CHECK(mResult.numRows == mCheck.size());
     for(size_t i = 0; i < mResult.numRows;i++){
         CHECK(mResult.numCols == mCheck[i].size());
@@ -25,3 +25,111 @@ TEST_CASE("Testing COO Add") {
 
     
 }
+
+// dense product of two small COO matrices, for reference
+vector<vector<double>> dense_product(const COO::COOMatrix<double>& A, const COO::COOMatrix<double>& B) {
+    vector<vector<double>> a(A.numRows, vector<double>(A.numCols, 0.0)), c(A.numRows, vector<double>(B.numCols, 0.0));
+    for (size_t k = 0; k < A.values.size(); k++) a[A.rowCoord[k]][A.colCoord[k]] += A.values[k];
+    for (size_t k = 0; k < B.values.size(); k++)
+        for (size_t i = 0; i < A.numRows; i++) c[i][B.colCoord[k]] += a[i][B.rowCoord[k]] * B.values[k];
+    return c;
+}
+
+TEST_CASE("Testing COO Multiply") {
+    // unsorted input with entries in any order
+    COO::COOMatrix<double> A, B;
+    A.numRows = 30; A.numCols = 20; B.numRows = 20; B.numCols = 25;
+    for (size_t k = 0; k < 120; k++) {
+        A.rowCoord.push_back((k * 7) % 30); A.colCoord.push_back((k * 11 + k / 30) % 20); A.values.push_back(std::sin(k + 1.0));
+        B.rowCoord.push_back((k * 13) % 20); B.colCoord.push_back((k * 3 + k / 20) % 25); B.values.push_back(std::cos(k + 1.0));
+    }
+    A.nnz = B.nnz = 120;
+    COO::COOMatrix<double> C = COO::multiply_matrixCOO(A, B);
+    vector<vector<double>> reference = dense_product(A, B);
+    CHECK(C.numRows == 30);
+    CHECK(C.numCols == 25);
+    CHECK(C.nnz == C.values.size());
+    for (size_t k = 0; k < C.values.size(); k++) {
+        CHECK(C.values[k] == doctest::Approx(reference[C.rowCoord[k]][C.colCoord[k]]));
+        if (k > 0) CHECK((C.rowCoord[k - 1] < C.rowCoord[k] || (C.rowCoord[k - 1] == C.rowCoord[k] && C.colCoord[k - 1] < C.colCoord[k])));
+    }
+    size_t structural = 0;
+    for (auto& row : reference) for (double v : row) structural += v != 0;
+    CHECK(C.values.size() >= structural);
+
+    // a very wide B goes through the hash accumulator
+    COO::COOMatrix<double> W;
+    W.numRows = 20; W.numCols = 100000000; W.nnz = 3;
+    W.rowCoord = {4, 4, 7}; W.colCoord = {99999999, 5, 5}; W.values = {2.0, 3.0, 4.0};
+    COO::COOMatrix<double> D = COO::multiply_matrixCOO(A, W);
+    CHECK(!D.values.empty());
+    for (size_t k = 0; k < D.values.size(); k++) {
+        double expected = 0;
+        for (size_t a = 0; a < A.values.size(); a++)
+            for (size_t b = 0; b < W.values.size(); b++)
+                if (A.rowCoord[a] == D.rowCoord[k] && A.colCoord[a] == W.rowCoord[b] && W.colCoord[b] == D.colCoord[k])
+                    expected += A.values[a] * W.values[b];
+        CHECK(D.values[k] == doctest::Approx(expected));
+    }
+
+    CHECK_THROWS_AS(COO::multiply_matrixCOO(B, B), std::invalid_argument);
+}
+
+TEST_CASE("Testing COO Canonicalize and Transpose") {
+    // unsorted triplets with duplicates, one pair of which cancels
+    COO::COOMatrix<double> A;
+    A.numRows = 4; A.numCols = 5;
+    A.rowCoord = {3, 0, 2, 0, 3, 1, 0, 2};
+    A.colCoord = {1, 4, 2, 0, 1, 3, 4, 2};
+    A.values   = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, -3.0};
+    A.nnz = 8;
+    COO::COOMatrix<double> C = COO::canonicalize_COO(A);
+    CHECK(C.nnz == 5);
+    CHECK(C.rowCoord == vector<size_t>({0, 0, 1, 2, 3}));
+    CHECK(C.colCoord == vector<size_t>({0, 4, 3, 2, 1}));
+    CHECK(C.values == vector<double>({4.0, 9.0, 6.0, 0.0, 6.0}));
+
+    COO::COOMatrix<double> T = COO::transpose_matrixCOO(A);
+    CHECK(T.numRows == 5);
+    CHECK(T.numCols == 4);
+    CHECK(T.rowCoord == vector<size_t>({0, 1, 2, 3, 4}));
+    CHECK(T.colCoord == vector<size_t>({0, 3, 2, 1, 0}));
+    CHECK(T.values == vector<double>({4.0, 6.0, 0.0, 6.0, 9.0}));
+
+    // canonical inputs are what the merge in add_matrixCOO expects
+    COO::COOMatrix<double> S = COO::add_matrixCOO(C, COO::transpose_matrixCOO(T));
+    CHECK(S.values == vector<double>({8.0, 18.0, 12.0, 0.0, 12.0}));
+
+    // coordinates wider than one radix digit take several passes
+    COO::COOMatrix<double> W;
+    W.numRows = 3; W.numCols = size_t(1) << 40;
+    W.rowCoord = {1, 1, 0, 1};
+    W.colCoord = {(size_t(1) << 39) + 7, 70000, size_t(1) << 32, 70001};
+    W.values = {1.0, 2.0, 3.0, 4.0};
+    COO::COOMatrix<double> V = COO::canonicalize_COO(W);
+    CHECK(V.colCoord == vector<size_t>({size_t(1) << 32, 70000, 70001, (size_t(1) << 39) + 7}));
+    CHECK(V.values == vector<double>({3.0, 2.0, 4.0, 1.0}));
+
+    W.rowCoord[0] = 3;
+    CHECK_THROWS_AS(COO::canonicalize_COO(W), std::invalid_argument);
+}
+
+TEST_CASE("Testing COO Hashed Index") {
+    COO::COOMatrix<double> A;
+    A.numRows = 50; A.numCols = 40;
+    for (size_t k = 0; k < 300; k++) {
+        A.rowCoord.push_back((k * 17) % 50);
+        A.colCoord.push_back((k * 7 + k / 50) % 40);
+        A.values.push_back(k + 1.0);
+    }
+    A.nnz = A.values.size();
+    COO::COOIndex<double> index(A);
+    for (size_t i = 0; i < A.numRows; i++) {
+        for (size_t j = 0; j < A.numCols; j++) {
+            CHECK(index.get(i, j) == COO::get_matrixCOO(A, i, j));
+        }
+    }
+    CHECK(index.find(A.rowCoord[123], A.colCoord[123]) <= 123);
+    CHECK_THROWS_AS(index.get(50, 0), std::invalid_argument);
+    CHECK_THROWS_AS(COO::get_matrixCOO(A, 0, 40), std::invalid_argument);
+}
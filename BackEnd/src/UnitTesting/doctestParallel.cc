@@ -2,6 +2,14 @@
 #include "doctest.h"
 #include "../functionsCSRParallel.cc"
 #include "../functionsParallel.cc"
+#include "../functionsGMGParallel.cc"
+#include "../functionsEigenParallel.cc"
+#include "../functionsCholeskyParallel.cc"
+#include "../functionsCOOParallel.cc"
+#include "../functionsConversionParallel.cc"
+#include "../functionsElementwiseParallel.cc"
+#include "../functionsExpressionParallel.cc"
+#include "../functionsBatchedParallel.cc"
 #include "fstream"
 //Basic Unit tests for CSR add, multiply, and transpose
 //Use -d to time the tests
@@ -254,4 +262,954 @@ TEST_CASE("SSOR (W = 1.5) CSR 1")
 
     std::vector<double> x_expected = {0.714286, 1.190476, 1.666667};
     std::vector<double> x = parallel::ssor_iteration_CSR<double>(CSR_A, b,tol, max_iter,omega);
-}
\ No newline at end of file
+}
+TEST_CASE("Multicolor SSOR CSR independent of thread count")
+{
+    const size_t n = 200;
+    CSRMatrix<double> A;
+    A.numRows = n;
+    A.numColumns = n;
+    A.row_ptr.push_back(0);
+    for (size_t i = 0; i < n; i++) {
+        if (i > 0) { A.val.push_back(-1.0); A.col_ind.push_back(i - 1); }
+        A.val.push_back(4.0); A.col_ind.push_back(i);
+        if (i < n - 1) { A.val.push_back(-1.0); A.col_ind.push_back(i + 1); }
+        A.row_ptr.push_back(A.val.size());
+    }
+    std::vector<double> b(n, 1.0);
+
+    std::vector<double> x1, x4;
+    tbb::task_arena(1).execute([&]() { x1 = parallel::ssor_iteration_CSR<double>(A, b, 1e-10, 500, 1.2); });
+    tbb::task_arena(4).execute([&]() { x4 = parallel::ssor_iteration_CSR<double>(A, b, 1e-10, 500, 1.2); });
+    CHECK_VECTOR_EQ(x1, x4, 1e-15);
+
+    std::vector<double> Ax = matrix_vector_product_CSR(A, x4);
+    CHECK_VECTOR_EQ(Ax, b, 1e-8);
+}
+
+TEST_CASE("PCG with multicolor SSOR preconditioner")
+{
+    std::vector<std::vector<double>> A = {{4.0, 1.0, 1.0}, {1.0, 4.0, 1.0}, {1.0, 1.0, 4.0}};
+    auto CSR_A = from_vector_CSR<double>(A);
+    std::vector<double> b = {6.0, 6.0, 6.0};
+    std::vector<double> x0(3, 0.0);
+
+    auto M = parallel::make_ssor_preconditioner_CSR(CSR_A, 1.0);
+    std::vector<double> x = preconditioned_conjugate_gradient_CSR(CSR_A, b, x0, 100, 1e-10, M);
+
+    std::vector<double> x_expected = {1.0, 1.0, 1.0};
+    CHECK_VECTOR_EQ(x, x_expected, 1e-8);
+}
+
+TEST_CASE("Weighted Jacobi Iteration CSR matches serial")
+{
+    std::vector<std::vector<double>> A = {{3.0, 1.0, 1.0}, {1.0, 5.0, 2.0}, {2.0, 3.0, 6.0}};
+    auto CSR_A = from_vector_CSR<double>(A);
+    const std::vector<double> b = {5.0, 10.0, 15.0};
+
+    std::vector<double> serial = jacobi_method_CSR(CSR_A, b, 1e-9, 500, 0.8, 4);
+    std::vector<double> x = parallel::jacobi_method_CSR(CSR_A, b, 1e-9, 500, 0.8, 4);
+    CHECK_VECTOR_EQ(x, serial, 1e-15);
+
+    std::vector<double> x_expected = {0.714286, 1.190476, 1.666667};
+    CHECK_VECTOR_EQ(x, x_expected, 1e-6);
+}
+
+TEST_CASE("Geometric multigrid stencil operator matches CSR")
+{
+    parallel::StencilProblem<double> s;
+    s.dims = 3;
+    s.n[0] = 5; s.n[1] = 4; s.n[2] = 3;
+    s.center = 7.0;
+    s.lower[0] = -1.5; s.upper[0] = -0.5;
+    s.lower[1] = -1.0; s.upper[1] = -1.0;
+    s.lower[2] = -2.0; s.upper[2] = -0.25;
+    vector<double> x(s.size()), y;
+    for (size_t i = 0; i < x.size(); i++) x[i] = std::sin(1.0 + i);
+    parallel::stencil_apply(s, x, y);
+    vector<double> check = matrix_vector_product_CSR(parallel::stencil_to_CSR(s), x);
+    CHECK_VECTOR_EQ(y, check, 1e-12);
+}
+
+TEST_CASE("Geometric multigrid cycle count independent of grid size")
+{
+    for (size_t dims : {1, 2, 3})
+    {
+        vector<int> cycles;
+        for (size_t m : {15, 31, 63})
+        {
+            if (dims == 3 && m == 63)
+                continue;
+            parallel::StencilProblem<double> s = parallel::poisson_stencil<double>(dims, m);
+            parallel::GMGHierarchy<double> H = parallel::gmg_setup(s);
+            vector<double> b(s.size(), 1.0), Ax;
+            SolverInfo info;
+            vector<double> x = parallel::gmg_solve(H, b, 1e-8, 50, &info);
+            parallel::stencil_apply(s, x, Ax);
+            CHECK(info.converged);
+            CHECK_VECTOR_EQ(Ax, b, 1e-7);
+            cycles.push_back(info.iterations);
+        }
+        CHECK(cycles.back() <= cycles.front() + 2);
+        CHECK(cycles.back() < 12);
+    }
+}
+
+TEST_CASE("Geometric multigrid W, F cycles and Jacobi smoothing")
+{
+    // the tridiagonal (-0.5, 2, -0.5) benchmark matrix and a 2D convection-diffusion stencil
+    parallel::StencilProblem<double> tri;
+    tri.n[0] = 4095;
+    tri.center = 2.0;
+    tri.lower[0] = -0.5;
+    tri.upper[0] = -0.5;
+    parallel::StencilProblem<double> conv = parallel::poisson_stencil<double>(2, 63);
+    conv.lower[0] = -1.2;
+    conv.upper[0] = -0.8;
+
+    for (parallel::GMGCycle cycle : {parallel::GMGCycle::V, parallel::GMGCycle::W, parallel::GMGCycle::F})
+    {
+        for (parallel::GMGSmoother smoother : {parallel::GMGSmoother::RedBlackGaussSeidel, parallel::GMGSmoother::Jacobi})
+        {
+            parallel::GMGOptions options;
+            options.cycle = cycle;
+            options.smoother = smoother;
+            for (const parallel::StencilProblem<double> &s : {tri, conv})
+            {
+                parallel::GMGHierarchy<double> H = parallel::gmg_setup(s, options);
+                vector<double> b(s.size(), 1.0), Ax;
+                SolverInfo info;
+                vector<double> x = parallel::gmg_solve(H, b, 1e-8, 100, &info);
+                parallel::stencil_apply(s, x, Ax);
+                CHECK(info.converged);
+                CHECK_VECTOR_EQ(Ax, b, 1e-7);
+            }
+        }
+    }
+}
+
+TEST_CASE("PCG with geometric multigrid preconditioner")
+{
+    parallel::StencilProblem<double> s = parallel::poisson_stencil<double>(2, 127);
+    parallel::GMGOptions options;
+    options.symmetric = true;
+    parallel::GMGHierarchy<double> H = parallel::gmg_setup(s, options);
+    CSRMatrix<double> A = parallel::stencil_to_CSR(s);
+    vector<double> b(s.size(), 1.0), x0(s.size(), 0.0);
+    SolverInfo info;
+    vector<double> x = preconditioned_conjugate_gradient_CSR(A, b, x0, 100, 1e-8, parallel::make_gmg_preconditioner(H), &info);
+    vector<double> Ax = matrix_vector_product_CSR(A, x);
+    CHECK(info.converged);
+    CHECK(info.iterations < 15);
+    CHECK_VECTOR_EQ(Ax, b, 1e-7);
+}
+
+TEST_CASE("Chebyshev smoother CSR matches serial")
+{
+    parallel::StencilProblem<double> s = parallel::poisson_stencil<double>(2, 40);
+    CSRMatrix<double> A = parallel::stencil_to_CSR(s);
+    ChebyshevCSR<double> C = chebyshev_setup_CSR(A, 5, 30.0);
+    vector<double> b(A.numRows), xSerial(A.numRows, 0.0), xParallel(A.numRows, 0.0);
+    for (size_t i = 0; i < b.size(); i++) b[i] = std::cos(0.1 * i);
+    chebyshev_smooth_CSR(A, C, b, xSerial);
+    parallel::chebyshev_smooth_CSR(A, C, b, xParallel);
+    CHECK_VECTOR_EQ(xParallel, xSerial, 1e-12);
+
+    vector<double> x0(A.numRows, 0.0);
+    SolverInfo info;
+    vector<double> x = preconditioned_conjugate_gradient_CSR(A, b, x0, 500, 1e-8, parallel::make_chebyshev_preconditioner_CSR(A, C), &info);
+    vector<double> Ax = parallel::matrix_vector_product_CSR(A, x);
+    CHECK(info.converged);
+    CHECK_VECTOR_EQ(Ax, b, 1e-7);
+}
+
+TEST_CASE("Parallel pipelined and s-step CG")
+{
+    parallel::StencilProblem<double> stencil = parallel::poisson_stencil<double>(2, 48);
+    CSRMatrix<double> A = parallel::stencil_to_CSR(stencil);
+    vector<double> b(A.numRows), x0(A.numRows, 0.0), Ax;
+    for (size_t i = 0; i < b.size(); i++) b[i] = 1.0 + std::sin(0.3 * i);
+
+    SolverInfo cg, pipelined;
+    vector<double> x = parallel::conjugate_gradient_CSR(A, b, x0, 2000, 1e-8, &cg);
+    Ax = matrix_vector_product_CSR(A, x);
+    CHECK(cg.converged);
+    CHECK_VECTOR_EQ(Ax, b, 1e-7);
+
+    x = parallel::pipelined_conjugate_gradient_CSR(A, b, x0, 2000, 1e-8, &pipelined);
+    Ax = matrix_vector_product_CSR(A, x);
+    CHECK(pipelined.converged);
+    CHECK(std::abs(pipelined.iterations - cg.iterations) <= 3);
+    CHECK_VECTOR_EQ(Ax, b, 1e-7);
+
+    for (int s : {2, 4}) {
+        SolverInfo sStep;
+        x = parallel::s_step_conjugate_gradient_CSR(A, b, x0, s, 2000, 1e-8, &sStep);
+        Ax = matrix_vector_product_CSR(A, x);
+        CHECK(sStep.converged);
+        CHECK(sStep.iterations <= cg.iterations + 2 * s);
+        CHECK_VECTOR_EQ(Ax, b, 1e-7);
+    }
+}
+
+// Run with -d to compare the solvers; every time is the best of three solves. Pipelined
+// CG is one pass over the rows with one reduction per iteration, against three passes
+// and two reductions for plain CG. On one thread it costs the same per iteration while
+// its seven vectors fit in cache and about 10% more once they do not (CG keeps four);
+// on many threads the saved barriers win. s-step CG does about twice the work per
+// iteration to have one reduction every s iterations, which shared memory does not repay.
+TEST_CASE("CG reduction variants TIME")
+{
+    for (size_t m : {64, 256}) {
+        parallel::StencilProblem<double> stencil = parallel::poisson_stencil<double>(2, m);
+        CSRMatrix<double> A = parallel::stencil_to_CSR(stencil);
+        vector<double> b(A.numRows, 1.0), x0(A.numRows, 0.0);
+        const double tol = 1e-8 * std::sqrt(double(A.numRows));
+        SolverInfo cg, pipelined, sStep;
+        double tCG = 1e300, tPipelined = 1e300, tSStep = 1e300;
+        for (int run = 0; run < 3; run++) {
+            timer stopwatch;
+            parallel::conjugate_gradient_CSR(A, b, x0, 5000, tol, &cg);
+            tCG = std::min(tCG, stopwatch.elapsed());
+            parallel::pipelined_conjugate_gradient_CSR(A, b, x0, 5000, tol, &pipelined);
+            tPipelined = std::min(tPipelined, stopwatch.elapsed());
+            parallel::s_step_conjugate_gradient_CSR(A, b, x0, 4, 5000, tol, &sStep);
+            tSStep = std::min(tSStep, stopwatch.elapsed());
+        }
+        std::cerr << "n = " << A.numRows << ": CG " << tCG << "s / " << cg.iterations << " iterations, pipelined CG "
+                  << tPipelined << "s / " << pipelined.iterations << ", s-step CG (s = 4) " << tSStep << "s / "
+                  << sStep.iterations << "; per iteration " << 1e3 * tCG / cg.iterations << " / "
+                  << 1e3 * tPipelined / pipelined.iterations << " / " << 1e3 * tSStep / sStep.iterations << " ms"
+                  << std::endl;
+        CHECK(cg.converged);
+        CHECK(pipelined.converged);
+        CHECK(sStep.converged);
+    }
+}
+
+TEST_CASE("Parallel SpMM both layouts and transpose")
+{
+    CSRMatrix<double> A = load_fileCSR<double>("../../../data/matrices/1138_bus.mtx");
+    CSRMatrix<double> At = transpose_matrixCSR(A);
+    for (size_t k : {1, 3, 8, 13}) {
+        DenseBlock<double> X(A.numColumns, k);
+        ColumnMajorBlock<double> Xc(A.numColumns, k);
+        for (size_t i = 0; i < A.numColumns; i++) {
+            for (size_t j = 0; j < k; j++) {
+                X(i, j) = std::sin(0.01 * i + j);
+                Xc(i, j) = X(i, j);
+            }
+        }
+        DenseBlock<double> Y = parallel::multiply_block_CSR(A, X);
+        ColumnMajorBlock<double> Yc = parallel::multiply_block_CSR(A, Xc);
+        DenseBlock<double> Yt = parallel::multiply_block_transpose_CSR(A, X);
+        ColumnMajorBlock<double> Ytc = parallel::multiply_block_transpose_CSR(A, Xc);
+        DenseBlock<double> YtSerial = multiply_block_transpose_CSR(A, X);
+        for (size_t j = 0; j < k; j++) {
+            vector<double> x(A.numColumns), y(A.numRows), yc(A.numRows), yt(A.numColumns), ytc(A.numColumns), yts(A.numColumns);
+            for (size_t i = 0; i < A.numColumns; i++) x[i] = X(i, j);
+            for (size_t i = 0; i < A.numRows; i++) { y[i] = Y(i, j); yc[i] = Yc(i, j); }
+            for (size_t i = 0; i < A.numColumns; i++) { yt[i] = Yt(i, j); ytc[i] = Ytc(i, j); yts[i] = YtSerial(i, j); }
+            vector<double> check = matrix_vector_product_CSR(A, x);
+            vector<double> checkT = matrix_vector_product_CSR(At, x);
+            CHECK_VECTOR_EQ(y, check, 1e-9);
+            CHECK_VECTOR_EQ(yc, check, 1e-9);
+            CHECK_VECTOR_EQ(yt, checkT, 1e-9);
+            CHECK_VECTOR_EQ(ytc, checkT, 1e-9);
+            CHECK_VECTOR_EQ(yts, checkT, 1e-9);
+        }
+    }
+}
+
+// residual ||A x - lambda x|| of every returned pair, recomputed from the matrix
+static vector<double> eigen_residuals(const CSRMatrix<double> &A, const parallel::EigenResult<double> &E)
+{
+    vector<double> res;
+    for (size_t c = 0; c < E.values.size(); c++)
+    {
+        vector<double> x(E.vectors.val.begin() + c * A.numRows, E.vectors.val.begin() + (c + 1) * A.numRows);
+        vector<double> Ax = parallel::matrix_vector_product_CSR(A, x);
+        double sum = 0;
+        for (size_t i = 0; i < x.size(); i++)
+            sum += (Ax[i] - E.values[c] * x[i]) * (Ax[i] - E.values[c] * x[i]);
+        res.push_back(std::sqrt(sum));
+    }
+    return res;
+}
+
+TEST_CASE("Lanczos and LOBPCG on 2D Poisson")
+{
+    // a rectangular grid, so that the wanted eigenvalues are simple: single vector
+    // Lanczos finds only one copy of a multiple eigenvalue
+    const size_t kx = 30, ky = 23;
+    parallel::StencilProblem<double> s = parallel::poisson_stencil<double>(2, kx);
+    s.n[1] = ky;
+    CSRMatrix<double> A = parallel::stencil_to_CSR(s);
+    vector<double> exact;
+    for (size_t i = 1; i <= kx; i++)
+        for (size_t j = 1; j <= ky; j++)
+            exact.push_back(4.0 - 2.0 * std::cos(i * M_PI / (kx + 1)) - 2.0 * std::cos(j * M_PI / (ky + 1)));
+    std::sort(exact.begin(), exact.end());
+    const size_t nev = 3;
+
+    for (parallel::EigenTarget target : {parallel::EigenTarget::Smallest, parallel::EigenTarget::Largest})
+    {
+        parallel::EigenResult<double> L = parallel::lanczos_eigen_CSR(A, nev, target, 30, 1e-9, 200);
+        parallel::EigenResult<double> B = parallel::lobpcg_eigen_CSR(A, nev, target, 1e-8, 500);
+        CHECK(L.converged);
+        CHECK(B.converged);
+        vector<double> lr = eigen_residuals(A, L), br = eigen_residuals(A, B);
+        for (size_t c = 0; c < nev; c++)
+        {
+            const double want = target == parallel::EigenTarget::Smallest ? exact[c] : exact[exact.size() - 1 - c];
+            CHECK(L.values[c] == doctest::Approx(want).epsilon(1e-8));
+            CHECK(B.values[c] == doctest::Approx(want).epsilon(1e-8));
+            CHECK(lr[c] < 1e-7);
+            CHECK(br[c] < 1e-7);
+        }
+    }
+}
+
+TEST_CASE("Eigensolvers on 1138_bus")
+{
+    CSRMatrix<double> A = symmetric_from_triangle_CSR(load_fileCSR<double>("../../../data/matrices/1138_bus.mtx"));
+    const size_t nev = 3;
+    parallel::EigenResult<double> L = parallel::lanczos_eigen_CSR(A, nev, parallel::EigenTarget::Largest, 40, 1e-10, 300);
+    parallel::EigenResult<double> B = parallel::lobpcg_eigen_CSR(A, nev, parallel::EigenTarget::Largest, 1e-8, 1000);
+    CHECK(L.converged);
+    CHECK(B.converged);
+    vector<double> lr = eigen_residuals(A, L);
+    for (size_t c = 0; c < nev; c++)
+    {
+        CHECK(L.values[c] == doctest::Approx(B.values[c]).epsilon(1e-6));
+        CHECK(lr[c] < 1e-8 * L.values[0]);
+    }
+
+    // the smallest eigenvalues are badly separated relative to the spread of the
+    // spectrum; with a preconditioner LOBPCG converges, without one it does not get
+    // anywhere near, so the plain run only gets a short budget
+    parallel::EigenResult<double> pre = parallel::lobpcg_eigen_CSR(A, 1, parallel::EigenTarget::Smallest, 1e-6, 3000,
+                                                                   parallel::make_ssor_preconditioner_CSR(A, 1.0));
+    parallel::EigenResult<double> plain = parallel::lobpcg_eigen_CSR(A, 1, parallel::EigenTarget::Smallest, 1e-6, 50);
+    CHECK(pre.converged);
+    CHECK(pre.values[0] > 0);
+    CHECK_FALSE(plain.converged);
+    CHECK(plain.iterations == 50);
+    // a Rayleigh quotient is never below the smallest eigenvalue
+    CHECK(plain.values[0] > pre.values[0]);
+}
+
+TEST_CASE("Eigensolvers on bcsstk10")
+{
+    CSRMatrix<double> A = symmetric_from_triangle_CSR(load_fileCSR<double>("../../../benchmarking/bcsstk10.mtx"));
+    const size_t nev = 3;
+    parallel::EigenResult<double> L = parallel::lanczos_eigen_CSR(A, nev, parallel::EigenTarget::Largest, 40, 1e-10, 300);
+    parallel::EigenResult<double> B = parallel::lobpcg_eigen_CSR(A, nev, parallel::EigenTarget::Largest, 1e-8, 1000);
+    CHECK(L.converged);
+    CHECK(B.converged);
+    vector<double> lr = eigen_residuals(A, L);
+    for (size_t c = 0; c < nev; c++)
+    {
+        CHECK(L.values[c] == doctest::Approx(B.values[c]).epsilon(1e-8));
+        CHECK(lr[c] < 1e-8 * L.values[0]);
+    }
+
+    // the smallest eigenvalues sit about 5e5 times below the largest; LOBPCG
+    // preconditioned with the exact Cholesky factor finds them
+    parallel::CholeskyFactor<double> F = parallel::cholesky_factor_CSR(A);
+    PreconditionerCSR<double> M = [&F](const vector<double> &r, vector<double> &z) {
+        z = parallel::cholesky_solve_CSR(F, r);
+    };
+    parallel::EigenResult<double> S = parallel::lobpcg_eigen_CSR(A, nev, parallel::EigenTarget::Smallest, 1e-8, 500, M);
+    CHECK(S.converged);
+    vector<double> sr = eigen_residuals(A, S);
+    for (size_t c = 0; c < nev; c++)
+    {
+        CHECK(S.values[c] > 0);
+        CHECK(sr[c] < 1e-6 * S.values[nev - 1]);
+    }
+
+    // Sylvester's inertia: A - sigma I is positive definite only below the smallest
+    // eigenvalue, which confirms that none was missed
+    auto shifted = [&A](double sigma) {
+        CSRMatrix<double> C = A;
+        for (size_t i = 0; i < C.numRows; i++)
+            for (size_t p = C.row_ptr[i]; p < C.row_ptr[i + 1]; p++)
+                if (C.col_ind[p] == i) C.val[p] -= sigma;
+        return C;
+    };
+    CHECK_NOTHROW(parallel::cholesky_factor_CSR(shifted(0.999 * S.values[0])));
+    CHECK_THROWS_AS(parallel::cholesky_factor_CSR(shifted(1.001 * S.values[0])), std::runtime_error);
+}
+
+static double residual_norm(const CSRMatrix<double> &A, const vector<double> &x, const vector<double> &b)
+{
+    vector<double> Ax = parallel::matrix_vector_product_CSR(A, x);
+    double sum = 0;
+    for (size_t i = 0; i < b.size(); i++)
+        sum += (Ax[i] - b[i]) * (Ax[i] - b[i]);
+    return std::sqrt(sum);
+}
+
+TEST_CASE("Supernodal Cholesky on 2D and 3D Poisson")
+{
+    for (size_t dims : {2, 3})
+    {
+        parallel::StencilProblem<double> s = parallel::poisson_stencil<double>(dims, dims == 2 ? 40 : 12);
+        CSRMatrix<double> A = parallel::stencil_to_CSR(s);
+        vector<double> b(A.numRows);
+        for (size_t i = 0; i < b.size(); i++)
+            b[i] = std::sin(0.01 * i) + 1.0;
+
+        parallel::CholeskySymbolic natural = parallel::cholesky_analyze_CSR(A, Ordering::Natural);
+        parallel::CholeskySymbolic nd = parallel::cholesky_analyze_CSR(A, Ordering::NestedDissection);
+        CHECK(nd.factorNonzeros() < natural.factorNonzeros());
+        CHECK(nd.numSupernodes() < A.numRows);
+        for (const parallel::CholeskySymbolic *S : {&natural, &nd})
+        {
+            parallel::CholeskyFactor<double> F = parallel::cholesky_factor_CSR(A, *S);
+            vector<double> x = parallel::cholesky_solve_CSR(F, b);
+            CHECK(residual_norm(A, x, b) < 1e-10 * std::sqrt(double(A.numRows)));
+        }
+    }
+
+    // an indefinite matrix is rejected
+    CSRMatrix<double> B = parallel::stencil_to_CSR(parallel::poisson_stencil<double>(2, 10));
+    for (size_t i = 0; i < B.numRows; i++)
+        for (size_t p = B.row_ptr[i]; p < B.row_ptr[i + 1]; p++)
+            if (B.col_ind[p] == i) B.val[p] -= 3.0;
+    CHECK_THROWS_AS(parallel::cholesky_factor_CSR(B), std::runtime_error);
+}
+
+TEST_CASE("Supernodal Cholesky on 1138_bus, factor reuse")
+{
+    CSRMatrix<double> A = symmetric_from_triangle_CSR(load_fileCSR<double>("../../../data/matrices/1138_bus.mtx"));
+    const size_t n = A.numRows, k = 5;
+    parallel::CholeskySymbolic S = parallel::cholesky_analyze_CSR(A);
+    parallel::CholeskyFactor<double> F = parallel::cholesky_factor_CSR(A, S);
+    ColumnMajorBlock<double> B(n, k);
+    for (size_t j = 0; j < k; j++)
+        for (size_t i = 0; i < n; i++) B(i, j) = std::cos(0.1 * (j + 1) * i);
+    ColumnMajorBlock<double> X = parallel::cholesky_solve_CSR(F, B);
+    for (size_t j = 0; j < k; j++)
+    {
+        vector<double> x(X.val.begin() + j * n, X.val.begin() + (j + 1) * n);
+        vector<double> b(B.val.begin() + j * n, B.val.begin() + (j + 1) * n);
+        CHECK(residual_norm(A, x, b) < 1e-8);
+    }
+
+    // the analysis serves any matrix with the same pattern
+    CSRMatrix<double> A2 = A;
+    for (double &value : A2.val) value *= 2.0;
+    parallel::CholeskyFactor<double> F2 = parallel::cholesky_factor_CSR(A2, S);
+    vector<double> b(n, 1.0);
+    vector<double> x = parallel::cholesky_solve_CSR(F, b), x2 = parallel::cholesky_solve_CSR(F2, b);
+    for (size_t i = 0; i < n; i++)
+        CHECK(x2[i] == doctest::Approx(x[i] / 2.0).epsilon(1e-8));
+}
+
+TEST_CASE("Supernodal Cholesky on bcsstk10")
+{
+    // structural stiffness matrix from the UF Sparse Matrix Collection, condition
+    // number about 5e5
+    CSRMatrix<double> A = symmetric_from_triangle_CSR(load_fileCSR<double>("../../../benchmarking/bcsstk10.mtx"));
+    const size_t n = A.numRows;
+    REQUIRE(n == 1086);
+    vector<double> exact(n);
+    for (size_t i = 0; i < n; i++)
+        exact[i] = std::sin(0.05 * i) + 1.5;
+    vector<double> b = parallel::matrix_vector_product_CSR(A, exact);
+    double normB = 0, normX = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        normB += b[i] * b[i];
+        normX += exact[i] * exact[i];
+    }
+    for (Ordering ordering : {Ordering::Natural, Ordering::ReverseCuthillMcKee, Ordering::NestedDissection})
+    {
+        parallel::CholeskySymbolic S = parallel::cholesky_analyze_CSR(A, ordering);
+        parallel::CholeskyFactor<double> F = parallel::cholesky_factor_CSR(A, S);
+        vector<double> x = parallel::cholesky_solve_CSR(F, b);
+        CHECK(residual_norm(A, x, b) < 1e-12 * std::sqrt(normB));
+        double error = 0;
+        for (size_t i = 0; i < n; i++)
+            error += (x[i] - exact[i]) * (x[i] - exact[i]);
+        CHECK(std::sqrt(error) < 1e-9 * std::sqrt(normX));
+    }
+}
+
+TEST_CASE("Supernodal Cholesky vs PCG TIME")
+{
+    parallel::StencilProblem<double> s = parallel::poisson_stencil<double>(2, 256);
+    CSRMatrix<double> A = parallel::stencil_to_CSR(s);
+    vector<double> b(A.numRows, 1.0), x0(A.numRows, 0.0);
+    timer stopwatch;
+    parallel::CholeskySymbolic S = parallel::cholesky_analyze_CSR(A);
+    const double tAnalyze = stopwatch.elapsed();
+    parallel::CholeskyFactor<double> F = parallel::cholesky_factor_CSR(A, S);
+    const double tFactor = stopwatch.elapsed();
+    vector<double> x = parallel::cholesky_solve_CSR(F, b);
+    const double tSolve = stopwatch.elapsed();
+    SolverInfo info;
+    parallel::conjugate_gradient_CSR(A, b, x0, 5000, 1e-8 * std::sqrt(double(A.numRows)), &info);
+    const double tCG = stopwatch.elapsed();
+    std::cerr << "n = " << A.numRows << ", nnz(L) = " << S.factorNonzeros() << ": analyze " << tAnalyze << "s, factor "
+              << tFactor << "s, solve " << tSolve << "s, CG " << tCG << "s" << std::endl;
+    CHECK(residual_norm(A, x, b) < 1e-8);
+    CHECK(info.converged);
+}
+
+// Run with -d to see the copy cost that const reference parameters removed. Before them,
+// add, multiply and transpose copied both operands on every call, and the SpMV inside
+// conjugate_gradient_CSR copied A on every iteration. "copied" passes fresh copies, which
+// is the work those by-value signatures did; "by reference" is the current call.
+TEST_CASE("Copied vs const-reference inputs TIME")
+{
+    parallel::StencilProblem<double> s = parallel::poisson_stencil<double>(2, 300);
+    const CSRMatrix<double> A = parallel::stencil_to_CSR(s);
+    const vector<double> b(A.numRows, 1.0), x0(A.numRows, 0.0);
+    timer stopwatch;
+    for (int r = 0; r < 20; r++)
+        CHECK(add_matrixCSR(CSRMatrix<double>(A), CSRMatrix<double>(A)).numRows == A.numRows);
+    const double tAddCopied = stopwatch.elapsed();
+    for (int r = 0; r < 20; r++)
+        CHECK(add_matrixCSR(A, A).numRows == A.numRows);
+    const double tAdd = stopwatch.elapsed();
+    for (int r = 0; r < 5; r++)
+        CHECK(multiply_matrixCSR(CSRMatrix<double>(A), CSRMatrix<double>(A)).numRows == A.numRows);
+    const double tMultiplyCopied = stopwatch.elapsed();
+    for (int r = 0; r < 5; r++)
+        CHECK(multiply_matrixCSR(A, A).numRows == A.numRows);
+    const double tMultiply = stopwatch.elapsed();
+    for (int r = 0; r < 20; r++)
+        CHECK(transpose_matrixCSR(CSRMatrix<double>(A)).numRows == A.numColumns);
+    const double tTransposeCopied = stopwatch.elapsed();
+    for (int r = 0; r < 20; r++)
+        CHECK(transpose_matrixCSR(A).numRows == A.numColumns);
+    const double tTranspose = stopwatch.elapsed();
+    for (int r = 0; r < 100; r++)
+        CHECK(matrix_vector_product_CSR(CSRMatrix<double>(A), b).size() == A.numRows);
+    const double tSpMVCopied = stopwatch.elapsed();
+    for (int r = 0; r < 100; r++)
+        CHECK(matrix_vector_product_CSR(A, b).size() == A.numRows);
+    const double tSpMV = stopwatch.elapsed();
+    // conjugate_gradient_CSR prints its residual every iteration
+    std::streambuf *out = std::cout.rdbuf(nullptr);
+    conjugate_gradient_CSR(A, b, x0, 100, 1e-30);
+    std::cout.rdbuf(out);
+    std::cout.clear();
+    const double tCG = stopwatch.elapsed();
+    std::cerr << "n = " << A.numRows << ", copied vs by reference: 20 adds " << tAddCopied << "s / " << tAdd
+              << "s, 5 multiplies " << tMultiplyCopied << "s / " << tMultiply << "s, 20 transposes "
+              << tTransposeCopied << "s / " << tTranspose << "s, 100 SpMVs " << tSpMVCopied << "s / " << tSpMV
+              << "s; CG, 100 iterations " << tCG << "s, plus " << tSpMVCopied - tSpMV
+              << "s for copying A in every SpMV" << std::endl;
+
+    const vector<vector<double>> D = generate_random_matrix(400, 400, -1, 1);
+    for (int r = 0; r < 20; r++)
+        CHECK(sum_matrix(D, vector<vector<double>>(D)).size() == D.size());
+    const double tSumCopied = stopwatch.elapsed();
+    for (int r = 0; r < 20; r++)
+        CHECK(sum_matrix(D, D).size() == D.size());
+    const double tSum = stopwatch.elapsed();
+    for (int r = 0; r < 3; r++)
+        CHECK(mult_matrix(vector<vector<double>>(D), vector<vector<double>>(D)).size() == D.size());
+    const double tMultCopied = stopwatch.elapsed();
+    for (int r = 0; r < 3; r++)
+        CHECK(mult_matrix(D, D).size() == D.size());
+    const double tMult = stopwatch.elapsed();
+    for (int r = 0; r < 20; r++)
+        CHECK(transpose(vector<vector<double>>(D)).size() == D.size());
+    const double tDenseTransposeCopied = stopwatch.elapsed();
+    for (int r = 0; r < 20; r++)
+        CHECK(transpose(D).size() == D.size());
+    const double tDenseTranspose = stopwatch.elapsed();
+    std::cerr << "dense 400 x 400, copied vs by reference: 20 sum_matrix " << tSumCopied << "s / " << tSum
+              << "s, 3 mult_matrix " << tMultCopied << "s / " << tMult << "s, 20 transpose " << tDenseTransposeCopied
+              << "s / " << tDenseTranspose << "s" << std::endl;
+}
+
+// Run with -d to see what the output-parameter overloads save over the functions that
+// return a fresh matrix. Both take their inputs by const reference, so neither copies A;
+// the difference left is the allocation of the result.
+TEST_CASE("Returning vs output-parameter kernels TIME")
+{
+    parallel::StencilProblem<double> s = parallel::poisson_stencil<double>(2, 300);
+    CSRMatrix<double> A = parallel::stencil_to_CSR(s);
+    CSRMatrix<double> C;
+    add_into(C, A, A);
+    timer stopwatch;
+    for (int r = 0; r < 20; r++)
+        CHECK(add_matrixCSR(A, A).val.size() == C.val.size());
+    const double tAdd = stopwatch.elapsed();
+    for (int r = 0; r < 20; r++)
+        add_into(C, A, A);
+    const double tAddInto = stopwatch.elapsed();
+    for (int r = 0; r < 20; r++)
+        CHECK(transpose_matrixCSR(A).val.size() == A.val.size());
+    const double tTranspose = stopwatch.elapsed();
+    for (int r = 0; r < 20; r++)
+        transpose_into(C, A);
+    const double tTransposeInto = stopwatch.elapsed();
+    CSRMatrix<double> P;
+    for (int r = 0; r < 5; r++)
+        P = multiply_matrixCSR(A, A);
+    const double tMultiply = stopwatch.elapsed();
+    for (int r = 0; r < 5; r++)
+        multiply_into(C, A, A);
+    const double tMultiplyInto = stopwatch.elapsed();
+    CHECK(C.val == P.val);
+    std::cerr << "n = " << A.numRows << ", 20 calls: add " << tAdd << "s, add_into " << tAddInto << "s, transpose "
+              << tTranspose << "s, transpose_into " << tTransposeInto << "s; 5 calls: multiply " << tMultiply
+              << "s, multiply_into " << tMultiplyInto << "s" << std::endl;
+}
+
+// random n x m CSR matrix with about perRow sorted entries per row
+static CSRMatrix<double> random_CSR(size_t n, size_t m, size_t perRow, unsigned seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<size_t> column(0, m - 1);
+    std::uniform_real_distribution<double> value(-1.0, 1.0);
+    CSRMatrix<double> A;
+    A.numRows = n;
+    A.numColumns = m;
+    A.row_ptr.push_back(0);
+    for (size_t i = 0; i < n; i++)
+    {
+        vector<size_t> cols;
+        for (size_t k = 0; k < perRow; k++)
+            cols.push_back(column(generator));
+        std::sort(cols.begin(), cols.end());
+        cols.erase(std::unique(cols.begin(), cols.end()), cols.end());
+        for (size_t c : cols)
+        {
+            A.col_ind.push_back(c);
+            A.val.push_back(value(generator));
+        }
+        A.row_ptr.push_back(A.col_ind.size());
+    }
+    return A;
+}
+
+static void CHECK_CSR_EQUAL(const CSRMatrix<double> &A, const CSRMatrix<double> &B)
+{
+    CHECK(A.numRows == B.numRows);
+    CHECK(A.numColumns == B.numColumns);
+    CHECK(A.row_ptr == B.row_ptr);
+    CHECK(A.col_ind == B.col_ind);
+    CHECK(A.val == B.val);
+}
+
+TEST_CASE("Parallel CSR axpby, add and subtract")
+{
+    CSRMatrix<double> A = random_CSR(2000, 1500, 8, 1), B = random_CSR(2000, 1500, 8, 2);
+    CHECK_CSR_EQUAL(parallel::add_matrixCSR(A, B), add_matrixCSR(A, B));
+    CHECK_CSR_EQUAL(parallel::subtract_matrixCSR(A, B), subtract_matrixCSR(A, B));
+
+    // general coefficients against the serial routines on scaled copies
+    CSRMatrix<double> C = parallel::axpby_CSR(2.0, A, -0.5, B);
+    CSRMatrix<double> D = add_matrixCSR(scalar_multiply_CSR(A, 2.0), scalar_multiply_CSR(B, -0.5));
+    CHECK_CSR_EQUAL(C, D);
+
+    // same pattern: a vector axpby, and exact cancellations are still dropped
+    CSRMatrix<double> E = A;
+    for (double &v : E.val) v *= 3.0;
+    CSRMatrix<double> F = parallel::axpby_CSR(1.0, A, 0.5, E);
+    CHECK(F.col_ind == A.col_ind);
+    for (size_t k = 0; k < F.val.size(); k++)
+        CHECK(F.val[k] == A.val[k] + 0.5 * E.val[k]);
+    CHECK_CSR_EQUAL(parallel::subtract_matrixCSR(A, A), subtract_matrixCSR(A, A));
+    CHECK(parallel::subtract_matrixCSR(A, A).val.empty());
+
+    CSRMatrix<double> wrong = random_CSR(2000, 1499, 8, 3);
+    CHECK_THROWS_AS(parallel::axpby_CSR(1.0, A, 1.0, wrong), std::invalid_argument);
+}
+
+TEST_CASE("Parallel COO multiply matches serial")
+{
+    CSRMatrix<double> a = random_CSR(600, 400, 6, 4), b = random_CSR(400, 500, 6, 5);
+    auto toCOO = [](const CSRMatrix<double> &m) {
+        // entries in reverse order, the multiply must not rely on sorted input
+        COO::COOMatrix<double> c;
+        c.numRows = m.numRows;
+        c.numCols = m.numColumns;
+        for (size_t i = m.numRows; i-- > 0;)
+            for (size_t p = m.row_ptr[i + 1]; p-- > m.row_ptr[i];)
+            {
+                c.rowCoord.push_back(i);
+                c.colCoord.push_back(m.col_ind[p]);
+                c.values.push_back(m.val[p]);
+            }
+        c.nnz = c.values.size();
+        return c;
+    };
+    COO::COOMatrix<double> A = toCOO(a), B = toCOO(b);
+    COO::COOMatrix<double> serial = COO::multiply_matrixCOO(A, B);
+    COO::COOMatrix<double> par = COOParallel::multiply_matrixCOO(A, B);
+    CHECK(par.nnz == serial.nnz);
+    CHECK(par.rowCoord == serial.rowCoord);
+    CHECK(par.colCoord == serial.colCoord);
+    CHECK(par.values == serial.values);
+
+    // same entries as the CSR Gustavson product
+    CSRMatrix<double> c = multiply_matrixCSR(a, b);
+    CHECK(c.val.size() == par.values.size());
+    CHECK(c.col_ind == par.colCoord);
+}
+
+TEST_CASE("Testing parallel COO canonicalize and transpose")
+{
+    // enough triplets for the blocked radix sort, with many duplicates and a wide column range
+    COO::COOMatrix<double> A;
+    A.numRows = 5000;
+    A.numCols = 300000;
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<size_t> row(0, A.numRows - 1), col(0, 999);
+    for (size_t k = 0; k < 200000; k++)
+    {
+        A.rowCoord.push_back(row(gen));
+        A.colCoord.push_back(col(gen) * 300);
+        A.values.push_back(static_cast<double>(k % 17) - 8.0);
+    }
+    A.nnz = A.values.size();
+
+    COO::COOMatrix<double> serial = COO::canonicalize_COO(A);
+    COO::COOMatrix<double> par = COOParallel::canonicalize_COO(A);
+    CHECK(serial.nnz < A.nnz);
+    CHECK(par.nnz == serial.nnz);
+    CHECK(par.rowCoord == serial.rowCoord);
+    CHECK(par.colCoord == serial.colCoord);
+    CHECK(par.values == serial.values);
+
+    COO::COOMatrix<double> T = COOParallel::transpose_matrixCOO(A);
+    COO::COOMatrix<double> TT = COOParallel::transpose_matrixCOO(T);
+    CHECK(T.numRows == A.numCols);
+    CHECK(T.nnz == serial.nnz);
+    CHECK(TT.rowCoord == serial.rowCoord);
+    CHECK(TT.colCoord == serial.colCoord);
+    CHECK(TT.values == serial.values);
+    for (size_t k = 1; k < T.nnz; k++)
+        CHECK((T.rowCoord[k - 1] < T.rowCoord[k] || (T.rowCoord[k - 1] == T.rowCoord[k] && T.colCoord[k - 1] < T.colCoord[k])));
+
+    A.colCoord[123456] = A.numCols;
+    CHECK_THROWS_AS(COOParallel::canonicalize_COO(A), std::invalid_argument);
+}
+
+TEST_CASE("Testing parallel sparse format conversions")
+{
+    // large enough for the blocked counting sorts
+    CSRMatrix<double> A = random_CSR(20000, 15000, 6, 21);
+    CSCMatrix<double> serialC = convert_CSR_to_CSC(A);
+    CSCMatrix<double> parC = parallel::convert_CSR_to_CSC(A);
+    CHECK(parC.col_ptr == serialC.col_ptr);
+    CHECK(parC.row_ind == serialC.row_ind);
+    CHECK(parC.val == serialC.val);
+    CHECK_CSR_EQUAL(parallel::convert_CSC_to_CSR(parC), A);
+
+    COO::COOMatrix<double> B = parallel::convert_CSR_to_COO(A);
+    COO::COOMatrix<double> serialB = convert_CSR_to_COO(A);
+    CHECK(B.rowCoord == serialB.rowCoord);
+    CHECK(B.colCoord == serialB.colCoord);
+    CHECK(B.values == serialB.values);
+
+    // shuffled triplets with every entry split in two
+    std::mt19937 gen(5);
+    std::vector<size_t> perm(B.nnz);
+    std::iota(perm.begin(), perm.end(), 0);
+    std::shuffle(perm.begin(), perm.end(), gen);
+    TripletAssemblerCSR<double> assembler(A.numRows, A.numColumns);
+    assembler.reserve(2 * B.nnz);
+    for (size_t k : perm)
+    {
+        assembler.add(B.rowCoord[k], B.colCoord[k], 0.25 * B.values[k]);
+        assembler.add(B.rowCoord[k], B.colCoord[k], 0.75 * B.values[k]);
+    }
+    CSRMatrix<double> serialAssembled = assembler.assemble();
+    CSRMatrix<double> parAssembled = parallel::assemble_CSR(assembler);
+    CHECK_CSR_EQUAL(parAssembled, serialAssembled);
+    CHECK(parAssembled.col_ind == A.col_ind);
+    for (size_t p = 0; p < A.val.size(); p++)
+        CHECK(parAssembled.val[p] == doctest::Approx(A.val[p]));
+
+    COO::COOMatrix<double> shuffled;
+    shuffled.numRows = A.numRows;
+    shuffled.numCols = A.numColumns;
+    for (size_t k : perm)
+    {
+        shuffled.rowCoord.push_back(B.rowCoord[k]);
+        shuffled.colCoord.push_back(B.colCoord[k]);
+        shuffled.values.push_back(B.values[k]);
+    }
+    shuffled.nnz = B.nnz;
+    CHECK_CSR_EQUAL(parallel::convert_COO_to_CSR(shuffled), A);
+    CSCMatrix<double> fromCOO = parallel::convert_COO_to_CSC(shuffled);
+    CHECK(fromCOO.col_ptr == serialC.col_ptr);
+    CHECK(fromCOO.row_ind == serialC.row_ind);
+    CHECK(fromCOO.val == serialC.val);
+}
+
+TEST_CASE("Testing parallel output overloads")
+{
+    CSRMatrix<double> A = random_CSR(1500, 1200, 7, 31), B = random_CSR(1500, 1200, 7, 32);
+    CSRMatrix<double> Bt = transpose_matrixCSR(B);
+    CSRMatrix<double> C;
+    parallel::add_into(C, A, B);
+    CHECK_CSR_EQUAL(C, add_matrixCSR(A, B));
+    parallel::subtract_into(C, A, B);
+    CHECK_CSR_EQUAL(C, subtract_matrixCSR(A, B));
+    parallel::multiply_into(C, A, Bt);
+    CHECK_CSR_EQUAL(C, multiply_matrixCSR(A, Bt));
+    // a second product into the same output reuses its arrays
+    const double *storage = C.val.data();
+    parallel::multiply_into(C, A, Bt);
+    CHECK(C.val.data() == storage);
+    CHECK_THROWS_AS(parallel::add_into(A, A, B), std::invalid_argument);
+    CHECK_THROWS_AS(parallel::multiply_into(Bt, A, Bt), std::invalid_argument);
+}
+
+TEST_CASE("Testing parallel elementwise kernels")
+{
+    // large enough to be split into blocks
+    CSRMatrix<double> A = random_CSR(8000, 6000, 8, 41);
+    CSRMatrix<double> serial, par;
+    axpb_into(serial, A, -1.5, 0.25);
+    parallel::axpb_into(par, A, -1.5, 0.25);
+    CHECK_CSR_EQUAL(par, serial);
+    clamp_into(serial, A, -0.1, 0.2);
+    parallel::clamp_into(par, A, -0.1, 0.2);
+    CHECK_CSR_EQUAL(par, serial);
+    multiply_elementwise_into(serial, A, par);
+    parallel::multiply_elementwise_in_place(par, A);
+    CHECK_CSR_EQUAL(par, serial);
+    CHECK_THROWS_AS(parallel::multiply_elementwise_in_place(par, random_CSR(8000, 6000, 8, 42)), std::invalid_argument);
+
+    COO::COOMatrix<double> B = convert_CSR_to_COO(A), Bpar = B;
+    abs_in_place(B);
+    parallel::abs_in_place(Bpar);
+    CHECK(Bpar.values == B.values);
+    COOParallel::scalar_mult_matrixCOO(Bpar, 0.5);
+    COO::scalar_mult_matrixCOO(B, 0.5);
+    CHECK(Bpar.values == B.values);
+    COOParallel::scalar_mult_matrixCOO(Bpar, 3);
+    COOParallel::scalar_add_matrixCOO(Bpar, 1);
+    COO::scalar_mult_matrixCOO(B, 3);
+    COO::scalar_add_matrixCOO(B, 1);
+    CHECK(Bpar.values == B.values);
+
+    std::vector<std::vector<double>> D(300, std::vector<double>(200)), Dserial, Dpar;
+    for (size_t i = 0; i < D.size(); i++)
+        for (size_t j = 0; j < D[i].size(); j++)
+            D[i][j] = double(i) - double(j);
+    scale_into(Dserial, D, 0.5);
+    parallel::scale_into(Dpar, D, 0.5);
+    CHECK(Dpar == Dserial);
+    parallel::shift_in_place(D, 1.0);
+    CHECK(D[10][3] == 8);
+}
+
+TEST_CASE("Testing parallel matrix statistics")
+{
+    CSRMatrix<double> A = random_CSR(20000, 20000, 5, 51);
+    const MatrixStatistics<double> serial = compressed_statistics(A.numRows, A.numColumns, A.row_ptr, A.col_ind, A.val, true);
+    const MatrixStatistics<double> par = parallel::statistics_CSR(A);
+    CHECK(par.nnz == serial.nnz);
+    CHECK(par.min == serial.min);
+    CHECK(par.max == serial.max);
+    CHECK(par.sum == doctest::Approx(serial.sum));
+    CHECK(par.frobeniusNorm == doctest::Approx(serial.frobeniusNorm));
+    CHECK(par.oneNorm == doctest::Approx(serial.oneNorm));
+    CHECK(par.infNorm == doctest::Approx(serial.infNorm));
+    CHECK(par.dominanceRatio == doctest::Approx(serial.dominanceRatio));
+    CHECK(par.diagonallyDominant == serial.diagonallyDominant);
+    CHECK_FALSE(par.patternSymmetric);
+    CHECK(parallel::find_min_CSR(A) == serial.min);
+
+    // the symmetric part of A has a symmetric pattern
+    CSRMatrix<double> S = parallel::add_matrixCSR(A, transpose_matrixCSR(A));
+    CHECK(parallel::statistics_CSR(S).patternSymmetric);
+
+    COO::COOMatrix<double> B = convert_CSR_to_COO(A);
+    const MatrixStatistics<double> coo = COOParallel::statistics_COO(B);
+    CHECK(coo.nnz == serial.nnz);
+    CHECK(coo.max == serial.max);
+    CHECK(coo.oneNorm == doctest::Approx(serial.oneNorm));
+    CHECK(coo.infNorm == doctest::Approx(serial.infNorm));
+    CHECK_FALSE(coo.patternSymmetric);
+    CHECK(COOParallel::find_min_COO(B) == serial.min);
+    CHECK(COOParallel::statistics_COO(convert_CSR_to_COO(S)).patternSymmetric);
+    // nothing is kept on the matrix, so a direct write to values is seen
+    B.values[7] = 1e6;
+    CHECK(COOParallel::find_max_COO(B) == 1e6);
+    CHECK(COOParallel::statistics_COO(B).max == 1e6);
+    A.val[7] = -1e6;
+    CHECK(parallel::find_min_CSR(A) == -1e6);
+    CHECK(parallel::find_max_CSR(A) == serial.max);
+
+    std::vector<std::vector<double>> D(400, std::vector<double>(300));
+    for (size_t i = 0; i < D.size(); i++)
+        for (size_t j = 0; j < D[i].size(); j++)
+            D[i][j] = (i * 7 + j * 13) % 11 == 0 ? 0.0 : double(i) - 1.5 * double(j);
+    const MatrixStatistics<double> denseSerial = matrix_statistics(D);
+    const MatrixStatistics<double> denseParallel = matrix_statistics_parallel(D);
+    CHECK(denseParallel.nnz == denseSerial.nnz);
+    CHECK(denseParallel.min == denseSerial.min);
+    CHECK(denseParallel.max == denseSerial.max);
+    CHECK(denseParallel.sum == doctest::Approx(denseSerial.sum));
+    CHECK(denseParallel.oneNorm == doctest::Approx(denseSerial.oneNorm));
+    CHECK(denseParallel.infNorm == doctest::Approx(denseSerial.infNorm));
+}
+
+TEST_CASE("Testing parallel expression evaluation")
+{
+    using expr::term;
+    vector<vector<double>> A = generate_random_matrix(400, 300, -1, 1);
+    vector<vector<double>> B = generate_random_matrix(400, 300, -1, 1);
+    vector<vector<double>> S = generate_random_matrix(300, 300, -1, 1);
+
+    vector<vector<double>> serial, par;
+    expr::assign(serial, 2.0 * term(A) - term(B) * 0.5);
+    parallel::assign(par, 2.0 * term(A) - term(B) * 0.5);
+    CHECK(serial == par);
+
+    expr::assign(serial, term(A) * term(S) - 3.0 * term(B));
+    parallel::assign(par, term(A) * term(S) - 3.0 * term(B));
+    CHECK(serial == par);
+    expr::assign(serial, (term(A) + term(B)) * term(S));
+    par = parallel::evaluate((term(A) + term(B)) * term(S));
+    CHECK(serial == par);
+
+    // a product reading the destination
+    vector<vector<double>> D = A;
+    parallel::assign(D, term(D) * term(S) + term(D));
+    expr::assign(serial, term(A) * term(S) + term(A));
+    CHECK(serial == D);
+}
+
+TEST_CASE("Testing parallel batched small matrices")
+{
+    const size_t count = 5000;
+    BatchedMatrices<double> A = make_batched<double>(count, 6, 6), B = make_batched<double>(count, 6, 2);
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<double> dist(-1, 1);
+    for (double &v : A.val)
+        v = dist(gen);
+    for (double &v : B.val)
+        v = dist(gen);
+    for (size_t m = 0; m < count; m++)
+        for (size_t i = 0; i < 6; i++)
+            A(m, i, i) += 6;
+
+    BatchedMatrices<double> serial, par;
+    batched_gemm(serial, 1.5, A, B, 0.0);
+    parallel::batched_gemm(par, 1.5, A, B, 0.0);
+    CHECK(serial.val == par.val);
+
+    BatchedLU<double> f = batched_lu(A), g = parallel::batched_lu(A);
+    CHECK(f.lu.val == g.lu.val);
+    CHECK(f.pivots == g.pivots);
+    BatchedMatrices<double> x = B, y = B;
+    batched_lu_solve(f, x);
+    vector<int> info = parallel::batched_solve(A, y);
+    CHECK(x.val == y.val);
+    CHECK(std::count(info.begin(), info.end(), 0) == int(count));
+}
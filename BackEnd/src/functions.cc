@@ -5,18 +5,22 @@
 // counter based loops.
 // See: algorithm.h by GCC
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <random>
 #include <sstream>
 #include <climits>
 #include <string>
+#include <utility>
 #include <vector>
 // #include <omp.h>
 #include <vector>
 #include <cmath>
 #include <stdexcept>
 #include <tuple>
+#include "functionsStatistics.cc"
+#include "functionsFixed.cc"
 
 typedef std::vector<std::vector<double>> matrix;
 
@@ -115,11 +119,12 @@ vector<vector<double>> identity_matrix(size_t size)
 }
 
 /// @brief Adds to matrices together.
-/// @param m1 first matrix.
+/// @param m1 first matrix, taken by value and reused for the result; pass
+/// std::move(m1) when it is no longer needed to avoid the copy.
 /// @param m2 second matrix.
 /// @return The sum of the matrices.
 vector<vector<double>> sum_matrix(vector<vector<double>> m1,
-                                  const vector<vector<double>> m2)
+                                  const vector<vector<double>> &m2)
 {
     //   NB: in the future it may be important to use the compiler defined sizes
     //   for platform portability
@@ -137,8 +142,12 @@ vector<vector<double>> sum_matrix(vector<vector<double>> m1,
     return m1;
 }
 
+/// @brief Subtracts the second matrix from the first.
+/// @param m1 first matrix, taken by value and reused for the result.
+/// @param m2 second matrix.
+/// @return The difference of the matrices.
 vector<vector<double>> sub_matrix(vector<vector<double>> m1,
-                                  const vector<vector<double>> m2)
+                                  const vector<vector<double>> &m2)
 {
     //   NB: in the future it may be important to use the compiler defined sizes
     //   for platform portability
@@ -157,6 +166,51 @@ vector<vector<double>> sub_matrix(vector<vector<double>> m1,
     return m1;
 }
 
+/// @brief Adds two matrices together into m3, reusing its rows; m3 may be m1 or m2.
+/// @param m3 The sum, set to the dimension error if the dimensions differ.
+/// @param m1 first matrix.
+/// @param m2 second matrix.
+void add_into(vector<vector<double>> &m3, const vector<vector<double>> &m1,
+              const vector<vector<double>> &m2)
+{
+    const size_t d1 = m1.size(), d2 = m1[0].size();
+    if (d1 != m2.size() || d2 != m2[0].size())
+    {
+        m3 = d_err;
+        return;
+    }
+    m3.resize(d1);
+    for (size_t i = 0; i < d1; ++i)
+    {
+        m3[i].resize(d2);
+        for (size_t j = 0; j < d2; ++j)
+            m3[i][j] = m1[i][j] + m2[i][j];
+    }
+}
+
+/// @brief Subtracts the second matrix from the first into m3, reusing its rows; m3 may
+/// be m1 or m2.
+/// @param m3 The difference, set to the dimension error if the dimensions differ.
+/// @param m1 first matrix.
+/// @param m2 second matrix.
+void subtract_into(vector<vector<double>> &m3, const vector<vector<double>> &m1,
+                   const vector<vector<double>> &m2)
+{
+    const size_t d1 = m1.size(), d2 = m1[0].size();
+    if (d1 != m2.size() || d2 != m2[0].size())
+    {
+        m3 = d_err;
+        return;
+    }
+    m3.resize(d1);
+    for (size_t i = 0; i < d1; ++i)
+    {
+        m3[i].resize(d2);
+        for (size_t j = 0; j < d2; ++j)
+            m3[i][j] = m1[i][j] - m2[i][j];
+    }
+}
+
 /// @brief Creates a random matrix of given dimensions filled with values in
 /// specified range.
 /// @param d1 Number of rows.
@@ -190,73 +244,87 @@ vector<vector<double>> generate_random_matrix(const int d1, const int d2,
     return matrix;
 }
 
-/// @brief Multiplies two matrices together.
+/// @brief Multiplies two matrices together into m3, reusing its rows. The loops run
+/// i-k-j so the rows of m2 and m3 are streamed contiguously.
+/// @param m3 Product matrix, set to the dimension error if the inner dimensions differ.
 /// @param m1 First matrix.
 /// @param m2 Second matrix.
-/// @return Product matrix.
-vector<vector<double>> mult_matrix(const vector<vector<double>> m1,
-                                   const vector<vector<double>> m2)
+/// @exception m3 must not be m1 or m2.
+void multiply_into(vector<vector<double>> &m3, const vector<vector<double>> &m1,
+                   const vector<vector<double>> &m2)
 {
-    const int r1 = static_cast<int>(m1.size()),
-              c1 = static_cast<int>(m1[0].size()),
-              r2 = static_cast<int>(m2.size()),
-              c2 = static_cast<int>(m2[0].size());
+    if (&m3 == &m1 || &m3 == &m2)
+        throw invalid_argument("The output matrix must not be one of the inputs.");
+    const size_t r1 = m1.size(),
+                 c1 = m1[0].size(),
+                 r2 = m2.size(),
+                 c2 = m2[0].size();
     //   columns of first matrix must equal rows of second
     if (c1 != r2)
-        return d_err;
-
-    vector<vector<double>> m3(r1);
-
-    // Try using the std::par_unseq execution policy from C++20 (it's actually
-    // pretty cool how it implements SIMD)
-    for (auto i = 0; i < r1; i++)
-        m3[i] = vector<double>(c2, 0);
+    {
+        m3 = d_err;
+        return;
+    }
 
-    for (int i = 0; i < r1; ++i)
-        for (int j = 0; j < c2; ++j)
-            for (int k = 0; k < r2; ++k)
-                m3[i][j] += m1[i][k] * m2[k][j];
+    m3.resize(r1);
+    for (size_t i = 0; i < r1; ++i)
+        m3[i].assign(c2, 0.0);
 
-    return m3;
+    for (size_t i = 0; i < r1; ++i)
+        for (size_t k = 0; k < r2; ++k)
+        {
+            const double a = m1[i][k];
+            const vector<double> &row = m2[k];
+            vector<double> &out = m3[i];
+            for (size_t j = 0; j < c2; ++j)
+                out[j] += a * row[j];
+        }
 }
 
-/// @brief Multiplies a matrix by a scalar value.
-/// @param matrix The matrix to be multiplied.
-/// @param scalar The scalar value.
-/// @return The resulting matrix after scalar multiplication.
-vector<vector<double>> scalar_multiply(const vector<vector<double>> matrix, const double scalar)
+/// @brief Multiplies two matrices together.
+/// @param m1 First matrix.
+/// @param m2 Second matrix.
+/// @return Product matrix.
+vector<vector<double>> mult_matrix(const vector<vector<double>> &m1,
+                                   const vector<vector<double>> &m2)
 {
-    const int rows = static_cast<int>(matrix.size());
-    const int cols = static_cast<int>(matrix[0].size());
-
-    vector<vector<double>> result(rows, vector<double>(cols, 0.0));
-
-    for (int i = 0; i < rows; ++i)
-        for (int j = 0; j < cols; ++j)
-            result[i][j] = matrix[i][j] * scalar;
-
-    return result;
+    vector<vector<double>> m3;
+    multiply_into(m3, m1, m2);
+    return m3;
 }
 
-
 /// @brief Scales the matrix upwards by a given constant (i.e. multiply every
 /// value in the matrix).
-/// @param m1 The matrix.
+/// @param m1 The matrix, taken by value and reused for the result.
 /// @param s Scaling constant.
 /// @return The updated matrix.
 vector<vector<double>> scale_up(vector<vector<double>> m1, const double s)
 {
-    const int d1 = static_cast<int>(m1.size()),
-              d2 = static_cast<int>(m1[0].size());
-    for (auto i = 0; i < d1; ++i)
-        for (auto j = 0; j < d2; ++j)
-            m1[i][j] *= s;
+    for (auto &row : m1)
+        for (double &value : row)
+            value *= s;
     return m1;
 }
 
+/// @brief Multiplies a matrix by a scalar value.
+/// @param matrix The matrix to be multiplied.
+/// @param scalar The scalar value.
+/// @return The resulting matrix after scalar multiplication.
+vector<vector<double>> scalar_multiply(const vector<vector<double>> &matrix, const double scalar)
+{
+    vector<vector<double>> result(matrix.size());
+    for (size_t i = 0; i < matrix.size(); ++i)
+    {
+        result[i].reserve(matrix[i].size());
+        for (const double value : matrix[i])
+            result[i].push_back(value * scalar);
+    }
+    return result;
+}
+
 /// @brief Scales the matrix downwards by a given constant (i.e. divides every
 /// value in the matrix).
-/// @param m1 The matrix.
+/// @param m1 The matrix, taken by value and reused for the result.
 /// @param s Scaling constant.
 /// @return The update matrix.
 vector<vector<double>> scale_down(vector<vector<double>> m1, const double s)
@@ -267,31 +335,78 @@ vector<vector<double>> scale_down(vector<vector<double>> m1, const double s)
     if (s == 0.0)
         return a_err;
 
-    const int d1 = static_cast<int>(m1.size()),
-              d2 = static_cast<int>(m1[0].size());
-    for (auto i = 0; i < d1; ++i)
-        for (auto j = 0; j < d2; ++j)
-            m1[i][j] /= s;
+    for (auto &row : m1)
+        for (double &value : row)
+            value /= s;
     return m1;
 }
 
-/// @brief Transposes the matrix.
-/// @param m1 Input matrix.
-/// @return Transposed matrix.
-vector<vector<double>> transpose(const vector<vector<double>> m1)
+/// @brief Statistics of a dense matrix in one pass: min, max and sum of the entries,
+/// the Frobenius, 1- and inf-norms, the diagonal dominance ratio and whether the
+/// nonzero pattern is symmetric.
+/// @param m1 The matrix.
+/// @return The statistics; nnz is the number of nonzero entries.
+/// @exception The rows must all have the same length.
+MatrixStatistics<double> matrix_statistics(const vector<vector<double>> &m1)
 {
-    const int d1 = static_cast<int>(m1.size()),
-              d2 = static_cast<int>(m1[0].size());
+    const size_t rows = m1.size(), cols = rows ? m1[0].size() : 0;
+    StatisticsAccumulator<double> acc;
+    acc.symmetric = rows == cols;
+    vector<double> rowOff(rows, 0.0), colOff(cols, 0.0), diag(min(rows, cols), 0.0);
+    size_t nonzeros = 0;
+    for (size_t i = 0; i < rows; ++i)
+    {
+        const vector<double> &row = m1[i];
+        if (row.size() != cols)
+            throw invalid_argument("The rows of the matrix must have the same length.");
+        acc.add_values(row.data(), cols);
+        for (size_t j = 0; j < cols; ++j)
+        {
+            const double a = fabs(row[j]);
+            nonzeros += row[j] != 0.0;
+            if (i == j)
+            {
+                diag[i] = a;
+                continue;
+            }
+            rowOff[i] += a;
+            colOff[j] += a;
+            if (acc.symmetric && (row[j] != 0.0) != (m1[j][i] != 0.0))
+                acc.symmetric = false;
+        }
+    }
+    MatrixStatistics<double> stats = finish_statistics(acc, rowOff, colOff, diag);
+    stats.nnz = nonzeros;
+    return stats;
+}
 
-    vector<vector<double>> m2(d2);
+/// @brief Transposes the matrix into m2, reusing its rows.
+/// @param m2 Transposed matrix.
+/// @param m1 Input matrix.
+/// @exception m2 must not be m1.
+void transpose_into(vector<vector<double>> &m2, const vector<vector<double>> &m1)
+{
+    if (&m2 == &m1)
+        throw invalid_argument("The output matrix must not be one of the inputs.");
+    const size_t d1 = m1.size(),
+                 d2 = m1[0].size();
 
-    for (auto i = 0; i < d2; ++i)
-        m2[i] = vector<double>(d1);
+    m2.resize(d2);
+    for (size_t i = 0; i < d2; ++i)
+        m2[i].resize(d1);
 
-    for (auto i = 0; i < d1; ++i)
-        for (auto j = 0; j < d2; ++j)
+    for (size_t i = 0; i < d1; ++i)
+        for (size_t j = 0; j < d2; ++j)
             m2[j][i] = m1[i][j];
+}
 
+/// @brief Transposes the matrix.
+/// @param m1 Input matrix.
+/// @return Transposed matrix.
+vector<vector<double>> transpose(const vector<vector<double>> &m1)
+{
+    vector<vector<double>> m2;
+    transpose_into(m2, m1);
     return m2;
 }
 
@@ -299,7 +414,7 @@ vector<vector<double>> transpose(const vector<vector<double>> m1)
 /// @param matrices All of the matrices in the current process.
 /// @param filename File to save matrices.
 /// @return True on success, false otherwise.
-bool save_file(const vector<vector<vector<double>>> matrices,
+bool save_file(const vector<vector<vector<double>>> &matrices,
                const char *filename)
 {
     fstream f;
@@ -416,6 +531,23 @@ bool gaussian_elimination(std::vector<std::vector<double>> &A, std::vector<doubl
 {
     const size_t n = A.size();
 
+    // up to 16x16 the elimination runs on the stack with the unrolled fixed-size kernel
+    bool square = b.size() == n;
+    for (size_t i = 0; i < n && square; i++)
+        square = A[i].size() == n;
+    bool solved = false;
+    if (square && dispatch_fixed_size(n, [&](auto size) {
+            constexpr size_t N = decltype(size)::value;
+            FixedMatrix<double, N, N> F = to_fixed<double, N, N>(A);
+            FixedVector<double, N> x;
+            std::copy(b.begin(), b.end(), x.begin());
+            solved = gaussian_elimination_fixed(F, x);
+            for (size_t i = 0; i < N; i++)
+                A[i].assign(F.row(i), F.row(i) + N);
+            b.assign(x.begin(), x.end());
+        }))
+        return solved;
+
     for (size_t i = 0; i < n; i++)
     {
 
@@ -457,7 +589,7 @@ bool gaussian_elimination(std::vector<std::vector<double>> &A, std::vector<doubl
 // A is an m x n matrix with m >= n
 // Q is an m x n orthogonal matrix
 // R is an n x n upper-triangular matrix
-pair<vector<vector<double>>, vector<vector<double>>> qr_factorization(vector<vector<double>> A)
+pair<vector<vector<double>>, vector<vector<double>>> qr_factorization(const vector<vector<double>> &A)
 {
     const int m = A.size();
     const int n = A[0].size();
@@ -566,7 +698,7 @@ std::vector<int> lu_factorization_inplace(std::vector<std::vector<double>> &A)
     return p;
 }
 
-tuple<vector<vector<double>>, vector<vector<double>>, vector<vector<double>>> lu_factorization(std::vector<std::vector<double>> &A)
+tuple<vector<vector<double>>, vector<vector<double>>, vector<vector<double>>> lu_factorization(const std::vector<std::vector<double>> &A)
 {
     vector<vector<double>> L(A.size(), vector<double>(A.size(), 0.0));
     vector<vector<double>> U(A.size(), vector<double>(A.size(), 0.0));
@@ -609,7 +741,7 @@ tuple<vector<vector<double>>, vector<vector<double>>, vector<vector<double>>> lu
 // Perfome Cholesky factorization on the input matrix A
 // Return the lower triangular matrix L
 
-vector<vector<double>> cholesky_factorization(std::vector<std::vector<double>> &A)
+vector<vector<double>> cholesky_factorization(const std::vector<std::vector<double>> &A)
 {
     const size_t n = A.size();
     vector<vector<double>> L(n, vector<double>(n, 0.0));
@@ -645,7 +777,7 @@ vector<vector<double>> cholesky_factorization(std::vector<std::vector<double>> &
 }
 
 // Perform LDL^T factorization on the input matrix A
-pair<std::vector<std::vector<double>>, std::vector<double>> ldlt_factorization(std::vector<std::vector<double>> &A)
+pair<std::vector<std::vector<double>>, std::vector<double>> ldlt_factorization(const std::vector<std::vector<double>> &A)
 {
     const int n = A.size();
 
@@ -1150,7 +1282,7 @@ std::vector<double> gcr(const std::vector<std::vector<double>> &A,
  * @param numCols 
  * @return double 
  */
-double find_matrix_determinant(std::vector<std::vector<double>> &matrix) {
+double find_matrix_determinant(const std::vector<std::vector<double>> &matrix) {
     int dimension = matrix.size();
 
     if (dimension == 1) {
@@ -1187,7 +1319,7 @@ double find_matrix_determinant(std::vector<std::vector<double>> &matrix) {
  * @param A 
  * @return double 
  */
-double matrix_determinant_lu(std::vector<std::vector<double>> &A)
+double matrix_determinant_lu(const std::vector<std::vector<double>> &A)
 {
     int n = A.size();
     vector<vector<double>> L(A.size(), vector<double>(A.size(), 0.0));
@@ -0,0 +1,448 @@
+// functionsAMG.cc
+// Smoothed aggregation algebraic multigrid (AMG) for CSR matrices. The hierarchy is
+// built once by amg_setup_CSR and then applied as a V-cycle, either on its own or as
+// a preconditioner for preconditioned_conjugate_gradient_CSR.
+
+#ifndef FUNCTIONS_AMG_CC
+#define FUNCTIONS_AMG_CC
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include "functionsCSR.cc"
+
+using namespace std;
+
+/// @brief The relaxation used on every level of the AMG hierarchy
+enum class AMGSmoother
+{
+    Jacobi,
+    Chebyshev
+};
+
+/// @brief Parameters of the AMG setup and cycle
+class AMGOptions
+{
+public:
+    /// a_ij is a strong connection when |a_ij| >= strength * sqrt(|a_ii * a_jj|)
+    double strength = 0.08;
+    /// stop coarsening once a level has at most this many rows; it is solved directly
+    size_t coarseSize = 50;
+    size_t maxLevels = 10;
+    AMGSmoother smoother = AMGSmoother::Chebyshev;
+    int preSweeps = 1;
+    int postSweeps = 1;
+    /// degree of the Chebyshev polynomial applied per sweep
+    int chebyshevDegree = 3;
+};
+
+/// @brief One level of the hierarchy: the operator, the transfer to the next coarser
+/// level, the data the smoother needs and work vectors so a cycle does not allocate
+template <typename T>
+class AMGLevel
+{
+public:
+    CSRMatrix<T> A;
+    /// prolongator P (this level x next level) and restriction R = P^T
+    CSRMatrix<T> P, R;
+    vector<T> invDiag;
+    /// estimate of the largest eigenvalue of D^-1 A
+    T lambdaMax = 0;
+    /// Chebyshev smoother over [lambdaMax / 30, lambdaMax]
+    ChebyshevCSR<T> chebyshev;
+    vector<T> x, b, r, work;
+};
+
+/// @brief A smoothed aggregation hierarchy, levels[0] holds the original matrix. The
+/// coarsest level is solved with a dense LU factorization kept in coarseLU/coarsePivot.
+template <typename T>
+class AMGHierarchy
+{
+public:
+    AMGOptions options;
+    vector<AMGLevel<T>> levels;
+    vector<T> coarseLU;
+    vector<size_t> coarsePivot;
+};
+
+/**
+ * @brief Strength of connection filter: keeps the off-diagonal entries with
+ * |a_ij| >= theta * sqrt(|a_ii * a_jj|). Only the pattern of the result is used.
+ *
+ * @tparam T
+ * @param A
+ * @param theta
+ * @return CSRMatrix<T> the strong connections of A, without the diagonal
+ */
+template <typename T>
+CSRMatrix<T> amg_strength_CSR(const CSRMatrix<T> &A, double theta)
+{
+    const vector<T> diag = diagonal_CSR(A);
+    CSRMatrix<T> S;
+    S.numRows = A.numRows;
+    S.numColumns = A.numColumns;
+    S.row_ptr.push_back(0);
+    for (size_t i = 0; i < A.numRows; i++)
+    {
+        for (size_t k = A.row_ptr[i]; k < A.row_ptr[i + 1]; k++)
+        {
+            const size_t j = A.col_ind[k];
+            if (j != i && std::abs(A.val[k]) >= theta * std::sqrt(std::abs(diag[i] * diag[j])))
+            {
+                S.val.push_back(A.val[k]);
+                S.col_ind.push_back(j);
+            }
+        }
+        S.row_ptr.push_back(S.col_ind.size());
+    }
+    return S;
+}
+
+/**
+ * @brief Standard three pass aggregation on the strength graph S.
+ * 1. every node whose strong neighbours are all free starts an aggregate with them,
+ * 2. remaining nodes join the aggregate of a strong neighbour from pass 1,
+ * 3. whatever is left is grouped with its free neighbours into new aggregates.
+ *
+ * @tparam T
+ * @param S strength graph from amg_strength_CSR
+ * @param numAggregates output, the number of aggregates
+ * @return vector<size_t> the aggregate of every node
+ */
+template <typename T>
+vector<size_t> amg_aggregate_CSR(const CSRMatrix<T> &S, size_t &numAggregates)
+{
+    const size_t n = S.numRows;
+    const size_t unassigned = static_cast<size_t>(-1);
+    vector<size_t> aggregate(n, unassigned);
+    numAggregates = 0;
+
+    // pass 1
+    for (size_t i = 0; i < n; i++)
+    {
+        if (aggregate[i] != unassigned)
+        {
+            continue;
+        }
+        bool free = true;
+        for (size_t k = S.row_ptr[i]; k < S.row_ptr[i + 1] && free; k++)
+        {
+            free = aggregate[S.col_ind[k]] == unassigned;
+        }
+        if (!free)
+        {
+            continue;
+        }
+        aggregate[i] = numAggregates;
+        for (size_t k = S.row_ptr[i]; k < S.row_ptr[i + 1]; k++)
+        {
+            aggregate[S.col_ind[k]] = numAggregates;
+        }
+        numAggregates++;
+    }
+
+    // pass 2, only joining aggregates that existed after pass 1
+    const vector<size_t> afterPassOne = aggregate;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (aggregate[i] != unassigned)
+        {
+            continue;
+        }
+        for (size_t k = S.row_ptr[i]; k < S.row_ptr[i + 1]; k++)
+        {
+            if (afterPassOne[S.col_ind[k]] != unassigned)
+            {
+                aggregate[i] = afterPassOne[S.col_ind[k]];
+                break;
+            }
+        }
+    }
+
+    // pass 3
+    for (size_t i = 0; i < n; i++)
+    {
+        if (aggregate[i] != unassigned)
+        {
+            continue;
+        }
+        aggregate[i] = numAggregates;
+        for (size_t k = S.row_ptr[i]; k < S.row_ptr[i + 1]; k++)
+        {
+            if (aggregate[S.col_ind[k]] == unassigned)
+            {
+                aggregate[S.col_ind[k]] = numAggregates;
+            }
+        }
+        numAggregates++;
+    }
+    return aggregate;
+}
+
+/**
+ * @brief Tentative prolongator for the constant near null space: column a has the
+ * value 1/sqrt(|aggregate a|) on the rows of aggregate a, so its columns are orthonormal
+ *
+ * @tparam T
+ * @param aggregate from amg_aggregate_CSR
+ * @param numAggregates
+ * @return CSRMatrix<T>
+ */
+template <typename T>
+CSRMatrix<T> amg_tentative_prolongator_CSR(const vector<size_t> &aggregate, size_t numAggregates)
+{
+    const size_t n = aggregate.size();
+    vector<size_t> size(numAggregates, 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        size[aggregate[i]]++;
+    }
+    CSRMatrix<T> P;
+    P.numRows = n;
+    P.numColumns = numAggregates;
+    P.row_ptr.resize(n + 1);
+    P.col_ind.resize(n);
+    P.val.resize(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        P.row_ptr[i] = i;
+        P.col_ind[i] = aggregate[i];
+        P.val[i] = 1.0 / std::sqrt(static_cast<T>(size[aggregate[i]]));
+    }
+    P.row_ptr[n] = n;
+    return P;
+}
+
+/**
+ * @brief Factors the coarsest operator with dense LU and partial pivoting
+ */
+template <typename T>
+void amg_factor_coarse(AMGHierarchy<T> &H)
+{
+    const CSRMatrix<T> &A = H.levels.back().A;
+    const size_t n = A.numRows;
+    H.coarseLU.assign(n * n, 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t k = A.row_ptr[i]; k < A.row_ptr[i + 1]; k++)
+        {
+            H.coarseLU[i * n + A.col_ind[k]] = A.val[k];
+        }
+    }
+    dense_lu_factor(H.coarseLU, H.coarsePivot, n);
+}
+
+/**
+ * @brief Solves the coarsest level, x = A^-1 b
+ */
+template <typename T>
+void amg_solve_coarse(const AMGHierarchy<T> &H, const vector<T> &b, vector<T> &x)
+{
+    x.assign(b.begin(), b.end());
+    dense_lu_solve(H.coarseLU, H.coarsePivot, x);
+}
+
+/**
+ * @brief Builds a smoothed aggregation hierarchy for A. On each level the strong
+ * connections are aggregated, the tentative prolongator P0 is smoothed with one
+ * damped Jacobi step, P = (I - 4/(3 rho) D^-1 A) P0, and the next operator is the
+ * Galerkin product P^T A P computed with multiply_matrixCSR.
+ *
+ * @tparam T
+ * @param A square matrix with a nonzero diagonal, typically SPD
+ * @param options
+ * @return AMGHierarchy<T>
+ */
+template <typename T>
+AMGHierarchy<T> amg_setup_CSR(const CSRMatrix<T> &A, const AMGOptions &options = AMGOptions())
+{
+    if (A.numRows != A.numColumns)
+    {
+        throw std::invalid_argument("AMG needs a square matrix.");
+    }
+    AMGHierarchy<T> H;
+    H.options = options;
+    H.levels.emplace_back();
+    H.levels[0].A = A;
+
+    while (true)
+    {
+        AMGLevel<T> &level = H.levels.back();
+        const size_t n = level.A.numRows;
+        level.chebyshev = chebyshev_setup_CSR<T>(level.A, options.chebyshevDegree, 30);
+        level.invDiag = level.chebyshev.invDiag;
+        level.lambdaMax = level.chebyshev.upper;
+        level.x.resize(n);
+        level.b.resize(n);
+        level.r.resize(n);
+        level.work.resize(n);
+        if (n <= options.coarseSize || H.levels.size() >= options.maxLevels)
+        {
+            break;
+        }
+
+        size_t numAggregates = 0;
+        const vector<size_t> aggregate = amg_aggregate_CSR(amg_strength_CSR(level.A, options.strength), numAggregates);
+        if (numAggregates == 0 || numAggregates >= n)
+        {
+            // no coarsening possible, solve this level directly
+            break;
+        }
+        CSRMatrix<T> P0 = amg_tentative_prolongator_CSR<T>(aggregate, numAggregates);
+
+        // P = P0 - omega D^-1 (A P0)
+        CSRMatrix<T> AP0 = multiply_matrixCSR(level.A, P0);
+        const T omega = 4.0 / (3.0 * level.lambdaMax);
+        for (size_t i = 0; i < n; i++)
+        {
+            for (size_t k = AP0.row_ptr[i]; k < AP0.row_ptr[i + 1]; k++)
+            {
+                AP0.val[k] *= omega * level.invDiag[i];
+            }
+        }
+        level.P = subtract_matrixCSR(P0, AP0);
+        level.R = transpose_matrixCSR(level.P);
+        CSRMatrix<T> coarse = multiply_matrixCSR(level.R, multiply_matrixCSR(level.A, level.P));
+
+        H.levels.emplace_back();
+        H.levels.back().A = std::move(coarse);
+    }
+    amg_factor_coarse(H);
+    return H;
+}
+
+/**
+ * @brief Applies `sweeps` sweeps of the configured smoother to level.x for the right
+ * hand side level.b. Both smoothers are polynomials in D^-1 A, so pre and post
+ * smoothing together keep the V-cycle symmetric.
+ */
+template <typename T>
+void amg_smooth(AMGLevel<T> &level, const AMGOptions &options, int sweeps)
+{
+    if (options.smoother == AMGSmoother::Jacobi)
+    {
+        const T weight = 4.0 / (3.0 * level.lambdaMax);
+        for (int s = 0; s < sweeps; s++)
+        {
+            jacobi_sweep_CSR(level.A, level.invDiag, level.b, level.x, level.work, weight);
+            level.x.swap(level.work);
+        }
+        return;
+    }
+    // Chebyshev damps the upper part of the spectrum of D^-1 A, which the coarse
+    // grid cannot represent
+    for (int s = 0; s < sweeps; s++)
+    {
+        chebyshev_smooth_CSR(level.A, level.chebyshev, level.b, level.x);
+    }
+}
+
+/**
+ * @brief One V-cycle starting at level l, improving H.levels[l].x for the right hand
+ * side H.levels[l].b
+ */
+template <typename T>
+void amg_vcycle(AMGHierarchy<T> &H, size_t l)
+{
+    AMGLevel<T> &level = H.levels[l];
+    if (l + 1 == H.levels.size())
+    {
+        amg_solve_coarse(H, level.b, level.x);
+        return;
+    }
+    amg_smooth(level, H.options, H.options.preSweeps);
+
+    // restrict the residual
+    matrix_vector_product_CSR(level.A, level.x, level.r);
+    for (size_t i = 0; i < level.A.numRows; i++)
+    {
+        level.r[i] = level.b[i] - level.r[i];
+    }
+    AMGLevel<T> &coarse = H.levels[l + 1];
+    matrix_vector_product_CSR(level.R, level.r, coarse.b);
+    std::fill(coarse.x.begin(), coarse.x.end(), 0.0);
+    amg_vcycle(H, l + 1);
+
+    // prolongate and correct
+    matrix_vector_product_CSR(level.P, coarse.x, level.r);
+    for (size_t i = 0; i < level.A.numRows; i++)
+    {
+        level.x[i] += level.r[i];
+    }
+    amg_smooth(level, H.options, H.options.postSweeps);
+}
+
+/**
+ * @brief Solves Ax = b with AMG V-cycles as a stationary method
+ *
+ * @tparam T
+ * @param H hierarchy from amg_setup_CSR
+ * @param b
+ * @param tol tolerance on the 2-norm of the residual
+ * @param maxit maximum number of V-cycles
+ * @param info optional convergence report
+ * @return vector<T>
+ */
+template <typename T>
+vector<T> amg_solve_CSR(AMGHierarchy<T> &H, const vector<T> &b, double tol, int maxit, SolverInfo *info = nullptr)
+{
+    AMGLevel<T> &fine = H.levels[0];
+    const size_t n = fine.A.numRows;
+    std::fill(fine.x.begin(), fine.x.end(), 0.0);
+    fine.b.assign(b.begin(), b.end());
+    vector<T> r(n);
+    T normR = std::sqrt(std::inner_product(b.begin(), b.end(), b.begin(), T(0)));
+    if (info)
+    {
+        info->residuals.assign(1, normR);
+    }
+    int it = 0;
+    while (it < maxit && normR >= tol)
+    {
+        amg_vcycle(H, 0);
+        matrix_vector_product_CSR(fine.A, fine.x, r);
+        normR = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            normR += (b[i] - r[i]) * (b[i] - r[i]);
+        }
+        normR = std::sqrt(normR);
+        it++;
+        if (info)
+        {
+            info->residuals.push_back(normR);
+        }
+    }
+    if (info)
+    {
+        info->iterations = it;
+        info->converged = normR < tol;
+    }
+    return fine.x;
+}
+
+/**
+ * @brief Wraps one V-cycle with a zero initial guess as a preconditioner, z = M^-1 r,
+ * for preconditioned_conjugate_gradient_CSR and the other Krylov solvers. The
+ * hierarchy holds the work vectors, so it must outlive the preconditioner and must not
+ * be shared between threads.
+ *
+ * @tparam T
+ * @param H hierarchy from amg_setup_CSR
+ * @return PreconditionerCSR<T>
+ */
+template <typename T>
+PreconditionerCSR<T> make_amg_preconditioner_CSR(AMGHierarchy<T> &H)
+{
+    return [&H](const vector<T> &r, vector<T> &z)
+    {
+        AMGLevel<T> &fine = H.levels[0];
+        fine.b.assign(r.begin(), r.end());
+        std::fill(fine.x.begin(), fine.x.end(), 0.0);
+        amg_vcycle(H, 0);
+        z.assign(fine.x.begin(), fine.x.end());
+    };
+}
+
+#endif
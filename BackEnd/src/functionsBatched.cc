@@ -0,0 +1,493 @@
+// functionsBatched.cc
+// Batched operations on many equally sized small dense matrices: GEMM, LU with partial
+// pivoting and solve. The batch is stored interleaved (structure of arrays): entry (i, j)
+// of every member is contiguous, so each kernel runs its loops over i, j and k once for
+// the whole batch and the innermost loop, over the members, is SIMD vectorized. The
+// kernels act on a range of members, which is how functionsBatchedParallel.cc splits a
+// batch into TBB tasks; dimensions up to FIXED_MAX_DIMENSION become template arguments
+// through dispatch_fixed_size so that the loops over them have constant trip counts. LU,
+// solve and square GEMM fix every such loop; other GEMM shapes fix only k.
+
+#ifndef FUNCTIONS_BATCHED_CC
+#define FUNCTIONS_BATCHED_CC
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "functionsFixed.cc"
+#include "functionsSIMD.cc"
+
+/**
+ * @brief count matrices of numRows x numColumns, interleaved: entry (i, j) of member b
+ * is val[(i * numColumns + j) * count + b]
+ *
+ * @tparam T
+ */
+template <typename T>
+struct BatchedMatrices
+{
+    size_t count = 0;
+    size_t numRows = 0;
+    size_t numColumns = 0;
+    std::vector<T> val;
+
+    T &operator()(size_t b, size_t i, size_t j) { return val[(i * numColumns + j) * count + b]; }
+    const T &operator()(size_t b, size_t i, size_t j) const { return val[(i * numColumns + j) * count + b]; }
+};
+
+/// @brief Gives B the shape of a batch, reusing its storage; the values are zeroed
+template <typename T>
+void resize_batched(BatchedMatrices<T> &B, size_t count, size_t numRows, size_t numColumns)
+{
+    B.count = count;
+    B.numRows = numRows;
+    B.numColumns = numColumns;
+    B.val.assign(count * numRows * numColumns, T(0));
+}
+
+/// @brief A batch of count zero matrices
+template <typename T>
+BatchedMatrices<T> make_batched(size_t count, size_t numRows, size_t numColumns)
+{
+    BatchedMatrices<T> B;
+    resize_batched(B, count, numRows, numColumns);
+    return B;
+}
+
+/// @brief Interleaves equally sized dense matrices into a batch
+/// @exception every matrix must have the dimensions of the first
+template <typename T>
+BatchedMatrices<T> pack_batched(const std::vector<std::vector<std::vector<T>>> &matrices)
+{
+    const size_t rows = matrices.empty() ? 0 : matrices[0].size();
+    const size_t cols = rows == 0 ? 0 : matrices[0][0].size();
+    BatchedMatrices<T> B = make_batched<T>(matrices.size(), rows, cols);
+    for (size_t b = 0; b < matrices.size(); b++)
+    {
+        if (matrices[b].size() != rows)
+        {
+            throw std::invalid_argument("The matrices of a batch must have the same dimensions.");
+        }
+        for (size_t i = 0; i < rows; i++)
+        {
+            if (matrices[b][i].size() != cols)
+            {
+                throw std::invalid_argument("The matrices of a batch must have the same dimensions.");
+            }
+            for (size_t j = 0; j < cols; j++)
+            {
+                B(b, i, j) = matrices[b][i][j];
+            }
+        }
+    }
+    return B;
+}
+
+/// @brief Member b of a batch as a dense matrix
+template <typename T>
+std::vector<std::vector<T>> unpack_batched(const BatchedMatrices<T> &B, size_t b)
+{
+    std::vector<std::vector<T>> m(B.numRows, std::vector<T>(B.numColumns));
+    for (size_t i = 0; i < B.numRows; i++)
+    {
+        for (size_t j = 0; j < B.numColumns; j++)
+        {
+            m[i][j] = B(b, i, j);
+        }
+    }
+    return m;
+}
+
+/// @brief Member b of a batch as a fixed matrix
+/// @exception the batch must hold R x C matrices
+template <typename T, size_t R, size_t C>
+void load_fixed(FixedMatrix<T, R, C> &A, const BatchedMatrices<T> &B, size_t b)
+{
+    if (B.numRows != R || B.numColumns != C)
+    {
+        throw std::invalid_argument("The batch does not hold matrices of the dimensions of the fixed matrix.");
+    }
+    for (size_t k = 0; k < R * C; k++)
+    {
+        A.a[k] = B.val[k * B.count + b];
+    }
+}
+
+/// @brief Writes a fixed matrix to member b of a batch
+/// @exception the batch must hold R x C matrices
+template <typename T, size_t R, size_t C>
+void store_fixed(const FixedMatrix<T, R, C> &A, BatchedMatrices<T> &B, size_t b)
+{
+    if (B.numRows != R || B.numColumns != C)
+    {
+        throw std::invalid_argument("The batch does not hold matrices of the dimensions of the fixed matrix.");
+    }
+    for (size_t k = 0; k < R * C; k++)
+    {
+        B.val[k * B.count + b] = A.a[k];
+    }
+}
+
+/**
+ * @brief Calls kernel(n) with n as a std::integral_constant when it is small enough for
+ * dispatch_fixed_size, and as a size_t otherwise; the kernels take either
+ */
+template <typename F>
+void with_batched_size(size_t n, const F &kernel)
+{
+    if (!dispatch_fixed_size(n, kernel))
+    {
+        kernel(n);
+    }
+}
+
+/**
+ * @brief C = alpha * A * B + beta * C for the members first <= b < last, all matrices
+ * interleaved with the same count
+ *
+ * @param rows rows of A and C
+ * @param inner columns of A, rows of B
+ * @param cols columns of B and C
+ */
+template <typename T, typename Rows, typename Inner, typename Cols>
+void batched_gemm_kernel(T *c, const T alpha, const T *a, const T *bm, const T beta, size_t count, Rows rows,
+                         Inner inner, Cols cols, size_t first, size_t last)
+{
+    for (size_t i = 0; i < rows; i++)
+    {
+        for (size_t j = 0; j < cols; j++)
+        {
+            T *cij = c + (i * cols + j) * count;
+            SIMD_LOOP
+            for (size_t b = first; b < last; b++)
+            {
+                // beta = 0 overwrites C, which may hold anything
+                cij[b] = beta == T(0) ? T(0) : beta * cij[b];
+            }
+        }
+        for (size_t k = 0; k < inner; k++)
+        {
+            const T *aik = a + (i * inner + k) * count;
+            for (size_t j = 0; j < cols; j++)
+            {
+                const T *bkj = bm + (k * cols + j) * count;
+                T *cij = c + (i * cols + j) * count;
+                SIMD_LOOP
+                for (size_t b = first; b < last; b++)
+                {
+                    cij[b] += alpha * aik[b] * bkj[b];
+                }
+            }
+        }
+    }
+}
+
+/// @brief Checks the operands of a batched GEMM and shapes C; it is resized when beta is 0
+/// @exception the batches must have the same count and conforming dimensions, and C must
+/// not be A or B
+template <typename T>
+void prepare_batched_gemm(BatchedMatrices<T> &C, const BatchedMatrices<T> &A, const BatchedMatrices<T> &B,
+                          const T beta)
+{
+    if (A.count != B.count || A.numColumns != B.numRows)
+    {
+        throw std::invalid_argument("The batches must have the same count and the columns of the first must "
+                                    "match the rows of the second.");
+    }
+    if (&C == &A || &C == &B)
+    {
+        throw std::invalid_argument("The output of a batched GEMM must not be one of its inputs.");
+    }
+    if (beta == T(0))
+    {
+        if (C.count != A.count || C.numRows != A.numRows || C.numColumns != B.numColumns)
+        {
+            resize_batched(C, A.count, A.numRows, B.numColumns);
+        }
+    }
+    else if (C.count != A.count || C.numRows != A.numRows || C.numColumns != B.numColumns)
+    {
+        throw std::invalid_argument("The batch to accumulate into does not have the dimensions of the product.");
+    }
+}
+
+/// @brief The batched GEMM on the members first <= b < last, once prepare_batched_gemm
+/// has checked the operands. Square members get all three dimensions as constants; the
+/// other shapes only the inner one, since dispatching each dimension separately would
+/// instantiate FIXED_MAX_DIMENSION^3 kernels.
+template <typename T>
+void batched_gemm_members(BatchedMatrices<T> &C, const T alpha, const BatchedMatrices<T> &A,
+                          const BatchedMatrices<T> &B, const T beta, size_t first, size_t last)
+{
+    if (A.numRows == A.numColumns && B.numRows == B.numColumns)
+    {
+        with_batched_size(A.numRows, [&](auto n) {
+            batched_gemm_kernel(C.val.data(), alpha, A.val.data(), B.val.data(), beta, A.count, n, n, n, first, last);
+        });
+        return;
+    }
+    with_batched_size(A.numColumns, [&](auto inner) {
+        batched_gemm_kernel(C.val.data(), alpha, A.val.data(), B.val.data(), beta, A.count, A.numRows, inner,
+                            B.numColumns, first, last);
+    });
+}
+
+/**
+ * @brief C = alpha * A * B + beta * C for every member of the batches
+ *
+ * @param C The output; with beta = 0 it is resized, otherwise it must have the shape of
+ * the product
+ * @exception the batches must have the same count and conforming dimensions, and C must
+ * not be A or B
+ */
+template <typename T>
+void batched_gemm(BatchedMatrices<T> &C, const T alpha, const BatchedMatrices<T> &A, const BatchedMatrices<T> &B,
+                  const T beta)
+{
+    prepare_batched_gemm(C, A, B, beta);
+    batched_gemm_members(C, alpha, A, B, beta, 0, A.count);
+}
+
+/**
+ * @brief The LU factorizations of a batch, PA = LU for every member, stored in place as
+ * lu_factorization_inplace stores them. Row k was swapped with row pivots[k * count + b]
+ * at step k of member b. info[b] is 0 when member b factored, or k + 1 when its pivot k
+ * was zero, as in LAPACK; the factorization of a singular member is not usable.
+ *
+ * @tparam T
+ */
+template <typename T>
+struct BatchedLU
+{
+    BatchedMatrices<T> lu;
+    std::vector<size_t> pivots;
+    std::vector<int> info;
+};
+
+/// @brief LU with partial pivoting of the members first <= b < last of an interleaved
+/// batch of n x n matrices
+template <typename T, typename Size>
+void batched_lu_kernel(T *a, size_t *pivots, int *info, size_t count, Size n, size_t first, size_t last)
+{
+    for (size_t k = 0; k < n; k++)
+    {
+        size_t *p = pivots + k * count;
+        SIMD_LOOP
+        for (size_t b = first; b < last; b++)
+        {
+            p[b] = k;
+        }
+        for (size_t i = k + 1; i < n; i++)
+        {
+            const T *aik = a + (i * n + k) * count;
+            SIMD_LOOP
+            for (size_t b = first; b < last; b++)
+            {
+                const T current = a[(p[b] * n + k) * count + b];
+                const T candidate = aik[b];
+                p[b] = (candidate < T(0) ? -candidate : candidate) > (current < T(0) ? -current : current) ? i : p[b];
+            }
+        }
+        for (size_t b = first; b < last; b++)
+        {
+            if (p[b] != k)
+            {
+                for (size_t j = 0; j < n; j++)
+                {
+                    std::swap(a[(k * n + j) * count + b], a[(p[b] * n + j) * count + b]);
+                }
+            }
+        }
+        const T *akk = a + (k * n + k) * count;
+        for (size_t b = first; b < last; b++)
+        {
+            if (akk[b] == T(0) && info[b] == 0)
+            {
+                info[b] = int(k + 1);
+            }
+        }
+        for (size_t i = k + 1; i < n; i++)
+        {
+            T *lik = a + (i * n + k) * count;
+            SIMD_LOOP
+            for (size_t b = first; b < last; b++)
+            {
+                // a zero pivot leaves its column alone so the member stays finite
+                lik[b] = akk[b] == T(0) ? T(0) : lik[b] / akk[b];
+            }
+            for (size_t j = k + 1; j < n; j++)
+            {
+                T *aij = a + (i * n + j) * count;
+                const T *akj = a + (k * n + j) * count;
+                SIMD_LOOP
+                for (size_t b = first; b < last; b++)
+                {
+                    aij[b] -= lik[b] * akj[b];
+                }
+            }
+        }
+    }
+}
+
+/// @brief The storage for the factorization of A, which is moved into it
+/// @exception the members of A must be square
+template <typename T>
+BatchedLU<T> prepare_batched_lu(BatchedMatrices<T> A)
+{
+    if (A.numRows != A.numColumns)
+    {
+        throw std::invalid_argument("Error: Matrix must be square nxn");
+    }
+    BatchedLU<T> f;
+    f.pivots.assign(A.count * A.numRows, 0);
+    f.info.assign(A.count, 0);
+    f.lu = std::move(A);
+    return f;
+}
+
+/// @brief Factors the members first <= b < last of f.lu in place
+template <typename T>
+void batched_lu_members(BatchedLU<T> &f, size_t first, size_t last)
+{
+    with_batched_size(f.lu.numRows, [&](auto n) {
+        batched_lu_kernel(f.lu.val.data(), f.pivots.data(), f.info.data(), f.lu.count, n, first, last);
+    });
+}
+
+/**
+ * @brief LU factorization with partial pivoting of every member of a batch. A singular
+ * member does not stop the others; it is reported in info.
+ *
+ * @param A The batch of square matrices, taken by value and factored in place; pass
+ * std::move(A) when it is no longer needed
+ * @exception the members of A must be square
+ */
+template <typename T>
+BatchedLU<T> batched_lu(BatchedMatrices<T> A)
+{
+    BatchedLU<T> f = prepare_batched_lu(std::move(A));
+    batched_lu_members(f, 0, f.lu.count);
+    return f;
+}
+
+/// @brief Solves A X = B for the members first <= b < last from the interleaved LU
+/// factors, B being overwritten with X
+template <typename T, typename Size>
+void batched_lu_solve_kernel(const T *lu, const size_t *pivots, T *x, size_t count, Size n, size_t rhs, size_t first,
+                             size_t last)
+{
+    for (size_t k = 0; k < n; k++)
+    {
+        const size_t *p = pivots + k * count;
+        for (size_t b = first; b < last; b++)
+        {
+            if (p[b] != k)
+            {
+                for (size_t c = 0; c < rhs; c++)
+                {
+                    std::swap(x[(k * rhs + c) * count + b], x[(p[b] * rhs + c) * count + b]);
+                }
+            }
+        }
+    }
+    // L has a unit diagonal
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t j = 0; j < i; j++)
+        {
+            const T *lij = lu + (i * n + j) * count;
+            for (size_t c = 0; c < rhs; c++)
+            {
+                T *xi = x + (i * rhs + c) * count;
+                const T *xj = x + (j * rhs + c) * count;
+                SIMD_LOOP
+                for (size_t b = first; b < last; b++)
+                {
+                    xi[b] -= lij[b] * xj[b];
+                }
+            }
+        }
+    }
+    for (size_t r = 0; r < n; r++)
+    {
+        const size_t i = n - 1 - r;
+        for (size_t j = i + 1; j < n; j++)
+        {
+            const T *uij = lu + (i * n + j) * count;
+            for (size_t c = 0; c < rhs; c++)
+            {
+                T *xi = x + (i * rhs + c) * count;
+                const T *xj = x + (j * rhs + c) * count;
+                SIMD_LOOP
+                for (size_t b = first; b < last; b++)
+                {
+                    xi[b] -= uij[b] * xj[b];
+                }
+            }
+        }
+        const T *uii = lu + (i * n + i) * count;
+        for (size_t c = 0; c < rhs; c++)
+        {
+            T *xi = x + (i * rhs + c) * count;
+            SIMD_LOOP
+            for (size_t b = first; b < last; b++)
+            {
+                xi[b] /= uii[b];
+            }
+        }
+    }
+}
+
+/// @brief Checks that B can be solved with the factorization f
+/// @exception B must have as many members as f and as many rows as its matrices
+template <typename T>
+void check_batched_solve(const BatchedLU<T> &f, const BatchedMatrices<T> &B)
+{
+    if (B.count != f.lu.count || B.numRows != f.lu.numRows)
+    {
+        throw std::invalid_argument("The right hand sides must have the count and rows of the factored batch.");
+    }
+}
+
+/// @brief The solve of the members first <= b < last, once check_batched_solve has passed
+template <typename T>
+void batched_lu_solve_members(const BatchedLU<T> &f, BatchedMatrices<T> &B, size_t first, size_t last)
+{
+    with_batched_size(f.lu.numRows, [&](auto n) {
+        batched_lu_solve_kernel(f.lu.val.data(), f.pivots.data(), B.val.data(), f.lu.count, n, B.numColumns, first,
+                                last);
+    });
+}
+
+/**
+ * @brief Solves A X = B for every member from the batched LU factorization of A. The
+ * members that info reports as singular get non-finite solutions.
+ *
+ * @param f from batched_lu
+ * @param B The right hand sides, one or more columns per member, overwritten with X
+ * @exception B must have as many members as f and as many rows as its matrices
+ */
+template <typename T>
+void batched_lu_solve(const BatchedLU<T> &f, BatchedMatrices<T> &B)
+{
+    check_batched_solve(f, B);
+    batched_lu_solve_members(f, B, 0, B.count);
+}
+
+/**
+ * @brief Solves A X = B for every member of the batches
+ *
+ * @param A The batch of square matrices, taken by value and factored in place
+ * @param B The right hand sides, overwritten with X
+ * @return info as batched_lu reports it, 0 for every member that was solved
+ */
+template <typename T>
+std::vector<int> batched_solve(BatchedMatrices<T> A, BatchedMatrices<T> &B)
+{
+    BatchedLU<T> f = batched_lu(std::move(A));
+    batched_lu_solve(f, B);
+    return std::move(f.info);
+}
+
+#endif
@@ -0,0 +1,77 @@
+// functionsBatchedParallel.cc
+// Parallel versions of the batched operations in functionsBatched.cc. The members of a
+// batch are split into chunks that run the SIMD kernels concurrently; the members are
+// independent, so the results are identical to the serial functions.
+
+#ifndef FUNCTIONS_BATCHED_PARALLEL_CC
+#define FUNCTIONS_BATCHED_PARALLEL_CC
+
+#include <utility>
+#include <vector>
+#include <tbb/tbb.h>
+#include "functionsBatched.cc"
+
+namespace parallel {
+
+/// @brief Below this many members the serial functions are used
+constexpr size_t BATCHED_PARALLEL_CUTOFF = 1024;
+
+/// @brief Members per task, a multiple of every SIMD width so that the chunks of an
+/// interleaved entry start on vector boundaries
+constexpr size_t BATCHED_CHUNK = 256;
+
+/// @brief Runs kernel(first, last) over chunks of the count members
+template <typename F>
+void for_each_batch_chunk(size_t count, const F &kernel)
+{
+    if (count < BATCHED_PARALLEL_CUTOFF)
+    {
+        kernel(size_t(0), count);
+        return;
+    }
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, count, BATCHED_CHUNK),
+                      [&](const tbb::blocked_range<size_t> &r) { kernel(r.begin(), r.end()); });
+}
+
+/// @brief Parallel version of batched_gemm
+template <typename T>
+void batched_gemm(BatchedMatrices<T> &C, const T alpha, const BatchedMatrices<T> &A, const BatchedMatrices<T> &B,
+                  const T beta)
+{
+    prepare_batched_gemm(C, A, B, beta);
+    parallel::for_each_batch_chunk(A.count, [&](size_t first, size_t last) {
+        batched_gemm_members(C, alpha, A, B, beta, first, last);
+    });
+}
+
+/// @brief Parallel version of batched_lu
+template <typename T>
+BatchedLU<T> batched_lu(BatchedMatrices<T> A)
+{
+    BatchedLU<T> f = prepare_batched_lu(std::move(A));
+    parallel::for_each_batch_chunk(f.lu.count, [&](size_t first, size_t last) { batched_lu_members(f, first, last); });
+    return f;
+}
+
+/// @brief Parallel version of batched_lu_solve
+template <typename T>
+void batched_lu_solve(const BatchedLU<T> &f, BatchedMatrices<T> &B)
+{
+    check_batched_solve(f, B);
+    parallel::for_each_batch_chunk(B.count, [&](size_t first, size_t last) {
+        batched_lu_solve_members(f, B, first, last);
+    });
+}
+
+/// @brief Parallel version of batched_solve
+template <typename T>
+std::vector<int> batched_solve(BatchedMatrices<T> A, BatchedMatrices<T> &B)
+{
+    BatchedLU<T> f = parallel::batched_lu(std::move(A));
+    parallel::batched_lu_solve(f, B);
+    return std::move(f.info);
+}
+
+} // namespace parallel
+
+#endif
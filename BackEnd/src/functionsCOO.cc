@@ -1,3 +1,6 @@
+#ifndef FUNCTIONS_COO_CC
+#define FUNCTIONS_COO_CC
+
 #include <stdlib.h>
 #include <vector>
 #include <iostream>
@@ -10,6 +13,10 @@
 #include <map>
 #include <cmath>
 #include <unordered_map>
+#include <functional>
+#include <utility>
+#include <memory>
+#include "functionsStatistics.cc"
 
 //Rather than create three separate vectors, could store one vector with a struct that consists of the
 //coordinates and the values all as one.
@@ -26,6 +33,9 @@ namespace COO {
 
     //save position and value of non-zero elements
         public:
+            // the scalar type of the matrix; scalar arguments are taken as this type so
+            // that they convert instead of taking part in deducing T
+            using value_type = T;
             std::vector<size_t> rowCoord;
             std::vector<size_t> colCoord;
             std::vector<T> values;
@@ -35,7 +45,8 @@ namespace COO {
     };
 
     /**
-     * @brief Get the Value COO object
+     * @brief Get the Value COO object. This scans every entry, since the entries may be in
+     * any order; for repeated lookups build a COOIndex once.
      * 
      * @param compressedCoord 
      * @param row 
@@ -43,11 +54,11 @@ namespace COO {
      * @return double 
      */
     template<typename T>
-        T get_matrixCOO(COOMatrix<T> compressedCoord, size_t row, size_t col) {
-            if (compressedCoord.numRows < row) {
+        T get_matrixCOO(const COOMatrix<T>& compressedCoord, size_t row, size_t col) {
+            if (compressedCoord.numRows <= row) {
                 throw std::invalid_argument("Row is not within range\n");
             }
-            if (compressedCoord.numCols < col) {
+            if (compressedCoord.numCols <= col) {
                 throw std::invalid_argument("Column is not within range\n");
             }
 
@@ -61,6 +72,58 @@ namespace COO {
         }
 
 
+    /**
+     * @brief Hashed index of the entries of a COO matrix for O(1) expected lookups in any
+     * entry order. Built once in O(nnz); it refers to the matrix, which must outlive it
+     * and not be modified. With duplicate entries the first one is found, as in
+     * get_matrixCOO.
+     * 
+     * @tparam T 
+     */
+    template <typename T>
+        class COOIndex {
+            public:
+                static constexpr size_t npos = static_cast<size_t>(-1);
+
+                explicit COOIndex(const COOMatrix<T>& compressedCoord) : matrix(&compressedCoord) {
+                    positions.reserve(compressedCoord.values.size());
+                    for (size_t k = 0; k < compressedCoord.values.size(); ++k) {
+                        positions.emplace(key(compressedCoord.rowCoord[k], compressedCoord.colCoord[k]), k);
+                    }
+                }
+
+                /// position of entry (row, col) in the coordinate vectors, npos if not stored
+                size_t find(size_t row, size_t col) const {
+                    auto found = positions.find(key(row, col));
+                    return found == positions.end() ? npos : found->second;
+                }
+
+                T get(size_t row, size_t col) const {
+                    if (matrix->numRows <= row) {
+                        throw std::invalid_argument("Row is not within range\n");
+                    }
+                    if (matrix->numCols <= col) {
+                        throw std::invalid_argument("Column is not within range\n");
+                    }
+                    const size_t k = find(row, col);
+                    return k == npos ? T(0) : matrix->values[k];
+                }
+
+            private:
+                struct KeyHash {
+                    size_t operator()(const std::pair<size_t, size_t>& k) const {
+                        // 64-bit mix of the row into the column
+                        return std::hash<size_t>()(k.first * 0x9E3779B97F4A7C15ull ^ k.second);
+                    }
+                };
+
+                static std::pair<size_t, size_t> key(size_t row, size_t col) { return std::make_pair(row, col); }
+
+                const COOMatrix<T>* matrix;
+                std::unordered_map<std::pair<size_t, size_t>, size_t, KeyHash> positions;
+        };
+
+
     /**
      * @brief Convert a dense matrix to a sparse compressed column object. Any non-zero values are added 
      *        along with their coordinates
@@ -99,7 +162,7 @@ namespace COO {
      * @return std::vector<std::vector<int>> 
      */
     template<typename T>
-        std::vector<std::vector<T>> convertCOOtoDense(COOMatrix<T> compressedCoord) {
+        std::vector<std::vector<T>> convertCOOtoDense(const COOMatrix<T>& compressedCoord) {
             std::vector<std::vector<int>> dense;
             int nnz_id = 0;
 
@@ -119,17 +182,56 @@ namespace COO {
         }
 
     /**
-     * @brief Find the minumum, nonzero value within the COO values vector
+     * @brief Statistics of a COO matrix (min, max, sum, norms, diagonal dominance, pattern
+     * symmetry) in one pass over the entries. Nothing is cached on the matrix. Entries are
+     * taken as stored, so duplicates count separately (see canonicalize_COO);
+     * the transposed entries for the symmetry check are looked up in a COOIndex.
+     * 
+     * @tparam T 
+     * @param compressedCoord 
+     * @return MatrixStatistics<T> 
+     */
+    template<typename T>
+        MatrixStatistics<T> statistics_COO(const COOMatrix<T> &compressedCoord) {
+            const size_t count = compressedCoord.values.size();
+            StatisticsAccumulator<T> acc;
+            acc.add_values(compressedCoord.values.data(), count);
+            acc.symmetric = compressedCoord.numRows == compressedCoord.numCols;
+            std::unique_ptr<COOIndex<T>> index;
+            if (acc.symmetric && count > 0) {
+                index = std::make_unique<COOIndex<T>>(compressedCoord);
+            }
+
+            std::vector<double> rowOff(compressedCoord.numRows, 0.0), colOff(compressedCoord.numCols, 0.0),
+                diag(std::min(compressedCoord.numRows, compressedCoord.numCols), 0.0);
+            for (size_t k = 0; k < count; ++k) {
+                const size_t row = compressedCoord.rowCoord[k], col = compressedCoord.colCoord[k];
+                const double a = abs_value(compressedCoord.values[k]);
+                if (row == col) {
+                    diag[row] += a;
+                    continue;
+                }
+                rowOff[row] += a;
+                colOff[col] += a;
+                if (acc.symmetric && index->find(col, row) == COOIndex<T>::npos) {
+                    acc.symmetric = false;
+                }
+            }
+
+            return finish_statistics(acc, rowOff, colOff, diag);
+        }
+
+    /**
+     * @brief Find the minumum value within the COO values vector
      * 
      * @tparam T 
      * @param compressedCoord 
      * @return T 
      */
     template<typename T>
-        T find_min_COO(COOMatrix<T> &compressedCoord) {
+        T find_min_COO(const COOMatrix<T> &compressedCoord) {
             if (compressedCoord.values.size() == 0) {
                 throw std::invalid_argument("Error: no values within the COO matrix\n");
-                return 0;
             }
             T min_val = compressedCoord.values[0];
             for (auto &value : compressedCoord.values) {
@@ -149,10 +251,9 @@ namespace COO {
      * @return T 
      */
     template<typename T>
-        T find_max_COO(COOMatrix<T> &compressedCoord) {
+        T find_max_COO(const COOMatrix<T> &compressedCoord) {
             if (compressedCoord.values.size() == 0) {
                 throw std::invalid_argument("Error: no values within the COO matrix\n");
-                return 0;
             }
             T max_val = compressedCoord.values[0];
             for (auto &value : compressedCoord.values) {
@@ -167,19 +268,18 @@ namespace COO {
     /**
      * @brief Scale up a matrix by a certain scalar, throws error if scalar is zero
      * 
-     * @param compressedCoord 
+     * @param compressedCoord scaled in place
      * @param scalar 
-     * @return COO 
+     * @return COO the scaled matrix, compressedCoord itself
      */
     template<typename T>
-        COOMatrix<T> scalar_mult_matrixCOO(COOMatrix<T> &compressedCoord, int scalar) {
-            if (scalar == 0) {
+        COOMatrix<T> &scalar_mult_matrixCOO(COOMatrix<T> &compressedCoord, const typename COOMatrix<T>::value_type scalar) {
+            if (scalar == T(0)) {
                 throw std::invalid_argument("Error: cannot zero out matrix\n");
             }
 
-            const int valueSize = static_cast<int>(compressedCoord.values.size());
-            for (size_t i = 0; i < valueSize; ++i) {
-                compressedCoord.values.at(i) = compressedCoord.values.at(i) * scalar;
+            for (T &value : compressedCoord.values) {
+                value *= scalar;
             }
 
             return compressedCoord;
@@ -188,18 +288,18 @@ namespace COO {
     /**
      * @brief Scale down a matrix by a certain scalar, throws error if scalar is zero
      * 
-     * @param compressedCoord 
+     * @param compressedCoord scaled in place
      * @param scalar 
-     * @return COO 
+     * @return COO the scaled matrix, compressedCoord itself
      */
     template<typename T>
-        COOMatrix<T> scalar_div_matrixCOO(COOMatrix<T> &compressedCoord, int scalar) {
-            if (scalar == 0) {
+        COOMatrix<T> &scalar_div_matrixCOO(COOMatrix<T> &compressedCoord, const typename COOMatrix<T>::value_type scalar) {
+            if (scalar == T(0)) {
                 throw std::invalid_argument("Error: cannot divide by zero\n");
             }
 
-            for (size_t i = 0; i < compressedCoord.values.size(); ++i) {
-                compressedCoord.values.at(i) = compressedCoord.values.at(i) / scalar;
+            for (T &value : compressedCoord.values) {
+                value /= scalar;
             }
 
             return compressedCoord;
@@ -213,14 +313,9 @@ namespace COO {
      * @param scalar 
      */
     template<typename T>
-        void scalar_add_matrixCOO(COOMatrix<T> &compressedCoord, int scalar) {
-            //No modification, return nothing
-            if (scalar == 0) {
-                return;
-            }
-
-            for (size_t i = 0; i < compressedCoord.values.size(); ++i) {
-                compressedCoord.values.at(i) = compressedCoord.values.at(i) + scalar;
+        void scalar_add_matrixCOO(COOMatrix<T> &compressedCoord, const typename COOMatrix<T>::value_type scalar) {
+            for (T &value : compressedCoord.values) {
+                value += scalar;
             }
         }
 
@@ -232,19 +327,15 @@ namespace COO {
      * @param scalar 
      */
     template<typename T>
-        void scalar_sub_matrixCOO(COOMatrix<T> &compressedCoord, int scalar) {
-            //No modification, return nothing
-            if (scalar == 0) {
-                return;
-            }
-
-            for (size_t i = 0; i < compressedCoord.values.size(); ++i) {
-                compressedCoord.values.at(i) = compressedCoord.values.at(i) - scalar;
+        void scalar_sub_matrixCOO(COOMatrix<T> &compressedCoord, const typename COOMatrix<T>::value_type scalar) {
+            for (T &value : compressedCoord.values) {
+                value -= scalar;
             }
         }
 
     /**
      * @brief Add two Compressed Coordinate matrices together, both matrices must be of the same size
+     * and in canonical order (see canonicalize_COO)
      * 
      * @param compressedCoord1 
      * @param compressedCoord2 
@@ -314,7 +405,8 @@ namespace COO {
         }
 
         /**
-         * @brief Subtracting two COO matrices and returning the difference
+         * @brief Subtracting two COO matrices and returning the difference, both must be in
+         * canonical order (see canonicalize_COO)
          * 
          * @tparam T 
          * @param compressedCoord1 
@@ -385,7 +477,117 @@ namespace COO {
         }
 
         /**
-         * @brief 
+         * @brief Groups the entries of a COO matrix by row with a counting sort, without
+         * moving them: the entries of row i are order[rowPtr[i]] ... order[rowPtr[i + 1] - 1],
+         * in their original relative order. O(nnz + numRows).
+         * 
+         * @tparam T 
+         * @param compressedCoord 
+         * @param rowPtr output, numRows + 1 offsets
+         * @param order output, entry indices grouped by row
+         */
+        template <typename T>
+            void row_index_COO(const COOMatrix<T>& compressedCoord, std::vector<size_t>& rowPtr, std::vector<size_t>& order) {
+                const size_t nnz = compressedCoord.values.size();
+                rowPtr.assign(compressedCoord.numRows + 1, 0);
+                for (size_t k = 0; k < nnz; ++k) {
+                    rowPtr[compressedCoord.rowCoord[k] + 1]++;
+                }
+                for (size_t i = 0; i < compressedCoord.numRows; ++i) {
+                    rowPtr[i + 1] += rowPtr[i];
+                }
+                std::vector<size_t> next(rowPtr.begin(), rowPtr.end() - 1);
+                order.resize(nnz);
+                for (size_t k = 0; k < nnz; ++k) {
+                    order[next[compressedCoord.rowCoord[k]]++] = k;
+                }
+            }
+
+        /**
+         * @brief Accumulates one sparse row of a product. Narrow results use a dense
+         * array indexed by column with a list of the touched columns; very wide ones,
+         * where a dense array per row (or per thread) would not pay off, use a hash map.
+         * 
+         * @tparam T 
+         */
+        template <typename T>
+            class RowAccumulator {
+                public:
+                    explicit RowAccumulator(size_t numCols, bool dense) : isDense(dense) {
+                        if (isDense) {
+                            values.assign(numCols, 0);
+                            occupied.assign(numCols, false);
+                        }
+                    }
+
+                    void add(size_t col, T value) {
+                        if (isDense) {
+                            if (!occupied[col]) {
+                                occupied[col] = true;
+                                touched.push_back(col);
+                                values[col] = value;
+                            } else {
+                                values[col] += value;
+                            }
+                        } else {
+                            auto inserted = hashed.emplace(col, value);
+                            if (!inserted.second) {
+                                inserted.first->second += value;
+                            } else {
+                                touched.push_back(col);
+                            }
+                        }
+                    }
+
+                    size_t size() const { return touched.size(); }
+
+                    /// writes the accumulated entries in column order and resets the row
+                    void flush(size_t row, size_t* rows, size_t* cols, T* vals) {
+                        std::sort(touched.begin(), touched.end());
+                        for (size_t k = 0; k < touched.size(); ++k) {
+                            const size_t col = touched[k];
+                            rows[k] = row;
+                            cols[k] = col;
+                            if (isDense) {
+                                vals[k] = values[col];
+                            } else {
+                                vals[k] = hashed[col];
+                            }
+                        }
+                        clear();
+                    }
+
+                    void clear() {
+                        if (isDense) {
+                            for (size_t col : touched) {
+                                occupied[col] = false;
+                            }
+                        } else {
+                            hashed.clear();
+                        }
+                        touched.clear();
+                    }
+
+                private:
+                    bool isDense;
+                    std::vector<T> values;
+                    std::vector<bool> occupied;
+                    std::vector<size_t> touched;
+                    std::unordered_map<size_t, T> hashed;
+            };
+
+        /// @brief Dense accumulators are used unless the result is much wider than the work
+        /// per row would justify
+        inline bool use_dense_accumulator(size_t numCols, size_t nnzA, size_t nnzB, size_t numRows) {
+            return numCols <= 16 * (nnzA + nnzB + numRows) + 1024;
+        }
+
+        /**
+         * @brief Multiplies two COO matrices (Gustavson's row by row algorithm). B is indexed
+         * by row once with a counting sort, so each entry A(i, k) is combined only with row k
+         * of B; the products of output row i are summed in an accumulator and emitted sorted
+         * by column. The result is in row-major order, O(flops + nnz log) instead of comparing
+         * every pair of entries. The inputs may be in any order.
          * 
          * @tparam T 
          * @param compressedCoord1 
@@ -397,93 +599,178 @@ namespace COO {
                 if (compressedCoord1.numCols != compressedCoord2.numRows) {
                     throw std::invalid_argument("The number of columns in the first matrix must match the number of rows in the second matrix.");
                 }
- 
 
                 COOMatrix<T> returnMatrix;
                 returnMatrix.numRows = compressedCoord1.numRows;
                 returnMatrix.numCols = compressedCoord2.numCols;
-                
-                
-                // compute dot products of rows of A and columns of B
-                for (size_t i = 0; i < compressedCoord1.rowCoord.size(); i++) {
-                    for (size_t j = 0; j < compressedCoord2.rowCoord.size(); j++) {
-                        if (compressedCoord1.colCoord[i] == compressedCoord2.rowCoord[j]) {
-                            size_t row = compressedCoord1.rowCoord[i];
-                            size_t col = compressedCoord2.colCoord[j];
-                            T val = compressedCoord1.values[i] * compressedCoord2.values[j];
-                            size_t k = 0;
-                            while (k < returnMatrix.rowCoord.size() && (returnMatrix.rowCoord[k] < row || (returnMatrix.rowCoord[k] == row && returnMatrix.colCoord[k] < col))) {
-                                k++;
-                            }
-                            if (k == returnMatrix.rowCoord.size() || (returnMatrix.rowCoord[k] != row || returnMatrix.colCoord[k] != col)) {
-                                returnMatrix.rowCoord.insert(returnMatrix.rowCoord.begin() + k, row);
-                                returnMatrix.colCoord.insert(returnMatrix.colCoord.begin() + k, col);
-                                returnMatrix.values.insert(returnMatrix.values.begin() + k, val);
-                            } else {
-                                returnMatrix.values[k] += val;
-                            }
+
+                std::vector<size_t> aPtr, aOrder, bPtr, bOrder;
+                row_index_COO(compressedCoord1, aPtr, aOrder);
+                row_index_COO(compressedCoord2, bPtr, bOrder);
+                RowAccumulator<T> accumulator(compressedCoord2.numCols,
+                                              use_dense_accumulator(compressedCoord2.numCols, compressedCoord1.values.size(),
+                                                                    compressedCoord2.values.size(), compressedCoord1.numRows));
+                for (size_t i = 0; i < compressedCoord1.numRows; ++i) {
+                    for (size_t p = aPtr[i]; p < aPtr[i + 1]; ++p) {
+                        const size_t a = aOrder[p];
+                        const size_t k = compressedCoord1.colCoord[a];
+                        const T aValue = compressedCoord1.values[a];
+                        for (size_t q = bPtr[k]; q < bPtr[k + 1]; ++q) {
+                            const size_t b = bOrder[q];
+                            accumulator.add(compressedCoord2.colCoord[b], aValue * compressedCoord2.values[b]);
                         }
                     }
+                    const size_t start = returnMatrix.values.size();
+                    returnMatrix.rowCoord.resize(start + accumulator.size());
+                    returnMatrix.colCoord.resize(start + accumulator.size());
+                    returnMatrix.values.resize(start + accumulator.size());
+                    accumulator.flush(i, returnMatrix.rowCoord.data() + start, returnMatrix.colCoord.data() + start,
+                                      returnMatrix.values.data() + start);
                 }
+                returnMatrix.nnz = returnMatrix.values.size();
 
                 return returnMatrix;
-                
             }
 
 
 
+        /// @brief Widest radix digit used when sorting coordinates; keys narrower than this
+        /// are sorted in a single counting pass with one bucket per row or column
+        constexpr unsigned COO_RADIX_BITS = 16;
+
+        /// @brief Number of bits needed to hold any coordinate below extent
+        inline unsigned coordinate_bits(size_t extent) {
+            unsigned bits = 0;
+            while (bits < 64 && extent > 1 && ((extent - 1) >> bits) != 0) {
+                bits++;
+            }
+            return bits;
+        }
+
         /**
-         * @brief 
+         * @brief Stable LSD radix sort of the entry indices in order by keys[order[k]], with
+         * digits of at most COO_RADIX_BITS bits. Coordinates below 2^16 take one counting pass,
+         * so sorting by column and then by row is O(nnz + numRows + numCols).
          * 
-         * @tparam T 
-         * @param compressedCoord 
-         * @return COOMatrix<T> 
+         * @param keys coordinate of every entry
+         * @param extent all keys are below extent
+         * @param order entry indices, reordered in place
+         * @param scratch workspace, resized as needed
          */
-        template <typename T>
-            COOMatrix<T> transpose_matrixCOO(const COOMatrix<T>& compressedCoord) {
-                // Create a new instance of the COOMatrix class to hold the transposed matrix
-                COOMatrix<T> compressedCoordT;
-
-                // Set the number of rows, columns, and non-zero elements in the transposed matrix to be the same as the original matrix
-                compressedCoordT.numRows = compressedCoord.numCols;
-                compressedCoordT.numCols = compressedCoord.numRows;
-                compressedCoordT.nnz = compressedCoord.nnz;
-
-                for (size_t i = 0; i < compressedCoord.colCoord.size(); ++i) {
-                    compressedCoordT.colCoord.push_back(compressedCoord.rowCoord.at(i));
-                    compressedCoordT.rowCoord.push_back(compressedCoord.colCoord.at(i));
-                    compressedCoordT.values.push_back(compressedCoord.values.at(i));
+        inline void radix_sort_by_key(const std::vector<size_t>& keys, size_t extent,
+                                      std::vector<size_t>& order, std::vector<size_t>& scratch) {
+            const unsigned bits = coordinate_bits(extent);
+            scratch.resize(order.size());
+            std::vector<size_t> count;
+            for (unsigned shift = 0; shift < bits; shift += COO_RADIX_BITS) {
+                const unsigned width = std::min(COO_RADIX_BITS, bits - shift);
+                const size_t mask = (size_t(1) << width) - 1;
+                count.assign(mask + 2, 0);
+                for (size_t index : order) {
+                    count[((keys[index] >> shift) & mask) + 1]++;
+                }
+                for (size_t d = 0; d <= mask; ++d) {
+                    count[d + 1] += count[d];
                 }
+                for (size_t index : order) {
+                    scratch[count[(keys[index] >> shift) & mask]++] = index;
+                }
+                order.swap(scratch);
+            }
+        }
 
-                for (size_t i = 0; i < compressedCoord.values.size(); ++i) {
-                    size_t min_index = i;
-                    for (size_t j = i+1; j < compressedCoord.values.size(); ++j) {
-                        if (compressedCoordT.rowCoord[j] < compressedCoordT.rowCoord[min_index]) {
-                            min_index = j;
-                        }
+        /// @brief Throws if any coordinate lies outside the matrix
+        template <typename T>
+            void check_coordinates_COO(const std::vector<size_t>& rows, const std::vector<size_t>& cols,
+                                       const std::vector<T>& values, size_t numRows, size_t numCols) {
+                if (rows.size() != values.size() || cols.size() != values.size()) {
+                    throw std::invalid_argument("Error: coordinate and value vectors must have the same length\n");
+                }
+                for (size_t k = 0; k < values.size(); ++k) {
+                    if (rows[k] >= numRows || cols[k] >= numCols) {
+                        throw std::invalid_argument("Error: COO entry outside of the matrix\n");
                     }
+                }
+            }
 
-                    if (min_index != i) {
-                        std::swap(compressedCoordT.colCoord[min_index], compressedCoordT.colCoord[i]);
-                        std::swap(compressedCoordT.rowCoord[min_index], compressedCoordT.rowCoord[i]);
-                        std::swap(compressedCoordT.values[min_index], compressedCoordT.values[i]);
+        /**
+         * @brief Builds a canonical COO matrix from triplets: entries sorted by (row, col) and
+         * duplicates summed (an entry whose duplicates cancel is kept as an explicit zero).
+         * The sort is a stable radix sort by column and then by row, O(nnz) for coordinates
+         * below 2^16 and one extra pass per further 16 bits.
+         * 
+         * @tparam T 
+         * @param rows 
+         * @param cols 
+         * @param values 
+         * @param numRows 
+         * @param numCols 
+         * @return COOMatrix<T> 
+         */
+        template <typename T>
+            COOMatrix<T> canonicalize_triplets(const std::vector<size_t>& rows, const std::vector<size_t>& cols,
+                                               const std::vector<T>& values, size_t numRows, size_t numCols) {
+                check_coordinates_COO(rows, cols, values, numRows, numCols);
+                std::vector<size_t> order(values.size()), scratch;
+                std::iota(order.begin(), order.end(), 0);
+                radix_sort_by_key(cols, numCols, order, scratch);
+                radix_sort_by_key(rows, numRows, order, scratch);
+
+                COOMatrix<T> returnMatrix;
+                returnMatrix.numRows = numRows;
+                returnMatrix.numCols = numCols;
+                returnMatrix.rowCoord.reserve(order.size());
+                returnMatrix.colCoord.reserve(order.size());
+                returnMatrix.values.reserve(order.size());
+                for (size_t k = 0; k < order.size(); ++k) {
+                    const size_t index = order[k];
+                    if (k > 0 && rows[index] == returnMatrix.rowCoord.back() && cols[index] == returnMatrix.colCoord.back()) {
+                        returnMatrix.values.back() += values[index];
+                    } else {
+                        returnMatrix.rowCoord.push_back(rows[index]);
+                        returnMatrix.colCoord.push_back(cols[index]);
+                        returnMatrix.values.push_back(values[index]);
                     }
                 }
+                returnMatrix.nnz = returnMatrix.values.size();
 
-                return compressedCoordT;
-
+                return returnMatrix;
             }
 
+        /**
+         * @brief Sorts a COO matrix by (row, col) and sums duplicate entries, which is the
+         * form add_matrixCOO and sub_matrixCOO expect. See canonicalize_triplets.
+         * 
+         * @tparam T 
+         * @param compressedCoord 
+         * @return COOMatrix<T> 
+         */
+        template <typename T>
+            COOMatrix<T> canonicalize_COO(const COOMatrix<T>& compressedCoord) {
+                return canonicalize_triplets(compressedCoord.rowCoord, compressedCoord.colCoord, compressedCoord.values,
+                                             compressedCoord.numRows, compressedCoord.numCols);
+            }
 
-
-
+        /**
+         * @brief Transpose of a COO matrix, in canonical (row, col) order with duplicates
+         * summed. The swapped coordinates go straight through the radix sort, O(nnz).
+         * 
+         * @tparam T 
+         * @param compressedCoord 
+         * @return COOMatrix<T> 
+         */
+        template <typename T>
+            COOMatrix<T> transpose_matrixCOO(const COOMatrix<T>& compressedCoord) {
+                return canonicalize_triplets(compressedCoord.colCoord, compressedCoord.rowCoord, compressedCoord.values,
+                                             compressedCoord.numCols, compressedCoord.numRows);
+            }
 
         template<typename T>
             void guassian_jordan_elimination(COOMatrix<T> &compressedCoord) {
                 
             }
     
-    std::vector<std::vector<double>> load_fileCOO(std::string fileName) {
+    inline std::vector<std::vector<double>> load_fileCOO(std::string fileName) {
         std::ifstream file(fileName);
         int num_row, num_col, num_lines;
 
@@ -502,3 +789,4 @@ namespace COO {
     }
 }
 
+#endif
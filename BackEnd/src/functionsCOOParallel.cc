@@ -1,3 +1,6 @@
+#ifndef FUNCTIONS_COO_PARALLEL_CC
+#define FUNCTIONS_COO_PARALLEL_CC
+
 #include <stdlib.h>
 #include <vector>
 #include <iostream>
@@ -9,31 +12,18 @@
 #include <algorithm>
 #include <map>
 #include <unordered_map>
+#include <memory>
 
 #include "tbb/tbb.h"
+#include "functionsCOO.cc"
 // #include "tbb/blocked_range.h"
 // #include "tbb/parallel_for.h"
 // #include "tbb/parallel_reduce.h"
 
 namespace COOParallel {
 
-    /**
-     * @brief Compressed Coordinate Structure implementation
-     * 
-     * @tparam T 
-     */
-    template <typename T>
-    class COOMatrix {
-
-    //save position and value of non-zero elements
-        public:
-            std::vector<size_t> rowCoord;
-            std::vector<size_t> colCoord;
-            std::vector<T> values;
-            size_t numRows;
-            size_t numCols;
-            size_t nnz; //number of non zero elements        
-    };
+    // the matrix type is shared with the serial COO functions
+    using COO::COOMatrix;
 
     /**
      * @brief Get the Value COO object
@@ -44,11 +34,11 @@ namespace COOParallel {
      * @return double 
      */
     template<typename T>
-        T get_matrixCOO(COOMatrix<T> compressedCoord, size_t row, size_t col) {
-            if (compressedCoord.numRows < row) {
+        T get_matrixCOO(const COOMatrix<T>& compressedCoord, size_t row, size_t col) {
+            if (compressedCoord.numRows <= row) {
                 throw std::invalid_argument("Row is not within range\n");
             }
-            if (compressedCoord.numCols < col) {
+            if (compressedCoord.numCols <= col) {
                 throw std::invalid_argument("Column is not within range\n");
             }
 
@@ -75,7 +65,7 @@ namespace COOParallel {
     template<typename T>
         COOMatrix<T> from_vector(std::vector<std::vector<T>>& denseMatrix) {
             size_t nnz_id = 0;
-            COO::COOMatrix<T> coo;
+            COOMatrix<T> coo;
             coo.numRows = denseMatrix.size();
             coo.numCols = denseMatrix.at(0).size();
             for (size_t i = 0; i < denseMatrix.size(); ++i) {
@@ -100,7 +90,7 @@ namespace COOParallel {
      * @return std::vector<std::vector<int>> 
      */
     template<typename T>
-        std::vector<std::vector<T>> convertCOOtoDense(COOMatrix<T> compressedCoord) {
+        std::vector<std::vector<T>> convertCOOtoDense(const COOMatrix<T>& compressedCoord) {
             std::vector<std::vector<int>> dense;
             int nnz_id = 0;
 
@@ -119,37 +109,100 @@ namespace COOParallel {
             return dense;
         }
 
+    /// below this many entries the serial statistics pass is used
+    constexpr size_t COO_PARALLEL_STATISTICS_CUTOFF = 1 << 15;
+
+    /**
+     * @brief Parallel version of COO::statistics_COO. A parallel_reduce over blocks of entries
+     * joins the running totals, each block reducing its values with the SIMD loop; the absolute
+     * row and column sums go into per-thread arrays that are added up at the end.
+     * 
+     * @tparam T 
+     * @param compressedCoord 
+     * @return MatrixStatistics<T> 
+     */
+    template<typename T>
+        MatrixStatistics<T> statistics_COO(const COOMatrix<T> &compressedCoord) {
+            const size_t count = compressedCoord.values.size();
+            if (count < COO_PARALLEL_STATISTICS_CUTOFF) {
+                return COO::statistics_COO(compressedCoord);
+            }
+            const size_t numRows = compressedCoord.numRows, numCols = compressedCoord.numCols;
+            const size_t numDiag = std::min(numRows, numCols);
+            StatisticsAccumulator<T> init;
+            init.symmetric = numRows == numCols;
+            std::unique_ptr<COO::COOIndex<T>> index;
+            if (init.symmetric) {
+                index = std::make_unique<COO::COOIndex<T>>(compressedCoord);
+            }
+
+            struct AbsSums {
+                std::vector<double> rowOff, colOff, diag;
+            };
+            tbb::enumerable_thread_specific<AbsSums> sums([&] {
+                return AbsSums{std::vector<double>(numRows, 0.0), std::vector<double>(numCols, 0.0),
+                               std::vector<double>(numDiag, 0.0)};
+            });
+            const StatisticsAccumulator<T> acc = tbb::parallel_reduce(
+                tbb::blocked_range<size_t>(0, count, 4096), init,
+                [&](const tbb::blocked_range<size_t>& range, StatisticsAccumulator<T> part) {
+                    part.add_values(compressedCoord.values.data() + range.begin(), range.size());
+                    AbsSums &local = sums.local();
+                    for (size_t k = range.begin(); k != range.end(); ++k) {
+                        const size_t row = compressedCoord.rowCoord[k], col = compressedCoord.colCoord[k];
+                        const double a = abs_value(compressedCoord.values[k]);
+                        if (row == col) {
+                            local.diag[row] += a;
+                            continue;
+                        }
+                        local.rowOff[row] += a;
+                        local.colOff[col] += a;
+                        if (part.symmetric && index->find(col, row) == COO::COOIndex<T>::npos) {
+                            part.symmetric = false;
+                        }
+                    }
+                    return part;
+                },
+                [](StatisticsAccumulator<T> x, const StatisticsAccumulator<T>& y) {
+                    x.join(y);
+                    return x;
+                }
+            );
+
+            std::vector<double> rowOff(numRows, 0.0), colOff(numCols, 0.0), diag(numDiag, 0.0);
+            for (const AbsSums &local : sums) {
+                for (size_t i = 0; i < numRows; ++i) rowOff[i] += local.rowOff[i];
+                for (size_t j = 0; j < numCols; ++j) colOff[j] += local.colOff[j];
+                for (size_t i = 0; i < numDiag; ++i) diag[i] += local.diag[i];
+            }
+            return finish_statistics(acc, rowOff, colOff, diag);
+        }
+
     /**
-     * @brief Find the minumum, nonzero value within the COO values vector
+     * @brief Find the minumum value within the COO values vector
      * 
      * @tparam T 
      * @param compressedCoord 
      * @return T 
      */
     template<typename T>
-        T find_min_COO(COOMatrix<T> &compressedCoord) {
+        T find_min_COO(const COOMatrix<T> &compressedCoord) {
             if (compressedCoord.values.size() == 0) {
                 throw std::invalid_argument("Error: no values within the COO matrix\n");
-                return 0;
             }
-            
-            const int valueSize = static_cast<int>(compressedCoord.values.size());
-
-            size_t minVal = tbb::parallel_reduce(
-                tbb::blocked_range<std::vector<size_t>::iterator>(compressedCoord.values.begin(), compressedCoord.values.end()),
-                std::numeric_limits<size_t>::max(),
-                [&](const tbb::blocked_range<std::vector<size_t>::iterator>& range, size_t init) {
-                    for (auto it = range.begin(); it != range.end(); ++it) {
-                        init = std::min(init, *it);
+            return tbb::parallel_reduce(
+                tbb::blocked_range<size_t>(0, compressedCoord.values.size()),
+                compressedCoord.values[0],
+                [&](const tbb::blocked_range<size_t>& range, T init) {
+                    for (size_t k = range.begin(); k != range.end(); ++k) {
+                        init = std::min(init, compressedCoord.values[k]);
                     }
                     return init;
                 },
-                [&](size_t x, size_t y) {
-                    return std::min(x,y);
+                [](T x, T y) {
+                    return std::min(x, y);
                 }
             );
-
-            return minVal;
         }
 
     /**
@@ -160,50 +213,57 @@ namespace COOParallel {
      * @return T 
      */
     template<typename T>
-        T find_max_COO(COOMatrix<T> &compressedCoord) {
+        T find_max_COO(const COOMatrix<T> &compressedCoord) {
             if (compressedCoord.values.size() == 0) {
                 throw std::invalid_argument("Error: no values within the COO matrix\n");
-                return 0;
             }
-            
-            size_t maxVal = tbb::parallel_reduce(
-                tbb::blocked_range<std::vector<size_t>::iterator>(compressedCoord.values.begin(), compressedCoord.values.end()),
-                std::numeric_limits<size_t>::max(),
-                [&](const tbb::blocked_range<std::vector<size_t>::iterator>& range, size_t init) {
-                    for (auto it = range.begin(); it != range.end(); ++it) {
-                        init = std::max(init, *it);
+            return tbb::parallel_reduce(
+                tbb::blocked_range<size_t>(0, compressedCoord.values.size()),
+                compressedCoord.values[0],
+                [&](const tbb::blocked_range<size_t>& range, T init) {
+                    for (size_t k = range.begin(); k != range.end(); ++k) {
+                        init = std::max(init, compressedCoord.values[k]);
                     }
                     return init;
                 },
-                [&](size_t x, size_t y) {
-                    return std::max(x,y);
+                [](T x, T y) {
+                    return std::max(x, y);
                 }
             );
+        }
 
-            return maxVal;
+    /**
+     * @brief Applies f to every stored value in parallel; each task runs a plain loop over a
+     * contiguous block of the value array, which vectorizes
+     * 
+     * @param compressedCoord 
+     * @param f callable void(T &)
+     */
+    template<typename T, typename F>
+        void apply_to_values(COOMatrix<T> &compressedCoord, const F &f) {
+            T *values = compressedCoord.values.data();
+            tbb::parallel_for(tbb::blocked_range<size_t>(0, compressedCoord.values.size(), 4096),
+                [&](const tbb::blocked_range<size_t>& range) {
+                    for (size_t it = range.begin(); it != range.end(); ++it) {
+                        f(values[it]);
+                    }
+            });
         }
 
     /**
      * @brief Scale up a matrix by a certain scalar, throws error if scalar is zero
      * 
-     * @param compressedCoord 
+     * @param compressedCoord scaled in place
      * @param scalar 
-     * @return COO 
+     * @return COO the scaled matrix, compressedCoord itself
      */
     template<typename T>
-        COOMatrix<T> scalar_mult_matrixCOO(COOMatrix<T> &compressedCoord, int scalar) {
-            if (scalar == 0) {
+        COOMatrix<T> &scalar_mult_matrixCOO(COOMatrix<T> &compressedCoord, const typename COOMatrix<T>::value_type scalar) {
+            if (scalar == T(0)) {
                 throw std::invalid_argument("Error: cannot zero out matrix\n");
             }
 
-            const size_t valueSize = static_cast<size_t>(compressedCoord.values.size());
-            tbb::parallel_for(tbb::blocked_range<size_t>(0, valueSize),
-                [&](const tbb::blocked_range<size_t>& range) {
-                    for (auto it = range.begin(); it != range.end(); ++it) {
-                        compressedCoord.values.at(i) = compressedCoord.values.at(i) * scalar;
-                    }
-            });
-
+            apply_to_values(compressedCoord, [scalar](T &value) { value *= scalar; });
 
             return compressedCoord;
         }
@@ -211,22 +271,17 @@ namespace COOParallel {
     /**
      * @brief Scale down a matrix by a certain scalar, throws error if scalar is zero
      * 
-     * @param compressedCoord 
+     * @param compressedCoord scaled in place
      * @param scalar 
-     * @return COO 
+     * @return COO the scaled matrix, compressedCoord itself
      */
     template<typename T>
-        COOMatrix<T> scalar_div_matrixCOO(COOMatrix<T> &compressedCoord, int scalar) {
-            if (scalar == 0) {
+        COOMatrix<T> &scalar_div_matrixCOO(COOMatrix<T> &compressedCoord, const typename COOMatrix<T>::value_type scalar) {
+            if (scalar == T(0)) {
                 throw std::invalid_argument("Error: cannot divide by zero\n");
             }
-            const size_t valueSize = static_cast<size_t>(compressedCoord.values.size());
-            tbb::parallel_for(tbb::blocked_range<size_t>(0, valueSize),
-                [&](const tbb::blocked_range<size_t>& range) {
-                    for (auto it = range.begin(); it != range.end(); ++it) {
-                        compressedCoord.values.at(i) = compressedCoord.values.at(i) / scalar;
-                    }
-            });
+
+            apply_to_values(compressedCoord, [scalar](T &value) { value /= scalar; });
 
             return compressedCoord;
         }
@@ -239,15 +294,8 @@ namespace COOParallel {
      * @param scalar 
      */
     template<typename T>
-        void scalar_add_matrixCOO(COOMatrix<T> &compressedCoord, int scalar) {
-            //No modification, return nothing
-            if (scalar == 0) {
-                return;
-            }
-
-            for (size_t i = 0; i < compressedCoord.values.size(); ++i) {
-                compressedCoord.values.at(i) = compressedCoord.values.at(i) + scalar;
-            }
+        void scalar_add_matrixCOO(COOMatrix<T> &compressedCoord, const typename COOMatrix<T>::value_type scalar) {
+            apply_to_values(compressedCoord, [scalar](T &value) { value += scalar; });
         }
 
     /**
@@ -258,15 +306,8 @@ namespace COOParallel {
      * @param scalar 
      */
     template<typename T>
-        void scalar_sub_matrixCOO(COOMatrix<T> &compressedCoord, int scalar) {
-            //No modification, return nothing
-            if (scalar == 0) {
-                return;
-            }
-
-            for (size_t i = 0; i < compressedCoord.values.size(); ++i) {
-                compressedCoord.values.at(i) = compressedCoord.values.at(i) - scalar;
-            }
+        void scalar_sub_matrixCOO(COOMatrix<T> &compressedCoord, const typename COOMatrix<T>::value_type scalar) {
+            apply_to_values(compressedCoord, [scalar](T &value) { value -= scalar; });
         }
 
     /**
@@ -340,7 +381,10 @@ namespace COOParallel {
         }
 
         /**
-         * @brief 
+         * @brief Parallel version of COO::multiply_matrixCOO. Output rows are independent: a
+         * parallel symbolic pass counts the entries of every row, a prefix sum sizes the
+         * output, and a numeric pass writes each sorted row directly into place. Every
+         * thread has its own accumulator, reused across the rows it handles.
          * 
          * @tparam T 
          * @param compressedCoord1 
@@ -352,86 +396,227 @@ namespace COOParallel {
                 if (compressedCoord1.numCols != compressedCoord2.numRows) {
                     throw std::invalid_argument("The number of columns in the first matrix must match the number of rows in the second matrix.");
                 }
- 
-
-                COOMatrix<T> returnMatrix;
-                returnMatrix.numRows = compressedCoord1.numRows;
-                returnMatrix.numCols = compressedCoord2.numCols;
-                
-                
-                // compute dot products of rows of A and columns of B
-                for (size_t i = 0; i < compressedCoord1.rowCoord.size(); i++) {
-                    for (size_t j = 0; j < compressedCoord2.rowCoord.size(); j++) {
-                        if (compressedCoord1.colCoord[i] == compressedCoord2.rowCoord[j]) {
-                            size_t row = compressedCoord1.rowCoord[i];
-                            size_t col = compressedCoord2.colCoord[j];
-                            T val = compressedCoord1.values[i] * compressedCoord2.values[j];
-                            size_t k = 0;
-                            while (k < returnMatrix.rowCoord.size() && (returnMatrix.rowCoord[k] < row || (returnMatrix.rowCoord[k] == row && returnMatrix.colCoord[k] < col))) {
-                                k++;
-                            }
-                            if (k == returnMatrix.rowCoord.size() || (returnMatrix.rowCoord[k] != row || returnMatrix.colCoord[k] != col)) {
-                                returnMatrix.rowCoord.insert(returnMatrix.rowCoord.begin() + k, row);
-                                returnMatrix.colCoord.insert(returnMatrix.colCoord.begin() + k, col);
-                                returnMatrix.values.insert(returnMatrix.values.begin() + k, val);
-                            } else {
-                                returnMatrix.values[k] += val;
-                            }
+                const size_t numRows = compressedCoord1.numRows;
+                const size_t numCols = compressedCoord2.numCols;
+                std::vector<size_t> aPtr, aOrder, bPtr, bOrder;
+                tbb::parallel_invoke([&] { COO::row_index_COO(compressedCoord1, aPtr, aOrder); },
+                                     [&] { COO::row_index_COO(compressedCoord2, bPtr, bOrder); });
+                const bool dense = COO::use_dense_accumulator(numCols, compressedCoord1.values.size(),
+                                                              compressedCoord2.values.size(), numRows);
+                tbb::enumerable_thread_specific<COO::RowAccumulator<T>> accumulators(numCols, dense);
+
+                auto accumulateRow = [&](size_t i, COO::RowAccumulator<T>& accumulator) {
+                    for (size_t p = aPtr[i]; p < aPtr[i + 1]; ++p) {
+                        const size_t a = aOrder[p];
+                        const size_t k = compressedCoord1.colCoord[a];
+                        const T aValue = compressedCoord1.values[a];
+                        for (size_t q = bPtr[k]; q < bPtr[k + 1]; ++q) {
+                            const size_t b = bOrder[q];
+                            accumulator.add(compressedCoord2.colCoord[b], aValue * compressedCoord2.values[b]);
                         }
                     }
+                };
+
+                std::vector<size_t> rowStart(numRows + 1, 0);
+                tbb::parallel_for(tbb::blocked_range<size_t>(0, numRows), [&](const tbb::blocked_range<size_t>& range) {
+                    COO::RowAccumulator<T>& accumulator = accumulators.local();
+                    for (size_t i = range.begin(); i < range.end(); ++i) {
+                        accumulateRow(i, accumulator);
+                        rowStart[i + 1] = accumulator.size();
+                        accumulator.clear();
+                    }
+                });
+                for (size_t i = 0; i < numRows; ++i) {
+                    rowStart[i + 1] += rowStart[i];
                 }
 
+                COOMatrix<T> returnMatrix;
+                returnMatrix.numRows = numRows;
+                returnMatrix.numCols = numCols;
+                returnMatrix.nnz = rowStart[numRows];
+                returnMatrix.rowCoord.resize(returnMatrix.nnz);
+                returnMatrix.colCoord.resize(returnMatrix.nnz);
+                returnMatrix.values.resize(returnMatrix.nnz);
+                tbb::parallel_for(tbb::blocked_range<size_t>(0, numRows), [&](const tbb::blocked_range<size_t>& range) {
+                    COO::RowAccumulator<T>& accumulator = accumulators.local();
+                    for (size_t i = range.begin(); i < range.end(); ++i) {
+                        accumulateRow(i, accumulator);
+                        accumulator.flush(i, returnMatrix.rowCoord.data() + rowStart[i], returnMatrix.colCoord.data() + rowStart[i],
+                                          returnMatrix.values.data() + rowStart[i]);
+                    }
+                });
+
                 return returnMatrix;
-                
             }
 
 
 
+        /// @brief Below this many entries the serial COO sort is faster than splitting it up
+        constexpr size_t COO_PARALLEL_SORT_CUTOFF = 1 << 15;
+
+        /**
+         * @brief Parallel version of COO::radix_sort_by_key. Each pass splits the entries into
+         * contiguous blocks that histogram their digits concurrently; a scan over (digit, block)
+         * gives every block its own write offsets, so the scatter is parallel and still stable.
+         * 
+         * @param keys coordinate of every entry
+         * @param extent all keys are below extent
+         * @param order entry indices, reordered in place
+         * @param scratch workspace, resized as needed
+         */
+        inline void radix_sort_by_key(const std::vector<size_t>& keys, size_t extent,
+                                      std::vector<size_t>& order, std::vector<size_t>& scratch) {
+            const size_t nnz = order.size();
+            const unsigned bits = COO::coordinate_bits(extent);
+            const size_t grain = COO_PARALLEL_SORT_CUTOFF / 2;
+            const size_t numBlocks = std::max<size_t>(1, std::min<size_t>((nnz + grain - 1) / grain,
+                                                      4 * tbb::this_task_arena::max_concurrency()));
+            const size_t blockSize = (nnz + numBlocks - 1) / numBlocks;
+            scratch.resize(nnz);
+            std::vector<size_t> offsets;
+            for (unsigned shift = 0; shift < bits; shift += COO::COO_RADIX_BITS) {
+                const unsigned width = std::min(COO::COO_RADIX_BITS, bits - shift);
+                const size_t buckets = size_t(1) << width;
+                const size_t mask = buckets - 1;
+                // offsets[b * buckets + d] is where block b writes its next entry with digit d
+                offsets.assign(numBlocks * buckets, 0);
+                tbb::parallel_for(size_t(0), numBlocks, [&](size_t b) {
+                    size_t* count = offsets.data() + b * buckets;
+                    const size_t last = std::min(nnz, (b + 1) * blockSize);
+                    for (size_t k = b * blockSize; k < last; ++k) {
+                        count[(keys[order[k]] >> shift) & mask]++;
+                    }
+                });
+                size_t running = 0;
+                for (size_t d = 0; d < buckets; ++d) {
+                    for (size_t b = 0; b < numBlocks; ++b) {
+                        const size_t count = offsets[b * buckets + d];
+                        offsets[b * buckets + d] = running;
+                        running += count;
+                    }
+                }
+                tbb::parallel_for(size_t(0), numBlocks, [&](size_t b) {
+                    size_t* next = offsets.data() + b * buckets;
+                    const size_t last = std::min(nnz, (b + 1) * blockSize);
+                    for (size_t k = b * blockSize; k < last; ++k) {
+                        scratch[next[(keys[order[k]] >> shift) & mask]++] = order[k];
+                    }
+                });
+                order.swap(scratch);
+            }
+        }
+
         /**
-         * @brief 
+         * @brief Parallel version of COO::canonicalize_triplets. After the radix sort a parallel
+         * scan finds the first entry of every distinct (row, col) and numbers it, and each
+         * output entry then sums its own run of duplicates, in input order. Small inputs use
+         * the serial routine.
          * 
          * @tparam T 
-         * @param compressedCoord 
+         * @param rows 
+         * @param cols 
+         * @param values 
+         * @param numRows 
+         * @param numCols 
          * @return COOMatrix<T> 
          */
         template <typename T>
-            COOMatrix<T> transpose_matrixCOO(const COOMatrix<T>& compressedCoord) {
-                // Create a new instance of the COOMatrix class to hold the transposed matrix
-                COOMatrix<T> compressedCoordT;
-
-                // Set the number of rows, columns, and non-zero elements in the transposed matrix to be the same as the original matrix
-                compressedCoordT.numRows = compressedCoord.numCols;
-                compressedCoordT.numCols = compressedCoord.numRows;
-                compressedCoordT.nnz = compressedCoord.nnz;
-
-                for (size_t i = 0; i < compressedCoord.colCoord.size(); ++i) {
-                    compressedCoordT.colCoord.push_back(compressedCoord.rowCoord.at(i));
-                    compressedCoordT.rowCoord.push_back(compressedCoord.colCoord.at(i));
-                    compressedCoordT.values.push_back(compressedCoord.values.at(i));
+            COOMatrix<T> canonicalize_triplets(const std::vector<size_t>& rows, const std::vector<size_t>& cols,
+                                               const std::vector<T>& values, size_t numRows, size_t numCols) {
+                const size_t nnz = values.size();
+                if (nnz < COO_PARALLEL_SORT_CUTOFF) {
+                    return COO::canonicalize_triplets(rows, cols, values, numRows, numCols);
                 }
-
-                for (size_t i = 0; i < compressedCoord.values.size(); ++i) {
-                    size_t min_index = i;
-                    for (size_t j = i+1; j < compressedCoord.values.size(); ++j) {
-                        if (compressedCoordT.rowCoord[j] < compressedCoordT.rowCoord[min_index]) {
-                            min_index = j;
+                if (rows.size() != nnz || cols.size() != nnz) {
+                    throw std::invalid_argument("Error: coordinate and value vectors must have the same length\n");
+                }
+                const bool inside = tbb::parallel_reduce(tbb::blocked_range<size_t>(0, nnz), true,
+                    [&](const tbb::blocked_range<size_t>& range, bool ok) {
+                        for (size_t k = range.begin(); ok && k < range.end(); ++k) {
+                            ok = rows[k] < numRows && cols[k] < numCols;
                         }
-                    }
+                        return ok;
+                    },
+                    [](bool x, bool y) { return x && y; });
+                if (!inside) {
+                    throw std::invalid_argument("Error: COO entry outside of the matrix\n");
+                }
 
-                    if (min_index != i) {
-                        std::swap(compressedCoordT.colCoord[min_index], compressedCoordT.colCoord[i]);
-                        std::swap(compressedCoordT.rowCoord[min_index], compressedCoordT.rowCoord[i]);
-                        std::swap(compressedCoordT.values[min_index], compressedCoordT.values[i]);
+                std::vector<size_t> order(nnz), scratch;
+                tbb::parallel_for(tbb::blocked_range<size_t>(0, nnz), [&](const tbb::blocked_range<size_t>& range) {
+                    for (size_t k = range.begin(); k < range.end(); ++k) {
+                        order[k] = k;
                     }
-                }
+                });
+                COOParallel::radix_sort_by_key(cols, numCols, order, scratch);
+                COOParallel::radix_sort_by_key(rows, numRows, order, scratch);
+
+                // runStart[j] is the sorted position of the first duplicate of output entry j
+                std::vector<size_t> runStart(nnz + 1);
+                const size_t distinct = tbb::parallel_scan(tbb::blocked_range<size_t>(0, nnz), size_t(0),
+                    [&](const tbb::blocked_range<size_t>& range, size_t sum, bool isFinalScan) {
+                        for (size_t k = range.begin(); k < range.end(); ++k) {
+                            const bool head = k == 0 || rows[order[k]] != rows[order[k - 1]] || cols[order[k]] != cols[order[k - 1]];
+                            if (head) {
+                                if (isFinalScan) {
+                                    runStart[sum] = k;
+                                }
+                                sum++;
+                            }
+                        }
+                        return sum;
+                    },
+                    [](size_t x, size_t y) { return x + y; });
+                runStart[distinct] = nnz;
 
-                return compressedCoordT;
+                COOMatrix<T> returnMatrix;
+                returnMatrix.numRows = numRows;
+                returnMatrix.numCols = numCols;
+                returnMatrix.nnz = distinct;
+                returnMatrix.rowCoord.resize(distinct);
+                returnMatrix.colCoord.resize(distinct);
+                returnMatrix.values.resize(distinct);
+                tbb::parallel_for(tbb::blocked_range<size_t>(0, distinct), [&](const tbb::blocked_range<size_t>& range) {
+                    for (size_t j = range.begin(); j < range.end(); ++j) {
+                        const size_t first = order[runStart[j]];
+                        T sum = values[first];
+                        for (size_t k = runStart[j] + 1; k < runStart[j + 1]; ++k) {
+                            sum += values[order[k]];
+                        }
+                        returnMatrix.rowCoord[j] = rows[first];
+                        returnMatrix.colCoord[j] = cols[first];
+                        returnMatrix.values[j] = sum;
+                    }
+                });
 
+                return returnMatrix;
             }
 
+        /**
+         * @brief Parallel version of COO::canonicalize_COO
+         * 
+         * @tparam T 
+         * @param compressedCoord 
+         * @return COOMatrix<T> 
+         */
+        template <typename T>
+            COOMatrix<T> canonicalize_COO(const COOMatrix<T>& compressedCoord) {
+                return COOParallel::canonicalize_triplets(compressedCoord.rowCoord, compressedCoord.colCoord, compressedCoord.values,
+                                                          compressedCoord.numRows, compressedCoord.numCols);
+            }
 
-
-
+        /**
+         * @brief Parallel version of COO::transpose_matrixCOO, canonical output in O(nnz)
+         * 
+         * @tparam T 
+         * @param compressedCoord 
+         * @return COOMatrix<T> 
+         */
+        template <typename T>
+            COOMatrix<T> transpose_matrixCOO(const COOMatrix<T>& compressedCoord) {
+                return COOParallel::canonicalize_triplets(compressedCoord.colCoord, compressedCoord.rowCoord, compressedCoord.values,
+                                                          compressedCoord.numCols, compressedCoord.numRows);
+            }
 
         template<typename T>
             void guassian_jordan_elimination(COOMatrix<T> &compressedCoord) {
@@ -447,7 +632,7 @@ namespace COOParallel {
          * @return true If is diagonally dominant
          * @return false Otherwise
          */
-        bool diagonally_dominant(std::vector<std::vector<double>> denseMatrix) {
+        bool diagonally_dominant(const std::vector<std::vector<double>>& denseMatrix) {
             for (size_t i = 0; i < denseMatrix.size(); ++i) {
                 double sum = 0.0;
                 for (size_t j = 0; j < denseMatrix[i].size(); ++j) {
@@ -472,7 +657,7 @@ namespace COOParallel {
          * @param B 
          * @param iterations 
          */
-        std::vector<double> jacobi_method(std::vector<std::vector<double>> denseMatrix, std::vector<double> B, int maxIterations) {
+        std::vector<double> jacobi_method(const std::vector<std::vector<double>>& denseMatrix, const std::vector<double>& B, int maxIterations) {
             if (diagonally_dominant(denseMatrix) == false) {
                 throw std::invalid_argument("Input matrix is not diagonally dominant");
             }
@@ -502,13 +687,13 @@ namespace COOParallel {
         * @param A 
         * @return pair<vector<vector<double>>,vector<vector<double>>> 
         */
-pair<vector<vector<double>>,vector<vector<double>>> lu_factorization_parallel(const vector<vector<double>>& A) {
+std::pair<std::vector<std::vector<double>>,std::vector<std::vector<double>>> lu_factorization_parallel(const std::vector<std::vector<double>>& A) {
     if (A.size() != A[0].size()) {
-        throw invalid_argument("Error: Matrix must be square nxn");
+        throw std::invalid_argument("Error: Matrix must be square nxn");
     }
     const int n = static_cast<int>(A.size());
-    vector<vector<double>> L(n, vector<double>(n, 0.0)); 
-    vector<vector<double>> U = A; 
+    std::vector<std::vector<double>> L(n, std::vector<double>(n, 0.0)); 
+    std::vector<std::vector<double>> U = A; 
 
     tbb::parallel_for(tbb::blocked_range<int>(0, n), 
         [&] (tbb::blocked_range<int>& range) {
@@ -546,22 +731,4 @@ pair<vector<vector<double>>,vector<vector<double>>> lu_factorization_parallel(co
         }
 }
 
-#include <chrono>
-class timer {
-public:
-    std::chrono::time_point<std::chrono::high_resolution_clock> lastTime;
-    timer() : lastTime(std::chrono::high_resolution_clock::now()) {}
-    inline double elapsed() {
-        std::chrono::time_point<std::chrono::high_resolution_clock> thisTime=std::chrono::high_resolution_clock::now();
-        double deltaTime = std::chrono::duration<double>(thisTime-lastTime).count();
-        lastTime = thisTime;
-        return deltaTime;
-    }
-};
-
-using namespace COOParallel;
-
-int main() {
-    
-}
-
+#endif
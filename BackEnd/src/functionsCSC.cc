@@ -1,9 +1,16 @@
+#ifndef FUNCTIONS_CSC_CC
+#define FUNCTIONS_CSC_CC
+
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <random>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
+#include "functionsStatistics.cc"
 
 using namespace std;
 
@@ -18,35 +25,107 @@ public:
 };
 // loadfile
 // savefile
-/// @brief Gets a value from the compressed sparse column(CSC) matrix
+/// @brief Position of entry (row, col) in row_ind and val, found by binary search in
+/// the sorted row indices of the column; val.size() if the entry is not stored
 /// @exception The search row and col must be less than dimensions of m1
 /// @tparam T The type of the matrix
-/// @param m1 The CSC matrix to get the value from
-/// @param row The row of the value to get
-/// @param col The column of the value to get
-/// @return That value stored at row,column
+/// @param m1 The CSC matrix to search, with sorted row indices in every column
+/// @param row The row of the entry
+/// @param col The column of the entry
+/// @return The index of the entry, or m1.val.size()
 template <typename T>
-T get_matrixCSC(CSCMatrix<T> m1, size_t row, size_t col)
+size_t entry_index_CSC(const CSCMatrix<T> &m1, size_t row, size_t col)
 {
     if (m1.numRows <= row)
     {
-        // throw error
-        cout << "Number of rows exceeded: " << row << endl;
+        throw std::invalid_argument("The row being searched for is greater than the dimensions of the matrix.");
     }
     if (m1.numColumns <= col)
     {
-        // throw error
-        cout << "Number of columns exceeded: " << col << endl;
+        throw std::invalid_argument("The column being searched for is greater than the dimensions of the matrix.");
     }
-    // return -1;
-    for (size_t i = m1.col_ptr.at(col); i < m1.col_ptr.at(col + 1); i++)
+    const size_t *first = m1.row_ind.data() + m1.col_ptr[col];
+    const size_t *last = m1.row_ind.data() + m1.col_ptr[col + 1];
+    const size_t *found = std::lower_bound(first, last, row);
+    if (found != last && *found == row)
     {
-        if (m1.row_ind.at(i) == row)
+        return static_cast<size_t>(found - m1.row_ind.data());
+    }
+    return m1.val.size();
+}
+
+/// @brief Gets a value from the compressed sparse column(CSC) matrix, O(log k) for a
+/// column of k entries
+/// @exception The search row and col must be less than dimensions of m1
+/// @tparam T The type of the matrix
+/// @param m1 The CSC matrix to get the value from, with sorted row indices in every column
+/// @param row The row of the value to get
+/// @param col The column of the value to get
+/// @return That value stored at row,column
+template <typename T>
+T get_matrixCSC(const CSCMatrix<T> &m1, size_t row, size_t col)
+{
+    const size_t index = entry_index_CSC(m1, row, col);
+    return index < m1.val.size() ? m1.val[index] : T(0);
+}
+
+/// @brief Read-only view of one column of a CSC matrix, for sequential traversal:
+/// for (auto entry : column_view_CSC(A, j)) uses entry.row and entry.value
+/// @tparam T The type of the matrix
+template <typename T>
+class CSCColumnView
+{
+public:
+    struct Entry
+    {
+        size_t row;
+        const T &value;
+    };
+
+    class iterator
+    {
+    public:
+        iterator(const size_t *row, const T *value) : row(row), value(value) {}
+        Entry operator*() const { return Entry{*row, *value}; }
+        iterator &operator++()
         {
-            return m1.val.at(i);
+            ++row;
+            ++value;
+            return *this;
         }
+        bool operator==(const iterator &other) const { return row == other.row; }
+        bool operator!=(const iterator &other) const { return row != other.row; }
+
+    private:
+        const size_t *row;
+        const T *value;
+    };
+
+    CSCColumnView(const size_t *rows, const T *values, size_t count) : rows(rows), values(values), count(count) {}
+    iterator begin() const { return iterator(rows, values); }
+    iterator end() const { return iterator(rows + count, values + count); }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t row(size_t k) const { return rows[k]; }
+    const T &value(size_t k) const { return values[k]; }
+
+private:
+    const size_t *rows;
+    const T *values;
+    size_t count;
+};
+
+/// @brief The entries of column j of a CSC matrix, in storage order
+/// @exception j must be less than the number of columns
+template <typename T>
+CSCColumnView<T> column_view_CSC(const CSCMatrix<T> &m1, size_t j)
+{
+    if (m1.numColumns <= j)
+    {
+        throw std::invalid_argument("The column being searched for is greater than the dimensions of the matrix.");
     }
-    return 0;
+    return CSCColumnView<T>(m1.row_ind.data() + m1.col_ptr[j], m1.val.data() + m1.col_ptr[j],
+                            m1.col_ptr[j + 1] - m1.col_ptr[j]);
 }
 
 /// @brief Converts a dense matrix to a compressed sparse column(CSC) matrix
@@ -54,7 +133,7 @@ T get_matrixCSC(CSCMatrix<T> m1, size_t row, size_t col)
 /// @param array  The dense matrix to convert
 /// @return The CSC matrix
 template <typename T>
-CSCMatrix<T> from_vector_CSC(vector<vector<T>> &array)
+CSCMatrix<T> from_vector_CSC(const vector<vector<T>> &array)
 {
     CSCMatrix<T> returnMatrix;
     returnMatrix.numRows = array.size();
@@ -75,30 +154,98 @@ CSCMatrix<T> from_vector_CSC(vector<vector<T>> &array)
     return returnMatrix;
 }
 
+/// @brief Builds a CSC matrix from its arrays, which are moved in rather than copied;
+/// pass std::move(...) for arrays that are no longer needed
+/// @exception The arrays must describe a numRows x numColumns matrix
+/// @tparam T The type of the matrix
+/// @return The CSC matrix owning the arrays
+template <typename T>
+CSCMatrix<T> make_CSC(size_t numRows, size_t numColumns, vector<size_t> col_ptr, vector<size_t> row_ind, vector<T> val)
+{
+    if (col_ptr.size() != numColumns + 1 || col_ptr[0] != 0 || col_ptr.back() != row_ind.size() || row_ind.size() != val.size())
+    {
+        throw std::invalid_argument("The col_ptr, row_ind and val arrays do not describe a CSC matrix of this size.");
+    }
+    for (size_t i = 0; i < numColumns; i++)
+    {
+        if (col_ptr[i] > col_ptr[i + 1])
+        {
+            throw std::invalid_argument("col_ptr must be nondecreasing.");
+        }
+    }
+    for (size_t index : row_ind)
+    {
+        if (index >= numRows)
+        {
+            throw std::invalid_argument("A row index is greater than the dimensions of the matrix.");
+        }
+    }
+    CSCMatrix<T> returnMatrix;
+    returnMatrix.numRows = numRows;
+    returnMatrix.numColumns = numColumns;
+    returnMatrix.col_ptr = std::move(col_ptr);
+    returnMatrix.row_ind = std::move(row_ind);
+    returnMatrix.val = std::move(val);
+    return returnMatrix;
+}
+
 /// @brief Converts a compressed sparse column(CSC) matrix to a dense matrix
 /// @tparam T The type of the matrix
 /// @param m1 The CSC matrix to convert
 /// @return The dense matrix
 template <typename T>
-void print_matrixCSC(CSCMatrix<T> m1)
+void print_matrixCSC(const CSCMatrix<T> &m1)
 {
+    // one cursor per column, advanced down the sorted columns as the rows are printed
+    vector<size_t> next(m1.col_ptr.begin(), m1.col_ptr.end() - 1);
     for (size_t i = 0; i < m1.numRows; i++)
     {
         for (size_t j = 0; j < m1.numColumns; j++)
         {
-            cout << get_matrixCSC(m1, i, j) << " ";
+            if (next[j] < m1.col_ptr[j + 1] && m1.row_ind[next[j]] == i)
+            {
+                cout << m1.val[next[j]++] << " ";
+            }
+            else
+            {
+                cout << T(0) << " ";
+            }
         }
         cout << endl;
     }
 }
 
-/// @brief Adds two compressed sparse column(CSC) matrices
+/// @brief Empties C for reuse as an output matrix, keeping the capacity of its arrays
+/// so that repeated calls with the same C do not reallocate
+template <typename T>
+void reset_CSC(CSCMatrix<T> &C, size_t numRows, size_t numColumns)
+{
+    C.numRows = numRows;
+    C.numColumns = numColumns;
+    C.val.clear();
+    C.row_ind.clear();
+    C.col_ptr.clear();
+}
+
+/// @brief The output of the *_into functions is written while the inputs are read, so
+/// it must be a different matrix
+template <typename T>
+void check_output_CSC(const CSCMatrix<T> &C, const CSCMatrix<T> &m1, const CSCMatrix<T> &m2)
+{
+    if (&C == &m1 || &C == &m2)
+    {
+        throw std::invalid_argument("The output matrix must not be one of the inputs.");
+    }
+}
+
+/// @brief Adds two compressed sparse column(CSC) matrices into C, reusing its storage
+/// @exception C must not be m1 or m2
 /// @tparam T The type of the matrix
+/// @param C The output, the sum of the two matrices
 /// @param m1 The first CSC matrix to add
 /// @param m2 The second CSC matrix to add
-/// @return The sum of the two matrices
 template <typename T>
-CSCMatrix<T> add_matrixCSC(CSCMatrix<T> m1, CSCMatrix<T> m2)
+void add_into(CSCMatrix<T> &C, const CSCMatrix<T> &m1, const CSCMatrix<T> &m2)
 {
     if (m1.numRows != m2.numRows)
     {
@@ -108,10 +255,9 @@ CSCMatrix<T> add_matrixCSC(CSCMatrix<T> m1, CSCMatrix<T> m2)
     {
         throw std::invalid_argument("The number of columns in the first matrix must match the number of columns in the second matrix.");
     }
-    CSCMatrix<T> returnMatrix;
-    returnMatrix.numRows = m1.numRows;
-    returnMatrix.numColumns = m1.numColumns;
-    returnMatrix.col_ptr.push_back(0);
+    check_output_CSC(C, m1, m2);
+    reset_CSC(C, m1.numRows, m1.numColumns);
+    C.col_ptr.push_back(0);
 
     for (size_t i = 0; i < m1.numColumns; i++)
     {
@@ -123,14 +269,14 @@ CSCMatrix<T> add_matrixCSC(CSCMatrix<T> m1, CSCMatrix<T> m2)
         {
             if (m1.row_ind.at(a1) < m2.row_ind.at(a2))
             {
-                returnMatrix.val.push_back(m1.val.at(a1));
-                returnMatrix.row_ind.push_back(m1.row_ind.at(a1));
+                C.val.push_back(m1.val.at(a1));
+                C.row_ind.push_back(m1.row_ind.at(a1));
                 a1++;
             }
             else if (m1.row_ind.at(a1) > m2.row_ind.at(a2))
             {
-                returnMatrix.val.push_back(m2.val.at(a2));
-                returnMatrix.row_ind.push_back(m2.row_ind.at(a2));
+                C.val.push_back(m2.val.at(a2));
+                C.row_ind.push_back(m2.row_ind.at(a2));
                 a2++;
             }
             else if (m1.row_ind.at(a1) == m2.row_ind.at(a2))
@@ -138,8 +284,8 @@ CSCMatrix<T> add_matrixCSC(CSCMatrix<T> m1, CSCMatrix<T> m2)
                 T value = m1.val.at(a1) + m2.val.at(a2);
                 if (value != 0)
                 {
-                    returnMatrix.val.push_back(value);
-                    returnMatrix.row_ind.push_back(m1.row_ind.at(a1));
+                    C.val.push_back(value);
+                    C.row_ind.push_back(m1.row_ind.at(a1));
                 }
                 a1++;
                 a2++;
@@ -147,35 +293,47 @@ CSCMatrix<T> add_matrixCSC(CSCMatrix<T> m1, CSCMatrix<T> m2)
         }
         while (a1 < b1)
         {
-            returnMatrix.val.push_back(m1.val.at(a1));
-            returnMatrix.row_ind.push_back(m1.row_ind.at(a1));
+            C.val.push_back(m1.val.at(a1));
+            C.row_ind.push_back(m1.row_ind.at(a1));
             a1++;
         }
         while (a2 < b2)
         {
-            returnMatrix.val.push_back(m2.val.at(a2));
-            returnMatrix.row_ind.push_back(m2.row_ind.at(a2));
+            C.val.push_back(m2.val.at(a2));
+            C.row_ind.push_back(m2.row_ind.at(a2));
             a2++;
         }
-        returnMatrix.col_ptr.push_back(returnMatrix.val.size());
+        C.col_ptr.push_back(C.val.size());
     }
+}
+
+/// @brief Adds two compressed sparse column(CSC) matrices
+/// @tparam T The type of the matrix
+/// @param m1 The first CSC matrix to add
+/// @param m2 The second CSC matrix to add
+/// @return The sum of the two matrices
+template <typename T>
+CSCMatrix<T> add_matrixCSC(const CSCMatrix<T> &m1, const CSCMatrix<T> &m2)
+{
+    CSCMatrix<T> returnMatrix;
+    add_into(returnMatrix, m1, m2);
     return returnMatrix;
 }
 
-/// @brief Transposes a compressed sparse column(CSC) matrix
+/// @brief Transposes a compressed sparse column(CSC) matrix into C, reusing its storage
+/// @exception C must not be m1
 /// @tparam T  The type of the matrix
+/// @param C   The output, the transposed CSC matrix
 /// @param m1  The CSC matrix to transpose
-/// @return     The transposed CSC matrix
 template <typename T>
-CSCMatrix<T> transpose_matrixCSC(CSCMatrix<T> m1)
+void transpose_into(CSCMatrix<T> &C, const CSCMatrix<T> &m1)
 {
-    CSCMatrix<T> returnMatrix;
-    returnMatrix.numRows = m1.numColumns;
-    returnMatrix.numColumns = m1.numRows;
-    returnMatrix.col_ptr.push_back(0);
+    check_output_CSC(C, m1, m1);
+    reset_CSC(C, m1.numColumns, m1.numRows);
+    C.col_ptr.push_back(0);
     vector<size_t> row_count(m1.numRows, 0);
-    returnMatrix.val = vector<T>(m1.val.size());
-    returnMatrix.row_ind = vector<size_t>(m1.row_ind.size());
+    C.val.resize(m1.val.size());
+    C.row_ind.resize(m1.row_ind.size());
     for (size_t i = 0; i < m1.numColumns; i++)
     {
         for (size_t j = m1.col_ptr.at(i); j < m1.col_ptr.at(i + 1); j++)
@@ -185,38 +343,53 @@ CSCMatrix<T> transpose_matrixCSC(CSCMatrix<T> m1)
     }
     for (size_t i = 0; i < m1.numRows; i++)
     {
-        returnMatrix.col_ptr.push_back(returnMatrix.col_ptr.at(i) + row_count.at(i));
+        C.col_ptr.push_back(C.col_ptr.at(i) + row_count.at(i));
     }
     row_count = vector<size_t>(m1.numRows, 0);
     for (size_t i = 0; i < m1.numColumns; i++)
     {
         for (size_t j = m1.col_ptr.at(i); j < m1.col_ptr.at(i + 1); j++)
         {
-            size_t index = returnMatrix.col_ptr.at(m1.row_ind.at(j)) + row_count.at(m1.row_ind.at(j));
-            returnMatrix.val.at(index) = m1.val.at(j);
-            returnMatrix.row_ind.at(index) = i;
+            size_t index = C.col_ptr.at(m1.row_ind.at(j)) + row_count.at(m1.row_ind.at(j));
+            C.val.at(index) = m1.val.at(j);
+            C.row_ind.at(index) = i;
             row_count.at(m1.row_ind.at(j))++;
         }
     }
+}
+
+/// @brief Transposes a compressed sparse column(CSC) matrix
+/// @tparam T  The type of the matrix
+/// @param m1  The CSC matrix to transpose
+/// @return     The transposed CSC matrix
+template <typename T>
+CSCMatrix<T> transpose_matrixCSC(const CSCMatrix<T> &m1)
+{
+    CSCMatrix<T> returnMatrix;
+    transpose_into(returnMatrix, m1);
     return returnMatrix;
 }
 
-/// @brief Multiplies two compressed sparse column(CSC) matrices
+/// @brief Multiplies two compressed sparse column(CSC) matrices into C, reusing its storage
+/// @exception C must not be m1 or m2
 /// @tparam T The type of the matrix
+/// @param C The output, the product of the two matrices
 /// @param m1 The first CSC matrix to multiply
 /// @param m2 The second CSC matrix to multiply
-/// @return The product of the two matrices
 template <typename T>
-CSCMatrix<T> multiply_matrixCSC(CSCMatrix<T> m1, CSCMatrix<T> m2)
+void multiply_into(CSCMatrix<T> &C, const CSCMatrix<T> &m1, const CSCMatrix<T> &m2)
 {
     if (m1.numColumns != m2.numRows)
     {
         throw std::invalid_argument("The number of columns in the first matrix must match the number of rows in the second matrix.");
     }
-    CSCMatrix<T> returnMatrix;
-    returnMatrix.numRows = m1.numRows;
-    returnMatrix.numColumns = m2.numColumns;
-    returnMatrix.col_ptr.push_back(0);
+    check_output_CSC(C, m1, m2);
+    // the product is built transposed (column i holds row i of the product) and
+    // transposed into C at the end
+    CSCMatrix<T> productT;
+    productT.numRows = m2.numColumns;
+    productT.numColumns = m1.numRows;
+    productT.col_ptr.push_back(0);
     CSCMatrix<T> m1t = transpose_matrixCSC(m1);
     for (size_t i = 0; i < m1t.numColumns; i++)
     {
@@ -246,22 +419,36 @@ CSCMatrix<T> multiply_matrixCSC(CSCMatrix<T> m1, CSCMatrix<T> m2)
             }
             if (sum != 0)
             {
-                returnMatrix.val.push_back(sum);
-                returnMatrix.row_ind.push_back(j);
+                productT.val.push_back(sum);
+                productT.row_ind.push_back(j);
             }
         }
-        returnMatrix.col_ptr.push_back(returnMatrix.val.size());
+        productT.col_ptr.push_back(productT.val.size());
     }
-    return transpose_matrixCSC(returnMatrix);
+    transpose_into(C, productT);
 }
 
-/// @brief Subtract two compressed sparse column(CSC) matrices
+/// @brief Multiplies two compressed sparse column(CSC) matrices
+/// @tparam T The type of the matrix
+/// @param m1 The first CSC matrix to multiply
+/// @param m2 The second CSC matrix to multiply
+/// @return The product of the two matrices
+template <typename T>
+CSCMatrix<T> multiply_matrixCSC(const CSCMatrix<T> &m1, const CSCMatrix<T> &m2)
+{
+    CSCMatrix<T> returnMatrix;
+    multiply_into(returnMatrix, m1, m2);
+    return returnMatrix;
+}
+
+/// @brief Subtract two compressed sparse column(CSC) matrices into C, reusing its storage
+/// @exception C must not be m1 or m2
 /// @tparam T The type of the matrix
+/// @param C The output, the difference of the two matrices
 /// @param m1 The first CSC matrix to add
 /// @param m2 The second CSC matrix to add
-/// @return The difference of the two matrices
 template <typename T>
-CSCMatrix<T> subtract_matrixCSC(CSCMatrix<T> m1, CSCMatrix<T> m2)
+void subtract_into(CSCMatrix<T> &C, const CSCMatrix<T> &m1, const CSCMatrix<T> &m2)
 {
     if (m1.numRows != m2.numRows)
     {
@@ -271,10 +458,9 @@ CSCMatrix<T> subtract_matrixCSC(CSCMatrix<T> m1, CSCMatrix<T> m2)
     {
         throw std::invalid_argument("The number of columns in the first matrix must match the number of columns in the second matrix.");
     }
-    CSCMatrix<T> returnMatrix;
-    returnMatrix.numRows = m1.numRows;
-    returnMatrix.numColumns = m1.numColumns;
-    returnMatrix.col_ptr.push_back(0);
+    check_output_CSC(C, m1, m2);
+    reset_CSC(C, m1.numRows, m1.numColumns);
+    C.col_ptr.push_back(0);
 
     for (size_t i = 0; i < m1.numColumns; i++)
     {
@@ -286,14 +472,14 @@ CSCMatrix<T> subtract_matrixCSC(CSCMatrix<T> m1, CSCMatrix<T> m2)
         {
             if (m1.row_ind.at(a1) < m2.row_ind.at(a2))
             {
-                returnMatrix.val.push_back(m1.val.at(a1));
-                returnMatrix.row_ind.push_back(m1.row_ind.at(a1));
+                C.val.push_back(m1.val.at(a1));
+                C.row_ind.push_back(m1.row_ind.at(a1));
                 a1++;
             }
             else if (m1.row_ind.at(a1) > m2.row_ind.at(a2))
             {
-                returnMatrix.val.push_back(-m2.val.at(a2));
-                returnMatrix.row_ind.push_back(m2.row_ind.at(a2));
+                C.val.push_back(-m2.val.at(a2));
+                C.row_ind.push_back(m2.row_ind.at(a2));
                 a2++;
             }
             else if (m1.row_ind.at(a1) == m2.row_ind.at(a2))
@@ -301,8 +487,8 @@ CSCMatrix<T> subtract_matrixCSC(CSCMatrix<T> m1, CSCMatrix<T> m2)
                 T value = m1.val.at(a1) - m2.val.at(a2);
                 if (value != 0)
                 {
-                    returnMatrix.val.push_back(value);
-                    returnMatrix.row_ind.push_back(m1.row_ind.at(a1));
+                    C.val.push_back(value);
+                    C.row_ind.push_back(m1.row_ind.at(a1));
                 }
                 a1++;
                 a2++;
@@ -310,49 +496,72 @@ CSCMatrix<T> subtract_matrixCSC(CSCMatrix<T> m1, CSCMatrix<T> m2)
         }
         while (a1 < b1)
         {
-            returnMatrix.val.push_back(m1.val.at(a1));
-            returnMatrix.row_ind.push_back(m1.row_ind.at(a1));
+            C.val.push_back(m1.val.at(a1));
+            C.row_ind.push_back(m1.row_ind.at(a1));
             a1++;
         }
         while (a2 < b2)
         {
-            returnMatrix.val.push_back(-m2.val.at(a2));
-            returnMatrix.row_ind.push_back(m2.row_ind.at(a2));
+            C.val.push_back(-m2.val.at(a2));
+            C.row_ind.push_back(m2.row_ind.at(a2));
             a2++;
         }
-        returnMatrix.col_ptr.push_back(returnMatrix.val.size());
+        C.col_ptr.push_back(C.val.size());
     }
+}
+
+/// @brief Subtract two compressed sparse column(CSC) matrices
+/// @tparam T The type of the matrix
+/// @param m1 The first CSC matrix to add
+/// @param m2 The second CSC matrix to add
+/// @return The difference of the two matrices
+template <typename T>
+CSCMatrix<T> subtract_matrixCSC(const CSCMatrix<T> &m1, const CSCMatrix<T> &m2)
+{
+    CSCMatrix<T> returnMatrix;
+    subtract_into(returnMatrix, m1, m2);
     return returnMatrix;
 }
 
 /// @brief Scalar multiply a compressed sparse column(CSC) matrix
 /// @tparam T The type of the matrix
-/// @param m The CSC matrix to scalar multiply
+/// @param m The CSC matrix to scalar multiply; use scale_in_place (functionsElementwise.cc)
+/// to scale a matrix without copying its pattern
 /// @param scalar The scalar to multiply the matrix by
 /// @return The scalar multiplied matrix
 template <typename T>
-CSCMatrix<T> scalar_multiply_CSC(CSCMatrix<T> m, T scalar)
+CSCMatrix<T> scalar_multiply_CSC(const CSCMatrix<T> &m, T scalar)
 {
-
     CSCMatrix<T> result;
     result.numRows = m.numRows;
     result.numColumns = m.numColumns;
-    result.val = vector<T>(m.val.size());
-    result.row_ind = vector<size_t>(m.row_ind.begin(), m.row_ind.end());
-    result.col_ptr = vector<size_t>(m.col_ptr.begin(), m.col_ptr.end());
-    for (size_t i = 0; i < m.val.size(); i++)
+    result.col_ptr = m.col_ptr;
+    result.row_ind = m.row_ind;
+    result.val.reserve(m.val.size());
+    for (const T value : m.val)
     {
-        result.val.at(i) = m.val.at(i) * scalar;
+        result.val.push_back(value * scalar);
     }
     return result;
 }
 
-/// @brief Find the min value in a compressed sparse row(CSC) matrix
+/// @brief Statistics of a compressed sparse column(CSC) matrix, computed in one pass. Nothing
+/// is cached on the matrix; keep the result to check several properties without rescanning.
+/// @tparam T The type of the matrix
+/// @param matrix The CSC matrix, with sorted indices in every column
+/// @return min, max, sum, norms, diagonal dominance and pattern symmetry
+template <typename T>
+MatrixStatistics<T> statistics_CSC(const CSCMatrix<T> &matrix)
+{
+    return compressed_statistics(matrix.numColumns, matrix.numRows, matrix.col_ptr, matrix.row_ind, matrix.val, false);
+}
+
+/// @brief Find the min value in a compressed sparse column(CSC) matrix
 /// @tparam T The type of the matrix
 /// @param m The CSC matrix to find the min value of
 /// @return The min value in the matrix
 template <typename T>
-T find_min_CSC(CSCMatrix<T> matrix)
+T find_min_CSC(const CSCMatrix<T> &matrix)
 {
 
     T min_value = matrix.val[0];
@@ -366,12 +575,12 @@ T find_min_CSC(CSCMatrix<T> matrix)
     return min_value;
 }
 
-/// @brief Find the max value in a compressed sparse row(CSC) matrix
+/// @brief Find the max value in a compressed sparse column(CSC) matrix
 /// @tparam T The type of the matrix
 /// @param m The CSC matrix to find the max value of
 /// @return The max value in the matrix
 template <typename T>
-T find_max_CSC(CSCMatrix<T> matrix)
+T find_max_CSC(const CSCMatrix<T> &matrix)
 {
     T max_value = matrix.val[0];
     for (T val : matrix.val)
@@ -428,4 +637,6 @@ T find_max_CSC(CSCMatrix<T> matrix)
 //     print_matrixCSC(scalar_multiply_CSC(m3, 2));
 
 //     return 0;
-// }
\ No newline at end of file
+// }
+
+#endif
@@ -1,9 +1,20 @@
+#ifndef FUNCTIONS_CSR_CC
+#define FUNCTIONS_CSR_CC
+
+#include <algorithm>
+#include <cmath>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <numeric>
 #include <random>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
+#include "functionsSIMD.cc"
+#include "functionsStatistics.cc"
 
 using namespace std;
 
@@ -26,15 +37,16 @@ public:
 // TODO loadfile
 // TODO savefile
 
-/// @brief Gets a value from the compressed sparse row(CSR) matrix
+/// @brief Position of entry (row, col) in col_ind and val, found by binary search in
+/// the sorted column indices of the row; val.size() if the entry is not stored
 /// @exception The search row and col must be less than dimensions of m1
 /// @tparam T The type of the matrix
-/// @param m1 The CSR matrix to get the value from
-/// @param row The row of the value to get
-/// @param col The column of the value to get
-/// @return That value stored at row,column
+/// @param m1 The CSR matrix to search, with sorted column indices in every row
+/// @param row The row of the entry
+/// @param col The column of the entry
+/// @return The index of the entry, or m1.val.size()
 template <typename T>
-T get_matrixCSR(CSRMatrix<T> m1, size_t row, size_t col)
+size_t entry_index_CSR(const CSRMatrix<T> &m1, size_t row, size_t col)
 {
     if (m1.numRows <= row)
     {
@@ -44,21 +56,96 @@ T get_matrixCSR(CSRMatrix<T> m1, size_t row, size_t col)
     {
         throw std::invalid_argument("The column being searched for is greater than the dimensions of the matrix.");
     }
-    for (size_t i = m1.row_ptr.at(row); i < m1.row_ptr.at(row + 1); i++)
+    const size_t *first = m1.col_ind.data() + m1.row_ptr[row];
+    const size_t *last = m1.col_ind.data() + m1.row_ptr[row + 1];
+    const size_t *found = std::lower_bound(first, last, col);
+    if (found != last && *found == col)
+    {
+        return static_cast<size_t>(found - m1.col_ind.data());
+    }
+    return m1.val.size();
+}
+
+/// @brief Gets a value from the compressed sparse row(CSR) matrix, O(log k) for a row
+/// of k entries
+/// @exception The search row and col must be less than dimensions of m1
+/// @tparam T The type of the matrix
+/// @param m1 The CSR matrix to get the value from, with sorted column indices in every row
+/// @param row The row of the value to get
+/// @param col The column of the value to get
+/// @return That value stored at row,column
+template <typename T>
+T get_matrixCSR(const CSRMatrix<T> &m1, size_t row, size_t col)
+{
+    const size_t index = entry_index_CSR(m1, row, col);
+    return index < m1.val.size() ? m1.val[index] : T(0);
+}
+
+/// @brief Read-only view of one row of a CSR matrix, for sequential traversal:
+/// for (auto entry : row_view_CSR(A, i)) uses entry.col and entry.value
+/// @tparam T The type of the matrix
+template <typename T>
+class CSRRowView
+{
+public:
+    struct Entry
+    {
+        size_t col;
+        const T &value;
+    };
+
+    class iterator
     {
-        if (m1.col_ind.at(i) == col)
+    public:
+        iterator(const size_t *col, const T *value) : col(col), value(value) {}
+        Entry operator*() const { return Entry{*col, *value}; }
+        iterator &operator++()
         {
-            return m1.val.at(i);
+            ++col;
+            ++value;
+            return *this;
         }
+        bool operator==(const iterator &other) const { return col == other.col; }
+        bool operator!=(const iterator &other) const { return col != other.col; }
+
+    private:
+        const size_t *col;
+        const T *value;
+    };
+
+    CSRRowView(const size_t *cols, const T *values, size_t count) : cols(cols), values(values), count(count) {}
+    iterator begin() const { return iterator(cols, values); }
+    iterator end() const { return iterator(cols + count, values + count); }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t col(size_t k) const { return cols[k]; }
+    const T &value(size_t k) const { return values[k]; }
+
+private:
+    const size_t *cols;
+    const T *values;
+    size_t count;
+};
+
+/// @brief The entries of row i of a CSR matrix, in storage order
+/// @exception i must be less than the number of rows
+template <typename T>
+CSRRowView<T> row_view_CSR(const CSRMatrix<T> &m1, size_t i)
+{
+    if (m1.numRows <= i)
+    {
+        throw std::invalid_argument("The row being searched for is greater than the dimensions of the matrix.");
     }
-    return 0;
+    return CSRRowView<T>(m1.col_ind.data() + m1.row_ptr[i], m1.val.data() + m1.row_ptr[i],
+                         m1.row_ptr[i + 1] - m1.row_ptr[i]);
 }
+
 /// @brief Converts a dense matrix to a compressed sparse row(CSR) matrix
 /// @tparam T The type of the matrix
 /// @param array The dense matrix to convert
 /// @return The CSR matrix
 template <typename T>
-CSRMatrix<T> from_vector_CSR(vector<vector<T>> &array)
+CSRMatrix<T> from_vector_CSR(const vector<vector<T>> &array)
 {
     CSRMatrix<T> returnMatrix;
     returnMatrix.numRows = array.size();
@@ -79,29 +166,96 @@ CSRMatrix<T> from_vector_CSR(vector<vector<T>> &array)
     return returnMatrix;
 }
 
+/// @brief Builds a CSR matrix from its arrays, which are moved in rather than copied;
+/// pass std::move(...) for arrays that are no longer needed
+/// @exception The arrays must describe a numRows x numColumns matrix
+/// @tparam T The type of the matrix
+/// @return The CSR matrix owning the arrays
+template <typename T>
+CSRMatrix<T> make_CSR(size_t numRows, size_t numColumns, vector<size_t> row_ptr, vector<size_t> col_ind, vector<T> val)
+{
+    if (row_ptr.size() != numRows + 1 || row_ptr[0] != 0 || row_ptr.back() != col_ind.size() || col_ind.size() != val.size())
+    {
+        throw std::invalid_argument("The row_ptr, col_ind and val arrays do not describe a CSR matrix of this size.");
+    }
+    for (size_t i = 0; i < numRows; i++)
+    {
+        if (row_ptr[i] > row_ptr[i + 1])
+        {
+            throw std::invalid_argument("row_ptr must be nondecreasing.");
+        }
+    }
+    for (size_t index : col_ind)
+    {
+        if (index >= numColumns)
+        {
+            throw std::invalid_argument("A column index is greater than the dimensions of the matrix.");
+        }
+    }
+    CSRMatrix<T> returnMatrix;
+    returnMatrix.numRows = numRows;
+    returnMatrix.numColumns = numColumns;
+    returnMatrix.row_ptr = std::move(row_ptr);
+    returnMatrix.col_ind = std::move(col_ind);
+    returnMatrix.val = std::move(val);
+    return returnMatrix;
+}
+
 /// @brief Prints out a compressed sparse row(CSR) matrix to cout
 /// @tparam T The type of the matrix
 /// @param m1 The matrix too print out
 template <typename T>
-void print_matrixCSR(CSRMatrix<T> m1)
+void print_matrixCSR(const CSRMatrix<T> &m1)
 {
     for (size_t i = 0; i < m1.numRows; i++)
     {
+        // walk the sorted row alongside the columns instead of searching for each one
+        size_t p = m1.row_ptr[i];
         for (size_t j = 0; j < m1.numColumns; j++)
         {
-            cout << get_matrixCSR(m1, i, j) << " ";
+            if (p < m1.row_ptr[i + 1] && m1.col_ind[p] == j)
+            {
+                cout << m1.val[p++] << " ";
+            }
+            else
+            {
+                cout << T(0) << " ";
+            }
         }
         cout << endl;
     }
 }
-/// @brief Adds two compressed spares row(CSR) matrices together
-/// @exception The two matrixes must have the same dimensions
+/// @brief Empties C for reuse as an output matrix, keeping the capacity of its arrays
+/// so that repeated calls with the same C do not reallocate
+template <typename T>
+void reset_CSR(CSRMatrix<T> &C, size_t numRows, size_t numColumns)
+{
+    C.numRows = numRows;
+    C.numColumns = numColumns;
+    C.val.clear();
+    C.col_ind.clear();
+    C.row_ptr.clear();
+}
+
+/// @brief The output of the *_into functions is written while the inputs are read, so
+/// it must be a different matrix
+template <typename T>
+void check_output_CSR(const CSRMatrix<T> &C, const CSRMatrix<T> &m1, const CSRMatrix<T> &m2)
+{
+    if (&C == &m1 || &C == &m2)
+    {
+        throw std::invalid_argument("The output matrix must not be one of the inputs.");
+    }
+}
+
+/// @brief Adds two compressed spares row(CSR) matrices together into C, reusing its storage
+/// @exception The two matrixes must have the same dimensions, and C must not be m1 or m2
 /// @tparam T The type of both matrixes
+/// @param C The output, m1+m2
 /// @param m1 The first matrix too add
 /// @param m2 The second matrix too add
-/// @return m1+m2
 template <typename T>
-CSRMatrix<T> add_matrixCSR(CSRMatrix<T> m1, CSRMatrix<T> m2)
+void add_into(CSRMatrix<T> &C, const CSRMatrix<T> &m1, const CSRMatrix<T> &m2)
 {
     if (m1.numRows != m2.numRows)
     {
@@ -111,10 +265,9 @@ CSRMatrix<T> add_matrixCSR(CSRMatrix<T> m1, CSRMatrix<T> m2)
     {
         throw std::invalid_argument("The number of columns in the first matrix must match the number of columns in the second matrix.");
     }
-    CSRMatrix<T> returnMatrix;
-    returnMatrix.numRows = m1.numRows;
-    returnMatrix.numColumns = m1.numColumns;
-    returnMatrix.row_ptr.push_back(0);
+    check_output_CSR(C, m1, m2);
+    reset_CSR(C, m1.numRows, m1.numColumns);
+    C.row_ptr.push_back(0);
 
     for (size_t i = 0; i < m1.numRows; i++)
     {
@@ -126,14 +279,14 @@ CSRMatrix<T> add_matrixCSR(CSRMatrix<T> m1, CSRMatrix<T> m2)
         {
             if (m1.col_ind.at(a1) < m2.col_ind.at(a2))
             {
-                returnMatrix.val.push_back(m1.val.at(a1));
-                returnMatrix.col_ind.push_back(m1.col_ind.at(a1));
+                C.val.push_back(m1.val.at(a1));
+                C.col_ind.push_back(m1.col_ind.at(a1));
                 a1++;
             }
             else if (m1.col_ind.at(a1) > m2.col_ind.at(a2))
             {
-                returnMatrix.val.push_back(m2.val.at(a2));
-                returnMatrix.col_ind.push_back(m2.col_ind.at(a2));
+                C.val.push_back(m2.val.at(a2));
+                C.col_ind.push_back(m2.col_ind.at(a2));
                 a2++;
             }
             else if (m1.col_ind.at(a1) == m2.col_ind.at(a2))
@@ -141,8 +294,8 @@ CSRMatrix<T> add_matrixCSR(CSRMatrix<T> m1, CSRMatrix<T> m2)
                 T value = m1.val.at(a1) + m2.val.at(a2);
                 if (value != 0)
                 {
-                    returnMatrix.val.push_back(value);
-                    returnMatrix.col_ind.push_back(m1.col_ind.at(a1));
+                    C.val.push_back(value);
+                    C.col_ind.push_back(m1.col_ind.at(a1));
                 }
                 a1++;
                 a2++;
@@ -150,25 +303,39 @@ CSRMatrix<T> add_matrixCSR(CSRMatrix<T> m1, CSRMatrix<T> m2)
         }
         while (a1 < b1)
         {
-            returnMatrix.val.push_back(m1.val.at(a1));
-            returnMatrix.col_ind.push_back(m1.col_ind.at(a1));
+            C.val.push_back(m1.val.at(a1));
+            C.col_ind.push_back(m1.col_ind.at(a1));
             a1++;
         }
         while (a2 < b2)
         {
-            returnMatrix.val.push_back(m2.val.at(a2));
-            returnMatrix.col_ind.push_back(m2.col_ind.at(a2));
+            C.val.push_back(m2.val.at(a2));
+            C.col_ind.push_back(m2.col_ind.at(a2));
             a2++;
         }
-        returnMatrix.row_ptr.push_back(returnMatrix.val.size());
+        C.row_ptr.push_back(C.val.size());
     }
+}
+
+/// @brief Adds two compressed spares row(CSR) matrices together
+/// @exception The two matrixes must have the same dimensions
+/// @tparam T The type of both matrixes
+/// @param m1 The first matrix too add
+/// @param m2 The second matrix too add
+/// @return m1+m2
+template <typename T>
+CSRMatrix<T> add_matrixCSR(const CSRMatrix<T> &m1, const CSRMatrix<T> &m2)
+{
+    CSRMatrix<T> returnMatrix;
+    add_into(returnMatrix, m1, m2);
     return returnMatrix;
 }
 
-/// @brief Transposes a compressed sparse row(CSR) matrix
+/// @brief Transposes a compressed sparse row(CSR) matrix into C, reusing its storage
+/// @exception C must not be m1
 /// @tparam T The type of the matrix
+/// @param C The output, m1 transposed
 /// @param m1 The CSR matrix to transpose
-/// @return m1 transposed
 /// We first check make a vector row_count with 0s. This will keep track of how many elements
 /// are at each column (or each row for the transposed matrix). We compute this by iterating through
 /// the elements and adding the count at the respective row. Then, each element row_ptr[i] of the new
@@ -180,15 +347,14 @@ CSRMatrix<T> add_matrixCSR(CSRMatrix<T> m1, CSRMatrix<T> m2)
 /// row_count[m1.col_ind[j]]. And obtain the index. Then add this element to such index in the new
 /// matrix: returnMatrix.val[index]=m1.val[j] as well as its column index: returnMatrix.col_ind[index]=i.
 template <typename T>
-CSRMatrix<T> transpose_matrixCSR(CSRMatrix<T> m1)
+void transpose_into(CSRMatrix<T> &C, const CSRMatrix<T> &m1)
 {
-    CSRMatrix<T> returnMatrix;
-    returnMatrix.numRows = m1.numColumns;
-    returnMatrix.numColumns = m1.numRows;
-    returnMatrix.row_ptr.push_back(0);
+    check_output_CSR(C, m1, m1);
+    reset_CSR(C, m1.numColumns, m1.numRows);
+    C.row_ptr.push_back(0);
     vector<size_t> row_count(m1.numColumns, 0);
-    returnMatrix.val = vector<T>(m1.val.size());
-    returnMatrix.col_ind = vector<size_t>(m1.col_ind.size());
+    C.val.resize(m1.val.size());
+    C.col_ind.resize(m1.col_ind.size());
     for (size_t i = 0; i < m1.numRows; i++)
     {
         for (size_t j = m1.row_ptr.at(i); j < m1.row_ptr.at(i + 1); j++)
@@ -198,85 +364,113 @@ CSRMatrix<T> transpose_matrixCSR(CSRMatrix<T> m1)
     }
     for (size_t i = 0; i < m1.numColumns; i++)
     {
-        returnMatrix.row_ptr.push_back(returnMatrix.row_ptr.at(i) + row_count.at(i));
+        C.row_ptr.push_back(C.row_ptr.at(i) + row_count.at(i));
     }
     row_count = vector<size_t>(m1.numColumns, 0);
     for (size_t i = 0; i < m1.numRows; i++)
     {
         for (size_t j = m1.row_ptr.at(i); j < m1.row_ptr.at(i + 1); j++)
         {
-            size_t index = returnMatrix.row_ptr.at(m1.col_ind.at(j)) + row_count.at(m1.col_ind.at(j));
-            returnMatrix.val.at(index) = m1.val.at(j);
-            returnMatrix.col_ind.at(index) = i;
+            size_t index = C.row_ptr.at(m1.col_ind.at(j)) + row_count.at(m1.col_ind.at(j));
+            C.val.at(index) = m1.val.at(j);
+            C.col_ind.at(index) = i;
             row_count.at(m1.col_ind.at(j))++;
         }
     }
+}
+
+/// @brief Transposes a compressed sparse row(CSR) matrix, see transpose_into
+/// @tparam T The type of the matrix
+/// @param m1 The CSR matrix to transpose
+/// @return m1 transposed
+template <typename T>
+CSRMatrix<T> transpose_matrixCSR(const CSRMatrix<T> &m1)
+{
+    CSRMatrix<T> returnMatrix;
+    transpose_into(returnMatrix, m1);
     return returnMatrix;
 }
 
-/// @brief Multiplies two compressed sparse row(CSR) matrixes
-/// @exception The number of columns in m1 must equal the number of rows in m2
+/// @brief Multiplies two compressed sparse row(CSR) matrixes into C, reusing its storage
+/// @exception The number of columns in m1 must equal the number of rows in m2, and C
+/// must not be m1 or m2
 /// @tparam T The type of the matrixes
+/// @param C The output, the dot product of m1 and m2
 /// @param m1 The first CSR matrix to multiply
 /// @param m2 The second CSR matrix to multiply
-/// @return The dot product of m1 and m2
+/// Row i of the result is the sum of the rows m2[k] scaled by m1[i][k] (Gustavson's
+/// algorithm). The sums are gathered in a dense accumulator of length m2.numColumns
+/// together with the list of columns touched in this row, so the work is proportional
+/// to the number of scalar products instead of rows x columns. The touched columns are
+/// sorted before they are written out so the result has sorted column indices.
 template <typename T>
-CSRMatrix<T> multiply_matrixCSR(CSRMatrix<T> m1, CSRMatrix<T> m2)
+void multiply_into(CSRMatrix<T> &C, const CSRMatrix<T> &m1, const CSRMatrix<T> &m2)
 {
     if (m1.numColumns != m2.numRows)
     {
         throw std::invalid_argument("The number of columns in the first matrix must match the number of rows in the second matrix.");
     }
-    CSRMatrix<T> returnMatrix;
-    returnMatrix.numRows = m1.numRows;
-    returnMatrix.numColumns = m2.numColumns;
-    returnMatrix.row_ptr.push_back(0);
-    CSRMatrix<T> m2t = transpose_matrixCSR(m2);
+    check_output_CSR(C, m1, m2);
+    reset_CSR(C, m1.numRows, m2.numColumns);
+    C.row_ptr.push_back(0);
+    vector<T> accumulator(m2.numColumns, 0);
+    vector<bool> used(m2.numColumns, false);
+    vector<size_t> touched;
     for (size_t i = 0; i < m1.numRows; i++)
     {
-        for (size_t j = 0; j < m2t.numRows; j++)
+        touched.clear();
+        for (size_t a = m1.row_ptr[i]; a < m1.row_ptr[i + 1]; a++)
         {
-            T sum = 0;
-            size_t a1 = m1.row_ptr.at(i);
-            size_t b1 = m1.row_ptr.at(i + 1);
-            size_t a2 = m2t.row_ptr.at(j);
-            size_t b2 = m2t.row_ptr.at(j + 1);
-            while (a1 < b1 && a2 < b2)
+            const size_t k = m1.col_ind[a];
+            const T value = m1.val[a];
+            for (size_t b = m2.row_ptr[k]; b < m2.row_ptr[k + 1]; b++)
             {
-                if (m1.col_ind.at(a1) < m2t.col_ind.at(a2))
-                {
-                    a1++;
-                }
-                else if (m1.col_ind.at(a1) > m2t.col_ind.at(a2))
+                const size_t j = m2.col_ind[b];
+                if (!used[j])
                 {
-                    a2++;
-                }
-                else if (m1.col_ind.at(a1) == m2t.col_ind.at(a2))
-                {
-                    sum += m1.val.at(a1) * m2t.val.at(a2);
-                    a1++;
-                    a2++;
+                    used[j] = true;
+                    touched.push_back(j);
                 }
+                accumulator[j] += value * m2.val[b];
             }
-            if (sum != 0)
+        }
+        std::sort(touched.begin(), touched.end());
+        for (size_t j : touched)
+        {
+            if (accumulator[j] != 0)
             {
-                returnMatrix.val.push_back(sum);
-                returnMatrix.col_ind.push_back(j);
+                C.val.push_back(accumulator[j]);
+                C.col_ind.push_back(j);
             }
+            accumulator[j] = 0;
+            used[j] = false;
         }
-        returnMatrix.row_ptr.push_back(returnMatrix.val.size());
+        C.row_ptr.push_back(C.val.size());
     }
-    return returnMatrix;
 }
 
-/// @brief Subtract two compressed sparse row(CSR) matrixes
+/// @brief Multiplies two compressed sparse row(CSR) matrixes, see multiply_into
 /// @exception The number of columns in m1 must equal the number of rows in m2
 /// @tparam T The type of the matrixes
+/// @param m1 The first CSR matrix to multiply
+/// @param m2 The second CSR matrix to multiply
+/// @return The dot product of m1 and m2
+template <typename T>
+CSRMatrix<T> multiply_matrixCSR(const CSRMatrix<T> &m1, const CSRMatrix<T> &m2)
+{
+    CSRMatrix<T> returnMatrix;
+    multiply_into(returnMatrix, m1, m2);
+    return returnMatrix;
+}
+
+/// @brief Subtract two compressed sparse row(CSR) matrixes into C, reusing its storage
+/// @exception The two matrixes must have the same dimensions, and C must not be m1 or m2
+/// @tparam T The type of the matrixes
+/// @param C The output, the difference of m1 and m2
 /// @param m1 The first CSR matrix to subtract
 /// @param m2 The second CSR matrix to subtract
-/// @return The difference of m1 and m2
 template <typename T>
-CSRMatrix<T> subtract_matrixCSR(CSRMatrix<T> m1, CSRMatrix<T> m2)
+void subtract_into(CSRMatrix<T> &C, const CSRMatrix<T> &m1, const CSRMatrix<T> &m2)
 {
     if (m1.numRows != m2.numRows)
     {
@@ -286,10 +480,9 @@ CSRMatrix<T> subtract_matrixCSR(CSRMatrix<T> m1, CSRMatrix<T> m2)
     {
         throw std::invalid_argument("The number of columns in the first matrix must match the number of columns in the second matrix.");
     }
-    CSRMatrix<T> returnMatrix;
-    returnMatrix.numRows = m1.numRows;
-    returnMatrix.numColumns = m1.numColumns;
-    returnMatrix.row_ptr.push_back(0);
+    check_output_CSR(C, m1, m2);
+    reset_CSR(C, m1.numRows, m1.numColumns);
+    C.row_ptr.push_back(0);
 
     for (size_t i = 0; i < m1.numRows; i++)
     {
@@ -301,14 +494,14 @@ CSRMatrix<T> subtract_matrixCSR(CSRMatrix<T> m1, CSRMatrix<T> m2)
         {
             if (m1.col_ind.at(a1) < m2.col_ind.at(a2))
             {
-                returnMatrix.val.push_back(m1.val.at(a1));
-                returnMatrix.col_ind.push_back(m1.col_ind.at(a1));
+                C.val.push_back(m1.val.at(a1));
+                C.col_ind.push_back(m1.col_ind.at(a1));
                 a1++;
             }
             else if (m1.col_ind.at(a1) > m2.col_ind.at(a2))
             {
-                returnMatrix.val.push_back(-m2.val.at(a2));
-                returnMatrix.col_ind.push_back(m2.col_ind.at(a2));
+                C.val.push_back(-m2.val.at(a2));
+                C.col_ind.push_back(m2.col_ind.at(a2));
                 a2++;
             }
             else if (m1.col_ind.at(a1) == m2.col_ind.at(a2))
@@ -316,8 +509,8 @@ CSRMatrix<T> subtract_matrixCSR(CSRMatrix<T> m1, CSRMatrix<T> m2)
                 T value = m1.val.at(a1) - m2.val.at(a2);
                 if (value != 0)
                 {
-                    returnMatrix.val.push_back(value);
-                    returnMatrix.col_ind.push_back(m1.col_ind.at(a1));
+                    C.val.push_back(value);
+                    C.col_ind.push_back(m1.col_ind.at(a1));
                 }
                 a1++;
                 a2++;
@@ -325,50 +518,73 @@ CSRMatrix<T> subtract_matrixCSR(CSRMatrix<T> m1, CSRMatrix<T> m2)
         }
         while (a1 < b1)
         {
-            returnMatrix.val.push_back(m1.val.at(a1));
-            returnMatrix.col_ind.push_back(m1.col_ind.at(a1));
+            C.val.push_back(m1.val.at(a1));
+            C.col_ind.push_back(m1.col_ind.at(a1));
             a1++;
         }
         while (a2 < b2)
         {
-            returnMatrix.val.push_back(-m2.val.at(a2));
-            returnMatrix.col_ind.push_back(m2.col_ind.at(a2));
+            C.val.push_back(-m2.val.at(a2));
+            C.col_ind.push_back(m2.col_ind.at(a2));
             a2++;
         }
-        returnMatrix.row_ptr.push_back(returnMatrix.col_ind.size());
+        C.row_ptr.push_back(C.col_ind.size());
     }
+}
+
+/// @brief Subtract two compressed sparse row(CSR) matrixes, see subtract_into
+/// @exception The two matrixes must have the same dimensions
+/// @tparam T The type of the matrixes
+/// @param m1 The first CSR matrix to subtract
+/// @param m2 The second CSR matrix to subtract
+/// @return The difference of m1 and m2
+template <typename T>
+CSRMatrix<T> subtract_matrixCSR(const CSRMatrix<T> &m1, const CSRMatrix<T> &m2)
+{
+    CSRMatrix<T> returnMatrix;
+    subtract_into(returnMatrix, m1, m2);
     return returnMatrix;
 }
 
 /// @brief Scalar multiply a compressed sparse row(CSR) matrix
 /// @tparam T The type of the matrix
-/// @param m The CSR matrix to scalar multiply
+/// @param m The CSR matrix to scalar multiply; use scale_in_place (functionsElementwise.cc)
+/// to scale a matrix without copying its pattern
 /// @param scalar The scalar to multiply the matrix by
 /// @return The scalar multiplied matrix
 template <typename T>
-CSRMatrix<T> scalar_multiply_CSR(CSRMatrix<T> m, T scalar)
+CSRMatrix<T> scalar_multiply_CSR(const CSRMatrix<T> &m, T scalar)
 {
-
     CSRMatrix<T> result;
     result.numRows = m.numRows;
     result.numColumns = m.numColumns;
-    result.val = vector<T>(m.val.size());
-    result.col_ind = vector<size_t>(m.col_ind.begin(), m.col_ind.end());
-    result.row_ptr = vector<size_t>(m.row_ptr.begin(), m.row_ptr.end());
-    for (size_t i = 0; i < m.val.size(); i++)
+    result.row_ptr = m.row_ptr;
+    result.col_ind = m.col_ind;
+    result.val.reserve(m.val.size());
+    for (const T value : m.val)
     {
-        result.val.at(i) = m.val.at(i) * scalar;
+        result.val.push_back(value * scalar);
     }
     return result;
 }
 
+/// @brief Statistics of a compressed sparse row(CSR) matrix, computed in one pass. Nothing
+/// is cached on the matrix; keep the result to check several properties without rescanning.
+/// @tparam T The type of the matrix
+/// @param matrix The CSR matrix, with sorted indices in every row
+/// @return min, max, sum, norms, diagonal dominance and pattern symmetry
+template <typename T>
+MatrixStatistics<T> statistics_CSR(const CSRMatrix<T> &matrix)
+{
+    return compressed_statistics(matrix.numRows, matrix.numColumns, matrix.row_ptr, matrix.col_ind, matrix.val, true);
+}
+
 /// @brief Find the min value in a compressed sparse row(CSR) matrix
 /// @tparam T The type of the matrix
 /// @param m The CSR matrix to find the min value of
 /// @return The min value in the matrix
-
 template <typename T>
-T find_min_CSR(CSRMatrix<T> matrix)
+T find_min_CSR(const CSRMatrix<T> &matrix)
 {
 
     T min_value = matrix.val[0];
@@ -387,7 +603,7 @@ T find_min_CSR(CSRMatrix<T> matrix)
 /// @param m The CSR matrix to find the max value of
 /// @return The max value in the matrix
 template <typename T>
-T find_max_CSR(CSRMatrix<T> matrix)
+T find_max_CSR(const CSRMatrix<T> &matrix)
 {
     T max_value = matrix.val[0];
     for (T val : matrix.val)
@@ -503,12 +719,12 @@ CSRMatrix<T> load_fileCSR(string fileName)
  * meaning that the elements on the diagonal indices of the matrix are greater or equal to
  * the sum of the rest of the elements in that row.
  * 
- * @param denseMatrix 
+ * @param m1 
  * @return true If is diagonally dominant
  * @return false Otherwise
  */
 template <typename T>
-bool diagonally_dominant(CSRMatrix<T> m1) {
+bool diagonally_dominant(const CSRMatrix<T> &m1) {
     for (size_t i = 0; i < m1.numRows; ++i) {
         size_t a1 = m1.row_ptr.at(i);
         size_t b1 = m1.row_ptr.at(i + 1);
@@ -530,58 +746,98 @@ bool diagonally_dominant(CSRMatrix<T> m1) {
     return true;
 }
 
+/**
+ * @brief Extracts D^-1, the reciprocal of the diagonal of a CSR matrix, so iterative
+ * methods do not have to search every row for its diagonal entry on each sweep.
+ * @exception Every row must have a nonzero diagonal entry
+ *
+ * @tparam T
+ * @param m1
+ * @return std::vector<T> 1/a_ii for each row i
+ */
+template <typename T>
+std::vector<T> inverse_diagonal_CSR(const CSRMatrix<T> &m1) {
+    std::vector<T> invDiag(m1.numRows, 0.0);
+    for (size_t i = 0; i < m1.numRows; ++i) {
+        for (size_t k = m1.row_ptr[i]; k < m1.row_ptr[i + 1]; ++k) {
+            if (m1.col_ind[k] == i) {
+                invDiag[i] = 1.0 / m1.val[k];
+                break;
+            }
+        }
+        if (invDiag[i] == 0) {
+            throw std::invalid_argument("Input matrix has a zero on the diagonal");
+        }
+    }
+    return invDiag;
+}
+
+/**
+ * @brief One (weighted) Jacobi sweep
+ * xNew[i] = (1 - weight) * x[i] + weight * (B[i] - sum_{j != i} a_ij x[j]) / a_ii
+ * fused with the max-norm of xNew - x, computed in the same pass over the rows.
+ *
+ * @tparam T
+ * @param m1
+ * @param invDiag from inverse_diagonal_CSR
+ * @param B
+ * @param x current iterate
+ * @param xNew output, must already have m1.numRows entries
+ * @param weight damping factor, 1.0 is plain Jacobi
+ * @return T the max-norm of xNew - x
+ */
+template <typename T>
+T jacobi_sweep_CSR(const CSRMatrix<T> &m1, const std::vector<T> &invDiag, const std::vector<T> &B,
+                   const std::vector<T> &x, std::vector<T> &xNew, const T weight) {
+    T diff = 0.0;
+    for (size_t i = 0; i < m1.numRows; ++i) {
+        // the full row product includes a_ii * x_i, which the x[i] + ... form below
+        // cancels, so the inner loop needs no diagonal branch
+        T sum = 0.0;
+        for (size_t k = m1.row_ptr[i]; k < m1.row_ptr[i + 1]; ++k) {
+            sum += m1.val[k] * x[m1.col_ind[k]];
+        }
+        const T value = x[i] + weight * (B[i] - sum) * invDiag[i];
+        diff = std::max(diff, static_cast<T>(std::abs(value - x[i])));
+        xNew[i] = value;
+    }
+    return diff;
+}
+
 /**
  * @brief The Jacobi Method is an iterative method for determining the solutions of a strictly
  * diagonally dominant matrix A. Through each iteration, the values of x[i] are approximated through
- * the formula x[i] = B[i]
+ * the formula x[i] = (B[i] - sum_{j != i} a_ij x[j]) / a_ii. D^-1 is extracted once, the two
+ * iterate buffers are swapped instead of copied, and the convergence norm is computed in the
+ * same pass as the update.
  * 
  * @param denseMatrix 
  * @param B 
  * @param tol - the tolerance for convergence
  * @param iterations - the maximum number of iterations to perform
+ * @param weight - damping factor for weighted Jacobi (1.0 is plain Jacobi)
+ * @param checkEvery - only test for convergence every checkEvery iterations
  */
 template <typename T>
-std::vector<T> jacobi_method_CSR(CSRMatrix<T> m1, std::vector<T> B, const double tol,int maxIterations) {
+std::vector<T> jacobi_method_CSR(const CSRMatrix<T> &m1, const std::vector<T> &B, const double tol,int maxIterations,
+                                 const T weight = 1.0, const int checkEvery = 1) {
     if (diagonally_dominant(m1) == false) {
         throw std::invalid_argument("Input matrix is not diagonally dominant");
     }
+    const std::vector<T> invDiag = inverse_diagonal_CSR(m1);
     std::vector<T> xValues(B.size(), 0.0);
     std::vector<T> approxValues(B.size(), 0.0);
     int iterations = 0;
     double diff = tol + 1.0;
     while (iterations < maxIterations && diff > tol) {
-        for (size_t i = 0; i < m1.numRows; ++i) {
-            size_t a1 = m1.row_ptr.at(i);
-            size_t b1 = m1.row_ptr.at(i + 1);
-            T sum = 0.0;
-            T diagonal = 0.0;
-            while(a1 < b1){
-                if(m1.col_ind[a1] == i){
-                    diagonal = m1.val[a1];
-                }else{
-                    sum += m1.val[a1] * xValues[m1.col_ind[a1]];
-                }
-                a1++;
-            }
-            //no devide by zero error becuase of diagonally dominant check
-            approxValues[i] = (B[i] - sum) / diagonal;
-            
-        }
-         // Calculate the norm of the difference between x and x_new
-        diff = 0.0;
-        for (size_t i = 0; i < m1.numRows; i++)
-        {
-            double abs_diff = std::abs(approxValues[i] - xValues[i]);
-            if (abs_diff > diff)
-            {
-                diff = abs_diff;
-            }
-        }
-        xValues = approxValues;
+        T sweepDiff = jacobi_sweep_CSR(m1, invDiag, B, xValues, approxValues, weight);
+        xValues.swap(approxValues);
         iterations++;
-    
+        if (checkEvery <= 1 || iterations % checkEvery == 0) {
+            diff = sweepDiff;
+        }
     }
-return approxValues;
+    return xValues;
 }
 
 /**
@@ -596,7 +852,7 @@ return approxValues;
  * @return std::vector<T> 
  */
 template <typename T>
-std::vector<T> gauss_sidel_CSR(CSRMatrix<T> m1, std::vector<T> B, const double tol,int maxIterations) {
+std::vector<T> gauss_sidel_CSR(const CSRMatrix<T> &m1, const std::vector<T> &B, const double tol,int maxIterations) {
     // if (diagonally_dominant(m1) == false) {
     //     throw std::invalid_argument("Input matrix is not diagonally dominant");
     // }
@@ -639,93 +895,243 @@ std::vector<T> gauss_sidel_CSR(CSRMatrix<T> m1, std::vector<T> B, const double t
     return xValues;
 }
 
+/**
+ * @brief Extracts the diagonal of a CSR matrix. Rows without a stored diagonal entry
+ * get a zero so callers can detect them.
+ *
+ * @tparam T
+ * @param A
+ * @return std::vector<T> the diagonal, one entry per row
+ */
+template <typename T>
+std::vector<T> diagonal_CSR(const CSRMatrix<T> &A)
+{
+    std::vector<T> diag(A.numRows, 0.0);
+    for (size_t i = 0; i < A.numRows; i++)
+    {
+        for (size_t k = A.row_ptr[i]; k < A.row_ptr[i + 1]; k++)
+        {
+            if (A.col_ind[k] == i)
+            {
+                diag[i] = A.val[k];
+                break;
+            }
+        }
+    }
+    return diag;
+}
+
+/**
+ * @brief One relaxation sweep of SOR over the rows first..last (or last..first when
+ * backward is true), updating x in place. The diagonal is passed in so it is only
+ * looked up once per solve.
+ */
+template <typename T>
+void sor_sweep_CSR(const CSRMatrix<T> &A,
+                   const std::vector<T> &diag,
+                   const std::vector<T> &b,
+                   std::vector<T> &x,
+                   const T omega,
+                   const bool backward)
+{
+    const size_t n = A.numRows;
+    for (size_t step = 0; step < n; step++)
+    {
+        const size_t i = backward ? n - 1 - step : step;
+        T sum = 0.0;
+        for (size_t k = A.row_ptr[i]; k < A.row_ptr[i + 1]; k++)
+        {
+            if (A.col_ind[k] != i)
+            {
+                sum += A.val[k] * x[A.col_ind[k]];
+            }
+        }
+        x[i] = (1.0 - omega) * x[i] + (omega / diag[i]) * (b[i] - sum);
+    }
+}
+
+/**
+ * @brief Solve Ax = b with symmetric successive over-relaxation. Each iteration is a
+ * forward SOR sweep (rows 0..n-1) followed by a backward sweep (rows n-1..0), both
+ * using the newest values of x. For symmetric A the resulting iteration matrix is
+ * symmetric, which is what makes SSOR usable as a CG preconditioner.
+ *
+ * @tparam T
+ * @param A
+ * @param b
+ * @param tol - max-norm of the change in x between iterations
+ * @param max_iter
+ * @param omega - relaxation parameter (0 < omega < 2)
+ * @return std::vector<T>
+ */
 template <typename T>
-std::vector<T> ssor_iteration_CSR(CSRMatrix<T> A,
+std::vector<T> ssor_iteration_CSR(const CSRMatrix<T> &A,
                                   const std::vector<T> &b,
                                   const T tol,
                                   const int max_iter,
                                   const T omega)
 {
     const size_t n = A.numRows;
+    const std::vector<T> diag = diagonal_CSR(A);
+    for (size_t i = 0; i < n; i++)
+    {
+        if (diag[i] == 0)
+        {
+            throw std::invalid_argument("SSOR requires a nonzero diagonal.");
+        }
+    }
     std::vector<T> x(n, 0.0);
-    std::vector<T> x_new(n, 0.0);
+    std::vector<T> x_old(n, 0.0);
 
     int iter = 0;
     T diff = tol + 1.0;
 
     while (iter < max_iter && diff > tol)
     {
-        // Normally one needs to solve M(x_new - x) = b - Ax using lu_solve where M = (D + omega*L)^-1 * (D + omega*U),
-        // L is the strict lower triangular part of A, U is the strict upper triangular part of A, and D is the diagonal of A.
-        // However, according to https://en.wikipedia.org/wiki/Successive_over-relaxation, we can use forward substitution:
-        for (size_t i = 0; i < n; i++)
-        {
-            T sum = 0.0;
-            T diag = 0.0;
-            for (size_t k = A.row_ptr[i]; k < A.row_ptr[i+1]; k++) {
-                size_t j = A.col_ind[k];
-                if (j < i) {
-                    sum += A.val[k] * x_new[j];
-                } else if (j > i) {
-                    sum += A.val[k] * x[j];
-                } else {
-                    diag = A.val[k];
-                }
-            }
-            x_new[i] = (1.0 - omega) * x[i] + (omega / diag) * (b[i] - sum);
-        }
+        std::copy(x.begin(), x.end(), x_old.begin());
+        sor_sweep_CSR(A, diag, b, x, omega, false);
+        sor_sweep_CSR(A, diag, b, x, omega, true);
+
         // Compute the difference between the new and old iterates
         diff = 0.0;
         for (size_t i = 0; i < n; i++)
         {
-            T abs_diff = std::abs(x_new[i] - x[i]);
+            T abs_diff = std::abs(x[i] - x_old[i]);
             if (abs_diff > diff)
             {
                 diff = abs_diff;
             }
         }
-        x = x_new;
         iter++;
     }
     return x;
 }
 
-
 /**
- * @brief 
- * 
- * @tparam T 
- * @param m1 
+ * @brief A preconditioner applies z = M^-1 r for some approximation M of A.
+ * Solvers that take one call it once per iteration, so it should not allocate.
  */
-template <typename T> 
-    void lu_decomposition_CSR(CSRMatrix<T> m1) {
-        int n = m1.row_ptr.size() - 1;
-        CSRMatrix<T> L;
-        L.val = m1.vals;
-        L.row_ptr = m1.row_ptr;
-        L.col_ind = m1.col_ind;
-        CSRMatrix<T> U;
-        U.val = m1.val;
-        U.row_ptr = m1.row_ptr;
-        U.col_ind = m1.col_ind;
-
-        for (int i = 0; i < n; ++i) {
-            L.val.at(L.row_ptr[i]) = 1.0;   
-        }
-    }
+template <typename T>
+using PreconditionerCSR = std::function<void(const std::vector<T> &, std::vector<T> &)>;
 
 /**
- * @brief Matrix-vector product function
- * 
- * @tparam T 
- * @param m1 
- * @param v 
- * @return std::vector<T> 
+ * @brief Applies the SSOR preconditioner
+ * M = omega/(2-omega) * (D/omega + L) (D/omega)^-1 (D/omega + U)
+ * to r, i.e. z = M^-1 r, with one forward and one backward triangular solve.
+ * M is symmetric positive definite whenever A is, so it can be used with CG.
+ *
+ * @tparam T
+ * @param A
+ * @param diag the diagonal of A, from diagonal_CSR
+ * @param r
+ * @param z output, resized to A.numRows
+ * @param omega relaxation parameter (0 < omega < 2)
  */
 template <typename T>
-    std::vector<T> matrix_vector_product_CSR(CSRMatrix<T> m1, std::vector<T> v) {
-        std::vector<T> result(m1.numRows, 0.0);
-
+void ssor_apply_CSR(const CSRMatrix<T> &A,
+                    const std::vector<T> &diag,
+                    const std::vector<T> &r,
+                    std::vector<T> &z,
+                    const T omega)
+{
+    const size_t n = A.numRows;
+    z.resize(n);
+    // (D/omega + L) y = r
+    for (size_t i = 0; i < n; i++)
+    {
+        T sum = r[i];
+        for (size_t k = A.row_ptr[i]; k < A.row_ptr[i + 1]; k++)
+        {
+            if (A.col_ind[k] < i)
+            {
+                sum -= A.val[k] * z[A.col_ind[k]];
+            }
+        }
+        z[i] = sum * omega / diag[i];
+    }
+    // y = (2 - omega)/omega * (D/omega) y
+    for (size_t i = 0; i < n; i++)
+    {
+        z[i] *= (2.0 - omega) / omega * diag[i] / omega;
+    }
+    // (D/omega + U) z = y
+    for (size_t step = 0; step < n; step++)
+    {
+        const size_t i = n - 1 - step;
+        T sum = z[i];
+        for (size_t k = A.row_ptr[i]; k < A.row_ptr[i + 1]; k++)
+        {
+            if (A.col_ind[k] > i)
+            {
+                sum -= A.val[k] * z[A.col_ind[k]];
+            }
+        }
+        z[i] = sum * omega / diag[i];
+    }
+}
+
+/**
+ * @brief Builds an SSOR preconditioner for A. The returned object keeps a reference
+ * to A, so A must outlive it.
+ *
+ * @tparam T
+ * @param A
+ * @param omega relaxation parameter (0 < omega < 2)
+ * @return PreconditionerCSR<T>
+ */
+template <typename T>
+PreconditionerCSR<T> make_ssor_preconditioner_CSR(const CSRMatrix<T> &A, const T omega)
+{
+    std::vector<T> diag = diagonal_CSR(A);
+    for (size_t i = 0; i < A.numRows; i++)
+    {
+        if (diag[i] == 0)
+        {
+            throw std::invalid_argument("SSOR requires a nonzero diagonal.");
+        }
+    }
+    return [&A, diag, omega](const std::vector<T> &r, std::vector<T> &z)
+    {
+        ssor_apply_CSR(A, diag, r, z, omega);
+    };
+}
+
+
+/**
+ * @brief 
+ * 
+ * @tparam T 
+ * @param m1 
+ */
+template <typename T> 
+    void lu_decomposition_CSR(const CSRMatrix<T> &m1) {
+        int n = m1.row_ptr.size() - 1;
+        CSRMatrix<T> L;
+        L.val = m1.vals;
+        L.row_ptr = m1.row_ptr;
+        L.col_ind = m1.col_ind;
+        CSRMatrix<T> U;
+        U.val = m1.val;
+        U.row_ptr = m1.row_ptr;
+        U.col_ind = m1.col_ind;
+
+        for (int i = 0; i < n; ++i) {
+            L.val.at(L.row_ptr[i]) = 1.0;   
+        }
+    }
+
+/**
+ * @brief Matrix-vector product function
+ * 
+ * @tparam T 
+ * @param m1 
+ * @param v 
+ * @return std::vector<T> 
+ */
+template <typename T>
+    std::vector<T> matrix_vector_product_CSR(const CSRMatrix<T> &m1, const std::vector<T> &v) {
+        std::vector<T> result(m1.numRows, 0.0);
+
         for (size_t i = 0; i < m1.numRows; ++i) {
             size_t row_start = m1.row_ptr[i];
             size_t row_end = m1.row_ptr[i + 1];
@@ -738,6 +1144,41 @@ template <typename T>
         return result;
     }
 
+/**
+ * @brief Matrix-vector product y = A*x on raw storage, for vectors that are slices of a
+ * larger array (a block of basis vectors, for instance)
+ * 
+ * @tparam T 
+ * @param A 
+ * @param x A.numColumns entries
+ * @param y A.numRows entries, overwritten; must not overlap x
+ */
+template <typename T>
+    void matrix_vector_product_CSR(const CSRMatrix<T> &A, const T *x, T *y) {
+        for (size_t i = 0; i < A.numRows; ++i) {
+            T sum = 0.0;
+            for (size_t k = A.row_ptr[i]; k < A.row_ptr[i + 1]; ++k) {
+                sum += A.val[k] * x[A.col_ind[k]];
+            }
+            y[i] = sum;
+        }
+    }
+
+/**
+ * @brief Matrix-vector product y = A*x into a caller-owned vector, so solvers can
+ * reuse the same buffer every iteration instead of allocating a new result
+ * 
+ * @tparam T 
+ * @param A 
+ * @param x 
+ * @param y output, resized to A.numRows
+ */
+template <typename T>
+    void matrix_vector_product_CSR(const CSRMatrix<T> &A, const std::vector<T> &x, std::vector<T> &y) {
+        y.resize(A.numRows);
+        matrix_vector_product_CSR(A, x.data(), y.data());
+    }
+
 
 /**
  * @brief Vector dot products return the scalar
@@ -748,7 +1189,7 @@ template <typename T>
  * @return T 
  */
 template <typename T>
-    T vector_vector_product(std::vector<T> a, std::vector<T> b) {
+    T vector_vector_product(const std::vector<T> &a, const std::vector<T> &b) {
         T result = 0.0;
         size_t n = a.size();
         for (size_t i = 0; i < n; ++i) {
@@ -770,7 +1211,7 @@ template <typename T>
  * @return std::vector<T> 
  */
 template <typename T>
-    std::vector<T> vector_combination(std::vector<T> a, std::vector<T> b, double scalar1, double scalar2) {
+    std::vector<T> vector_combination(const std::vector<T> &a, const std::vector<T> &b, double scalar1, double scalar2) {
         size_t n = a.size();
         std::vector<T> result(n);
         for (size_t i = 0; i < n; ++i) {
@@ -789,7 +1230,7 @@ template <typename T>
  * @return T 
  */
 template <typename T>
-    T vector_inner_product(std::vector<T> &U, std::vector<T> &V )  {
+    T vector_inner_product(const std::vector<T> &U, const std::vector<T> &V )  {
         return inner_product( U.begin(), U.end(), V.begin(), 0.0 );
     }
 
@@ -801,7 +1242,7 @@ template <typename T>
  * @return T 
  */
 template <typename T>
-    T vector_norm(std::vector<T> a) {
+    T vector_norm(const std::vector<T> &a) {
         return std::sqrt(std::inner_product(a.begin(), a.end(), a.begin(), 0.0));
     }
 
@@ -819,8 +1260,8 @@ template <typename T>
  * @return std::vector<T> 
  */
 template <typename T>
-    std::vector<T> conjugate_gradient_CSR(CSRMatrix<T> A, 
-                                          std::vector<T> b, 
+    std::vector<T> conjugate_gradient_CSR(const CSRMatrix<T> &A, 
+                                          const std::vector<T> &b, 
                                           std::vector<T> x0, 
                                           int maxit, 
                                           double tol) {
@@ -852,3 +1293,2173 @@ template <typename T>
         return x;
 }
 
+/**
+ * @brief Convergence report filled in by the Krylov solvers when a pointer to one is
+ * passed: the number of iterations and the residual 2-norm after each of them,
+ * starting with the initial residual.
+ */
+class SolverInfo
+{
+public:
+    int iterations = 0;
+    bool converged = false;
+    vector<double> residuals;
+};
+
+/**
+ * @brief Preconditioned Conjugate Gradient for CSR. M is applied once per iteration
+ * (see make_ssor_preconditioner_CSR) and must be symmetric positive definite.
+ * 
+ * @tparam T 
+ * @param A symmetric positive definite matrix
+ * @param b 
+ * @param x0 initial guess
+ * @param maxit 
+ * @param tol tolerance on the 2-norm of the residual
+ * @param M the preconditioner
+ * @param info optional convergence report
+ * @return std::vector<T> 
+ */
+template <typename T>
+    std::vector<T> preconditioned_conjugate_gradient_CSR(const CSRMatrix<T> &A,
+                                                         const std::vector<T> &b,
+                                                         std::vector<T> x0,
+                                                         int maxit,
+                                                         double tol,
+                                                         const PreconditionerCSR<T> &M,
+                                                         SolverInfo *info = nullptr) {
+        const size_t n = b.size();
+        std::vector<T> &x = x0;
+        x.resize(n, 0.0);
+        std::vector<T> r(n), z(n), p(n), Ap(n);
+
+        matrix_vector_product_CSR(A, x, Ap);
+        for (size_t k = 0; k < n; ++k) {
+            r[k] = b[k] - Ap[k];
+        }
+        M(r, z);
+        p = z;
+        T rz = vector_inner_product(r, z);
+
+        T normR = std::sqrt(vector_inner_product(r, r));
+        if (info) {
+            info->residuals.assign(1, normR);
+        }
+        int i = 0;
+        while (i < maxit && normR >= tol) {
+            matrix_vector_product_CSR(A, p, Ap);
+            const T alpha = rz / vector_inner_product(p, Ap);
+            normR = 0.0;
+            for (size_t k = 0; k < n; ++k) {
+                x[k] += alpha * p[k];
+                r[k] -= alpha * Ap[k];
+                normR += r[k] * r[k];
+            }
+            normR = std::sqrt(normR);
+            if (info) {
+                info->residuals.push_back(normR);
+            }
+            M(r, z);
+            const T rz_new = vector_inner_product(r, z);
+            const T beta = rz_new / rz;
+            rz = rz_new;
+            for (size_t k = 0; k < n; ++k) {
+                p[k] = z[k] + beta * p[k];
+            }
+            i++;
+        }
+        if (info) {
+            info->iterations = i;
+            info->converged = normR < tol;
+        }
+        std::cerr << "PCG Iterations: " << i << std::endl;
+        return x;
+}
+
+/**
+ * @brief Rows [first, last) of one pipelined CG iteration: q = A w for the row, then
+ * z = q + beta z, s = w + beta s, p = r + beta p, x += alpha p, r -= alpha s and
+ * wNext = w - alpha z, and (r, r) and (wNext, r) are added to gamma and delta. The rows
+ * go in chunks: the SpMV of a chunk fills a small buffer, then the updates of the chunk
+ * run as one SIMD loop, which they could not with the row loop of the SpMV around them.
+ */
+template <typename T>
+    void pipelined_cg_rows(const CSRMatrix<T> &A, size_t first, size_t last, T alpha, T beta, const T *w, T *wNext,
+                           T *z, T *s, T *p, T *x, T *r, T &gamma, T &delta) {
+        constexpr size_t chunk = 256;
+        T q[chunk];
+        for (size_t k0 = first; k0 < last; k0 += chunk) {
+            const size_t len = std::min(chunk, last - k0);
+            for (size_t j = 0; j < len; ++j) {
+                T value = 0;
+                for (size_t e = A.row_ptr[k0 + j]; e < A.row_ptr[k0 + j + 1]; ++e) {
+                    value += A.val[e] * w[A.col_ind[e]];
+                }
+                q[j] = value;
+            }
+            T g = 0, d = 0;
+            SIMD_LOOP_REDUCTION(reduction(+ : g, d))
+            for (size_t j = 0; j < len; ++j) {
+                const size_t k = k0 + j;
+                z[k] = q[j] + beta * z[k];
+                s[k] = w[k] + beta * s[k];
+                p[k] = r[k] + beta * p[k];
+                x[k] += alpha * p[k];
+                r[k] -= alpha * s[k];
+                wNext[k] = w[k] - alpha * z[k];
+                g += r[k] * r[k];
+                d += wNext[k] * r[k];
+            }
+            gamma += g;
+            delta += d;
+        }
+    }
+
+/**
+ * @brief Pipelined Conjugate Gradient (Ghysels and Vanroose) for CSR. It is the same
+ * Krylov method as conjugate_gradient_CSR, but the recurrences are rearranged so that
+ * alpha and beta only depend on the inner products (r, r) and (Ar, r) of the previous
+ * iteration. An iteration is then a single pass over the rows, pipelined_cg_rows: the
+ * SpMV q = A w, the six vector updates and the two inner products of the new r and w
+ * together. w is double buffered since the SpMV still reads the old one. Plain CG
+ * needs three passes with two reductions. The recursively updated residual can drift from the true
+ * one, so convergence is confirmed with b - Ax and the recurrences are restarted from
+ * the true residual if needed.
+ *
+ * @tparam T
+ * @param A symmetric positive definite matrix
+ * @param b
+ * @param x0 initial guess
+ * @param maxit
+ * @param tol tolerance on the 2-norm of the residual
+ * @param info optional convergence report
+ * @return std::vector<T>
+ */
+template <typename T>
+    std::vector<T> pipelined_conjugate_gradient_CSR(const CSRMatrix<T> &A,
+                                                    const std::vector<T> &b,
+                                                    std::vector<T> x0,
+                                                    int maxit,
+                                                    double tol,
+                                                    SolverInfo *info = nullptr) {
+        const size_t n = b.size();
+        std::vector<T> &x = x0;
+        x.resize(n, 0.0);
+        std::vector<T> r(n), w(n), wNext(n), z(n), s(n), p(n);
+        T gamma = 0, delta = 0, gammaOld = 0, alphaOld = 0;
+        bool restart = true;
+
+        // r = b - Ax, w = Ar and the two inner products for the first iteration
+        auto start = [&]() {
+            matrix_vector_product_CSR(A, x, wNext);
+            for (size_t k = 0; k < n; ++k) {
+                r[k] = b[k] - wNext[k];
+            }
+            matrix_vector_product_CSR(A, r, w);
+            gamma = 0;
+            delta = 0;
+            for (size_t k = 0; k < n; ++k) {
+                gamma += r[k] * r[k];
+                delta += w[k] * r[k];
+            }
+            restart = true;
+        };
+        start();
+        T normR = std::sqrt(gamma);
+        if (info) {
+            info->residuals.assign(1, normR);
+        }
+        int i = 0;
+        while (i < maxit) {
+            if (normR < tol) {
+                // confirm with the true residual
+                start();
+                normR = std::sqrt(gamma);
+                if (normR < tol) {
+                    break;
+                }
+            }
+            T alpha, beta;
+            if (restart) {
+                beta = 0;
+                alpha = gamma / delta;
+                restart = false;
+            } else {
+                beta = gamma / gammaOld;
+                alpha = gamma / (delta - beta * gamma / alphaOld);
+            }
+            gammaOld = gamma;
+            alphaOld = alpha;
+            gamma = 0;
+            delta = 0;
+            pipelined_cg_rows(A, 0, n, alpha, beta, w.data(), wNext.data(), z.data(), s.data(), p.data(), x.data(),
+                              r.data(), gamma, delta);
+            w.swap(wNext);
+            normR = std::sqrt(gamma);
+            if (info) {
+                info->residuals.push_back(normR);
+            }
+            i++;
+        }
+        if (info) {
+            info->iterations = i;
+            info->converged = normR < tol;
+        }
+        std::cerr << "Pipelined CG Iterations: " << i << std::endl;
+        return x;
+}
+
+/**
+ * @brief Helpers for s-step CG: the Krylov basis V of one outer step, stored column by
+ * column, is [p, Ap, ..., A^s p, r, Ar, ..., A^(s-1) r] with every power of A scaled
+ * by 1/theta to keep the columns of similar size. Multiplying by A maps column c to
+ * column c + 1 times theta, except for the last column of each block.
+ */
+template <typename T>
+    void s_step_basis_multiply(const std::vector<T> &v, std::vector<T> &out, int s, T theta) {
+        const int m = 2 * s + 1;
+        out.assign(m, 0.0);
+        for (int c = 0; c < m - 1; c++) {
+            if (c != s) {
+                out[c + 1] += theta * v[c];
+            }
+        }
+}
+
+/// @brief u^T G v for the (2s+1) x (2s+1) Gram matrix G of the s-step basis
+template <typename T>
+    T s_step_gram_product(const std::vector<T> &G, const std::vector<T> &u, const std::vector<T> &v) {
+        const size_t m = u.size();
+        T sum = 0;
+        for (size_t a = 0; a < m; a++) {
+            T row = 0;
+            for (size_t c = 0; c < m; c++) {
+                row += G[a * m + c] * v[c];
+            }
+            sum += u[a] * row;
+        }
+        return sum;
+}
+
+/**
+ * @brief Runs up to min(s, maxSteps) CG iterations in the coordinates of the s-step
+ * basis. G is the Gram matrix V^T V, so every inner product is a small dense product
+ * instead of a reduction over the whole vector. On return xc, rc and pc hold the coordinates of
+ * the updates; the number of iterations done is returned (fewer than s when the
+ * estimated residual norm drops below tol or the basis lost positive definiteness).
+ */
+template <typename T>
+    int s_step_inner_iterations(const std::vector<T> &G, int s, int maxSteps, T theta, double tol,
+                                std::vector<T> &xc, std::vector<T> &rc, std::vector<T> &pc,
+                                T &normR, SolverInfo *info) {
+        const int m = 2 * s + 1;
+        xc.assign(m, 0.0);
+        rc.assign(m, 0.0);
+        pc.assign(m, 0.0);
+        pc[0] = 1.0;
+        rc[s + 1] = 1.0;
+        std::vector<T> Bp;
+        T rr = s_step_gram_product(G, rc, rc);
+        int j = 0;
+        for (; j < std::min(s, maxSteps); j++) {
+            s_step_basis_multiply(pc, Bp, s, theta);
+            const T pAp = s_step_gram_product(G, pc, Bp);
+            if (!(pAp > 0)) {
+                break;
+            }
+            const T alpha = rr / pAp;
+            for (int c = 0; c < m; c++) {
+                xc[c] += alpha * pc[c];
+                rc[c] -= alpha * Bp[c];
+            }
+            const T rrNew = s_step_gram_product(G, rc, rc);
+            normR = std::sqrt(std::abs(rrNew));
+            if (info) {
+                info->residuals.push_back(normR);
+            }
+            if (normR < tol) {
+                j++;
+                break;
+            }
+            const T beta = rrNew / rr;
+            rr = rrNew;
+            for (int c = 0; c < m; c++) {
+                pc[c] = rc[c] + beta * pc[c];
+            }
+        }
+        return j;
+}
+
+/**
+ * @brief s-step (communication avoiding) Conjugate Gradient for CSR. Each outer step
+ * builds the Krylov basis [p, .., A^s p, r, .., A^(s-1) r] with 2s - 1 SpMVs, computes
+ * all inner products between basis vectors in one pass (the Gram matrix), and then runs
+ * s CG iterations on small vectors of length 2s + 1. That is one reduction every s
+ * iterations instead of two per iteration. The monomial basis gets ill conditioned as
+ * s grows, so s between 2 and 5 is sensible. Convergence is confirmed with the true
+ * residual b - Ax.
+ *
+ * Fewer reductions are paid for with more arithmetic. Per iteration it does about 2
+ * SpMVs where CG does 1, plus (2s + 1)(2s + 2) / 2 inner products for the Gram matrix
+ * and 3 (2s + 1) multiply-adds per row for the update, every s iterations, so about
+ * 2 SpMVs and 18 vector operations per iteration for s = 4 against 1 SpMV and 5 for CG.
+ * On one machine a reduction is cheap and this is 2 to 3 times slower than CG; it only
+ * pays off where a global reduction costs more than that, across many nodes.
+ *
+ * @tparam T
+ * @param A symmetric positive definite matrix
+ * @param b
+ * @param x0 initial guess
+ * @param s iterations per outer step
+ * @param maxit maximum number of (inner) iterations
+ * @param tol tolerance on the 2-norm of the residual
+ * @param info optional convergence report
+ * @return std::vector<T>
+ */
+template <typename T>
+    std::vector<T> s_step_conjugate_gradient_CSR(const CSRMatrix<T> &A,
+                                                 const std::vector<T> &b,
+                                                 std::vector<T> x0,
+                                                 int s,
+                                                 int maxit,
+                                                 double tol,
+                                                 SolverInfo *info = nullptr) {
+        if (s < 1) {
+            throw std::invalid_argument("s-step CG needs s >= 1.");
+        }
+        const size_t n = b.size();
+        const int m = 2 * s + 1;
+        std::vector<T> &x = x0;
+        x.resize(n, 0.0);
+        std::vector<T> r(n), p(n), V(m * n), G(m * m), xc, rc, pc;
+
+        // scale the powers of A by half the infinity norm, a bound on the spectral radius
+        T theta = 0;
+        for (size_t k = 0; k < A.numRows; ++k) {
+            T rowSum = 0;
+            for (size_t e = A.row_ptr[k]; e < A.row_ptr[k + 1]; ++e) {
+                rowSum += std::abs(A.val[e]);
+            }
+            theta = std::max(theta, rowSum);
+        }
+        theta /= 2.0;
+        auto trueResidual = [&]() {
+            matrix_vector_product_CSR(A, x, r);
+            T norm = 0;
+            for (size_t k = 0; k < n; ++k) {
+                r[k] = b[k] - r[k];
+                norm += r[k] * r[k];
+            }
+            p = r;
+            return std::sqrt(norm);
+        };
+        T normR = trueResidual();
+        if (info) {
+            info->residuals.assign(1, normR);
+        }
+        int i = 0;
+        while (i < maxit && normR >= tol) {
+            // Krylov basis, each vector the SpMV of the previous one read in place,
+            // then all inner products in one pass
+            std::copy(p.begin(), p.end(), V.begin());
+            std::copy(r.begin(), r.end(), V.begin() + (s + 1) * n);
+            for (int c = 0; c < m - 1; c++) {
+                if (c == s) {
+                    continue;
+                }
+                T *column = V.data() + (c + 1) * n;
+                matrix_vector_product_CSR(A, V.data() + c * n, column);
+                for (size_t k = 0; k < n; ++k) {
+                    column[k] /= theta;
+                }
+            }
+            std::fill(G.begin(), G.end(), 0.0);
+            for (size_t k = 0; k < n; ++k) {
+                for (int a = 0; a < m; a++) {
+                    const T va = V[a * n + k];
+                    for (int c = a; c < m; c++) {
+                        G[a * m + c] += va * V[c * n + k];
+                    }
+                }
+            }
+            for (int a = 0; a < m; a++) {
+                for (int c = 0; c < a; c++) {
+                    G[a * m + c] = G[c * m + a];
+                }
+            }
+
+            const int steps = s_step_inner_iterations(G, s, maxit - i, theta, tol, xc, rc, pc, normR, info);
+            if (steps == 0) {
+                throw std::runtime_error("s-step CG basis is not positive definite, use a smaller s.");
+            }
+            i += steps;
+            std::fill(r.begin(), r.end(), 0.0);
+            std::fill(p.begin(), p.end(), 0.0);
+            for (int c = 0; c < m; c++) {
+                const T *v = V.data() + c * n;
+                for (size_t k = 0; k < n; ++k) {
+                    x[k] += xc[c] * v[k];
+                    r[k] += rc[c] * v[k];
+                    p[k] += pc[c] * v[k];
+                }
+            }
+            if (normR < tol) {
+                // confirm with the true residual, restart from it otherwise
+                normR = trueResidual();
+                if (info) {
+                    info->residuals.back() = normR;
+                }
+            }
+        }
+        if (info) {
+            info->iterations = i;
+            info->converged = normR < tol;
+        }
+        std::cerr << "s-step CG Iterations: " << i << std::endl;
+        return x;
+}
+
+
+/**
+ * @brief Restarted GMRES(m) for general (nonsymmetric) CSR systems.
+ * Arnoldi uses modified Gram-Schmidt and the least squares problem is updated with
+ * Givens rotations, so the residual norm is known every iteration without forming x.
+ * Preconditioning is on the right, A M^-1 u = b with x = M^-1 u, so the reported
+ * residual is the true residual of Ax = b.
+ * Each iteration costs one SpMV (plus one preconditioner apply) and O(mn) work, and
+ * the workspace is fixed at m+1 basis vectors.
+ * 
+ * @tparam T 
+ * @param A 
+ * @param b 
+ * @param x0 initial guess
+ * @param restart m, the number of basis vectors kept before restarting
+ * @param maxit maximum total number of iterations
+ * @param tol tolerance on the 2-norm of the residual
+ * @param M optional right preconditioner
+ * @param info optional convergence report
+ * @return std::vector<T> 
+ */
+template <typename T>
+    std::vector<T> gmres_CSR(const CSRMatrix<T> &A,
+                             const std::vector<T> &b,
+                             std::vector<T> x0,
+                             int restart,
+                             int maxit,
+                             double tol,
+                             const PreconditionerCSR<T> &M = nullptr,
+                             SolverInfo *info = nullptr) {
+        if (A.numRows != A.numColumns || A.numRows != b.size()) {
+            throw std::invalid_argument("GMRES needs a square matrix matching the size of b.");
+        }
+        if (restart < 1) {
+            throw std::invalid_argument("The GMRES restart length must be at least 1.");
+        }
+        const size_t n = b.size();
+        const size_t m = static_cast<size_t>(restart);
+        std::vector<T> &x = x0;
+        x.resize(n, 0.0);
+
+        // Krylov basis V (m+1 vectors of length n, stored back to back) and the
+        // Hessenberg matrix H stored column by column with leading dimension m+1
+        std::vector<T> V((m + 1) * n);
+        std::vector<T> H((m + 1) * m);
+        std::vector<T> cs(m), sn(m), g(m + 1), y(m);
+        std::vector<T> r(n), w(n), z(n);
+
+        int total = 0;
+        bool converged = false;
+        if (info) {
+            info->residuals.clear();
+        }
+        while (true) {
+            // r = b - A x
+            matrix_vector_product_CSR(A, x, w);
+            T beta = 0.0;
+            for (size_t k = 0; k < n; ++k) {
+                r[k] = b[k] - w[k];
+                beta += r[k] * r[k];
+            }
+            beta = std::sqrt(beta);
+            if (info && total == 0) {
+                info->residuals.push_back(beta);
+            }
+            if (beta < tol) {
+                converged = true;
+                break;
+            }
+            if (total >= maxit) {
+                break;
+            }
+            for (size_t k = 0; k < n; ++k) {
+                V[k] = r[k] / beta;
+            }
+            std::fill(g.begin(), g.end(), 0.0);
+            g[0] = beta;
+
+            size_t j = 0;
+            bool done = false;
+            while (j < m && total < maxit && !done) {
+                T *vj = &V[j * n];
+                // w = A M^-1 v_j
+                if (M) {
+                    std::vector<T> &in = r;
+                    std::copy(vj, vj + n, in.begin());
+                    M(in, z);
+                    matrix_vector_product_CSR(A, z, w);
+                } else {
+                    std::copy(vj, vj + n, z.begin());
+                    matrix_vector_product_CSR(A, z, w);
+                }
+                // modified Gram-Schmidt against v_0..v_j
+                for (size_t i = 0; i <= j; ++i) {
+                    const T *vi = &V[i * n];
+                    T h = 0.0;
+                    for (size_t k = 0; k < n; ++k) {
+                        h += w[k] * vi[k];
+                    }
+                    H[i + j * (m + 1)] = h;
+                    for (size_t k = 0; k < n; ++k) {
+                        w[k] -= h * vi[k];
+                    }
+                }
+                T hNext = 0.0;
+                for (size_t k = 0; k < n; ++k) {
+                    hNext += w[k] * w[k];
+                }
+                hNext = std::sqrt(hNext);
+                H[j + 1 + j * (m + 1)] = hNext;
+                if (hNext != 0) {
+                    T *vNext = &V[(j + 1) * n];
+                    for (size_t k = 0; k < n; ++k) {
+                        vNext[k] = w[k] / hNext;
+                    }
+                }
+                // apply the previous rotations to the new column, then eliminate H(j+1, j)
+                T *hj = &H[j * (m + 1)];
+                for (size_t i = 0; i < j; ++i) {
+                    const T temp = cs[i] * hj[i] + sn[i] * hj[i + 1];
+                    hj[i + 1] = -sn[i] * hj[i] + cs[i] * hj[i + 1];
+                    hj[i] = temp;
+                }
+                const T denom = std::hypot(hj[j], hj[j + 1]);
+                cs[j] = denom == 0 ? 1.0 : hj[j] / denom;
+                sn[j] = denom == 0 ? 0.0 : hj[j + 1] / denom;
+                hj[j] = denom;
+                hj[j + 1] = 0.0;
+                g[j + 1] = -sn[j] * g[j];
+                g[j] = cs[j] * g[j];
+
+                total++;
+                j++;
+                const T residual = std::abs(g[j]);
+                if (info) {
+                    info->residuals.push_back(residual);
+                }
+                // a zero hNext is a lucky breakdown: the Krylov space holds the solution
+                done = residual < tol || hNext == 0;
+            }
+
+            // solve the j x j upper triangular system H y = g
+            for (size_t i = j; i-- > 0;) {
+                T sum = g[i];
+                for (size_t k = i + 1; k < j; ++k) {
+                    sum -= H[i + k * (m + 1)] * y[k];
+                }
+                y[i] = sum / H[i + i * (m + 1)];
+            }
+            // x += M^-1 (V y)
+            std::fill(w.begin(), w.end(), 0.0);
+            for (size_t i = 0; i < j; ++i) {
+                const T *vi = &V[i * n];
+                for (size_t k = 0; k < n; ++k) {
+                    w[k] += y[i] * vi[k];
+                }
+            }
+            if (M) {
+                M(w, z);
+            } else {
+                z.swap(w);
+            }
+            for (size_t k = 0; k < n; ++k) {
+                x[k] += z[k];
+            }
+        }
+        if (info) {
+            info->iterations = total;
+            info->converged = converged;
+        }
+        std::cerr << "GMRES Iterations: " << total << std::endl;
+        return x;
+}
+
+/**
+ * @brief Applies M^-1 to r, or copies r when there is no preconditioner
+ */
+template <typename T>
+    void apply_preconditioner_CSR(const PreconditionerCSR<T> &M, const std::vector<T> &r, std::vector<T> &z) {
+        if (M) {
+            M(r, z);
+        } else {
+            z.assign(r.begin(), r.end());
+        }
+    }
+
+/**
+ * @brief BiCGSTAB for general (nonsymmetric) CSR systems, right preconditioned.
+ * Uses a fixed workspace of eight vectors, two SpMVs per iteration, and fuses the
+ * vector updates with the dot products/norms that follow them.
+ * 
+ * @tparam T 
+ * @param A 
+ * @param b 
+ * @param x0 initial guess
+ * @param maxit 
+ * @param tol tolerance on the 2-norm of the residual
+ * @param M optional right preconditioner
+ * @param info optional convergence report
+ * @return std::vector<T> 
+ */
+template <typename T>
+    std::vector<T> bicgstab_CSR(const CSRMatrix<T> &A,
+                                const std::vector<T> &b,
+                                std::vector<T> x0,
+                                int maxit,
+                                double tol,
+                                const PreconditionerCSR<T> &M = nullptr,
+                                SolverInfo *info = nullptr) {
+        const size_t n = b.size();
+        std::vector<T> &x = x0;
+        x.resize(n, 0.0);
+        std::vector<T> r(n), rHat(n), p(n, 0.0), v(n, 0.0), s(n), t(n), pHat(n), sHat(n);
+
+        matrix_vector_product_CSR(A, x, t);
+        T normR = 0.0;
+        for (size_t k = 0; k < n; ++k) {
+            r[k] = b[k] - t[k];
+            rHat[k] = r[k];
+            normR += r[k] * r[k];
+        }
+        normR = std::sqrt(normR);
+        if (info) {
+            info->residuals.assign(1, normR);
+        }
+
+        T rho = 1.0, alpha = 1.0, omega = 1.0;
+        int i = 0;
+        while (i < maxit && normR >= tol) {
+            const T rhoNew = vector_inner_product(rHat, r);
+            if (rhoNew == 0) {
+                // breakdown, the shadow residual is orthogonal to r
+                break;
+            }
+            const T beta = (rhoNew / rho) * (alpha / omega);
+            for (size_t k = 0; k < n; ++k) {
+                p[k] = r[k] + beta * (p[k] - omega * v[k]);
+            }
+            apply_preconditioner_CSR(M, p, pHat);
+            matrix_vector_product_CSR(A, pHat, v);
+            alpha = rhoNew / vector_inner_product(rHat, v);
+
+            T normS = 0.0;
+            for (size_t k = 0; k < n; ++k) {
+                s[k] = r[k] - alpha * v[k];
+                normS += s[k] * s[k];
+            }
+            normS = std::sqrt(normS);
+            i++;
+            if (normS < tol) {
+                // s is already small enough, skip the stabilizing half step
+                for (size_t k = 0; k < n; ++k) {
+                    x[k] += alpha * pHat[k];
+                }
+                r.swap(s);
+                normR = normS;
+                if (info) {
+                    info->residuals.push_back(normR);
+                }
+            } else {
+                apply_preconditioner_CSR(M, s, sHat);
+                matrix_vector_product_CSR(A, sHat, t);
+                T ts = 0.0, tt = 0.0;
+                for (size_t k = 0; k < n; ++k) {
+                    ts += t[k] * s[k];
+                    tt += t[k] * t[k];
+                }
+                omega = ts / tt;
+
+                normR = 0.0;
+                for (size_t k = 0; k < n; ++k) {
+                    x[k] += alpha * pHat[k] + omega * sHat[k];
+                    r[k] = s[k] - omega * t[k];
+                    normR += r[k] * r[k];
+                }
+                normR = std::sqrt(normR);
+                rho = rhoNew;
+                if (info) {
+                    info->residuals.push_back(normR);
+                }
+                if (omega == 0) {
+                    break;
+                }
+            }
+            if (normR < tol) {
+                // the recursively updated r can drift away from b - Ax, so confirm with
+                // the true residual and restart from it if it has not converged yet
+                matrix_vector_product_CSR(A, x, t);
+                normR = 0.0;
+                for (size_t k = 0; k < n; ++k) {
+                    r[k] = b[k] - t[k];
+                    rHat[k] = r[k];
+                    p[k] = 0.0;
+                    v[k] = 0.0;
+                    normR += r[k] * r[k];
+                }
+                normR = std::sqrt(normR);
+                rho = alpha = omega = 1.0;
+            }
+        }
+        if (info) {
+            info->iterations = i;
+            info->converged = normR < tol;
+        }
+        std::cerr << "BiCGSTAB Iterations: " << i << std::endl;
+        return x;
+}
+
+/**
+ * @brief IDR(s) (induced dimension reduction, the biorthogonal variant of van Gijzen and
+ * Sonneveld) for general CSR systems, right preconditioned. Short recurrences like
+ * BiCGSTAB (IDR(1) is mathematically equivalent to it), but a larger shadow space s
+ * usually needs far fewer SpMVs on hard nonsymmetric problems. Workspace is 3s + 4
+ * vectors of length n regardless of the iteration count.
+ * 
+ * @tparam T 
+ * @param A 
+ * @param b 
+ * @param x0 initial guess
+ * @param s dimension of the shadow space (4 is a good default)
+ * @param maxit maximum number of SpMVs
+ * @param tol tolerance on the 2-norm of the residual
+ * @param M optional right preconditioner
+ * @param info optional convergence report, one residual per SpMV
+ * @return std::vector<T> 
+ */
+template <typename T>
+    std::vector<T> idrs_CSR(const CSRMatrix<T> &A,
+                            const std::vector<T> &b,
+                            std::vector<T> x0,
+                            int s,
+                            int maxit,
+                            double tol,
+                            const PreconditionerCSR<T> &M = nullptr,
+                            SolverInfo *info = nullptr) {
+        if (s < 1) {
+            throw std::invalid_argument("The IDR shadow space dimension must be at least 1.");
+        }
+        const size_t n = b.size();
+        const size_t ss = static_cast<size_t>(s);
+        std::vector<T> &x = x0;
+        x.resize(n, 0.0);
+
+        // P, G and U are n x s blocks stored column after column
+        std::vector<T> P(n * ss), G(n * ss, 0.0), U(n * ss, 0.0);
+        std::vector<T> Ms(ss * ss, 0.0), f(ss), c(ss);
+        std::vector<T> r(n), v(n), vHat(n), t(n);
+        for (size_t i = 0; i < ss; ++i) {
+            Ms[i + i * ss] = 1.0;
+        }
+
+        // random shadow space with orthonormal columns; fixed seed so runs are repeatable
+        std::mt19937 gen(0);
+        std::normal_distribution<double> dist(0.0, 1.0);
+        for (size_t j = 0; j < ss; ++j) {
+            T *pj = &P[j * n];
+            for (size_t k = 0; k < n; ++k) {
+                pj[k] = dist(gen);
+            }
+            for (size_t i = 0; i < j; ++i) {
+                const T *pi = &P[i * n];
+                T d = 0.0;
+                for (size_t k = 0; k < n; ++k) {
+                    d += pi[k] * pj[k];
+                }
+                for (size_t k = 0; k < n; ++k) {
+                    pj[k] -= d * pi[k];
+                }
+            }
+            T nrm = 0.0;
+            for (size_t k = 0; k < n; ++k) {
+                nrm += pj[k] * pj[k];
+            }
+            nrm = std::sqrt(nrm);
+            for (size_t k = 0; k < n; ++k) {
+                pj[k] /= nrm;
+            }
+        }
+
+        matrix_vector_product_CSR(A, x, t);
+        T normR = 0.0;
+        for (size_t k = 0; k < n; ++k) {
+            r[k] = b[k] - t[k];
+            normR += r[k] * r[k];
+        }
+        normR = std::sqrt(normR);
+        if (info) {
+            info->residuals.assign(1, normR);
+        }
+
+        // keeps |cos(t, r)| away from zero when choosing omega
+        const T angle = 0.7;
+        T om = 1.0;
+        int iter = 0;
+        bool breakdown = false;
+        while (normR >= tol && iter < maxit && !breakdown) {
+            // f = P^T r
+            for (size_t i = 0; i < ss; ++i) {
+                const T *pi = &P[i * n];
+                T d = 0.0;
+                for (size_t k = 0; k < n; ++k) {
+                    d += pi[k] * r[k];
+                }
+                f[i] = d;
+            }
+            for (size_t k = 0; k < ss; ++k) {
+                // solve the lower triangular system Ms(k:s, k:s) c = f(k:s)
+                for (size_t i = k; i < ss; ++i) {
+                    T sum = f[i];
+                    for (size_t j = k; j < i; ++j) {
+                        sum -= Ms[i + j * ss] * c[j];
+                    }
+                    c[i] = sum / Ms[i + i * ss];
+                }
+                // v = r - G(:, k:s) c
+                for (size_t q = 0; q < n; ++q) {
+                    T sum = r[q];
+                    for (size_t i = k; i < ss; ++i) {
+                        sum -= G[q + i * n] * c[i];
+                    }
+                    v[q] = sum;
+                }
+                apply_preconditioner_CSR(M, v, vHat);
+                // U(:, k) = U(:, k:s) c + om vHat, done in place since column k is read first
+                for (size_t q = 0; q < n; ++q) {
+                    T sum = om * vHat[q];
+                    for (size_t i = k; i < ss; ++i) {
+                        sum += U[q + i * n] * c[i];
+                    }
+                    U[q + k * n] = sum;
+                }
+                T *uk = &U[k * n];
+                T *gk = &G[k * n];
+                std::copy(uk, uk + n, v.begin());
+                matrix_vector_product_CSR(A, v, t);
+                std::copy(t.begin(), t.end(), gk);
+                // biorthogonalize the new G and U columns against p_0..p_{k-1}
+                for (size_t i = 0; i < k; ++i) {
+                    const T *pi = &P[i * n];
+                    T d = 0.0;
+                    for (size_t q = 0; q < n; ++q) {
+                        d += pi[q] * gk[q];
+                    }
+                    const T alpha = d / Ms[i + i * ss];
+                    const T *gi = &G[i * n];
+                    const T *ui = &U[i * n];
+                    for (size_t q = 0; q < n; ++q) {
+                        gk[q] -= alpha * gi[q];
+                        uk[q] -= alpha * ui[q];
+                    }
+                }
+                // new column of Ms
+                for (size_t i = k; i < ss; ++i) {
+                    const T *pi = &P[i * n];
+                    T d = 0.0;
+                    for (size_t q = 0; q < n; ++q) {
+                        d += pi[q] * gk[q];
+                    }
+                    Ms[i + k * ss] = d;
+                }
+                if (Ms[k + k * ss] == 0) {
+                    breakdown = true;
+                    break;
+                }
+                // make r orthogonal to p_0..p_k
+                const T beta = f[k] / Ms[k + k * ss];
+                normR = 0.0;
+                for (size_t q = 0; q < n; ++q) {
+                    r[q] -= beta * gk[q];
+                    x[q] += beta * uk[q];
+                    normR += r[q] * r[q];
+                }
+                normR = std::sqrt(normR);
+                iter++;
+                if (info) {
+                    info->residuals.push_back(normR);
+                }
+                if (normR < tol || iter >= maxit) {
+                    break;
+                }
+                for (size_t i = k + 1; i < ss; ++i) {
+                    f[i] -= beta * Ms[i + k * ss];
+                }
+            }
+            if (normR < tol || iter >= maxit || breakdown) {
+                break;
+            }
+
+            // enough vectors in G to take the step into the next subspace
+            apply_preconditioner_CSR(M, r, vHat);
+            matrix_vector_product_CSR(A, vHat, t);
+            T tr = 0.0, tt = 0.0;
+            for (size_t q = 0; q < n; ++q) {
+                tr += t[q] * r[q];
+                tt += t[q] * t[q];
+            }
+            om = tr / tt;
+            const T rho = std::abs(tr) / (std::sqrt(tt) * normR);
+            if (rho < angle) {
+                om *= angle / rho;
+            }
+            if (om == 0) {
+                break;
+            }
+            normR = 0.0;
+            for (size_t q = 0; q < n; ++q) {
+                x[q] += om * vHat[q];
+                r[q] -= om * t[q];
+                normR += r[q] * r[q];
+            }
+            normR = std::sqrt(normR);
+            iter++;
+            if (info) {
+                info->residuals.push_back(normR);
+            }
+        }
+        if (info) {
+            info->iterations = iter;
+            info->converged = normR < tol;
+        }
+        std::cerr << "IDR(" << s << ") Iterations: " << iter << std::endl;
+        return x;
+}
+
+/**
+ * @brief LU factorization with partial pivoting of a small dense row-major n x n
+ * matrix, in place. Used for the coarsest level of the multigrid solvers.
+ *
+ * @tparam T
+ * @param LU the matrix on input, L (unit diagonal, below) and U on output
+ * @param pivot output, row k was swapped with row pivot[k] at step k
+ * @param n
+ */
+template <typename T>
+void dense_lu_factor(std::vector<T> &LU, std::vector<size_t> &pivot, size_t n)
+{
+    pivot.resize(n);
+    for (size_t k = 0; k < n; k++)
+    {
+        size_t p = k;
+        for (size_t i = k + 1; i < n; i++)
+        {
+            if (std::abs(LU[i * n + k]) > std::abs(LU[p * n + k]))
+            {
+                p = i;
+            }
+        }
+        if (LU[p * n + k] == 0)
+        {
+            throw std::runtime_error("Singular matrix in dense LU factorization");
+        }
+        pivot[k] = p;
+        if (p != k)
+        {
+            std::swap_ranges(LU.begin() + k * n, LU.begin() + (k + 1) * n, LU.begin() + p * n);
+        }
+        for (size_t i = k + 1; i < n; i++)
+        {
+            const T factor = LU[i * n + k] / LU[k * n + k];
+            LU[i * n + k] = factor;
+            for (size_t j = k + 1; j < n; j++)
+            {
+                LU[i * n + j] -= factor * LU[k * n + j];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Solves with a factorization from dense_lu_factor, x is overwritten with
+ * the solution
+ */
+template <typename T>
+void dense_lu_solve(const std::vector<T> &LU, const std::vector<size_t> &pivot, std::vector<T> &x)
+{
+    const size_t n = pivot.size();
+    for (size_t k = 0; k < n; k++)
+    {
+        std::swap(x[k], x[pivot[k]]);
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t j = 0; j < i; j++)
+        {
+            x[i] -= LU[i * n + j] * x[j];
+        }
+    }
+    for (size_t i = n; i-- > 0;)
+    {
+        for (size_t j = i + 1; j < n; j++)
+        {
+            x[i] -= LU[i * n + j] * x[j];
+        }
+        x[i] /= LU[i * n + i];
+    }
+}
+
+/**
+ * @brief Estimates the extreme eigenvalues of D^-1 A for a symmetric matrix with a
+ * positive diagonal. Runs `steps` Lanczos steps on the similar matrix
+ * D^-1/2 A D^-1/2 and returns the extreme eigenvalues of the Lanczos tridiagonal,
+ * found by Sturm sequence bisection. The largest one is a slight underestimate and the
+ * smallest one an overestimate, so callers add their own safety margins.
+ *
+ * @tparam T
+ * @param A
+ * @param invDiag from inverse_diagonal_CSR
+ * @param steps number of Lanczos steps, about 10 is enough for the largest eigenvalue
+ * @return std::pair<T, T> (smallest, largest)
+ */
+template <typename T>
+std::pair<T, T> lanczos_eigenvalue_bounds_CSR(const CSRMatrix<T> &A, const std::vector<T> &invDiag, int steps)
+{
+    const size_t n = A.numRows;
+    std::vector<T> scale(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        if (invDiag[i] <= 0)
+        {
+            throw std::invalid_argument("Lanczos eigenvalue estimate needs a positive diagonal.");
+        }
+        scale[i] = std::sqrt(invDiag[i]);
+    }
+    std::vector<T> alpha, beta;
+    std::vector<T> v(n), vOld(n, 0.0), u(n), w(n);
+    // a deterministic start vector with components in every direction
+    T norm = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        v[i] = 1.0 + static_cast<T>((i * 7919) % 101) / 101.0;
+        norm += v[i] * v[i];
+    }
+    norm = std::sqrt(norm);
+    for (size_t i = 0; i < n; i++)
+    {
+        v[i] /= norm;
+    }
+    T b = 0;
+    for (int k = 0; k < steps && k < static_cast<int>(n); k++)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            u[i] = scale[i] * v[i];
+        }
+        matrix_vector_product_CSR(A, u, w);
+        T a = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            w[i] *= scale[i];
+            a += w[i] * v[i];
+        }
+        alpha.push_back(a);
+        T bNew = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            w[i] -= a * v[i] + b * vOld[i];
+            bNew += w[i] * w[i];
+        }
+        bNew = std::sqrt(bNew);
+        if (bNew <= 1e-12 * std::abs(a))
+        {
+            // invariant subspace, the Ritz values are exact
+            break;
+        }
+        beta.push_back(bNew);
+        for (size_t i = 0; i < n; i++)
+        {
+            vOld[i] = v[i];
+            v[i] = w[i] / bNew;
+        }
+        b = bNew;
+    }
+    const size_t m = alpha.size();
+
+    // Gershgorin interval of the tridiagonal, then bisection on the Sturm count
+    T lo = alpha[0], hi = alpha[0];
+    for (size_t i = 0; i < m; i++)
+    {
+        const T radius = (i > 0 ? std::abs(beta[i - 1]) : 0) + (i + 1 < m ? std::abs(beta[i]) : 0);
+        lo = std::min(lo, alpha[i] - radius);
+        hi = std::max(hi, alpha[i] + radius);
+    }
+    // number of eigenvalues of the tridiagonal below x
+    auto countBelow = [&](T x)
+    {
+        size_t count = 0;
+        T q = 1;
+        for (size_t i = 0; i < m; i++)
+        {
+            const T offDiag = i > 0 ? beta[i - 1] * beta[i - 1] : 0;
+            q = alpha[i] - x - (i > 0 ? offDiag / q : 0);
+            if (q == 0)
+            {
+                q = 1e-300;
+            }
+            if (q < 0)
+            {
+                count++;
+            }
+        }
+        return count;
+    };
+    auto bisect = [&](size_t index)
+    {
+        T a = lo, c = hi;
+        for (int it = 0; it < 100 && c - a > 1e-10 * (std::abs(a) + std::abs(c)); it++)
+        {
+            const T mid = (a + c) / 2;
+            if (countBelow(mid) > index)
+            {
+                c = mid;
+            }
+            else
+            {
+                a = mid;
+            }
+        }
+        return (a + c) / 2;
+    };
+    return {bisect(0), bisect(m - 1)};
+}
+
+/// @brief Setup for Chebyshev iteration on D^-1 A over the interval [lower, upper]. The
+/// work vectors are reused by every application, so one object must not be shared
+/// between threads.
+template <typename T>
+class ChebyshevCSR
+{
+public:
+    std::vector<T> invDiag;
+    T lower = 0;
+    T upper = 0;
+    int degree = 3;
+    mutable std::vector<T> r, d, w;
+};
+
+/**
+ * @brief Estimates the spectrum of D^-1 A with Lanczos and prepares a Chebyshev
+ * iteration. The upper bound gets a 10% margin. With ratio > 0 the interval is
+ * [upper / ratio, upper]: a multigrid smoother only has to damp that upper part of the
+ * spectrum, and a low degree polynomial preconditioner does much better on it than on
+ * the whole spectrum. With ratio == 0 the estimated smallest eigenvalue is used, which
+ * the stand-alone solver needs to converge.
+ *
+ * @tparam T
+ * @param A symmetric positive definite matrix
+ * @param degree number of Chebyshev steps per application
+ * @param ratio see above
+ * @param lanczosSteps
+ * @return ChebyshevCSR<T>
+ */
+template <typename T>
+ChebyshevCSR<T> chebyshev_setup_CSR(const CSRMatrix<T> &A, int degree, T ratio = 0, int lanczosSteps = 10)
+{
+    if (A.numRows != A.numColumns)
+    {
+        throw std::invalid_argument("Chebyshev iteration needs a square matrix.");
+    }
+    if (degree < 1)
+    {
+        throw std::invalid_argument("Chebyshev degree must be at least 1.");
+    }
+    ChebyshevCSR<T> C;
+    C.invDiag = inverse_diagonal_CSR(A);
+    const std::pair<T, T> bounds = lanczos_eigenvalue_bounds_CSR(A, C.invDiag, lanczosSteps);
+    C.upper = 1.1 * bounds.second;
+    C.lower = ratio > 0 ? C.upper / ratio : bounds.first;
+    if (C.lower <= 0 || C.lower >= C.upper)
+    {
+        throw std::invalid_argument("Chebyshev iteration needs a positive definite matrix.");
+    }
+    C.degree = degree;
+    C.r.resize(A.numRows);
+    C.d.resize(A.numRows);
+    C.w.resize(A.numRows);
+    return C;
+}
+
+/**
+ * @brief Applies C.degree Chebyshev steps to x for the system Ax = b. Only SpMV and
+ * vector updates are used: each step is one product A d followed by one fused loop
+ * that updates x, the residual and the next direction.
+ *
+ * @tparam T
+ * @param A
+ * @param C from chebyshev_setup_CSR
+ * @param b
+ * @param x initial guess on input, improved on output
+ */
+template <typename T>
+void chebyshev_smooth_CSR(const CSRMatrix<T> &A, const ChebyshevCSR<T> &C, const std::vector<T> &b, std::vector<T> &x)
+{
+    const size_t n = A.numRows;
+    const T theta = (C.upper + C.lower) / 2.0;
+    const T delta = (C.upper - C.lower) / 2.0;
+    const T sigma = theta / delta;
+    std::vector<T> &r = C.r, &d = C.d, &w = C.w;
+    matrix_vector_product_CSR(A, x, r);
+    for (size_t i = 0; i < n; i++)
+    {
+        r[i] = b[i] - r[i];
+        d[i] = C.invDiag[i] * r[i] / theta;
+    }
+    T rho = 1.0 / sigma;
+    for (int k = 0; k < C.degree; k++)
+    {
+        if (k + 1 == C.degree)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                x[i] += d[i];
+            }
+            break;
+        }
+        matrix_vector_product_CSR(A, d, w);
+        const T rhoNew = 1.0 / (2.0 * sigma - rho);
+        for (size_t i = 0; i < n; i++)
+        {
+            x[i] += d[i];
+            r[i] -= w[i];
+            d[i] = rhoNew * rho * d[i] + 2.0 * rhoNew / delta * C.invDiag[i] * r[i];
+        }
+        rho = rhoNew;
+    }
+}
+
+/**
+ * @brief Solves Ax = b with Chebyshev iteration. Apart from the setup there are no
+ * inner products; the residual norm is only computed every `checkEvery` steps.
+ *
+ * @tparam T
+ * @param A symmetric positive definite matrix
+ * @param b
+ * @param x0
+ * @param maxit maximum number of Chebyshev steps
+ * @param tol tolerance on the 2-norm of the residual
+ * @param checkEvery steps between convergence checks
+ * @param info optional convergence report
+ * @return std::vector<T>
+ */
+template <typename T>
+std::vector<T> chebyshev_iteration_CSR(const CSRMatrix<T> &A, const std::vector<T> &b, std::vector<T> x0, int maxit,
+                                       double tol, const int checkEvery = 10, SolverInfo *info = nullptr)
+{
+    ChebyshevCSR<T> C = chebyshev_setup_CSR<T>(A, checkEvery, 0);
+    std::vector<T> &x = x0;
+    std::vector<T> r(A.numRows);
+    auto residualNorm = [&]()
+    {
+        matrix_vector_product_CSR(A, x, r);
+        T norm = 0;
+        for (size_t i = 0; i < r.size(); i++)
+        {
+            norm += (b[i] - r[i]) * (b[i] - r[i]);
+        }
+        return std::sqrt(norm);
+    };
+    T normR = residualNorm();
+    if (info)
+    {
+        info->residuals.assign(1, normR);
+    }
+    int it = 0;
+    while (it < maxit && normR >= tol)
+    {
+        // restarting the recurrence every checkEvery steps keeps it cheap to monitor
+        C.degree = std::min(checkEvery, maxit - it);
+        chebyshev_smooth_CSR(A, C, b, x);
+        it += C.degree;
+        normR = residualNorm();
+        if (info)
+        {
+            info->residuals.push_back(normR);
+        }
+    }
+    if (info)
+    {
+        info->iterations = it;
+        info->converged = normR < tol;
+    }
+    std::cerr << "Chebyshev Iterations: " << it << std::endl;
+    return x;
+}
+
+/**
+ * @brief Polynomial preconditioner z = p(D^-1 A) D^-1 r, i.e. C.degree Chebyshev steps
+ * from a zero guess. It is symmetric for symmetric A, so it can be used with
+ * preconditioned_conjugate_gradient_CSR. The setup is copied into the preconditioner;
+ * A must outlive it.
+ *
+ * @tparam T
+ * @param A
+ * @param C from chebyshev_setup_CSR
+ * @return PreconditionerCSR<T>
+ */
+template <typename T>
+PreconditionerCSR<T> make_chebyshev_preconditioner_CSR(const CSRMatrix<T> &A, const ChebyshevCSR<T> &C)
+{
+    return [&A, C](const std::vector<T> &r, std::vector<T> &z)
+    {
+        z.assign(r.size(), 0.0);
+        chebyshev_smooth_CSR(A, C, r, z);
+    };
+}
+
+/**
+ * @brief A dense n x k block of vectors, e.g. k right hand sides, stored row-major:
+ * entry (i, j) is val[i * numColumns + j], so the k values of a row are contiguous.
+ */
+template <typename T>
+class DenseBlock
+{
+public:
+    size_t numRows = 0;
+    size_t numColumns = 0;
+    std::vector<T> val;
+
+    DenseBlock() {}
+    DenseBlock(size_t rows, size_t columns, T value = 0) : numRows(rows), numColumns(columns), val(rows * columns, value) {}
+    T &operator()(size_t i, size_t j) { return val[i * numColumns + j]; }
+    const T &operator()(size_t i, size_t j) const { return val[i * numColumns + j]; }
+};
+
+/**
+ * @brief A dense n x k block stored column-major: entry (i, j) is val[j * numRows + i],
+ * so every column is a contiguous vector, the layout of BLAS and LAPACK.
+ */
+template <typename T>
+class ColumnMajorBlock
+{
+public:
+    size_t numRows = 0;
+    size_t numColumns = 0;
+    std::vector<T> val;
+
+    ColumnMajorBlock() {}
+    ColumnMajorBlock(size_t rows, size_t columns, T value = 0) : numRows(rows), numColumns(columns), val(rows * columns, value) {}
+    T &operator()(size_t i, size_t j) { return val[j * numRows + i]; }
+    const T &operator()(size_t i, size_t j) const { return val[j * numRows + i]; }
+};
+
+/**
+ * @brief Row i of Y = A X for the W columns starting at j0. The W partial sums live in
+ * a fixed size local array, and the loop over them is a SIMD_LOOP across the columns
+ * of the block; each nonzero of the row is loaded once for all W columns.
+ * Element (r, j) of X is X[r * ldx + j] in row-major and X[j * ldx + r] in column-major
+ * layout, the same for Y.
+ */
+template <typename T, size_t W, bool ColumnMajor>
+inline void spmm_tile_CSR(const CSRMatrix<T> &A, const T *X, size_t ldx, T *Y, size_t ldy, size_t i, size_t j0)
+{
+    T acc[W] = {};
+    for (size_t e = A.row_ptr[i]; e < A.row_ptr[i + 1]; e++)
+    {
+        const T a = A.val[e];
+        const size_t c = A.col_ind[e];
+        SIMD_LOOP
+        for (size_t jj = 0; jj < W; jj++)
+        {
+            acc[jj] += a * (ColumnMajor ? X[(j0 + jj) * ldx + c] : X[c * ldx + j0 + jj]);
+        }
+    }
+    SIMD_LOOP
+    for (size_t jj = 0; jj < W; jj++)
+    {
+        (ColumnMajor ? Y[(j0 + jj) * ldy + i] : Y[i * ldy + j0 + jj]) = acc[jj];
+    }
+}
+
+/// @brief Rows [rowBegin, rowEnd) of Y = A X for a k column block, in tiles of 8, 4 and
+/// 1 columns. Used by the serial and the parallel SpMM.
+template <typename T, bool ColumnMajor>
+void spmm_rows_CSR(const CSRMatrix<T> &A, const T *X, size_t ldx, T *Y, size_t ldy, size_t k, size_t rowBegin, size_t rowEnd)
+{
+    for (size_t i = rowBegin; i < rowEnd; i++)
+    {
+        size_t j0 = 0;
+        for (; j0 + 8 <= k; j0 += 8)
+        {
+            spmm_tile_CSR<T, 8, ColumnMajor>(A, X, ldx, Y, ldy, i, j0);
+        }
+        for (; j0 + 4 <= k; j0 += 4)
+        {
+            spmm_tile_CSR<T, 4, ColumnMajor>(A, X, ldx, Y, ldy, i, j0);
+        }
+        for (; j0 < k; j0++)
+        {
+            spmm_tile_CSR<T, 1, ColumnMajor>(A, X, ldx, Y, ldy, i, j0);
+        }
+    }
+}
+
+/**
+ * @brief Rows [rowBegin, rowEnd) of A contribute to Y += A^T X: row i of A scatters
+ * a_ic * X(i, :) into row c of Y. The W values of X(i, :) are loaded once per tile and
+ * reused for every nonzero of the row, so no transpose of A is formed; the scatter into
+ * the W columns of row c is a SIMD_LOOP.
+ */
+template <typename T, size_t W, bool ColumnMajor>
+inline void spmm_transpose_tile_CSR(const CSRMatrix<T> &A, const T *X, size_t ldx, T *Y, size_t ldy, size_t i, size_t j0)
+{
+    T x[W];
+    SIMD_LOOP
+    for (size_t jj = 0; jj < W; jj++)
+    {
+        x[jj] = ColumnMajor ? X[(j0 + jj) * ldx + i] : X[i * ldx + j0 + jj];
+    }
+    for (size_t e = A.row_ptr[i]; e < A.row_ptr[i + 1]; e++)
+    {
+        const T a = A.val[e];
+        const size_t c = A.col_ind[e];
+        SIMD_LOOP
+        for (size_t jj = 0; jj < W; jj++)
+        {
+            (ColumnMajor ? Y[(j0 + jj) * ldy + c] : Y[c * ldy + j0 + jj]) += a * x[jj];
+        }
+    }
+}
+
+/// @brief Rows [rowBegin, rowEnd) of A added into Y += A^T X, see spmm_transpose_tile_CSR
+template <typename T, bool ColumnMajor>
+void spmm_transpose_rows_CSR(const CSRMatrix<T> &A, const T *X, size_t ldx, T *Y, size_t ldy, size_t k, size_t rowBegin,
+                             size_t rowEnd)
+{
+    for (size_t i = rowBegin; i < rowEnd; i++)
+    {
+        size_t j0 = 0;
+        for (; j0 + 8 <= k; j0 += 8)
+        {
+            spmm_transpose_tile_CSR<T, 8, ColumnMajor>(A, X, ldx, Y, ldy, i, j0);
+        }
+        for (; j0 + 4 <= k; j0 += 4)
+        {
+            spmm_transpose_tile_CSR<T, 4, ColumnMajor>(A, X, ldx, Y, ldy, i, j0);
+        }
+        for (; j0 < k; j0++)
+        {
+            spmm_transpose_tile_CSR<T, 1, ColumnMajor>(A, X, ldx, Y, ldy, i, j0);
+        }
+    }
+}
+
+/**
+ * @brief Sparse matrix times dense block, Y = A X. Every nonzero of A is read once and
+ * applied to all k columns, so the matrix is streamed once instead of k times.
+ *
+ * @tparam T
+ * @param A n x m CSR matrix
+ * @param X m x k block
+ * @param Y output, resized to n x k
+ */
+template <typename T>
+void multiply_block_CSR(const CSRMatrix<T> &A, const DenseBlock<T> &X, DenseBlock<T> &Y)
+{
+    if (A.numColumns != X.numRows)
+    {
+        throw std::invalid_argument("Matrix and block dimensions do not match.");
+    }
+    const size_t k = X.numColumns;
+    Y.numRows = A.numRows;
+    Y.numColumns = k;
+    Y.val.resize(A.numRows * k);
+    spmm_rows_CSR<T, false>(A, X.val.data(), k, Y.val.data(), k, k, 0, A.numRows);
+}
+
+/// @brief Sparse matrix times dense block
+/// @return A X
+template <typename T>
+DenseBlock<T> multiply_block_CSR(const CSRMatrix<T> &A, const DenseBlock<T> &X)
+{
+    DenseBlock<T> Y;
+    multiply_block_CSR(A, X, Y);
+    return Y;
+}
+
+/// @brief Sparse matrix times column-major dense block, Y = A X
+/// @param Y output, resized to n x k
+template <typename T>
+void multiply_block_CSR(const CSRMatrix<T> &A, const ColumnMajorBlock<T> &X, ColumnMajorBlock<T> &Y)
+{
+    if (A.numColumns != X.numRows)
+    {
+        throw std::invalid_argument("Matrix and block dimensions do not match.");
+    }
+    Y.numRows = A.numRows;
+    Y.numColumns = X.numColumns;
+    Y.val.resize(A.numRows * X.numColumns);
+    spmm_rows_CSR<T, true>(A, X.val.data(), X.numRows, Y.val.data(), Y.numRows, X.numColumns, 0, A.numRows);
+}
+
+/// @brief Sparse matrix times column-major dense block
+/// @return A X
+template <typename T>
+ColumnMajorBlock<T> multiply_block_CSR(const CSRMatrix<T> &A, const ColumnMajorBlock<T> &X)
+{
+    ColumnMajorBlock<T> Y;
+    multiply_block_CSR(A, X, Y);
+    return Y;
+}
+
+/**
+ * @brief Transposed sparse matrix times dense block, Y = A^T X, computed from the rows
+ * of A without forming the transpose
+ *
+ * @tparam T
+ * @param A n x m CSR matrix
+ * @param X n x k block
+ * @param Y output, resized to m x k
+ */
+template <typename T>
+void multiply_block_transpose_CSR(const CSRMatrix<T> &A, const DenseBlock<T> &X, DenseBlock<T> &Y)
+{
+    if (A.numRows != X.numRows)
+    {
+        throw std::invalid_argument("Matrix and block dimensions do not match.");
+    }
+    const size_t k = X.numColumns;
+    Y.numRows = A.numColumns;
+    Y.numColumns = k;
+    Y.val.assign(A.numColumns * k, 0.0);
+    spmm_transpose_rows_CSR<T, false>(A, X.val.data(), k, Y.val.data(), k, k, 0, A.numRows);
+}
+
+/// @brief Transposed sparse matrix times dense block
+/// @return A^T X
+template <typename T>
+DenseBlock<T> multiply_block_transpose_CSR(const CSRMatrix<T> &A, const DenseBlock<T> &X)
+{
+    DenseBlock<T> Y;
+    multiply_block_transpose_CSR(A, X, Y);
+    return Y;
+}
+
+/// @brief Transposed sparse matrix times column-major dense block, Y = A^T X
+/// @param Y output, resized to m x k
+template <typename T>
+void multiply_block_transpose_CSR(const CSRMatrix<T> &A, const ColumnMajorBlock<T> &X, ColumnMajorBlock<T> &Y)
+{
+    if (A.numRows != X.numRows)
+    {
+        throw std::invalid_argument("Matrix and block dimensions do not match.");
+    }
+    Y.numRows = A.numColumns;
+    Y.numColumns = X.numColumns;
+    Y.val.assign(A.numColumns * X.numColumns, 0.0);
+    spmm_transpose_rows_CSR<T, true>(A, X.val.data(), X.numRows, Y.val.data(), Y.numRows, X.numColumns, 0, A.numRows);
+}
+
+/// @brief Transposed sparse matrix times column-major dense block
+/// @return A^T X
+template <typename T>
+ColumnMajorBlock<T> multiply_block_transpose_CSR(const CSRMatrix<T> &A, const ColumnMajorBlock<T> &X)
+{
+    ColumnMajorBlock<T> Y;
+    multiply_block_transpose_CSR(A, X, Y);
+    return Y;
+}
+
+/// @brief U^T V for two blocks with the same number of rows, as a row-major
+/// U.numColumns x V.numColumns matrix
+template <typename T>
+std::vector<T> block_inner_product(const DenseBlock<T> &U, const DenseBlock<T> &V)
+{
+    const size_t ku = U.numColumns, kv = V.numColumns;
+    std::vector<T> result(ku * kv, 0.0);
+    for (size_t i = 0; i < U.numRows; i++)
+    {
+        const T *u = U.val.data() + i * ku;
+        const T *v = V.val.data() + i * kv;
+        for (size_t a = 0; a < ku; a++)
+        {
+            for (size_t c = 0; c < kv; c++)
+            {
+                result[a * kv + c] += u[a] * v[c];
+            }
+        }
+    }
+    return result;
+}
+
+/// @brief The 2-norm of every column of a block
+template <typename T>
+std::vector<T> block_column_norms(const DenseBlock<T> &X)
+{
+    std::vector<T> norms(X.numColumns, 0.0);
+    for (size_t i = 0; i < X.numRows; i++)
+    {
+        for (size_t j = 0; j < X.numColumns; j++)
+        {
+            norms[j] += X(i, j) * X(i, j);
+        }
+    }
+    for (T &norm : norms)
+    {
+        norm = std::sqrt(norm);
+    }
+    return norms;
+}
+
+/**
+ * @brief Thin QR of a block by modified Gram-Schmidt, W = Q R with Q overwriting W. A
+ * column that is (numerically) dependent on the previous ones becomes zero in Q and
+ * gets a zero diagonal in R, so the block keeps its width.
+ *
+ * @tparam T
+ * @param W n x k block, replaced by Q
+ * @return std::vector<T> R, k x k upper triangular, row-major
+ */
+template <typename T>
+std::vector<T> block_qr(DenseBlock<T> &W)
+{
+    const size_t n = W.numRows, k = W.numColumns;
+    std::vector<T> R(k * k, 0.0);
+    for (size_t j = 0; j < k; j++)
+    {
+        T before = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            before += W(i, j) * W(i, j);
+        }
+        for (size_t c = 0; c < j; c++)
+        {
+            T dot = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                dot += W(i, c) * W(i, j);
+            }
+            R[c * k + j] = dot;
+            for (size_t i = 0; i < n; i++)
+            {
+                W(i, j) -= dot * W(i, c);
+            }
+        }
+        T norm = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            norm += W(i, j) * W(i, j);
+        }
+        norm = std::sqrt(norm);
+        if (norm <= 1e-10 * std::sqrt(before))
+        {
+            norm = 0;
+        }
+        R[j * k + j] = norm;
+        for (size_t i = 0; i < n; i++)
+        {
+            W(i, j) = norm > 0 ? W(i, j) / norm : 0;
+        }
+    }
+    return R;
+}
+
+/// @brief Applies a vector preconditioner to every column of a block, Z = M^-1 R;
+/// without a preconditioner Z = R
+template <typename T>
+void apply_block_preconditioner_CSR(const PreconditionerCSR<T> &M, const DenseBlock<T> &R, DenseBlock<T> &Z)
+{
+    if (!M)
+    {
+        Z = R;
+        return;
+    }
+    Z.numRows = R.numRows;
+    Z.numColumns = R.numColumns;
+    Z.val.resize(R.val.size());
+    std::vector<T> r(R.numRows), z;
+    for (size_t j = 0; j < R.numColumns; j++)
+    {
+        for (size_t i = 0; i < R.numRows; i++)
+        {
+            r[i] = R(i, j);
+        }
+        M(r, z);
+        for (size_t i = 0; i < R.numRows; i++)
+        {
+            Z(i, j) = z[i];
+        }
+    }
+}
+
+/**
+ * @brief Block Conjugate Gradient for CSR (Dubrulle's variant), solving AX = B for all
+ * k columns of B at once. Each iteration costs one SpMM, A is read once for the whole
+ * block, and the search space grows by k directions shared by every right hand side,
+ * so it usually takes fewer iterations than k separate CG solves. The search block is
+ * re-orthonormalized every iteration and directions that became dependent (because
+ * some right hand sides converged) are dropped, which avoids the breakdown of the
+ * original O'Leary recurrences.
+ *
+ * @tparam T
+ * @param A symmetric positive definite matrix
+ * @param B n x k block of right hand sides
+ * @param X0 initial guess, n x k (or empty for zero); any other shape throws
+ * @param maxit
+ * @param tol tolerance on the 2-norm of the residual of every column
+ * @param M optional symmetric positive definite preconditioner, applied per column
+ * @param info optional convergence report, residuals holds the largest column residual
+ * @return DenseBlock<T>
+ */
+template <typename T>
+DenseBlock<T> block_conjugate_gradient_CSR(const CSRMatrix<T> &A, const DenseBlock<T> &B, DenseBlock<T> X0, int maxit,
+                                           double tol, const PreconditionerCSR<T> &M = nullptr, SolverInfo *info = nullptr)
+{
+    const size_t n = A.numRows, k = B.numColumns;
+    if (B.numRows != n)
+    {
+        throw std::invalid_argument("Right hand sides do not match the matrix size.");
+    }
+    DenseBlock<T> &X = X0;
+    if (X.val.empty())
+    {
+        X = DenseBlock<T>(n, k);
+    }
+    else if (X.numRows != n || X.numColumns != k)
+    {
+        throw std::invalid_argument("Initial guess does not match the right hand sides.");
+    }
+    DenseBlock<T> R = multiply_block_CSR(A, X), Z, P, Q;
+    for (size_t e = 0; e < R.val.size(); e++)
+    {
+        R.val[e] = B.val[e] - R.val[e];
+    }
+    auto maxNorm = [](const std::vector<T> &norms)
+    { return norms.empty() ? T(0) : *std::max_element(norms.begin(), norms.end()); };
+    T normR = maxNorm(block_column_norms(R));
+    if (info)
+    {
+        info->residuals.assign(1, normR);
+    }
+
+    // P = orth(Z), keeping only the independent columns
+    auto orthonormalize = [&](DenseBlock<T> &W)
+    {
+        const std::vector<T> diag = block_qr(W);
+        std::vector<size_t> keep;
+        for (size_t j = 0; j < W.numColumns; j++)
+        {
+            if (diag[j * W.numColumns + j] != 0)
+            {
+                keep.push_back(j);
+            }
+        }
+        DenseBlock<T> kept(n, keep.size());
+        for (size_t i = 0; i < n; i++)
+        {
+            for (size_t c = 0; c < keep.size(); c++)
+            {
+                kept(i, c) = W(i, keep[c]);
+            }
+        }
+        W = std::move(kept);
+    };
+    apply_block_preconditioner_CSR(M, R, Z);
+    P = Z;
+    orthonormalize(P);
+
+    std::vector<T> LU;
+    std::vector<size_t> pivot;
+    // solves (P^T A P) C = rhs for a row-major kp x k right hand side, in place
+    auto solve = [&](std::vector<T> &rhs, size_t kp)
+    {
+        std::vector<T> column(kp);
+        for (size_t j = 0; j < k; j++)
+        {
+            for (size_t a = 0; a < kp; a++)
+            {
+                column[a] = rhs[a * k + j];
+            }
+            dense_lu_solve(LU, pivot, column);
+            for (size_t a = 0; a < kp; a++)
+            {
+                rhs[a * k + j] = column[a];
+            }
+        }
+    };
+
+    int it = 0;
+    while (it < maxit && normR >= tol && P.numColumns > 0)
+    {
+        const size_t kp = P.numColumns;
+        multiply_block_CSR(A, P, Q);
+        LU = block_inner_product(P, Q);
+        dense_lu_factor(LU, pivot, kp);
+
+        // X += P alpha, R -= Q alpha with alpha = (P^T A P)^-1 P^T R
+        std::vector<T> alpha = block_inner_product(P, R);
+        solve(alpha, kp);
+        for (size_t i = 0; i < n; i++)
+        {
+            for (size_t j = 0; j < k; j++)
+            {
+                T dx = 0, dr = 0;
+                for (size_t a = 0; a < kp; a++)
+                {
+                    dx += P(i, a) * alpha[a * k + j];
+                    dr += Q(i, a) * alpha[a * k + j];
+                }
+                X(i, j) += dx;
+                R(i, j) -= dr;
+            }
+        }
+        normR = maxNorm(block_column_norms(R));
+        it++;
+        if (info)
+        {
+            info->residuals.push_back(normR);
+        }
+        if (normR < tol)
+        {
+            break;
+        }
+
+        // P = orth(Z + P beta) with beta = -(P^T A P)^-1 Q^T Z, A-conjugate to the old P
+        apply_block_preconditioner_CSR(M, R, Z);
+        std::vector<T> beta = block_inner_product(Q, Z);
+        solve(beta, kp);
+        DenseBlock<T> next = Z;
+        for (size_t i = 0; i < n; i++)
+        {
+            for (size_t j = 0; j < k; j++)
+            {
+                T sum = 0;
+                for (size_t a = 0; a < kp; a++)
+                {
+                    sum += P(i, a) * beta[a * k + j];
+                }
+                next(i, j) -= sum;
+            }
+        }
+        P = std::move(next);
+        orthonormalize(P);
+    }
+    if (info)
+    {
+        info->iterations = it;
+        info->converged = normR < tol;
+    }
+    std::cerr << "Block CG Iterations: " << it << std::endl;
+    return X;
+}
+
+/**
+ * @brief Restarted block GMRES(m) for CSR, solving AX = B for all k columns of B at
+ * once. Block Arnoldi builds m blocks of k basis vectors with one SpMM each; the block
+ * Hessenberg matrix is reduced with Givens rotations as it grows, which gives the
+ * residual norm of every right hand side without forming X. Preconditioning is on the
+ * right, as in gmres_CSR.
+ *
+ * @tparam T
+ * @param A
+ * @param B n x k block of right hand sides
+ * @param X0 initial guess, n x k (or empty for zero); any other shape throws
+ * @param restart m, the number of basis blocks kept before restarting
+ * @param maxit maximum total number of block iterations
+ * @param tol tolerance on the 2-norm of the residual of every column
+ * @param M optional right preconditioner, applied per column
+ * @param info optional convergence report, residuals holds the largest column residual
+ * @return DenseBlock<T>
+ */
+template <typename T>
+DenseBlock<T> block_gmres_CSR(const CSRMatrix<T> &A, const DenseBlock<T> &B, DenseBlock<T> X0, int restart, int maxit,
+                              double tol, const PreconditionerCSR<T> &M = nullptr, SolverInfo *info = nullptr)
+{
+    const size_t n = A.numRows, k = B.numColumns;
+    if (B.numRows != n)
+    {
+        throw std::invalid_argument("Right hand sides do not match the matrix size.");
+    }
+    if (restart < 1)
+    {
+        throw std::invalid_argument("GMRES restart length must be at least 1.");
+    }
+    const size_t m = restart;
+    const size_t rowsH = (m + 1) * k, colsH = m * k;
+    DenseBlock<T> &X = X0;
+    if (X.val.empty())
+    {
+        X = DenseBlock<T>(n, k);
+    }
+    else if (X.numRows != n || X.numColumns != k)
+    {
+        throw std::invalid_argument("Initial guess does not match the right hand sides.");
+    }
+    std::vector<DenseBlock<T>> V(m + 1);
+    // H is column-major with leading dimension rowsH, G is row-major rowsH x k
+    std::vector<T> H(rowsH * colsH), G(rowsH * k), cs(colsH * k), sn(colsH * k);
+    DenseBlock<T> R, Z, W;
+    auto maxNorm = [](const std::vector<T> &norms)
+    { return norms.empty() ? T(0) : *std::max_element(norms.begin(), norms.end()); };
+
+    int it = 0;
+    T normR = 0;
+    bool first = true;
+    while (true)
+    {
+        multiply_block_CSR(A, X, R);
+        for (size_t e = 0; e < R.val.size(); e++)
+        {
+            R.val[e] = B.val[e] - R.val[e];
+        }
+        normR = maxNorm(block_column_norms(R));
+        if (info)
+        {
+            if (first)
+            {
+                info->residuals.assign(1, normR);
+            }
+            else
+            {
+                info->residuals.back() = normR;
+            }
+        }
+        first = false;
+        if (normR < tol || it >= maxit)
+        {
+            break;
+        }
+
+        V[0] = R;
+        const std::vector<T> S = block_qr(V[0]);
+        std::fill(H.begin(), H.end(), 0.0);
+        std::fill(G.begin(), G.end(), 0.0);
+        std::copy(S.begin(), S.end(), G.begin());
+
+        size_t j = 0;
+        while (j < m && it < maxit)
+        {
+            apply_block_preconditioner_CSR(M, V[j], Z);
+            multiply_block_CSR(A, Z, W);
+            // block modified Gram-Schmidt
+            for (size_t i = 0; i <= j; i++)
+            {
+                const std::vector<T> Hij = block_inner_product(V[i], W);
+                for (size_t row = 0; row < n; row++)
+                {
+                    for (size_t c = 0; c < k; c++)
+                    {
+                        T sum = 0;
+                        for (size_t a = 0; a < k; a++)
+                        {
+                            sum += V[i](row, a) * Hij[a * k + c];
+                        }
+                        W(row, c) -= sum;
+                    }
+                }
+                for (size_t a = 0; a < k; a++)
+                {
+                    for (size_t c = 0; c < k; c++)
+                    {
+                        H[(j * k + c) * rowsH + i * k + a] = Hij[a * k + c];
+                    }
+                }
+            }
+            V[j + 1] = W;
+            const std::vector<T> Hnext = block_qr(V[j + 1]);
+            for (size_t a = 0; a < k; a++)
+            {
+                for (size_t c = 0; c < k; c++)
+                {
+                    H[(j * k + c) * rowsH + (j + 1) * k + a] = Hnext[a * k + c];
+                }
+            }
+
+            // Givens: column col has nonzeros down to row col + k
+            for (size_t col = j * k; col < (j + 1) * k; col++)
+            {
+                T *h = H.data() + col * rowsH;
+                for (size_t prev = 0; prev < col; prev++)
+                {
+                    for (size_t s = k; s >= 1; s--)
+                    {
+                        const size_t top = prev + s - 1;
+                        const T c = cs[prev * k + s - 1], sv = sn[prev * k + s - 1];
+                        const T t = c * h[top] + sv * h[top + 1];
+                        h[top + 1] = -sv * h[top] + c * h[top + 1];
+                        h[top] = t;
+                    }
+                }
+                for (size_t s = k; s >= 1; s--)
+                {
+                    const size_t top = col + s - 1;
+                    const T a = h[top], b = h[top + 1];
+                    const T rr = std::hypot(a, b);
+                    const T c = rr == 0 ? 1 : a / rr;
+                    const T sv = rr == 0 ? 0 : b / rr;
+                    cs[col * k + s - 1] = c;
+                    sn[col * k + s - 1] = sv;
+                    h[top] = rr;
+                    h[top + 1] = 0;
+                    for (size_t q = 0; q < k; q++)
+                    {
+                        const T g = c * G[top * k + q] + sv * G[(top + 1) * k + q];
+                        G[(top + 1) * k + q] = -sv * G[top * k + q] + c * G[(top + 1) * k + q];
+                        G[top * k + q] = g;
+                    }
+                }
+            }
+            j++;
+            it++;
+
+            // the residual of right hand side q lives in rows j*k .. (j+1)*k - 1 of G
+            std::vector<T> norms(k, 0.0);
+            for (size_t row = j * k; row < (j + 1) * k; row++)
+            {
+                for (size_t q = 0; q < k; q++)
+                {
+                    norms[q] += G[row * k + q] * G[row * k + q];
+                }
+            }
+            for (T &norm : norms)
+            {
+                norm = std::sqrt(norm);
+            }
+            normR = maxNorm(norms);
+            if (info)
+            {
+                info->residuals.push_back(normR);
+            }
+            if (normR < tol)
+            {
+                break;
+            }
+        }
+
+        // back substitution for Y (jk x k), skipping directions that broke down
+        const size_t size = j * k;
+        std::vector<T> Y(size * k, 0.0);
+        for (size_t row = size; row-- > 0;)
+        {
+            const T diag = H[row * rowsH + row];
+            for (size_t q = 0; q < k; q++)
+            {
+                T sum = G[row * k + q];
+                for (size_t c = row + 1; c < size; c++)
+                {
+                    sum -= H[c * rowsH + row] * Y[c * k + q];
+                }
+                Y[row * k + q] = diag != 0 ? sum / diag : 0;
+            }
+        }
+        // X += M^-1 (V Y)
+        DenseBlock<T> update(n, k);
+        for (size_t i = 0; i < j; i++)
+        {
+            for (size_t row = 0; row < n; row++)
+            {
+                for (size_t q = 0; q < k; q++)
+                {
+                    T sum = 0;
+                    for (size_t a = 0; a < k; a++)
+                    {
+                        sum += V[i](row, a) * Y[(i * k + a) * k + q];
+                    }
+                    update(row, q) += sum;
+                }
+            }
+        }
+        apply_block_preconditioner_CSR(M, update, Z);
+        for (size_t e = 0; e < X.val.size(); e++)
+        {
+            X.val[e] += Z.val[e];
+        }
+    }
+    if (info)
+    {
+        info->iterations = it;
+        info->converged = normR < tol;
+    }
+    std::cerr << "Block GMRES Iterations: " << it << std::endl;
+    return X;
+}
+
+/**
+ * @brief Expands a symmetric matrix stored as one triangle, as Matrix Market
+ * "symmetric" files are and as load_fileCSR returns them, into the full matrix:
+ * every off-diagonal entry (i, j) is mirrored to (j, i).
+ *
+ * @tparam T
+ * @param L the lower (or upper) triangle
+ * @return CSRMatrix<T> the full symmetric matrix with sorted rows
+ */
+template <typename T>
+CSRMatrix<T> symmetric_from_triangle_CSR(const CSRMatrix<T> &L)
+{
+    if (L.numRows != L.numColumns)
+    {
+        throw std::invalid_argument("A symmetric matrix must be square.");
+    }
+    const size_t n = L.numRows;
+    CSRMatrix<T> A;
+    A.numRows = n;
+    A.numColumns = n;
+    A.row_ptr.assign(n + 1, 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t k = L.row_ptr[i]; k < L.row_ptr[i + 1]; k++)
+        {
+            A.row_ptr[i + 1]++;
+            if (L.col_ind[k] != i)
+            {
+                A.row_ptr[L.col_ind[k] + 1]++;
+            }
+        }
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        A.row_ptr[i + 1] += A.row_ptr[i];
+    }
+    A.col_ind.resize(A.row_ptr[n]);
+    A.val.resize(A.row_ptr[n]);
+    std::vector<size_t> next(A.row_ptr.begin(), A.row_ptr.end() - 1);
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t k = L.row_ptr[i]; k < L.row_ptr[i + 1]; k++)
+        {
+            const size_t j = L.col_ind[k];
+            A.col_ind[next[i]] = j;
+            A.val[next[i]++] = L.val[k];
+            if (j != i)
+            {
+                A.col_ind[next[j]] = i;
+                A.val[next[j]++] = L.val[k];
+            }
+        }
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        std::vector<std::pair<size_t, T>> row;
+        for (size_t k = A.row_ptr[i]; k < A.row_ptr[i + 1]; k++)
+        {
+            row.emplace_back(A.col_ind[k], A.val[k]);
+        }
+        std::sort(row.begin(), row.end(), [](const std::pair<size_t, T> &a, const std::pair<size_t, T> &b)
+                  { return a.first < b.first; });
+        for (size_t k = 0; k < row.size(); k++)
+        {
+            A.col_ind[A.row_ptr[i] + k] = row[k].first;
+            A.val[A.row_ptr[i] + k] = row[k].second;
+        }
+    }
+    return A;
+}
+
+#endif
@@ -1,3 +1,6 @@
+#ifndef FUNCTIONS_CSR_PARALLEL_CC
+#define FUNCTIONS_CSR_PARALLEL_CC
+
 #include <fstream>
 #include <iostream>
 #include <random>
@@ -24,12 +27,63 @@ public:
 namespace parallel {
 using namespace std;
 
+/// @brief Below this many stored entries the serial statistics pass is used
+constexpr size_t STATISTICS_PARALLEL_CUTOFF = 1 << 15;
+
+/**
+ * @brief Parallel version of statistics_CSR. A parallel_reduce over blocks of rows joins
+ * the running totals; every row writes its own off-diagonal and diagonal sums, and the
+ * column sums go into per-thread arrays that are added up at the end.
+ *
+ * @tparam T
+ * @param A with sorted column indices in every row
+ * @return MatrixStatistics<T>
+ */
+template <typename T>
+MatrixStatistics<T> statistics_CSR(const CSRMatrix<T> &A)
+{
+    if (A.val.size() < STATISTICS_PARALLEL_CUTOFF)
+    {
+        return ::statistics_CSR(A);
+    }
+    const size_t n = A.numRows, m = A.numColumns;
+    vector<double> rowOff(n, 0.0), diag(std::min(n, m), 0.0);
+    tbb::enumerable_thread_specific<vector<double>> columnSums(vector<double>(m, 0.0));
+    StatisticsAccumulator<T> init;
+    init.symmetric = n == m;
+    const StatisticsAccumulator<T> acc = tbb::parallel_reduce(
+        tbb::blocked_range<size_t>(0, n), init,
+        [&](const tbb::blocked_range<size_t> &r, StatisticsAccumulator<T> part) {
+            double *colOff = columnSums.local().data();
+            for (size_t i = r.begin(); i < r.end(); i++)
+            {
+                accumulate_slice(part, i, A.row_ptr, A.col_ind, A.val, rowOff[i], colOff, diag);
+            }
+            return part;
+        },
+        [](StatisticsAccumulator<T> x, const StatisticsAccumulator<T> &y) {
+            x.join(y);
+            return x;
+        });
+    vector<double> colOff(m, 0.0);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, m), [&](const tbb::blocked_range<size_t> &r) {
+        for (const vector<double> &local : columnSums)
+        {
+            for (size_t j = r.begin(); j < r.end(); j++)
+            {
+                colOff[j] += local[j];
+            }
+        }
+    });
+    return finish_statistics(acc, rowOff, colOff, diag);
+}
+
 /// @brief Find the max value in a compressed sparse row(CSR) matrix
 /// @tparam T The type of the matrix
 /// @param m The CSR matrix to find the max value of
 /// @return The max value in the matrix
 template <typename T>
-T find_max_CSR(CSRMatrix<T> m1)
+T find_max_CSR(const CSRMatrix<T> &m1)
 {
     return tbb::parallel_reduce(
         tbb::blocked_range<int>(0, m1.val.size()),
@@ -47,6 +101,29 @@ T find_max_CSR(CSRMatrix<T> m1)
         [](T x, T y) { return std::max(x, y); }
     );}
 
+/// @brief Find the min value in a compressed sparse row(CSR) matrix
+/// @tparam T The type of the matrix
+/// @param m The CSR matrix to find the min value of
+/// @return The min value in the matrix
+template <typename T>
+T find_min_CSR(const CSRMatrix<T> &m1)
+{
+    return tbb::parallel_reduce(
+        tbb::blocked_range<int>(0, m1.val.size()),
+        m1.val[0],
+        [&](const tbb::blocked_range<int>& r, T min_value) {
+            for (int i = r.begin(); i != r.end(); ++i)
+            {
+                if (m1.val[i] < min_value)
+                {
+                    min_value = m1.val[i];
+                }
+            }
+            return min_value;
+        },
+        [](T x, T y) { return std::min(x, y); }
+    );}
+
 template<typename T>
 //to store the column and value vectors in the CSR format
 class VectorPair{
@@ -57,105 +134,185 @@ class VectorPair{
     VectorPair() : vec1(), vec2() {}
 };
 
-/// @brief Adds two compressed spares row(CSR) matrixes together
-/// @exception The two matrixes must have the same dimensions
-/// @tparam T The type of both matrixes
-/// @param m1 The first matrix too add
-/// @param m2 The second matrix too add
-/// @return m1+m2
+/// @brief In-place exclusive prefix sum of counts stored one slot to the right:
+/// on entry ptr[i + 1] is the count of row i and ptr[0] = 0, on exit ptr is the row
+/// pointer array. Done with tbb::parallel_scan.
+inline void prefix_sum_row_counts(vector<size_t> &ptr)
+{
+    tbb::parallel_scan(
+        tbb::blocked_range<size_t>(1, ptr.size()), size_t(0),
+        [&](const tbb::blocked_range<size_t> &r, size_t sum, bool isFinal) {
+            for (size_t i = r.begin(); i < r.end(); i++)
+            {
+                sum += ptr[i];
+                if (isFinal)
+                {
+                    ptr[i] = sum;
+                }
+            }
+            return sum;
+        },
+        std::plus<size_t>());
+}
+
+/**
+ * @brief C = alpha A + beta B for CSR matrices with sorted rows. A parallel symbolic
+ * pass counts the entries of every output row, a parallel prefix sum turns the counts
+ * into row_ptr, and a second parallel pass merges the rows straight into the sized
+ * output arrays. Entries present in only one operand are kept; a coincident pair
+ * that cancels to zero is dropped, as in add_matrixCSR. When A and B have the same
+ * pattern the merge reduces to a vector AXPBY on val, and the pattern is copied.
+ *
+ * The result is written into C, whose arrays are reused.
+ *
+ * @tparam T
+ * @param C output, must not be A or B
+ * @param alpha
+ * @param A
+ * @param beta
+ * @param B same dimensions as A
+ */
 template <typename T>
-CSRMatrix<T> add_matrixCSR(CSRMatrix<T> m1, CSRMatrix<T> m2)
+void axpby_into(CSRMatrix<T> &C, const T alpha, const CSRMatrix<T> &A, const T beta, const CSRMatrix<T> &B)
 {
-    if (m1.numRows != m2.numRows)
+    if (A.numRows != B.numRows)
     {
         throw std::invalid_argument("The number of rows in the first matrix must match the number of rows in the second matrix.");
     }
-    if (m1.numColumns != m2.numColumns)
+    if (A.numColumns != B.numColumns)
     {
         throw std::invalid_argument("The number of columns in the first matrix must match the number of columns in the second matrix.");
     }
-    CSRMatrix<T> returnMatrix;
-    returnMatrix.numRows = m1.numRows;
-    returnMatrix.numColumns = m1.numColumns;
-    returnMatrix.row_ptr.push_back(0);
-    //set the processor count to the number of available number of threads
-    const auto processor_count = std::thread::hardware_concurrency();
-    //vector of vector pairs to store the results of each thread
-    std::vector<vector<VectorPair<T>>> result;
-    //resize to ensure each thread has a place to put it's results
-    result.resize(processor_count);
-    //the vector of threads
-  	std::vector<std::thread> threadPool;
-	threadPool.reserve(processor_count);
-    //lambda to do the add
-    auto do_work = [&](int k){
-        vector<VectorPair<T>> v;
-        //increments by processor count and starts at k to divide work evenly
-		for (size_t i = k; i < m1.numRows; i += processor_count){
-        VectorPair<T> row;
-        size_t a1 = m1.row_ptr.at(i);
-        size_t b1 = m1.row_ptr.at(i + 1);
-        size_t a2 = m2.row_ptr.at(i);
-        size_t b2 = m2.row_ptr.at(i + 1);
-        while (a1 < b1 && a2 < b2)
+    check_output_CSR(C, A, B);
+    const size_t n = A.numRows;
+    C.numRows = n;
+    C.numColumns = A.numColumns;
+
+    if (A.row_ptr == B.row_ptr && A.col_ind == B.col_ind)
+    {
+        C.val.resize(A.val.size());
+        const size_t zeros = tbb::parallel_reduce(
+            tbb::blocked_range<size_t>(0, A.val.size()), size_t(0),
+            [&](const tbb::blocked_range<size_t> &r, size_t count) {
+                for (size_t k = r.begin(); k < r.end(); k++)
+                {
+                    C.val[k] = alpha * A.val[k] + beta * B.val[k];
+                    count += C.val[k] == 0;
+                }
+                return count;
+            },
+            std::plus<size_t>());
+        if (zeros == 0)
         {
-            if (m1.col_ind.at(a1) < m2.col_ind.at(a2))
+            C.row_ptr = A.row_ptr;
+            C.col_ind = A.col_ind;
+            return;
+        }
+        // rare: cancellations, fall through to the general merge
+        C.val.clear();
+    }
+
+    // one merge routine for both passes; it only writes when given output pointers
+    auto mergeRow = [&](size_t i, size_t *cols, T *vals) {
+        size_t a = A.row_ptr[i], b = B.row_ptr[i], count = 0;
+        const size_t aEnd = A.row_ptr[i + 1], bEnd = B.row_ptr[i + 1];
+        while (a < aEnd || b < bEnd)
+        {
+            size_t col;
+            T value;
+            if (b == bEnd || (a < aEnd && A.col_ind[a] < B.col_ind[b]))
             {
-                row.vec1.push_back(m1.col_ind.at(a1));
-                row.vec2.push_back(m1.val.at(a1));
-                a1++;
+                col = A.col_ind[a];
+                value = alpha * A.val[a++];
             }
-            else if (m1.col_ind.at(a1) > m2.col_ind.at(a2))
+            else if (a == aEnd || B.col_ind[b] < A.col_ind[a])
             {
-                row.vec1.push_back(m2.col_ind.at(a2));
-                row.vec2.push_back(m2.val.at(a2));
-                a2++;
+                col = B.col_ind[b];
+                value = beta * B.val[b++];
             }
-            else if (m1.col_ind.at(a1) == m2.col_ind.at(a2))
+            else
             {
-                T value = m1.val.at(a1) + m2.val.at(a2);
-                if (value != 0)
+                col = A.col_ind[a];
+                value = alpha * A.val[a++] + beta * B.val[b++];
+                if (value == 0)
                 {
-                    row.vec1.push_back(m1.col_ind.at(a1));
-                    row.vec2.push_back(value);
+                    continue;
                 }
-                a1++;
-                a2++;
             }
+            if (cols)
+            {
+                cols[count] = col;
+                vals[count] = value;
+            }
+            count++;
         }
-        while (a1 < b1)
+        return count;
+    };
+    C.row_ptr.assign(n + 1, 0);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, n), [&](const tbb::blocked_range<size_t> &r) {
+        for (size_t i = r.begin(); i < r.end(); i++)
         {
-            row.vec1.push_back(m1.col_ind.at(a1));
-            row.vec2.push_back(m1.val.at(a1));
-            a1++;
+            C.row_ptr[i + 1] = mergeRow(i, nullptr, nullptr);
         }
-        while (a2 < b2)
+    });
+    prefix_sum_row_counts(C.row_ptr);
+    C.col_ind.resize(C.row_ptr[n]);
+    C.val.resize(C.row_ptr[n]);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, n), [&](const tbb::blocked_range<size_t> &r) {
+        for (size_t i = r.begin(); i < r.end(); i++)
         {
-            row.vec1.push_back(m2.col_ind.at(a2));
-            row.vec2.push_back(m2.val.at(a2));
-            a2++;
-        }
-        v.push_back(row);
+            mergeRow(i, C.col_ind.data() + C.row_ptr[i], C.val.data() + C.row_ptr[i]);
         }
-        //store the result of the thread in the vector before returning
-        result[k] = v;
-	};
+    });
+}
 
-	//have the threads do the work
-	for (size_t i = 0; i < processor_count; ++i){
-      	threadPool.push_back(thread(do_work,i));
-    }
-	//join the threads
-	for(auto & val : threadPool){
-    	val.join();
-	}
-    //merge results of each thread into one CSRMatrix
-    for (size_t i = 0; i < m1.numRows; i++){
-        returnMatrix.col_ind.insert(returnMatrix.col_ind.end(),result[i%processor_count][i/processor_count].vec1.cbegin(),result[i%processor_count][i/processor_count].vec1.cend());
-        returnMatrix.val.insert(returnMatrix.val.end(),result[i%processor_count][i/processor_count].vec2.cbegin(),result[i%processor_count][i/processor_count].vec2.cend());
-        returnMatrix.row_ptr.push_back(returnMatrix.val.size());
-    }
-    return returnMatrix;
+/// @brief alpha A + beta B, see axpby_into
+template <typename T>
+CSRMatrix<T> axpby_CSR(const T alpha, const CSRMatrix<T> &A, const T beta, const CSRMatrix<T> &B)
+{
+    CSRMatrix<T> C;
+    parallel::axpby_into(C, alpha, A, beta, B);
+    return C;
+}
+
+/// @brief Adds two compressed spares row(CSR) matrixes together into C, reusing its storage
+/// @exception The two matrixes must have the same dimensions, and C must not be m1 or m2
+template <typename T>
+void add_into(CSRMatrix<T> &C, const CSRMatrix<T> &m1, const CSRMatrix<T> &m2)
+{
+    parallel::axpby_into(C, T(1), m1, T(1), m2);
+}
+
+/// @brief Subtract two compressed sparse row(CSR) matrixes into C, reusing its storage
+/// @exception The two matrixes must have the same dimensions, and C must not be m1 or m2
+template <typename T>
+void subtract_into(CSRMatrix<T> &C, const CSRMatrix<T> &m1, const CSRMatrix<T> &m2)
+{
+    parallel::axpby_into(C, T(1), m1, T(-1), m2);
+}
+
+/// @brief Adds two compressed spares row(CSR) matrixes together
+/// @exception The two matrixes must have the same dimensions
+/// @tparam T The type of both matrixes
+/// @param m1 The first matrix too add
+/// @param m2 The second matrix too add
+/// @return m1+m2
+template <typename T>
+CSRMatrix<T> add_matrixCSR(const CSRMatrix<T> &m1, const CSRMatrix<T> &m2)
+{
+    return parallel::axpby_CSR(T(1), m1, T(1), m2);
+}
+
+/// @brief Subtract two compressed sparse row(CSR) matrixes
+/// @exception The two matrixes must have the same dimensions
+/// @tparam T The type of the matrixes
+/// @param m1 The first CSR matrix to subtract
+/// @param m2 The second CSR matrix to subtract
+/// @return The difference of m1 and m2
+template <typename T>
+CSRMatrix<T> subtract_matrixCSR(const CSRMatrix<T> &m1, const CSRMatrix<T> &m2)
+{
+    return parallel::axpby_CSR(T(1), m1, T(-1), m2);
 }
 
 //this matrix code is correct and uses TBB, but it is slow and does not scale well
@@ -247,23 +404,23 @@ CSRMatrix<T> add_matrixCSR(CSRMatrix<T> m1, CSRMatrix<T> m2)
 //     return returnMatrix;
 // }
 
-/// @brief Multiplies two compressed sparse row(CSR) matrixes
-/// @exception The number of columns in m1 must equal the number of rows in m2
+/// @brief Multiplies two compressed sparse row(CSR) matrixes into C, reusing its storage
+/// @exception The number of columns in m1 must equal the number of rows in m2, and C
+/// must not be m1 or m2
 /// @tparam T The type of the matrixes
+/// @param C The output, the dot product of m1 and m2
 /// @param m1 The first CSR matrix to multiply
 /// @param m2 The second CSR matrix to multiply
-/// @return The dot product of m1 and m2
 template <typename T>
-CSRMatrix<T> multiply_matrixCSR(CSRMatrix<T> m1, CSRMatrix<T> m2)
+void multiply_into(CSRMatrix<T> &C, const CSRMatrix<T> &m1, const CSRMatrix<T> &m2)
 {
     if (m1.numColumns != m2.numRows)
     {
         throw std::invalid_argument("The number of columns in the first matrix must match the number of rows in the second matrix.");
     }
-    CSRMatrix<T> returnMatrix;
-    returnMatrix.numRows = m1.numRows;
-    returnMatrix.numColumns = m2.numColumns;
-    returnMatrix.row_ptr.push_back(0);
+    check_output_CSR(C, m1, m2);
+    reset_CSR(C, m1.numRows, m2.numColumns);
+    C.row_ptr.push_back(0);
     CSRMatrix<T> m2t = transpose_matrixCSR(m2);
     //set the processor count to the number of available number of threads
     const auto processor_count = std::thread::hardware_concurrency();;
@@ -325,10 +482,23 @@ CSRMatrix<T> multiply_matrixCSR(CSRMatrix<T> m1, CSRMatrix<T> m2)
 	}
     //merge results of each thread into one CSRMatrix
     for (size_t i = 0; i < m1.numRows; i++){
-        returnMatrix.col_ind.insert(returnMatrix.col_ind.end(),result[i%processor_count][i/processor_count].vec1.cbegin(),result[i%processor_count][i/processor_count].vec1.cend());
-        returnMatrix.val.insert(returnMatrix.val.end(),result[i%processor_count][i/processor_count].vec2.cbegin(),result[i%processor_count][i/processor_count].vec2.cend());
-        returnMatrix.row_ptr.push_back(returnMatrix.val.size());
+        C.col_ind.insert(C.col_ind.end(),result[i%processor_count][i/processor_count].vec1.cbegin(),result[i%processor_count][i/processor_count].vec1.cend());
+        C.val.insert(C.val.end(),result[i%processor_count][i/processor_count].vec2.cbegin(),result[i%processor_count][i/processor_count].vec2.cend());
+        C.row_ptr.push_back(C.val.size());
     }
+}
+
+/// @brief Multiplies two compressed sparse row(CSR) matrixes, see multiply_into
+/// @exception The number of columns in m1 must equal the number of rows in m2
+/// @tparam T The type of the matrixes
+/// @param m1 The first CSR matrix to multiply
+/// @param m2 The second CSR matrix to multiply
+/// @return The dot product of m1 and m2
+template <typename T>
+CSRMatrix<T> multiply_matrixCSR(const CSRMatrix<T> &m1, const CSRMatrix<T> &m2)
+{
+    CSRMatrix<T> returnMatrix;
+    parallel::multiply_into(returnMatrix, m1, m2);
     return returnMatrix;
 }
 
@@ -374,59 +544,76 @@ CSRMatrix<T> multiply_matrixCSR(CSRMatrix<T> m1, CSRMatrix<T> m2)
 // return approxValues;
 // }
 
+/**
+ * @brief Parallel weighted Jacobi sweep, see the serial jacobi_sweep_CSR. When
+ * computeDiff is true the max-norm of xNew - x is reduced in the same parallel pass
+ * as the update; otherwise it is a plain parallel_for and returns 0.
+ */
+template <typename T>
+T jacobi_sweep_CSR(const CSRMatrix<T> &m1, const std::vector<T> &invDiag, const std::vector<T> &B,
+                   const std::vector<T> &x, std::vector<T> &xNew, const T weight, const bool computeDiff) {
+    auto sweep = [&](const tbb::blocked_range<size_t> &r, T diff) {
+        for (size_t i = r.begin(); i < r.end(); i++) {
+            T sum = 0.0;
+            for (size_t k = m1.row_ptr[i]; k < m1.row_ptr[i + 1]; ++k) {
+                sum += m1.val[k] * x[m1.col_ind[k]];
+            }
+            const T value = x[i] + weight * (B[i] - sum) * invDiag[i];
+            if (computeDiff) {
+                diff = std::max(diff, static_cast<T>(std::abs(value - x[i])));
+            }
+            xNew[i] = value;
+        }
+        return diff;
+    };
+    if (!computeDiff) {
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, m1.numRows), [&](tbb::blocked_range<size_t> r){
+            sweep(r, T(0.0));
+        });
+        return 0.0;
+    }
+    return tbb::parallel_reduce(
+        tbb::blocked_range<size_t>(0, m1.numRows),
+        T(0.0),
+        sweep,
+        [](T a, T b) { return std::max(a, b); }
+    );
+}
+
 /**
  * @brief The Jacobi Method is an iterative method for determining the solutions of a strictly
  * diagonally dominant matrix A. Through each iteration, the values of x[i] are approximated through
- * the formula x[i] = B[i]
+ * the formula x[i] = (B[i] - sum_{j != i} a_ij x[j]) / a_ii. The update and the convergence norm
+ * are one fused parallel reduction, D^-1 is extracted once and the iterate buffers are swapped.
  * 
  * @param denseMatrix 
  * @param B 
  * @param tol - the tolerance for convergence
  * @param iterations - the maximum number of iterations to perform
+ * @param weight - damping factor for weighted Jacobi (1.0 is plain Jacobi)
+ * @param checkEvery - only reduce the convergence norm every checkEvery iterations
  */
 template <typename T>
-std::vector<T> jacobi_method_CSR(CSRMatrix<T> m1, std::vector<T> B, const double tol,int maxIterations) {
+std::vector<T> jacobi_method_CSR(const CSRMatrix<T> &m1, const std::vector<T> &B, const double tol,int maxIterations,
+                                 const T weight = 1.0, const int checkEvery = 1) {
     // if (diagonally_dominant(m1) == false) {
     //     throw std::invalid_argument("Input matrix is not diagonally dominant");
     // }
+    const std::vector<T> invDiag = inverse_diagonal_CSR(m1);
     std::vector<T> xValues(B.size(), 0.0);
     std::vector<T> approxValues(B.size(), 0.0);
     int iterations = 0;
     double diff = tol + 1.0;
     while (iterations < maxIterations && diff > tol) {
-        tbb::parallel_for( tbb::blocked_range<size_t>(0, m1.numRows), [&](tbb::blocked_range<size_t> r){
-        for(size_t i = r.begin(); i < r.end(); i++){
-            size_t a1 = m1.row_ptr.at(i);
-            size_t b1 = m1.row_ptr.at(i + 1);
-            T sum = 0.0;
-            T diagonal = 0.0;
-            while(a1 < b1){
-                if(m1.col_ind[a1] == i){
-                    diagonal = m1.val[a1];
-                }else{
-                    sum += m1.val[a1] * xValues[m1.col_ind[a1]];
-                }
-                a1++;
-            }
-            //no devide by zero error becuase of diagonally dominant check
-            approxValues[i] = (B[i] - sum) / diagonal;
-            
-        }});
-         // Calculate the norm of the difference between x and x_new
-        diff = 0.0;
-        for (size_t i = 0; i < m1.numRows; i++)
-        {
-            double abs_diff = std::abs(approxValues[i] - xValues[i]);
-            if (abs_diff > diff)
-            {
-                diff = abs_diff;
-            }
-        }
-        xValues = approxValues;
+        const bool check = checkEvery <= 1 || (iterations + 1) % checkEvery == 0;
+        T sweepDiff = jacobi_sweep_CSR(m1, invDiag, B, xValues, approxValues, weight, check);
+        xValues.swap(approxValues);
         iterations++;
-    
+        if (check) {
+            diff = sweepDiff;
+        }
     }
-return approxValues;
+return xValues;
 }
 
 template <typename T>
@@ -455,7 +642,7 @@ struct AtomicVector {
  * @return std::vector<T> 
  */
 template <typename T>
-std::vector<T> gauss_sidel_CSR(CSRMatrix<T> m1, std::vector<T> B, const double tol, int maxIterations) {
+std::vector<T> gauss_sidel_CSR(const CSRMatrix<T> &m1, const std::vector<T> &B, const double tol, int maxIterations) {
     std::vector<T> xValues(B.size(), 0.0);
     AtomicVector<T> approxValues(B.size());
 
@@ -504,57 +691,745 @@ std::vector<T> gauss_sidel_CSR(CSRMatrix<T> m1, std::vector<T> B, const double t
     return xValues;
 }
 
+/**
+ * @brief A partition of the rows of a matrix into colors such that no two rows of the
+ * same color are coupled (a_ij == 0 and a_ji == 0). Rows of color c are
+ * rows[color_ptr[c]] .. rows[color_ptr[c+1]-1], stored like a CSR row.
+ */
+class RowColoring {
+    public:
+    vector<size_t> color_ptr;
+    vector<size_t> rows;
+
+    size_t numColors() const { return color_ptr.size() - 1; }
+};
+
+/**
+ * @brief Greedy multicoloring of the adjacency graph of A + A^T. Rows are visited in
+ * natural order and get the smallest color not used by a neighbour, so the result
+ * only depends on the sparsity pattern, never on the number of threads.
+ *
+ * @tparam T
+ * @param A square matrix
+ * @return RowColoring
+ */
 template <typename T>
-std::vector<T> ssor_iteration_CSR(CSRMatrix<T> A,
+RowColoring color_rows_CSR(const CSRMatrix<T> &A)
+{
+    const size_t n = A.numRows;
+    // the pattern of A^T gives the rows that reference row i
+    CSRMatrix<T> At = transpose_matrixCSR(A);
+    const size_t uncolored = static_cast<size_t>(-1);
+    vector<size_t> color(n, uncolored);
+    // forbidden[c] == i means color c is taken by a neighbour of row i
+    vector<size_t> forbidden;
+    size_t numColors = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        auto mark = [&](const vector<size_t> &ptr, const vector<size_t> &ind) {
+            for (size_t k = ptr[i]; k < ptr[i + 1]; k++)
+            {
+                const size_t c = color[ind[k]];
+                if (ind[k] != i && c != uncolored)
+                {
+                    forbidden[c] = i;
+                }
+            }
+        };
+        mark(A.row_ptr, A.col_ind);
+        mark(At.row_ptr, At.col_ind);
+        size_t c = 0;
+        while (c < numColors && forbidden[c] == i)
+        {
+            c++;
+        }
+        if (c == numColors)
+        {
+            numColors++;
+            forbidden.push_back(uncolored);
+        }
+        color[i] = c;
+    }
+
+    RowColoring coloring;
+    coloring.color_ptr.assign(numColors + 1, 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        coloring.color_ptr[color[i] + 1]++;
+    }
+    for (size_t c = 0; c < numColors; c++)
+    {
+        coloring.color_ptr[c + 1] += coloring.color_ptr[c];
+    }
+    coloring.rows.resize(n);
+    vector<size_t> next(coloring.color_ptr.begin(), coloring.color_ptr.end() - 1);
+    for (size_t i = 0; i < n; i++)
+    {
+        coloring.rows[next[color[i]]++] = i;
+    }
+    return coloring;
+}
+
+/**
+ * @brief Relaxes all rows of one color in parallel. The rows of a color are not
+ * coupled to each other, so updating x in place is race free.
+ */
+template <typename T>
+void sor_color_sweep_CSR(const CSRMatrix<T> &A,
+                         const RowColoring &coloring,
+                         size_t c,
+                         const std::vector<T> &diag,
+                         const std::vector<T> &b,
+                         std::vector<T> &x,
+                         const T omega)
+{
+    tbb::parallel_for(tbb::blocked_range<size_t>(coloring.color_ptr[c], coloring.color_ptr[c + 1]), [&](tbb::blocked_range<size_t> r){
+        for (size_t idx = r.begin(); idx < r.end(); idx++)
+        {
+            const size_t i = coloring.rows[idx];
+            T sum = 0.0;
+            for (size_t k = A.row_ptr[i]; k < A.row_ptr[i + 1]; k++)
+            {
+                if (A.col_ind[k] != i)
+                {
+                    sum += A.val[k] * x[A.col_ind[k]];
+                }
+            }
+            x[i] = (1.0 - omega) * x[i] + (omega / diag[i]) * (b[i] - sum);
+        }
+    });
+}
+
+/**
+ * @brief Multicolor SSOR. The rows are grouped by color_rows_CSR; a forward sweep
+ * relaxes the colors in order 0..c-1 and the backward sweep in order c-1..0, with the
+ * rows inside a color relaxed in parallel. This is a true SSOR on the color-permuted
+ * matrix, so the iterates (and the iteration count) are the same for any number of
+ * threads.
+ *
+ * @tparam T
+ * @param A
+ * @param b
+ * @param tol - max-norm of the change in x between iterations
+ * @param max_iter
+ * @param omega - relaxation parameter (0 < omega < 2)
+ * @return std::vector<T>
+ */
+template <typename T>
+std::vector<T> ssor_iteration_CSR(const CSRMatrix<T> &A,
                                   const std::vector<T> &b,
                                   const T tol,
                                   const int max_iter,
                                   const T omega)
 {
     const size_t n = A.numRows;
+    const std::vector<T> diag = diagonal_CSR(A);
+    for (size_t i = 0; i < n; i++)
+    {
+        if (diag[i] == 0)
+        {
+            throw std::invalid_argument("SSOR requires a nonzero diagonal.");
+        }
+    }
+    const RowColoring coloring = color_rows_CSR(A);
+    const size_t numColors = coloring.numColors();
     std::vector<T> x(n, 0.0);
-    std::vector<T> x_new(n, 0.0);
+    std::vector<T> x_old(n, 0.0);
 
     int iter = 0;
     T diff = tol + 1.0;
 
     while (iter < max_iter && diff > tol)
     {
-        // Normally one needs to solve M(x_new - x) = b - Ax using lu_solve where M = (D + omega*L)^-1 * (D + omega*U),
-        // L is the strict lower triangular part of A, U is the strict upper triangular part of A, and D is the diagonal of A.
-        // However, according to https://en.wikipedia.org/wiki/Successive_over-relaxation, we can use forward substitution:
-        tbb::parallel_for( tbb::blocked_range<size_t>(0, A.numRows), [&](tbb::blocked_range<size_t> r){
-        for(size_t i = r.begin(); i < r.end(); i++){
-            T sum = 0.0;
-            T diag = 0.0;
-            for (size_t k = A.row_ptr[i]; k < A.row_ptr[i+1]; k++) {
-                size_t j = A.col_ind[k];
-                if (j < i) {
-                    sum += A.val[k] * x_new[j];
-                } else if (j > i) {
-                    sum += A.val[k] * x[j];
-                } else {
-                    diag = A.val[k];
-                }
-            }
-            x_new[i] = (1.0 - omega) * x[i] + (omega / diag) * (b[i] - sum);
-        }});
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, n), [&](tbb::blocked_range<size_t> r){
+            std::copy(x.begin() + r.begin(), x.begin() + r.end(), x_old.begin() + r.begin());
+        });
+        for (size_t c = 0; c < numColors; c++)
+        {
+            sor_color_sweep_CSR(A, coloring, c, diag, b, x, omega);
+        }
+        for (size_t c = numColors; c-- > 0;)
+        {
+            sor_color_sweep_CSR(A, coloring, c, diag, b, x, omega);
+        }
         // Compute the difference between the new and old iterates
-        diff = 0.0;
-        for (size_t i = 0; i < n; i++)
+        diff = tbb::parallel_reduce(
+            tbb::blocked_range<size_t>(0, n),
+            T(0.0),
+            [&](const tbb::blocked_range<size_t>& r, T local) {
+                for (size_t i = r.begin(); i != r.end(); ++i)
+                {
+                    local = std::max(local, static_cast<T>(std::abs(x[i] - x_old[i])));
+                }
+                return local;
+            },
+            [](T a, T b) { return std::max(a, b); }
+        );
+        iter++;
+    }
+    return x;
+}
+
+/**
+ * @brief Multicolor SSOR preconditioner, z = M^-1 r. Same M as the serial
+ * make_ssor_preconditioner_CSR but for the color-permuted matrix: a forward sweep over
+ * the colors, a diagonal scaling and a backward sweep, each color done in parallel.
+ * Keeps a reference to A, so A must outlive it.
+ *
+ * @tparam T
+ * @param A
+ * @param omega relaxation parameter (0 < omega < 2)
+ * @return PreconditionerCSR<T>
+ */
+template <typename T>
+PreconditionerCSR<T> make_ssor_preconditioner_CSR(const CSRMatrix<T> &A, const T omega)
+{
+    std::vector<T> diag = diagonal_CSR(A);
+    for (size_t i = 0; i < A.numRows; i++)
+    {
+        if (diag[i] == 0)
+        {
+            throw std::invalid_argument("SSOR requires a nonzero diagonal.");
+        }
+    }
+    RowColoring coloring = color_rows_CSR(A);
+    // color[i] of each row, to tell which neighbours come "before" row i
+    std::vector<size_t> color(A.numRows);
+    for (size_t c = 0; c < coloring.numColors(); c++)
+    {
+        for (size_t idx = coloring.color_ptr[c]; idx < coloring.color_ptr[c + 1]; idx++)
+        {
+            color[coloring.rows[idx]] = c;
+        }
+    }
+    return [&A, diag, coloring, color, omega](const std::vector<T> &r, std::vector<T> &z)
+    {
+        const size_t numColors = coloring.numColors();
+        z.resize(A.numRows);
+        auto solve_color = [&](size_t c, bool lower) {
+            tbb::parallel_for(tbb::blocked_range<size_t>(coloring.color_ptr[c], coloring.color_ptr[c + 1]), [&](tbb::blocked_range<size_t> range){
+                for (size_t idx = range.begin(); idx < range.end(); idx++)
+                {
+                    const size_t i = coloring.rows[idx];
+                    T sum = z[i];
+                    for (size_t k = A.row_ptr[i]; k < A.row_ptr[i + 1]; k++)
+                    {
+                        const size_t cj = color[A.col_ind[k]];
+                        if ((lower && cj < c) || (!lower && cj > c))
+                        {
+                            sum -= A.val[k] * z[A.col_ind[k]];
+                        }
+                    }
+                    z[i] = sum * omega / diag[i];
+                }
+            });
+        };
+        std::copy(r.begin(), r.end(), z.begin());
+        for (size_t c = 0; c < numColors; c++)
         {
-            T abs_diff = std::abs(x_new[i] - x[i]);
-            if (abs_diff > diff)
+            solve_color(c, true);
+        }
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, A.numRows), [&](tbb::blocked_range<size_t> range){
+            for (size_t i = range.begin(); i < range.end(); i++)
             {
-                diff = abs_diff;
+                z[i] *= (2.0 - omega) / omega * diag[i] / omega;
             }
+        });
+        for (size_t c = numColors; c-- > 0;)
+        {
+            solve_color(c, false);
         }
-        x = x_new;
-        iter++;
+    };
+}
+
+/// @brief Parallel sparse matrix vector product y = A x, rows split across threads
+/// @tparam T The type of the matrix
+/// @param A The CSR matrix
+/// @param x The vector to multiply
+/// @param y The result, resized to A.numRows
+template <typename T>
+void matrix_vector_product_CSR(const CSRMatrix<T> &A, const std::vector<T> &x, std::vector<T> &y) {
+    y.resize(A.numRows);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, A.numRows), [&](const tbb::blocked_range<size_t> &r) {
+        for (size_t i = r.begin(); i < r.end(); i++) {
+            T sum = 0;
+            for (size_t k = A.row_ptr[i]; k < A.row_ptr[i + 1]; k++) {
+                sum += A.val[k] * x[A.col_ind[k]];
+            }
+            y[i] = sum;
+        }
+    });
+}
+
+/// @brief Parallel sparse matrix vector product
+/// @tparam T The type of the matrix
+/// @param A The CSR matrix
+/// @param x The vector to multiply
+/// @return A x
+template <typename T>
+std::vector<T> matrix_vector_product_CSR(const CSRMatrix<T> &A, const std::vector<T> &x) {
+    std::vector<T> y;
+    parallel::matrix_vector_product_CSR(A, x, y);
+    return y;
+}
+
+/**
+ * @brief Parallel version of chebyshev_smooth_CSR. Every step is a parallel SpMV
+ * followed by one parallel vector update, there are no reductions at all.
+ *
+ * @tparam T
+ * @param A
+ * @param C from chebyshev_setup_CSR
+ * @param b
+ * @param x initial guess on input, improved on output
+ */
+template <typename T>
+void chebyshev_smooth_CSR(const CSRMatrix<T> &A, const ChebyshevCSR<T> &C, const std::vector<T> &b, std::vector<T> &x) {
+    const T theta = (C.upper + C.lower) / 2.0;
+    const T delta = (C.upper - C.lower) / 2.0;
+    const T sigma = theta / delta;
+    std::vector<T> &r = C.r, &d = C.d, &w = C.w;
+    const tbb::blocked_range<size_t> rows(0, A.numRows);
+    parallel::matrix_vector_product_CSR(A, x, r);
+    tbb::parallel_for(rows, [&](const tbb::blocked_range<size_t> &range) {
+        for (size_t i = range.begin(); i < range.end(); i++) {
+            r[i] = b[i] - r[i];
+            d[i] = C.invDiag[i] * r[i] / theta;
+        }
+    });
+    T rho = 1.0 / sigma;
+    for (int k = 0; k + 1 < C.degree; k++) {
+        parallel::matrix_vector_product_CSR(A, d, w);
+        const T rhoNew = 1.0 / (2.0 * sigma - rho);
+        tbb::parallel_for(rows, [&](const tbb::blocked_range<size_t> &range) {
+            for (size_t i = range.begin(); i < range.end(); i++) {
+                x[i] += d[i];
+                r[i] -= w[i];
+                d[i] = rhoNew * rho * d[i] + 2.0 * rhoNew / delta * C.invDiag[i] * r[i];
+            }
+        });
+        rho = rhoNew;
     }
+    tbb::parallel_for(rows, [&](const tbb::blocked_range<size_t> &range) {
+        for (size_t i = range.begin(); i < range.end(); i++) {
+            x[i] += d[i];
+        }
+    });
+}
+
+/**
+ * @brief Parallel version of make_chebyshev_preconditioner_CSR, z = p(D^-1 A) D^-1 r
+ *
+ * @tparam T
+ * @param A must outlive the preconditioner
+ * @param C from chebyshev_setup_CSR, copied into the preconditioner
+ * @return PreconditionerCSR<T>
+ */
+template <typename T>
+PreconditionerCSR<T> make_chebyshev_preconditioner_CSR(const CSRMatrix<T> &A, const ChebyshevCSR<T> &C) {
+    return [&A, C](const std::vector<T> &r, std::vector<T> &z) {
+        z.assign(r.size(), 0.0);
+        parallel::chebyshev_smooth_CSR(A, C, r, z);
+    };
+}
+
+/**
+ * @brief Parallel Conjugate Gradient for CSR, the reference for the pipelined and
+ * s-step variants below. Every iteration has two reductions, (p, Ap) and (r, r),
+ * each fused with the loop before it.
+ *
+ * @tparam T
+ * @param A symmetric positive definite matrix
+ * @param b
+ * @param x0 initial guess
+ * @param maxit
+ * @param tol tolerance on the 2-norm of the residual
+ * @param info optional convergence report
+ * @return std::vector<T>
+ */
+template <typename T>
+std::vector<T> conjugate_gradient_CSR(const CSRMatrix<T> &A, const std::vector<T> &b, std::vector<T> x0,
+                                      int maxit, double tol, SolverInfo *info = nullptr) {
+    const size_t n = b.size();
+    std::vector<T> &x = x0;
+    x.resize(n, 0.0);
+    std::vector<T> r(n), p(n), Ap(n);
+    const tbb::blocked_range<size_t> rows(0, n);
+
+    parallel::matrix_vector_product_CSR(A, x, Ap);
+    T rr = tbb::parallel_reduce(rows, T(0), [&](const tbb::blocked_range<size_t> &range, T sum) {
+        for (size_t k = range.begin(); k < range.end(); k++) {
+            r[k] = b[k] - Ap[k];
+            p[k] = r[k];
+            sum += r[k] * r[k];
+        }
+        return sum;
+    }, std::plus<T>());
+    T normR = std::sqrt(rr);
+    if (info) {
+        info->residuals.assign(1, normR);
+    }
+    int i = 0;
+    while (i < maxit && normR >= tol) {
+        // Ap = A p and (p, Ap)
+        const T pAp = tbb::parallel_reduce(rows, T(0), [&](const tbb::blocked_range<size_t> &range, T sum) {
+            for (size_t k = range.begin(); k < range.end(); k++) {
+                T value = 0;
+                for (size_t e = A.row_ptr[k]; e < A.row_ptr[k + 1]; e++) {
+                    value += A.val[e] * p[A.col_ind[e]];
+                }
+                Ap[k] = value;
+                sum += p[k] * value;
+            }
+            return sum;
+        }, std::plus<T>());
+        const T alpha = rr / pAp;
+        const T rrNew = tbb::parallel_reduce(rows, T(0), [&](const tbb::blocked_range<size_t> &range, T sum) {
+            for (size_t k = range.begin(); k < range.end(); k++) {
+                x[k] += alpha * p[k];
+                r[k] -= alpha * Ap[k];
+                sum += r[k] * r[k];
+            }
+            return sum;
+        }, std::plus<T>());
+        const T beta = rrNew / rr;
+        rr = rrNew;
+        tbb::parallel_for(rows, [&](const tbb::blocked_range<size_t> &range) {
+            for (size_t k = range.begin(); k < range.end(); k++) {
+                p[k] = r[k] + beta * p[k];
+            }
+        });
+        normR = std::sqrt(rr);
+        if (info) {
+            info->residuals.push_back(normR);
+        }
+        i++;
+    }
+    if (info) {
+        info->iterations = i;
+        info->converged = normR < tol;
+    }
+    std::cerr << "CG Iterations: " << i << std::endl;
+    return x;
+}
+
+/**
+ * @brief Parallel pipelined CG, see pipelined_conjugate_gradient_CSR. An iteration is
+ * one parallel_reduce over the rows: each task runs pipelined_cg_rows on its rows, so
+ * it computes its part of q = A w while it updates the vectors and accumulates its part
+ * of (r, r) and (Ar, r). The SpMV and the reduction share one pass and there is one
+ * barrier per iteration. The CG
+ * above has three parallel passes, two of them reductions.
+ *
+ * @tparam T
+ * @param A symmetric positive definite matrix
+ * @param b
+ * @param x0 initial guess
+ * @param maxit
+ * @param tol tolerance on the 2-norm of the residual
+ * @param info optional convergence report
+ * @return std::vector<T>
+ */
+template <typename T>
+std::vector<T> pipelined_conjugate_gradient_CSR(const CSRMatrix<T> &A, const std::vector<T> &b, std::vector<T> x0,
+                                                int maxit, double tol, SolverInfo *info = nullptr) {
+    const size_t n = b.size();
+    std::vector<T> &x = x0;
+    x.resize(n, 0.0);
+    std::vector<T> r(n), w(n), wNext(n), z(n), s(n), p(n);
+    const tbb::blocked_range<size_t> rows(0, n);
+    // (gamma, delta) = ((r, r), (w, r)), reduced together
+    using Dots = std::pair<T, T>;
+    auto addDots = [](const Dots &a, const Dots &c) { return Dots(a.first + c.first, a.second + c.second); };
+    Dots dots(0, 0);
+    T gammaOld = 0, alphaOld = 0;
+    bool restart = true;
+
+    auto start = [&]() {
+        parallel::matrix_vector_product_CSR(A, x, wNext);
+        tbb::parallel_for(rows, [&](const tbb::blocked_range<size_t> &range) {
+            for (size_t k = range.begin(); k < range.end(); k++) {
+                r[k] = b[k] - wNext[k];
+            }
+        });
+        parallel::matrix_vector_product_CSR(A, r, w);
+        dots = tbb::parallel_reduce(rows, Dots(0, 0), [&](const tbb::blocked_range<size_t> &range, Dots sum) {
+            for (size_t k = range.begin(); k < range.end(); k++) {
+                sum.first += r[k] * r[k];
+                sum.second += w[k] * r[k];
+            }
+            return sum;
+        }, addDots);
+        restart = true;
+    };
+    start();
+    T normR = std::sqrt(dots.first);
+    if (info) {
+        info->residuals.assign(1, normR);
+    }
+    int i = 0;
+    while (i < maxit) {
+        if (normR < tol) {
+            start();
+            normR = std::sqrt(dots.first);
+            if (normR < tol) {
+                break;
+            }
+        }
+        const T gamma = dots.first;
+        const T delta = dots.second;
+        T alpha, beta;
+        if (restart) {
+            beta = 0;
+            alpha = gamma / delta;
+            restart = false;
+        } else {
+            beta = gamma / gammaOld;
+            alpha = gamma / (delta - beta * gamma / alphaOld);
+        }
+        gammaOld = gamma;
+        alphaOld = alpha;
+        dots = tbb::parallel_reduce(rows, Dots(0, 0), [&](const tbb::blocked_range<size_t> &range, Dots sum) {
+            // the SpMV reads the old w, which no task writes
+            pipelined_cg_rows(A, range.begin(), range.end(), alpha, beta, w.data(), wNext.data(), z.data(), s.data(),
+                              p.data(), x.data(), r.data(), sum.first, sum.second);
+            return sum;
+        }, addDots);
+        w.swap(wNext);
+        normR = std::sqrt(dots.first);
+        if (info) {
+            info->residuals.push_back(normR);
+        }
+        i++;
+    }
+    if (info) {
+        info->iterations = i;
+        info->converged = normR < tol;
+    }
+    std::cerr << "Pipelined CG Iterations: " << i << std::endl;
+    return x;
+}
+
+/**
+ * @brief Parallel s-step CG, see s_step_conjugate_gradient_CSR. The basis SpMVs and
+ * the update are parallel loops, and the whole Gram matrix is one parallel reduction,
+ * so there is a single reduction every s iterations. A TBB reduction costs far less
+ * than the extra SpMV and basis work per iteration that this buys (see the serial
+ * version), so on shared memory it is 2 to 3 times slower than conjugate_gradient_CSR
+ * and is kept for comparison.
+ *
+ * @tparam T
+ * @param A symmetric positive definite matrix
+ * @param b
+ * @param x0 initial guess
+ * @param s iterations per outer step, 2 to 5 is sensible
+ * @param maxit maximum number of (inner) iterations
+ * @param tol tolerance on the 2-norm of the residual
+ * @param info optional convergence report
+ * @return std::vector<T>
+ */
+template <typename T>
+std::vector<T> s_step_conjugate_gradient_CSR(const CSRMatrix<T> &A, const std::vector<T> &b, std::vector<T> x0,
+                                             int s, int maxit, double tol, SolverInfo *info = nullptr) {
+    if (s < 1) {
+        throw std::invalid_argument("s-step CG needs s >= 1.");
+    }
+    const size_t n = b.size();
+    const int m = 2 * s + 1;
+    std::vector<T> &x = x0;
+    x.resize(n, 0.0);
+    std::vector<T> r(n), p(n), V(m * n), G(m * m), xc, rc, pc;
+    const tbb::blocked_range<size_t> rows(0, n);
+
+    const T theta = tbb::parallel_reduce(rows, T(0), [&](const tbb::blocked_range<size_t> &range, T norm) {
+        for (size_t k = range.begin(); k < range.end(); k++) {
+            T rowSum = 0;
+            for (size_t e = A.row_ptr[k]; e < A.row_ptr[k + 1]; e++) {
+                rowSum += std::abs(A.val[e]);
+            }
+            norm = std::max(norm, rowSum);
+        }
+        return norm;
+    }, [](T a, T c) { return std::max(a, c); }) / 2.0;
+    auto trueResidual = [&]() {
+        parallel::matrix_vector_product_CSR(A, x, r);
+        return std::sqrt(tbb::parallel_reduce(rows, T(0), [&](const tbb::blocked_range<size_t> &range, T sum) {
+            for (size_t k = range.begin(); k < range.end(); k++) {
+                r[k] = b[k] - r[k];
+                p[k] = r[k];
+                sum += r[k] * r[k];
+            }
+            return sum;
+        }, std::plus<T>()));
+    };
+    T normR = trueResidual();
+    if (info) {
+        info->residuals.assign(1, normR);
+    }
+    int i = 0;
+    while (i < maxit && normR >= tol) {
+        std::copy(p.begin(), p.end(), V.begin());
+        std::copy(r.begin(), r.end(), V.begin() + (s + 1) * n);
+        for (int c = 0; c < m - 1; c++) {
+            if (c == s) {
+                continue;
+            }
+            const T *in = V.data() + c * n;
+            T *out = V.data() + (c + 1) * n;
+            tbb::parallel_for(rows, [&](const tbb::blocked_range<size_t> &range) {
+                for (size_t k = range.begin(); k < range.end(); k++) {
+                    T value = 0;
+                    for (size_t e = A.row_ptr[k]; e < A.row_ptr[k + 1]; e++) {
+                        value += A.val[e] * in[A.col_ind[e]];
+                    }
+                    out[k] = value / theta;
+                }
+            });
+        }
+        // upper triangle of the Gram matrix in one reduction
+        G = tbb::parallel_reduce(rows, std::vector<T>(m * m, 0.0),
+            [&](const tbb::blocked_range<size_t> &range, std::vector<T> local) {
+                for (size_t k = range.begin(); k < range.end(); k++) {
+                    for (int a = 0; a < m; a++) {
+                        const T va = V[a * n + k];
+                        for (int c = a; c < m; c++) {
+                            local[a * m + c] += va * V[c * n + k];
+                        }
+                    }
+                }
+                return local;
+            },
+            [](std::vector<T> a, const std::vector<T> &c) {
+                for (size_t e = 0; e < a.size(); e++) {
+                    a[e] += c[e];
+                }
+                return a;
+            });
+        for (int a = 0; a < m; a++) {
+            for (int c = 0; c < a; c++) {
+                G[a * m + c] = G[c * m + a];
+            }
+        }
+
+        const int steps = s_step_inner_iterations(G, s, maxit - i, theta, tol, xc, rc, pc, normR, info);
+        if (steps == 0) {
+            throw std::runtime_error("s-step CG basis is not positive definite, use a smaller s.");
+        }
+        i += steps;
+        tbb::parallel_for(rows, [&](const tbb::blocked_range<size_t> &range) {
+            for (size_t k = range.begin(); k < range.end(); k++) {
+                T rk = 0, pk = 0;
+                for (int c = 0; c < m; c++) {
+                    const T v = V[c * n + k];
+                    x[k] += xc[c] * v;
+                    rk += rc[c] * v;
+                    pk += pc[c] * v;
+                }
+                r[k] = rk;
+                p[k] = pk;
+            }
+        });
+        if (normR < tol) {
+            normR = trueResidual();
+            if (info) {
+                info->residuals.back() = normR;
+            }
+        }
+    }
+    if (info) {
+        info->iterations = i;
+        info->converged = normR < tol;
+    }
+    std::cerr << "s-step CG Iterations: " << i << std::endl;
     return x;
 }
 
+/// @brief Parallel sparse matrix times dense block, Y = A X, with row blocks split
+/// across threads and the serial kernel vectorized across the k columns
+/// @param Y output, resized to n x k
+template <typename T>
+void multiply_block_CSR(const CSRMatrix<T> &A, const DenseBlock<T> &X, DenseBlock<T> &Y) {
+    if (A.numColumns != X.numRows) {
+        throw std::invalid_argument("Matrix and block dimensions do not match.");
+    }
+    const size_t k = X.numColumns;
+    Y.numRows = A.numRows;
+    Y.numColumns = k;
+    Y.val.resize(A.numRows * k);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, A.numRows), [&](const tbb::blocked_range<size_t> &r) {
+        spmm_rows_CSR<T, false>(A, X.val.data(), k, Y.val.data(), k, k, r.begin(), r.end());
+    });
+}
+
+/// @brief Parallel sparse matrix times column-major dense block, Y = A X
+/// @param Y output, resized to n x k
+template <typename T>
+void multiply_block_CSR(const CSRMatrix<T> &A, const ColumnMajorBlock<T> &X, ColumnMajorBlock<T> &Y) {
+    if (A.numColumns != X.numRows) {
+        throw std::invalid_argument("Matrix and block dimensions do not match.");
+    }
+    Y.numRows = A.numRows;
+    Y.numColumns = X.numColumns;
+    Y.val.resize(A.numRows * X.numColumns);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, A.numRows), [&](const tbb::blocked_range<size_t> &r) {
+        spmm_rows_CSR<T, true>(A, X.val.data(), X.numRows, Y.val.data(), Y.numRows, X.numColumns, r.begin(), r.end());
+    });
+}
+
+/// @brief Parallel sparse matrix times dense block, either layout
+/// @return A X
+template <typename Block, typename T>
+Block multiply_block_CSR(const CSRMatrix<T> &A, const Block &X) {
+    Block Y;
+    parallel::multiply_block_CSR(A, X, Y);
+    return Y;
+}
+
+/**
+ * @brief Parallel Y = A^T X without forming the transpose. Rows of A scatter into
+ * arbitrary rows of Y, so every thread accumulates into its own copy of Y and the
+ * copies are summed in parallel at the end; this needs one m x k buffer per thread.
+ *
+ * @tparam Block DenseBlock<T> or ColumnMajorBlock<T>
+ * @tparam T
+ * @param A n x m CSR matrix
+ * @param X n x k block
+ * @param Y output, resized to m x k
+ */
+template <typename Block, typename T>
+void multiply_block_transpose_CSR(const CSRMatrix<T> &A, const Block &X, Block &Y) {
+    if (A.numRows != X.numRows) {
+        throw std::invalid_argument("Matrix and block dimensions do not match.");
+    }
+    constexpr bool columnMajor = std::is_same<Block, ColumnMajorBlock<T>>::value;
+    const size_t k = X.numColumns;
+    const size_t ldx = columnMajor ? X.numRows : k;
+    const size_t ldy = columnMajor ? A.numColumns : k;
+    Y.numRows = A.numColumns;
+    Y.numColumns = k;
+    tbb::enumerable_thread_specific<std::vector<T>> partial(std::vector<T>(A.numColumns * k, 0.0));
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, A.numRows), [&](const tbb::blocked_range<size_t> &r) {
+        spmm_transpose_rows_CSR<T, columnMajor>(A, X.val.data(), ldx, partial.local().data(), ldy, k, r.begin(), r.end());
+    });
+    Y.val.assign(A.numColumns * k, 0.0);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, Y.val.size()), [&](const tbb::blocked_range<size_t> &r) {
+        for (const std::vector<T> &local : partial) {
+            for (size_t e = r.begin(); e < r.end(); e++) {
+                Y.val[e] += local[e];
+            }
+        }
+    });
+}
+
+/// @brief Parallel transposed sparse matrix times dense block, either layout
+/// @return A^T X
+template <typename Block, typename T>
+Block multiply_block_transpose_CSR(const CSRMatrix<T> &A, const Block &X) {
+    Block Y;
+    parallel::multiply_block_transpose_CSR(A, X, Y);
+    return Y;
+}
+
 }
 
 // int main() {
@@ -617,4 +1492,6 @@ std::vector<T> ssor_iteration_CSR(CSRMatrix<T> A,
 //     }
 //     cerr<< endl;
 //   return 0;
-// }
\ No newline at end of file
+// }
+
+#endif
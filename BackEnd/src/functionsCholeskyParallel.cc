@@ -0,0 +1,500 @@
+// functionsCholeskyParallel.cc
+// Supernodal sparse Cholesky, P A P^T = L L^T, for symmetric positive definite CSR
+// matrices. The analysis (fill-reducing ordering, elimination tree, structure of L and
+// the supernodes) is done once; the numeric factorization works on dense column-major
+// supernode panels with blocked kernels and factors independent subtrees of the
+// supernodal elimination tree in parallel. The factor is kept for any number of
+// solves.
+
+#ifndef FUNCTIONS_CHOLESKY_PARALLEL_CC
+#define FUNCTIONS_CHOLESKY_PARALLEL_CC
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+#include <tbb/tbb.h>
+#include "functionsCSR.cc"
+#include "functionsOrdering.cc"
+
+namespace parallel {
+using namespace std;
+
+/**
+ * @brief Result of cholesky_analyze_CSR. Supernode s holds the columns
+ * supernodeStart[s] ... supernodeStart[s + 1] - 1 of L, which share one row
+ * structure: rows[rowPtr[s]] ... rows[rowPtr[s + 1] - 1], sorted, beginning with the
+ * supernode's own columns. Its values are a dense column-major panel of
+ * (rowPtr[s + 1] - rowPtr[s]) x (width) at val[panelPtr[s]] in the factor.
+ */
+class CholeskySymbolic
+{
+public:
+    size_t n = 0;
+    /// perm[new] = old, the fill-reducing ordering
+    vector<size_t> perm;
+    vector<size_t> inverse;
+    /// elimination tree of the permuted matrix, n for a root
+    vector<size_t> parent;
+    vector<size_t> supernodeStart;
+    /// supernode of every column
+    vector<size_t> supernodeOf;
+    vector<size_t> supernodeParent;
+    vector<size_t> rowPtr;
+    vector<size_t> rows;
+    vector<size_t> panelPtr;
+    /// the supernodes whose columns update supernode s, in increasing order
+    vector<vector<size_t>> updaters;
+
+    size_t numSupernodes() const { return supernodeStart.size() - 1; }
+    /// nonzeros of L, counting each supernode's dense diagonal triangle once
+    size_t factorNonzeros() const
+    {
+        size_t count = 0;
+        for (size_t s = 0; s < numSupernodes(); s++)
+        {
+            const size_t m = rowPtr[s + 1] - rowPtr[s], w = supernodeStart[s + 1] - supernodeStart[s];
+            count += m * w - w * (w - 1) / 2;
+        }
+        return count;
+    }
+};
+
+/// @brief The numeric supernodal Cholesky factor, see CholeskySymbolic for the layout
+template <typename T>
+class CholeskyFactor
+{
+public:
+    CholeskySymbolic symbolic;
+    vector<T> val;
+};
+
+/**
+ * @brief The elimination tree of a symmetric matrix (Liu's algorithm with path
+ * compression), from the entries A(i, k), i < k, of every row k.
+ *
+ * @tparam T
+ * @param A symmetric matrix, both triangles stored
+ * @return vector<size_t> parent of every column, n for a root
+ */
+template <typename T>
+vector<size_t> elimination_tree_CSR(const CSRMatrix<T> &A)
+{
+    const size_t n = A.numRows;
+    vector<size_t> parent(n, n), ancestor(n, n);
+    for (size_t k = 0; k < n; k++)
+    {
+        for (size_t p = A.row_ptr[k]; p < A.row_ptr[k + 1]; p++)
+        {
+            size_t i = A.col_ind[p];
+            while (i < k)
+            {
+                const size_t next = ancestor[i];
+                ancestor[i] = k;
+                if (next == n)
+                {
+                    parent[i] = k;
+                    break;
+                }
+                i = next;
+            }
+        }
+    }
+    return parent;
+}
+
+/**
+ * @brief Symbolic analysis for cholesky_factor_CSR: the ordering, the elimination tree,
+ * the structure of L and its supernodes. Columns j and j + 1 share a supernode when
+ * j + 1 is the parent of j and the structure of j is that of j + 1 plus j + 1 itself.
+ * Only the pattern of A is used, so the result serves every matrix with that pattern.
+ *
+ * @tparam T
+ * @param A symmetric matrix, both triangles stored (see symmetric_from_triangle_CSR)
+ * @param ordering fill-reducing ordering to apply first
+ * @return CholeskySymbolic
+ */
+template <typename T>
+CholeskySymbolic cholesky_analyze_CSR(const CSRMatrix<T> &A, Ordering ordering = Ordering::NestedDissection)
+{
+    if (A.numRows != A.numColumns)
+    {
+        throw std::invalid_argument("The Cholesky factorization needs a square matrix.");
+    }
+    const size_t n = A.numRows;
+    CholeskySymbolic S;
+    S.n = n;
+    S.perm = compute_ordering_CSR(A, ordering);
+    S.inverse = inverse_permutation(S.perm);
+    const CSRMatrix<T> B = permute_symmetric_CSR(A, S.perm);
+    S.parent = elimination_tree_CSR(B);
+
+    // structure of L row by row: row k is the union of the etree paths from the
+    // entries B(k, i), i < k, up to k. Rows arrive in increasing order, so every
+    // column structure comes out sorted. Run twice, to count and then to fill.
+    vector<size_t> count(n, 0), mark(n, n), colPtr(n + 1, 0), colRows;
+    auto rowStructures = [&](bool fill)
+    {
+        std::fill(count.begin(), count.end(), 0);
+        std::fill(mark.begin(), mark.end(), n);
+        for (size_t k = 0; k < n; k++)
+        {
+            mark[k] = k;
+            for (size_t p = B.row_ptr[k]; p < B.row_ptr[k + 1]; p++)
+            {
+                for (size_t i = B.col_ind[p]; i < k && mark[i] != k; i = S.parent[i])
+                {
+                    if (fill)
+                    {
+                        colRows[colPtr[i] + count[i]] = k;
+                    }
+                    count[i]++;
+                    mark[i] = k;
+                }
+            }
+        }
+    };
+    rowStructures(false);
+    for (size_t j = 0; j < n; j++)
+    {
+        colPtr[j + 1] = colPtr[j] + count[j];
+    }
+    colRows.resize(colPtr[n]);
+    rowStructures(true);
+
+    // supernodes and their row structures
+    S.supernodeStart.assign(1, 0);
+    S.supernodeOf.assign(n, 0);
+    for (size_t j = 1; j <= n; j++)
+    {
+        if (j == n || S.parent[j - 1] != j || count[j - 1] != count[j] + 1)
+        {
+            S.supernodeStart.push_back(j);
+        }
+    }
+    S.rowPtr.assign(1, 0);
+    S.panelPtr.assign(1, 0);
+    for (size_t s = 0; s + 1 < S.supernodeStart.size(); s++)
+    {
+        const size_t f = S.supernodeStart[s], l = S.supernodeStart[s + 1];
+        for (size_t j = f; j < l; j++)
+        {
+            S.supernodeOf[j] = s;
+            S.rows.push_back(j);
+        }
+        S.rows.insert(S.rows.end(), colRows.begin() + colPtr[l - 1], colRows.begin() + colPtr[l]);
+        S.rowPtr.push_back(S.rows.size());
+        S.panelPtr.push_back(S.panelPtr[s] + (S.rowPtr[s + 1] - S.rowPtr[s]) * (l - f));
+    }
+
+    const size_t ns = S.numSupernodes();
+    S.supernodeParent.assign(ns, ns);
+    S.updaters.assign(ns, vector<size_t>());
+    for (size_t s = 0; s < ns; s++)
+    {
+        const size_t last = S.supernodeStart[s + 1] - 1;
+        if (S.parent[last] < n)
+        {
+            S.supernodeParent[s] = S.supernodeOf[S.parent[last]];
+        }
+        const size_t w = S.supernodeStart[s + 1] - S.supernodeStart[s];
+        size_t previous = ns;
+        for (size_t p = S.rowPtr[s] + w; p < S.rowPtr[s + 1]; p++)
+        {
+            const size_t target = S.supernodeOf[S.rows[p]];
+            if (target != previous)
+            {
+                S.updaters[target].push_back(s);
+                previous = target;
+            }
+        }
+    }
+    return S;
+}
+
+/// @brief C -= A B^T for column-major A (m x k), B (n x k) and C (m x n), blocked over k
+/// so that the columns of A and B in use stay in cache
+template <typename T>
+void dense_gemm_nt_subtract(size_t m, size_t n, size_t k, const T *A, size_t lda, const T *B, size_t ldb, T *C,
+                            size_t ldc)
+{
+    const size_t kb = 64;
+    for (size_t p0 = 0; p0 < k; p0 += kb)
+    {
+        const size_t p1 = std::min(k, p0 + kb);
+        for (size_t j = 0; j < n; j++)
+        {
+            T *c = C + j * ldc;
+            for (size_t p = p0; p < p1; p++)
+            {
+                const T b = B[j + p * ldb];
+                const T *a = A + p * lda;
+                for (size_t i = 0; i < m; i++)
+                {
+                    c[i] -= a[i] * b;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief In-place Cholesky of a column-major m x w panel whose top w x w block is the
+ * diagonal block: L11 = chol(A11) (POTRF) and L21 = A21 L11^-T (TRSM), done as a
+ * blocked right-looking factorization so that most work is in the GEMM update.
+ *
+ * @tparam T
+ * @param a panel, ld = m
+ * @param m
+ * @param w
+ */
+template <typename T>
+void dense_cholesky_panel(T *a, size_t m, size_t w)
+{
+    const size_t nb = 32;
+    for (size_t b0 = 0; b0 < w; b0 += nb)
+    {
+        const size_t b1 = std::min(w, b0 + nb);
+        // unblocked left-looking factorization of the column block
+        for (size_t j = b0; j < b1; j++)
+        {
+            T *aj = a + j * m;
+            for (size_t c = b0; c < j; c++)
+            {
+                const T *ac = a + c * m;
+                const T factor = ac[j];
+                for (size_t i = j; i < m; i++)
+                {
+                    aj[i] -= ac[i] * factor;
+                }
+            }
+            if (!(aj[j] > 0))
+            {
+                throw std::runtime_error("The matrix is not positive definite.");
+            }
+            const T d = std::sqrt(aj[j]);
+            aj[j] = d;
+            for (size_t i = j + 1; i < m; i++)
+            {
+                aj[i] /= d;
+            }
+        }
+        // trailing update of the remaining columns of the panel
+        if (b1 < w)
+        {
+            dense_gemm_nt_subtract(m - b1, w - b1, b1 - b0, a + b0 * m + b1, m, a + b0 * m + b1, m, a + b1 * m + b1, m);
+        }
+    }
+}
+
+/**
+ * @brief Numeric supernodal Cholesky P A P^T = L L^T. Every supernode is assembled
+ * from A, updated by the supernodes below it in the tree (left-looking, one dense
+ * GEMM per updating supernode) and factored by dense_cholesky_panel. A supernode
+ * becomes ready when all its children are done, so independent subtrees are factored
+ * in parallel by TBB tasks starting from the leaves.
+ *
+ * @tparam T
+ * @param A symmetric positive definite matrix with the pattern given to the analysis
+ * @param S analysis from cholesky_analyze_CSR
+ * @return CholeskyFactor<T>
+ */
+template <typename T>
+CholeskyFactor<T> cholesky_factor_CSR(const CSRMatrix<T> &A, const CholeskySymbolic &S)
+{
+    const size_t n = S.n;
+    if (A.numRows != n || A.numColumns != n)
+    {
+        throw std::invalid_argument("The matrix does not match the Cholesky analysis.");
+    }
+    CholeskyFactor<T> F;
+    F.symbolic = S;
+    F.val.assign(S.panelPtr.back(), 0.0);
+    const size_t ns = S.numSupernodes();
+
+    // relative row positions inside the supernode being factored, and the GEMM result
+    tbb::enumerable_thread_specific<vector<size_t>> positions([n]
+                                                               { return vector<size_t>(n, 0); });
+    tbb::enumerable_thread_specific<vector<T>> buffers;
+    auto factorSupernode = [&](size_t s)
+    {
+        vector<size_t> &position = positions.local();
+        vector<T> &buffer = buffers.local();
+        const size_t f = S.supernodeStart[s], w = S.supernodeStart[s + 1] - f;
+        const size_t *rows = S.rows.data() + S.rowPtr[s];
+        const size_t m = S.rowPtr[s + 1] - S.rowPtr[s];
+        T *panel = F.val.data() + S.panelPtr[s];
+        for (size_t i = 0; i < m; i++)
+        {
+            position[rows[i]] = i;
+        }
+        // lower triangle of column j of P A P^T is row perm[j] of A, by symmetry
+        for (size_t c = 0; c < w; c++)
+        {
+            const size_t old = S.perm[f + c];
+            for (size_t p = A.row_ptr[old]; p < A.row_ptr[old + 1]; p++)
+            {
+                const size_t i = S.inverse[A.col_ind[p]];
+                if (i >= f + c)
+                {
+                    panel[c * m + position[i]] += A.val[p];
+                }
+            }
+        }
+        for (size_t k : S.updaters[s])
+        {
+            const size_t *rk = S.rows.data() + S.rowPtr[k];
+            const size_t mk = S.rowPtr[k + 1] - S.rowPtr[k];
+            const size_t wk = S.supernodeStart[k + 1] - S.supernodeStart[k];
+            const T *lk = F.val.data() + S.panelPtr[k];
+            const size_t p1 = std::lower_bound(rk, rk + mk, f) - rk;
+            const size_t p2 = std::lower_bound(rk + p1, rk + mk, f + w) - rk;
+            const size_t rowsOut = mk - p1, colsOut = p2 - p1;
+            buffer.assign(rowsOut * colsOut, 0.0);
+            dense_gemm_nt_subtract(rowsOut, colsOut, wk, lk + p1, mk, lk + p1, mk, buffer.data(), rowsOut);
+            for (size_t c = 0; c < colsOut; c++)
+            {
+                T *column = panel + (rk[p1 + c] - f) * m;
+                for (size_t i = c; i < rowsOut; i++)
+                {
+                    column[position[rk[p1 + i]]] += buffer[c * rowsOut + i];
+                }
+            }
+        }
+        dense_cholesky_panel(panel, m, w);
+    };
+
+    vector<std::atomic<size_t>> pending(ns);
+    vector<size_t> leaves;
+    for (size_t s = 0; s < ns; s++)
+    {
+        pending[s] = 0;
+    }
+    for (size_t s = 0; s < ns; s++)
+    {
+        if (S.supernodeParent[s] < ns)
+        {
+            pending[S.supernodeParent[s]]++;
+        }
+    }
+    for (size_t s = 0; s < ns; s++)
+    {
+        if (pending[s] == 0)
+        {
+            leaves.push_back(s);
+        }
+    }
+    // the task that finishes the last child of a supernode goes on with the parent
+    tbb::parallel_for_each(leaves.begin(), leaves.end(), [&](size_t s)
+    {
+        while (true)
+        {
+            factorSupernode(s);
+            const size_t p = S.supernodeParent[s];
+            if (p == ns || --pending[p] != 0)
+            {
+                break;
+            }
+            s = p;
+        }
+    });
+    return F;
+}
+
+/// @brief Analysis and numeric factorization in one call
+template <typename T>
+CholeskyFactor<T> cholesky_factor_CSR(const CSRMatrix<T> &A, Ordering ordering = Ordering::NestedDissection)
+{
+    return cholesky_factor_CSR(A, cholesky_analyze_CSR(A, ordering));
+}
+
+/**
+ * @brief Solves A x = b with the factor P A P^T = L L^T: a supernodal forward solve
+ * with L and backward solve with L^T, each a dense triangular solve on the diagonal
+ * block plus a dense update with the rows below it.
+ *
+ * @tparam T
+ * @param F factor from cholesky_factor_CSR
+ * @param b
+ * @return vector<T> x
+ */
+template <typename T>
+vector<T> cholesky_solve_CSR(const CholeskyFactor<T> &F, const vector<T> &b)
+{
+    const CholeskySymbolic &S = F.symbolic;
+    const size_t n = S.n;
+    if (b.size() != n)
+    {
+        throw std::invalid_argument("The right hand side does not match the Cholesky factor.");
+    }
+    vector<T> y = permute_vector(b, S.perm);
+    const size_t ns = S.numSupernodes();
+    for (size_t s = 0; s < ns; s++)
+    {
+        const size_t f = S.supernodeStart[s], w = S.supernodeStart[s + 1] - f;
+        const size_t *rows = S.rows.data() + S.rowPtr[s];
+        const size_t m = S.rowPtr[s + 1] - S.rowPtr[s];
+        const T *panel = F.val.data() + S.panelPtr[s];
+        for (size_t c = 0; c < w; c++)
+        {
+            const T *column = panel + c * m;
+            const T yc = y[f + c] / column[c];
+            y[f + c] = yc;
+            for (size_t i = c + 1; i < w; i++)
+            {
+                y[f + i] -= column[i] * yc;
+            }
+            for (size_t i = w; i < m; i++)
+            {
+                y[rows[i]] -= column[i] * yc;
+            }
+        }
+    }
+    for (size_t s = ns; s-- > 0;)
+    {
+        const size_t f = S.supernodeStart[s], w = S.supernodeStart[s + 1] - f;
+        const size_t *rows = S.rows.data() + S.rowPtr[s];
+        const size_t m = S.rowPtr[s + 1] - S.rowPtr[s];
+        const T *panel = F.val.data() + S.panelPtr[s];
+        for (size_t c = w; c-- > 0;)
+        {
+            const T *column = panel + c * m;
+            T sum = y[f + c];
+            for (size_t i = c + 1; i < w; i++)
+            {
+                sum -= column[i] * y[f + i];
+            }
+            for (size_t i = w; i < m; i++)
+            {
+                sum -= column[i] * y[rows[i]];
+            }
+            y[f + c] = sum / column[c];
+        }
+    }
+    return unpermute_vector(y, S.perm);
+}
+
+/// @brief Solves A X = B for every column of a block with the same factor, the
+/// columns in parallel
+template <typename T>
+ColumnMajorBlock<T> cholesky_solve_CSR(const CholeskyFactor<T> &F, const ColumnMajorBlock<T> &B)
+{
+    if (B.numRows != F.symbolic.n)
+    {
+        throw std::invalid_argument("The right hand sides do not match the Cholesky factor.");
+    }
+    ColumnMajorBlock<T> X(B.numRows, B.numColumns);
+    tbb::parallel_for(size_t(0), B.numColumns, [&](size_t j)
+    {
+        const vector<T> b(B.val.begin() + j * B.numRows, B.val.begin() + (j + 1) * B.numRows);
+        const vector<T> x = parallel::cholesky_solve_CSR(F, b);
+        std::copy(x.begin(), x.end(), X.val.begin() + j * B.numRows);
+    });
+    return X;
+}
+
+} // namespace parallel
+
+#endif
@@ -0,0 +1,322 @@
+// functionsConversion.cc
+// Conversions between the sparse formats (COO, CSR and CSC) and a triplet assembler
+// for finite element and finite difference codes. Everything here is O(nnz) plus the
+// matrix dimensions: no conversion goes through a dense matrix, and entries are placed
+// with counting sorts instead of comparisons.
+
+#ifndef FUNCTIONS_CONVERSION_CC
+#define FUNCTIONS_CONVERSION_CC
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+#include "functionsCSR.cc"
+#include "functionsCSC.cc"
+#include "functionsCOO.cc"
+
+using namespace std;
+
+/**
+ * @brief Stable counting sort of the items 0 ... n - 1 by key(k) < numKeys. On exit the
+ * items with key j are order[ptr[j]] ... order[ptr[j + 1] - 1], in increasing k.
+ *
+ * @tparam KeyOf callable size_t(size_t)
+ * @param n number of items
+ * @param numKeys all keys are below numKeys
+ * @param key key of item k
+ * @param ptr output, numKeys + 1 offsets
+ * @param order output, the items grouped by key
+ */
+template <typename KeyOf>
+void counting_sort_keys(size_t n, size_t numKeys, const KeyOf &key, vector<size_t> &ptr, vector<size_t> &order)
+{
+    ptr.assign(numKeys + 1, 0);
+    for (size_t k = 0; k < n; k++)
+    {
+        ptr[key(k) + 1]++;
+    }
+    for (size_t j = 0; j < numKeys; j++)
+    {
+        ptr[j + 1] += ptr[j];
+    }
+    vector<size_t> next(ptr.begin(), ptr.end() - 1);
+    order.resize(n);
+    for (size_t k = 0; k < n; k++)
+    {
+        order[next[key(k)]++] = k;
+    }
+}
+
+/// @brief Throws unless the triplets have matching lengths and lie inside a
+/// numMajor x numMinor matrix
+template <typename T>
+void check_triplets(const vector<size_t> &major, const vector<size_t> &minor, const vector<T> &values,
+                    size_t numMajor, size_t numMinor)
+{
+    if (major.size() != values.size() || minor.size() != values.size())
+    {
+        throw std::invalid_argument("Error: coordinate and value vectors must have the same length");
+    }
+    for (size_t k = 0; k < values.size(); k++)
+    {
+        if (major[k] >= numMajor || minor[k] >= numMinor)
+        {
+            throw std::invalid_argument("Error: triplet outside of the matrix");
+        }
+    }
+}
+
+/// @brief True if the triplets are sorted by (major, minor) without duplicates
+inline bool triplets_canonical(const vector<size_t> &major, const vector<size_t> &minor)
+{
+    for (size_t k = 1; k < major.size(); k++)
+    {
+        if (major[k] < major[k - 1] || (major[k] == major[k - 1] && minor[k] <= minor[k - 1]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Compresses triplets in any order, possibly with duplicates, into the pointer,
+ * index and value arrays of a CSR (major = row) or CSC (major = column) matrix. The
+ * entries are counting sorted by minor index and then stably by major index, so every
+ * row (column) comes out sorted and its duplicates are adjacent; duplicates are summed.
+ * Canonical input skips the sorts and is only counted and copied.
+ *
+ * @tparam T
+ * @param major row (CSR) or column (CSC) of every entry
+ * @param minor column (CSR) or row (CSC) of every entry
+ * @param values
+ * @param numMajor
+ * @param numMinor
+ * @param ptr output, numMajor + 1 offsets
+ * @param ind output, minor indices
+ * @param val output, values
+ */
+template <typename T>
+void compress_triplets(const vector<size_t> &major, const vector<size_t> &minor, const vector<T> &values,
+                       size_t numMajor, size_t numMinor, vector<size_t> &ptr, vector<size_t> &ind, vector<T> &val)
+{
+    check_triplets(major, minor, values, numMajor, numMinor);
+    const size_t nnz = values.size();
+    if (triplets_canonical(major, minor))
+    {
+        ptr.assign(numMajor + 1, 0);
+        for (size_t k = 0; k < nnz; k++)
+        {
+            ptr[major[k] + 1]++;
+        }
+        for (size_t i = 0; i < numMajor; i++)
+        {
+            ptr[i + 1] += ptr[i];
+        }
+        ind = minor;
+        val = values;
+        return;
+    }
+
+    vector<size_t> minorPtr, byMinor, order;
+    counting_sort_keys(nnz, numMinor, [&](size_t k) { return minor[k]; }, minorPtr, byMinor);
+    counting_sort_keys(nnz, numMajor, [&](size_t k) { return major[byMinor[k]]; }, ptr, order);
+
+    ind.clear();
+    val.clear();
+    ind.reserve(nnz);
+    val.reserve(nnz);
+    size_t start = 0;
+    for (size_t i = 0; i < numMajor; i++)
+    {
+        const size_t end = ptr[i + 1];
+        ptr[i] = ind.size();
+        for (size_t p = start; p < end; p++)
+        {
+            const size_t e = byMinor[order[p]];
+            if (ind.size() > ptr[i] && ind.back() == minor[e])
+            {
+                val.back() += values[e];
+            }
+            else
+            {
+                ind.push_back(minor[e]);
+                val.push_back(values[e]);
+            }
+        }
+        start = end;
+    }
+    ptr[numMajor] = ind.size();
+}
+
+/// @brief Converts a COO matrix in any order to CSR, summing duplicate entries
+template <typename T>
+CSRMatrix<T> convert_COO_to_CSR(const COO::COOMatrix<T> &A)
+{
+    CSRMatrix<T> C;
+    C.numRows = A.numRows;
+    C.numColumns = A.numCols;
+    compress_triplets(A.rowCoord, A.colCoord, A.values, A.numRows, A.numCols, C.row_ptr, C.col_ind, C.val);
+    return C;
+}
+
+/// @brief Converts a COO matrix in any order to CSC, summing duplicate entries
+template <typename T>
+CSCMatrix<T> convert_COO_to_CSC(const COO::COOMatrix<T> &A)
+{
+    CSCMatrix<T> C;
+    C.numRows = A.numRows;
+    C.numColumns = A.numCols;
+    compress_triplets(A.colCoord, A.rowCoord, A.values, A.numCols, A.numRows, C.col_ptr, C.row_ind, C.val);
+    return C;
+}
+
+/**
+ * @brief Transposes compressed storage: (ptr, ind, val) with numMajor major slices
+ * becomes (tptr, tind, tval) with numMinor. The major slices are scattered in order, so
+ * the output slices are sorted whatever the order inside the input slices.
+ */
+template <typename T>
+void transpose_compressed(size_t numMajor, size_t numMinor, const vector<size_t> &ptr, const vector<size_t> &ind,
+                          const vector<T> &val, vector<size_t> &tptr, vector<size_t> &tind, vector<T> &tval)
+{
+    const size_t nnz = ptr[numMajor];
+    tptr.assign(numMinor + 1, 0);
+    for (size_t p = 0; p < nnz; p++)
+    {
+        tptr[ind[p] + 1]++;
+    }
+    for (size_t j = 0; j < numMinor; j++)
+    {
+        tptr[j + 1] += tptr[j];
+    }
+    vector<size_t> next(tptr.begin(), tptr.end() - 1);
+    tind.resize(nnz);
+    tval.resize(nnz);
+    for (size_t i = 0; i < numMajor; i++)
+    {
+        for (size_t p = ptr[i]; p < ptr[i + 1]; p++)
+        {
+            const size_t q = next[ind[p]]++;
+            tind[q] = i;
+            tval[q] = val[p];
+        }
+    }
+}
+
+/// @brief Converts CSR to CSC with a counting transpose, O(nnz + rows + columns)
+template <typename T>
+CSCMatrix<T> convert_CSR_to_CSC(const CSRMatrix<T> &A)
+{
+    CSCMatrix<T> C;
+    C.numRows = A.numRows;
+    C.numColumns = A.numColumns;
+    transpose_compressed(A.numRows, A.numColumns, A.row_ptr, A.col_ind, A.val, C.col_ptr, C.row_ind, C.val);
+    return C;
+}
+
+/// @brief Converts CSC to CSR with a counting transpose, O(nnz + rows + columns)
+template <typename T>
+CSRMatrix<T> convert_CSC_to_CSR(const CSCMatrix<T> &A)
+{
+    CSRMatrix<T> C;
+    C.numRows = A.numRows;
+    C.numColumns = A.numColumns;
+    transpose_compressed(A.numColumns, A.numRows, A.col_ptr, A.row_ind, A.val, C.row_ptr, C.col_ind, C.val);
+    return C;
+}
+
+/// @brief Converts CSR to COO in row-major order
+template <typename T>
+COO::COOMatrix<T> convert_CSR_to_COO(const CSRMatrix<T> &A)
+{
+    COO::COOMatrix<T> C;
+    C.numRows = A.numRows;
+    C.numCols = A.numColumns;
+    C.nnz = A.val.size();
+    C.rowCoord.resize(C.nnz);
+    for (size_t i = 0; i < A.numRows; i++)
+    {
+        std::fill(C.rowCoord.begin() + A.row_ptr[i], C.rowCoord.begin() + A.row_ptr[i + 1], i);
+    }
+    C.colCoord = A.col_ind;
+    C.values = A.val;
+    return C;
+}
+
+/**
+ * @brief Collects the contributions of an assembly loop (finite element matrices,
+ * finite difference stencils) as unsorted triplets and compresses them into CSR in one
+ * pass, summing the contributions that land on the same entry.
+ *
+ * @tparam T
+ */
+template <typename T>
+class TripletAssemblerCSR
+{
+public:
+    size_t numRows = 0, numColumns = 0;
+    vector<size_t> rows, cols;
+    vector<T> vals;
+
+    TripletAssemblerCSR(size_t numRows, size_t numColumns) : numRows(numRows), numColumns(numColumns) {}
+
+    void reserve(size_t n)
+    {
+        rows.reserve(n);
+        cols.reserve(n);
+        vals.reserve(n);
+    }
+
+    /// @brief Adds value to entry (row, col)
+    /// @exception row and col must be inside the matrix
+    void add(size_t row, size_t col, T value)
+    {
+        if (row >= numRows || col >= numColumns)
+        {
+            throw std::invalid_argument("Error: triplet outside of the matrix");
+        }
+        rows.push_back(row);
+        cols.push_back(col);
+        vals.push_back(value);
+    }
+
+    /// @brief Adds a dense element matrix, row-major of size dofs.size() squared, at the
+    /// rows and columns dofs
+    void add_element(const vector<size_t> &dofs, const vector<T> &element)
+    {
+        if (element.size() != dofs.size() * dofs.size())
+        {
+            throw std::invalid_argument("Error: element matrix must be dofs.size() x dofs.size()");
+        }
+        for (size_t a = 0; a < dofs.size(); a++)
+        {
+            for (size_t b = 0; b < dofs.size(); b++)
+            {
+                add(dofs[a], dofs[b], element[a * dofs.size() + b]);
+            }
+        }
+    }
+
+    size_t size() const { return vals.size(); }
+
+    void clear()
+    {
+        rows.clear();
+        cols.clear();
+        vals.clear();
+    }
+
+    /// @brief The assembled matrix, rows sorted and duplicates summed
+    CSRMatrix<T> assemble() const
+    {
+        CSRMatrix<T> A;
+        A.numRows = numRows;
+        A.numColumns = numColumns;
+        compress_triplets(rows, cols, vals, numRows, numColumns, A.row_ptr, A.col_ind, A.val);
+        return A;
+    }
+};
+
+#endif
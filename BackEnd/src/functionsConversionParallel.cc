@@ -0,0 +1,300 @@
+// functionsConversionParallel.cc
+// Parallel versions of the sparse format conversions in functionsConversion.cc. The
+// counting sorts are split into blocks of items that histogram concurrently, the
+// offsets come from parallel prefix sums, and the scatters keep the serial (stable)
+// order, so the results are identical to the serial conversions.
+
+#ifndef FUNCTIONS_CONVERSION_PARALLEL_CC
+#define FUNCTIONS_CONVERSION_PARALLEL_CC
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include <tbb/tbb.h>
+#include "functionsConversion.cc"
+#include "functionsCSRParallel.cc"
+
+namespace parallel {
+using namespace std;
+
+/// @brief Below this many entries the serial conversions are used
+constexpr size_t CONVERSION_PARALLEL_CUTOFF = 1 << 15;
+
+/**
+ * @brief Number of blocks for a parallel counting sort of n items into numKeys buckets.
+ * Every block keeps a histogram of numKeys counters, so the blocks are limited to keep
+ * the histograms no larger than the items.
+ */
+inline size_t counting_sort_blocks(size_t n, size_t numKeys)
+{
+    const size_t wanted = std::min<size_t>(n / (CONVERSION_PARALLEL_CUTOFF / 2) + 1,
+                                           4 * tbb::this_task_arena::max_concurrency());
+    return std::max<size_t>(1, std::min<size_t>(wanted, n / std::max<size_t>(numKeys, 1)));
+}
+
+/**
+ * @brief Parallel version of counting_sort_keys, with the same (stable) result. Block b
+ * histograms its contiguous range of items; the bucket totals go through
+ * prefix_sum_row_counts, and each bucket then hands its blocks their write offsets in
+ * block order.
+ *
+ * @tparam KeyOf callable size_t(size_t)
+ * @param n number of items
+ * @param numKeys all keys are below numKeys
+ * @param key key of item k
+ * @param ptr output, numKeys + 1 offsets
+ * @param order output, the items grouped by key
+ */
+template <typename KeyOf>
+void counting_sort_keys(size_t n, size_t numKeys, const KeyOf &key, vector<size_t> &ptr, vector<size_t> &order)
+{
+    const size_t numBlocks = counting_sort_blocks(n, numKeys);
+    if (numBlocks == 1)
+    {
+        ::counting_sort_keys(n, numKeys, key, ptr, order);
+        return;
+    }
+    const size_t blockSize = (n + numBlocks - 1) / numBlocks;
+    // offsets[b * numKeys + j]: count, then next write position, of key j in block b
+    vector<size_t> offsets(numBlocks * numKeys, 0);
+    tbb::parallel_for(size_t(0), numBlocks, [&](size_t b) {
+        size_t *count = offsets.data() + b * numKeys;
+        const size_t last = std::min(n, (b + 1) * blockSize);
+        for (size_t k = b * blockSize; k < last; k++)
+        {
+            count[key(k)]++;
+        }
+    });
+    ptr.assign(numKeys + 1, 0);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, numKeys), [&](const tbb::blocked_range<size_t> &r) {
+        for (size_t j = r.begin(); j < r.end(); j++)
+        {
+            for (size_t b = 0; b < numBlocks; b++)
+            {
+                ptr[j + 1] += offsets[b * numKeys + j];
+            }
+        }
+    });
+    prefix_sum_row_counts(ptr);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, numKeys), [&](const tbb::blocked_range<size_t> &r) {
+        for (size_t j = r.begin(); j < r.end(); j++)
+        {
+            size_t running = ptr[j];
+            for (size_t b = 0; b < numBlocks; b++)
+            {
+                const size_t count = offsets[b * numKeys + j];
+                offsets[b * numKeys + j] = running;
+                running += count;
+            }
+        }
+    });
+    order.resize(n);
+    tbb::parallel_for(size_t(0), numBlocks, [&](size_t b) {
+        size_t *next = offsets.data() + b * numKeys;
+        const size_t last = std::min(n, (b + 1) * blockSize);
+        for (size_t k = b * blockSize; k < last; k++)
+        {
+            order[next[key(k)]++] = k;
+        }
+    });
+}
+
+/**
+ * @brief Parallel version of compress_triplets: two parallel counting sorts (by minor,
+ * then by major), then a parallel count of the distinct entries of every major slice, a
+ * prefix sum, and a parallel pass that sums each slice's duplicates into place.
+ */
+template <typename T>
+void compress_triplets(const vector<size_t> &major, const vector<size_t> &minor, const vector<T> &values,
+                       size_t numMajor, size_t numMinor, vector<size_t> &ptr, vector<size_t> &ind, vector<T> &val)
+{
+    const size_t nnz = values.size();
+    if (nnz < CONVERSION_PARALLEL_CUTOFF)
+    {
+        ::compress_triplets(major, minor, values, numMajor, numMinor, ptr, ind, val);
+        return;
+    }
+    if (major.size() != nnz || minor.size() != nnz)
+    {
+        throw std::invalid_argument("Error: coordinate and value vectors must have the same length");
+    }
+    const bool inside = tbb::parallel_reduce(
+        tbb::blocked_range<size_t>(0, nnz), true,
+        [&](const tbb::blocked_range<size_t> &r, bool ok) {
+            for (size_t k = r.begin(); ok && k < r.end(); k++)
+            {
+                ok = major[k] < numMajor && minor[k] < numMinor;
+            }
+            return ok;
+        },
+        [](bool x, bool y) { return x && y; });
+    if (!inside)
+    {
+        throw std::invalid_argument("Error: triplet outside of the matrix");
+    }
+
+    vector<size_t> minorPtr, byMinor, sortedPtr, order;
+    parallel::counting_sort_keys(nnz, numMinor, [&](size_t k) { return minor[k]; }, minorPtr, byMinor);
+    parallel::counting_sort_keys(nnz, numMajor, [&](size_t k) { return major[byMinor[k]]; }, sortedPtr, order);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, nnz), [&](const tbb::blocked_range<size_t> &r) {
+        for (size_t p = r.begin(); p < r.end(); p++)
+        {
+            order[p] = byMinor[order[p]];
+        }
+    });
+
+    ptr.assign(numMajor + 1, 0);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, numMajor), [&](const tbb::blocked_range<size_t> &r) {
+        for (size_t i = r.begin(); i < r.end(); i++)
+        {
+            for (size_t p = sortedPtr[i]; p < sortedPtr[i + 1]; p++)
+            {
+                if (p == sortedPtr[i] || minor[order[p]] != minor[order[p - 1]])
+                {
+                    ptr[i + 1]++;
+                }
+            }
+        }
+    });
+    prefix_sum_row_counts(ptr);
+    ind.resize(ptr[numMajor]);
+    val.resize(ptr[numMajor]);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, numMajor), [&](const tbb::blocked_range<size_t> &r) {
+        for (size_t i = r.begin(); i < r.end(); i++)
+        {
+            size_t q = ptr[i];
+            for (size_t p = sortedPtr[i]; p < sortedPtr[i + 1]; p++)
+            {
+                const size_t e = order[p];
+                if (p == sortedPtr[i] || minor[e] != minor[order[p - 1]])
+                {
+                    ind[q] = minor[e];
+                    val[q] = values[e];
+                    q++;
+                }
+                else
+                {
+                    val[q - 1] += values[e];
+                }
+            }
+        }
+    });
+}
+
+/// @brief Parallel version of convert_COO_to_CSR
+template <typename T>
+CSRMatrix<T> convert_COO_to_CSR(const COO::COOMatrix<T> &A)
+{
+    CSRMatrix<T> C;
+    C.numRows = A.numRows;
+    C.numColumns = A.numCols;
+    parallel::compress_triplets(A.rowCoord, A.colCoord, A.values, A.numRows, A.numCols, C.row_ptr, C.col_ind, C.val);
+    return C;
+}
+
+/// @brief Parallel version of convert_COO_to_CSC
+template <typename T>
+CSCMatrix<T> convert_COO_to_CSC(const COO::COOMatrix<T> &A)
+{
+    CSCMatrix<T> C;
+    C.numRows = A.numRows;
+    C.numColumns = A.numCols;
+    parallel::compress_triplets(A.colCoord, A.rowCoord, A.values, A.numCols, A.numRows, C.col_ptr, C.row_ind, C.val);
+    return C;
+}
+
+/**
+ * @brief Parallel version of transpose_compressed. The entries are counting sorted by
+ * minor index in storage order, which is major order, so each output slice is sorted.
+ */
+template <typename T>
+void transpose_compressed(size_t numMajor, size_t numMinor, const vector<size_t> &ptr, const vector<size_t> &ind,
+                          const vector<T> &val, vector<size_t> &tptr, vector<size_t> &tind, vector<T> &tval)
+{
+    const size_t nnz = ptr[numMajor];
+    if (nnz < CONVERSION_PARALLEL_CUTOFF)
+    {
+        ::transpose_compressed(numMajor, numMinor, ptr, ind, val, tptr, tind, tval);
+        return;
+    }
+    vector<size_t> order;
+    parallel::counting_sort_keys(nnz, numMinor, [&](size_t p) { return ind[p]; }, tptr, order);
+    // the major index of every stored entry, for the scatter
+    vector<size_t> majorOf(nnz);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, numMajor), [&](const tbb::blocked_range<size_t> &r) {
+        for (size_t i = r.begin(); i < r.end(); i++)
+        {
+            std::fill(majorOf.begin() + ptr[i], majorOf.begin() + ptr[i + 1], i);
+        }
+    });
+    tind.resize(nnz);
+    tval.resize(nnz);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, nnz), [&](const tbb::blocked_range<size_t> &r) {
+        for (size_t q = r.begin(); q < r.end(); q++)
+        {
+            tind[q] = majorOf[order[q]];
+            tval[q] = val[order[q]];
+        }
+    });
+}
+
+/// @brief Parallel version of convert_CSR_to_CSC
+template <typename T>
+CSCMatrix<T> convert_CSR_to_CSC(const CSRMatrix<T> &A)
+{
+    CSCMatrix<T> C;
+    C.numRows = A.numRows;
+    C.numColumns = A.numColumns;
+    parallel::transpose_compressed(A.numRows, A.numColumns, A.row_ptr, A.col_ind, A.val, C.col_ptr, C.row_ind, C.val);
+    return C;
+}
+
+/// @brief Parallel version of convert_CSC_to_CSR
+template <typename T>
+CSRMatrix<T> convert_CSC_to_CSR(const CSCMatrix<T> &A)
+{
+    CSRMatrix<T> C;
+    C.numRows = A.numRows;
+    C.numColumns = A.numColumns;
+    parallel::transpose_compressed(A.numColumns, A.numRows, A.col_ptr, A.row_ind, A.val, C.row_ptr, C.col_ind, C.val);
+    return C;
+}
+
+/// @brief Parallel version of convert_CSR_to_COO
+template <typename T>
+COO::COOMatrix<T> convert_CSR_to_COO(const CSRMatrix<T> &A)
+{
+    COO::COOMatrix<T> C;
+    C.numRows = A.numRows;
+    C.numCols = A.numColumns;
+    C.nnz = A.val.size();
+    C.rowCoord.resize(C.nnz);
+    C.colCoord.resize(C.nnz);
+    C.values.resize(C.nnz);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, A.numRows), [&](const tbb::blocked_range<size_t> &r) {
+        const size_t first = A.row_ptr[r.begin()], last = A.row_ptr[r.end()];
+        for (size_t i = r.begin(); i < r.end(); i++)
+        {
+            std::fill(C.rowCoord.begin() + A.row_ptr[i], C.rowCoord.begin() + A.row_ptr[i + 1], i);
+        }
+        std::copy(A.col_ind.begin() + first, A.col_ind.begin() + last, C.colCoord.begin() + first);
+        std::copy(A.val.begin() + first, A.val.begin() + last, C.values.begin() + first);
+    });
+    return C;
+}
+
+/// @brief Compresses the triplets of an assembler into CSR in parallel
+template <typename T>
+CSRMatrix<T> assemble_CSR(const TripletAssemblerCSR<T> &assembler)
+{
+    CSRMatrix<T> A;
+    A.numRows = assembler.numRows;
+    A.numColumns = assembler.numColumns;
+    parallel::compress_triplets(assembler.rows, assembler.cols, assembler.vals, assembler.numRows,
+                                assembler.numColumns, A.row_ptr, A.col_ind, A.val);
+    return A;
+}
+
+} // namespace parallel
+
+#endif
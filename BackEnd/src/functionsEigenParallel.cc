@@ -0,0 +1,542 @@
+// functionsEigenParallel.cc
+// Eigensolvers for the extreme eigenpairs of symmetric CSR matrices: thick-restart
+// Lanczos and LOBPCG. Both spend their time in the parallel SpMV / SpMM kernels of
+// functionsCSRParallel.cc; the projected problems are small and solved densely.
+
+#ifndef FUNCTIONS_EIGEN_PARALLEL_CC
+#define FUNCTIONS_EIGEN_PARALLEL_CC
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include <tbb/tbb.h>
+#include "functionsCSRParallel.cc"
+
+namespace parallel {
+using namespace std;
+
+/// @brief Which end of the spectrum to compute
+enum class EigenTarget
+{
+    Smallest,
+    Largest
+};
+
+/// @brief Computed eigenpairs, ordered from the requested end of the spectrum inwards.
+/// Column i of vectors is the unit eigenvector for values[i] and residuals[i] is
+/// ||A x - lambda x|| for it.
+template <typename T>
+class EigenResult
+{
+public:
+    vector<T> values;
+    ColumnMajorBlock<T> vectors;
+    vector<T> residuals;
+    int iterations = 0;
+    bool converged = false;
+};
+
+/**
+ * @brief Eigenvalues and eigenvectors of a small dense symmetric matrix by the cyclic
+ * Jacobi method, used for the Rayleigh-Ritz problems of the iterative eigensolvers.
+ *
+ * @tparam T
+ * @param S row-major m x m symmetric matrix, destroyed
+ * @param m
+ * @param values output, the m eigenvalues in ascending order
+ * @param vectors output, row-major m x m, column i is the eigenvector of values[i]
+ */
+template <typename T>
+void symmetric_eigen_dense(vector<T> &S, size_t m, vector<T> &values, vector<T> &vectors)
+{
+    vector<T> Q(m * m, 0.0);
+    for (size_t i = 0; i < m; i++)
+    {
+        Q[i * m + i] = 1.0;
+    }
+    for (int sweep = 0; sweep < 100; sweep++)
+    {
+        T off = 0, total = 0;
+        for (size_t i = 0; i < m; i++)
+        {
+            for (size_t j = 0; j < m; j++)
+            {
+                total += S[i * m + j] * S[i * m + j];
+                if (i != j)
+                {
+                    off += S[i * m + j] * S[i * m + j];
+                }
+            }
+        }
+        if (off <= 1e-30 * total)
+        {
+            break;
+        }
+        for (size_t p = 0; p + 1 < m; p++)
+        {
+            for (size_t q = p + 1; q < m; q++)
+            {
+                const T apq = S[p * m + q];
+                if (apq == 0)
+                {
+                    continue;
+                }
+                // rotation that zeroes S(p, q)
+                const T tau = (S[q * m + q] - S[p * m + p]) / (2.0 * apq);
+                const T t = (tau >= 0 ? 1.0 : -1.0) / (std::abs(tau) + std::sqrt(1.0 + tau * tau));
+                const T c = 1.0 / std::sqrt(1.0 + t * t);
+                const T s = t * c;
+                for (size_t k = 0; k < m; k++)
+                {
+                    const T skp = S[k * m + p], skq = S[k * m + q];
+                    S[k * m + p] = c * skp - s * skq;
+                    S[k * m + q] = s * skp + c * skq;
+                }
+                for (size_t k = 0; k < m; k++)
+                {
+                    const T spk = S[p * m + k], sqk = S[q * m + k];
+                    S[p * m + k] = c * spk - s * sqk;
+                    S[q * m + k] = s * spk + c * sqk;
+                }
+                for (size_t k = 0; k < m; k++)
+                {
+                    const T qkp = Q[k * m + p], qkq = Q[k * m + q];
+                    Q[k * m + p] = c * qkp - s * qkq;
+                    Q[k * m + q] = s * qkp + c * qkq;
+                }
+            }
+        }
+    }
+    vector<size_t> order(m);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b)
+              { return S[a * m + a] < S[b * m + b]; });
+    values.resize(m);
+    vectors.resize(m * m);
+    for (size_t c = 0; c < m; c++)
+    {
+        values[c] = S[order[c] * m + order[c]];
+        for (size_t k = 0; k < m; k++)
+        {
+            vectors[k * m + c] = Q[k * m + order[c]];
+        }
+    }
+}
+
+/**
+ * @brief Thick-restart Lanczos (Wu and Simon) for the nev smallest or largest
+ * eigenpairs of a symmetric matrix. The basis holds at most basisSize vectors: when it
+ * is full the Ritz vectors closest to the target are kept, together with the last
+ * Lanczos vector, and the iteration continues from there. Every new vector is fully
+ * reorthogonalized against the basis (classical Gram-Schmidt, applied twice), with the
+ * inner products of each pass batched into one parallel reduction.
+ *
+ * @tparam T
+ * @param A symmetric matrix, both triangles stored (see symmetric_from_triangle_CSR)
+ * @param nev number of eigenpairs
+ * @param target smallest or largest
+ * @param basisSize maximum number of basis vectors, at least nev + 2
+ * @param tol a pair is converged when ||A x - lambda x|| < tol * max |lambda|
+ * @param maxRestarts
+ * @return EigenResult<T>
+ */
+template <typename T>
+EigenResult<T> lanczos_eigen_CSR(const CSRMatrix<T> &A, size_t nev, EigenTarget target, size_t basisSize, double tol,
+                                 int maxRestarts)
+{
+    const size_t n = A.numRows;
+    if (A.numColumns != n)
+    {
+        throw std::invalid_argument("Eigenvalues need a square matrix.");
+    }
+    const size_t m = std::min(basisSize, n);
+    if (nev < 1 || nev + 2 > m)
+    {
+        throw std::invalid_argument("Lanczos needs 1 <= nev and nev + 2 <= basisSize <= n.");
+    }
+    const tbb::blocked_range<size_t> rows(0, n);
+    ColumnMajorBlock<T> V(n, m + 1);
+    vector<T> Tm(m * m, 0.0), w(n), v(n), h(m);
+    std::mt19937 generator(0);
+    std::uniform_real_distribution<T> distribution(-1.0, 1.0);
+
+    // w -= V(:, 0..count) h with h = V^T w, twice
+    auto orthogonalize = [&](size_t count, vector<T> &coefficients)
+    {
+        std::fill(coefficients.begin(), coefficients.begin() + count, 0.0);
+        for (int pass = 0; pass < 2; pass++)
+        {
+            const vector<T> dots = tbb::parallel_reduce(rows, vector<T>(count, 0.0),
+                [&](const tbb::blocked_range<size_t> &r, vector<T> local)
+                {
+                    for (size_t c = 0; c < count; c++)
+                    {
+                        const T *vc = V.val.data() + c * n;
+                        T sum = 0;
+                        for (size_t i = r.begin(); i < r.end(); i++)
+                        {
+                            sum += vc[i] * w[i];
+                        }
+                        local[c] += sum;
+                    }
+                    return local;
+                },
+                [](vector<T> a, const vector<T> &b)
+                {
+                    for (size_t c = 0; c < a.size(); c++)
+                        a[c] += b[c];
+                    return a;
+                });
+            tbb::parallel_for(rows, [&](const tbb::blocked_range<size_t> &r)
+            {
+                for (size_t c = 0; c < count; c++)
+                {
+                    const T *vc = V.val.data() + c * n;
+                    for (size_t i = r.begin(); i < r.end(); i++)
+                    {
+                        w[i] -= dots[c] * vc[i];
+                    }
+                }
+            });
+            for (size_t c = 0; c < count; c++)
+            {
+                coefficients[c] += dots[c];
+            }
+        }
+        return std::sqrt(tbb::parallel_reduce(rows, T(0), [&](const tbb::blocked_range<size_t> &r, T sum)
+        {
+            for (size_t i = r.begin(); i < r.end(); i++)
+                sum += w[i] * w[i];
+            return sum;
+        }, std::plus<T>()));
+    };
+    // a random vector orthogonal to the first count basis vectors, stored as column count
+    auto randomColumn = [&](size_t count)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            w[i] = distribution(generator);
+        }
+        vector<T> unused(m + 1);
+        const T norm = orthogonalize(count, unused);
+        for (size_t i = 0; i < n; i++)
+        {
+            V(i, count) = w[i] / norm;
+        }
+    };
+
+    EigenResult<T> result;
+    randomColumn(0);
+    size_t kept = 0;
+    vector<T> theta, Y;
+    T beta = 0;
+    for (int restart = 0; restart <= maxRestarts; restart++)
+    {
+        for (size_t j = kept; j < m; j++)
+        {
+            std::copy(V.val.begin() + j * n, V.val.begin() + (j + 1) * n, v.begin());
+            parallel::matrix_vector_product_CSR(A, v, w);
+            beta = orthogonalize(j + 1, h);
+            // column j of the projected matrix; after a restart its first entries are
+            // the arrowhead couplings to the kept Ritz vectors
+            for (size_t i = 0; i <= j; i++)
+            {
+                Tm[i * m + j] = h[i];
+                Tm[j * m + i] = h[i];
+            }
+            if (j + 1 < m)
+            {
+                Tm[(j + 1) * m + j] = 0;
+                Tm[j * m + j + 1] = 0;
+            }
+            if (beta <= 1e-12 * std::abs(h[j]) || beta == 0)
+            {
+                // invariant subspace found, continue with a fresh direction
+                randomColumn(j + 1);
+                beta = 0;
+            }
+            else
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    V(i, j + 1) = w[i] / beta;
+                }
+            }
+            if (j + 1 < m)
+            {
+                Tm[(j + 1) * m + j] = beta;
+                Tm[j * m + j + 1] = beta;
+            }
+        }
+
+        // Rayleigh-Ritz on the projected matrix, wanted values first
+        vector<T> S = Tm;
+        symmetric_eigen_dense(S, m, theta, Y);
+        vector<size_t> order(m);
+        std::iota(order.begin(), order.end(), 0);
+        if (target == EigenTarget::Largest)
+        {
+            std::reverse(order.begin(), order.end());
+        }
+        T scale = 0;
+        for (T value : theta)
+        {
+            scale = std::max(scale, std::abs(value));
+        }
+        size_t numConverged = 0;
+        for (size_t c = 0; c < nev; c++)
+        {
+            if (beta * std::abs(Y[(m - 1) * m + order[c]]) < tol * scale)
+            {
+                numConverged++;
+            }
+        }
+        result.iterations = restart + 1;
+        const bool done = numConverged == nev || restart == maxRestarts;
+
+        // keep the Ritz vectors closest to the target, then the residual direction
+        const size_t keep = done ? nev : std::min(m - 1, nev + (m - nev) / 2);
+        ColumnMajorBlock<T> ritz(n, keep);
+        tbb::parallel_for(rows, [&](const tbb::blocked_range<size_t> &r)
+        {
+            for (size_t c = 0; c < keep; c++)
+            {
+                for (size_t i = r.begin(); i < r.end(); i++)
+                {
+                    T sum = 0;
+                    for (size_t a = 0; a < m; a++)
+                    {
+                        sum += V(i, a) * Y[a * m + order[c]];
+                    }
+                    ritz(i, c) = sum;
+                }
+            }
+        });
+        if (done)
+        {
+            result.values.resize(nev);
+            result.residuals.resize(nev);
+            for (size_t c = 0; c < nev; c++)
+            {
+                result.values[c] = theta[order[c]];
+                result.residuals[c] = beta * std::abs(Y[(m - 1) * m + order[c]]);
+            }
+            result.vectors = std::move(ritz);
+            result.converged = numConverged == nev;
+            break;
+        }
+        std::fill(Tm.begin(), Tm.end(), 0.0);
+        for (size_t c = 0; c < keep; c++)
+        {
+            std::copy(ritz.val.begin() + c * n, ritz.val.begin() + (c + 1) * n, V.val.begin() + c * n);
+            Tm[c * m + c] = theta[order[c]];
+        }
+        std::copy(V.val.begin() + m * n, V.val.begin() + (m + 1) * n, V.val.begin() + keep * n);
+        kept = keep;
+    }
+    std::cerr << "Lanczos Restarts: " << result.iterations << std::endl;
+    return result;
+}
+
+/**
+ * @brief LOBPCG (Knyazev) for the nev smallest or largest eigenpairs of a symmetric
+ * matrix. Each iteration does Rayleigh-Ritz on the span of the current block X, the
+ * preconditioned residuals W = M^-1 (A X - X Lambda) and the previous search directions
+ * P. That basis is orthonormalized (dropping dependent columns) before one parallel
+ * SpMM, which keeps the method stable when the residuals get small. Memory is a few
+ * n x nev blocks.
+ *
+ * @tparam T
+ * @param A symmetric matrix, both triangles stored
+ * @param nev block size and number of eigenpairs
+ * @param target smallest or largest
+ * @param tol a pair is converged when ||A x - lambda x|| < tol * max |lambda|
+ * @param maxit
+ * @param M optional symmetric positive definite preconditioner, applied per column;
+ * for the largest eigenvalues it should be left out
+ * @return EigenResult<T>
+ */
+template <typename T>
+EigenResult<T> lobpcg_eigen_CSR(const CSRMatrix<T> &A, size_t nev, EigenTarget target, double tol, int maxit,
+                                const PreconditionerCSR<T> &M = nullptr)
+{
+    const size_t n = A.numRows;
+    if (A.numColumns != n)
+    {
+        throw std::invalid_argument("Eigenvalues need a square matrix.");
+    }
+    if (nev < 1 || 3 * nev > n)
+    {
+        throw std::invalid_argument("LOBPCG needs 1 <= nev <= n / 3.");
+    }
+    std::mt19937 generator(0);
+    std::uniform_real_distribution<T> distribution(-1.0, 1.0);
+    DenseBlock<T> X(n, nev), AX, R, W, P, S, AS;
+    for (T &value : X.val)
+    {
+        value = distribution(generator);
+    }
+
+    // orthonormalizes B twice and removes the columns that turned out dependent
+    auto orthonormalize = [&](DenseBlock<T> &B)
+    {
+        vector<T> diag = block_qr(B);
+        const vector<T> again = block_qr(B);
+        vector<size_t> keep;
+        for (size_t j = 0; j < B.numColumns; j++)
+        {
+            if (diag[j * B.numColumns + j] != 0 && again[j * B.numColumns + j] != 0)
+            {
+                keep.push_back(j);
+            }
+        }
+        DenseBlock<T> kept(n, keep.size());
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, n), [&](const tbb::blocked_range<size_t> &r)
+        {
+            for (size_t i = r.begin(); i < r.end(); i++)
+                for (size_t c = 0; c < keep.size(); c++)
+                    kept(i, c) = B(i, keep[c]);
+        });
+        B = std::move(kept);
+    };
+    // Rayleigh-Ritz on the orthonormal basis S: the nev wanted Ritz pairs, with the
+    // coefficients returned row-major S.numColumns x nev
+    vector<T> lambda(nev);
+    auto rayleighRitz = [&](vector<T> &C)
+    {
+        const size_t ks = S.numColumns;
+        parallel::multiply_block_CSR(A, S, AS);
+        vector<T> G = block_inner_product(S, AS), values, vectors;
+        for (size_t a = 0; a < ks; a++)
+        {
+            for (size_t b = 0; b < a; b++)
+            {
+                G[a * ks + b] = G[b * ks + a] = (G[a * ks + b] + G[b * ks + a]) / 2.0;
+            }
+        }
+        symmetric_eigen_dense(G, ks, values, vectors);
+        C.assign(ks * nev, 0.0);
+        for (size_t c = 0; c < nev; c++)
+        {
+            const size_t index = target == EigenTarget::Smallest ? c : ks - 1 - c;
+            lambda[c] = values[index];
+            for (size_t a = 0; a < ks; a++)
+            {
+                C[a * nev + c] = vectors[a * ks + index];
+            }
+        }
+    };
+    // Y = B C for a row-major coefficient matrix C with B.numColumns rows, starting at
+    // row offset of C
+    auto combine = [&](const DenseBlock<T> &B, const vector<T> &C, size_t offset, size_t count, DenseBlock<T> &Y)
+    {
+        Y = DenseBlock<T>(n, nev);
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, n), [&](const tbb::blocked_range<size_t> &r)
+        {
+            for (size_t i = r.begin(); i < r.end(); i++)
+                for (size_t c = 0; c < nev; c++)
+                {
+                    T sum = 0;
+                    for (size_t a = 0; a < count; a++)
+                        sum += B(i, offset + a) * C[(offset + a) * nev + c];
+                    Y(i, c) = sum;
+                }
+        });
+    };
+
+    vector<T> C;
+    S = X;
+    orthonormalize(S);
+    rayleighRitz(C);
+    combine(S, C, 0, S.numColumns, X);
+    combine(AS, C, 0, S.numColumns, AX);
+
+    EigenResult<T> result;
+    vector<T> norms(nev);
+    int it = 0;
+    while (true)
+    {
+        R = AX;
+        for (size_t i = 0; i < n; i++)
+        {
+            for (size_t c = 0; c < nev; c++)
+            {
+                R(i, c) -= lambda[c] * X(i, c);
+            }
+        }
+        norms = block_column_norms(R);
+        T scale = 0;
+        for (T value : lambda)
+        {
+            scale = std::max(scale, std::abs(value));
+        }
+        bool converged = true;
+        for (size_t c = 0; c < nev; c++)
+        {
+            converged = converged && norms[c] < tol * scale;
+        }
+        if (converged || it >= maxit)
+        {
+            result.converged = converged;
+            break;
+        }
+        it++;
+
+        // S = [X, W, P] with W = M^-1 R
+        apply_block_preconditioner_CSR(M, R, W);
+        const size_t kx = nev, kw = W.numColumns, kp = P.numColumns;
+        S = DenseBlock<T>(n, kx + kw + kp);
+        for (size_t i = 0; i < n; i++)
+        {
+            for (size_t c = 0; c < kx; c++)
+                S(i, c) = X(i, c);
+            for (size_t c = 0; c < kw; c++)
+                S(i, kx + c) = W(i, c);
+            for (size_t c = 0; c < kp; c++)
+                S(i, kx + kw + c) = P(i, c);
+        }
+        orthonormalize(S);
+        rayleighRitz(C);
+        const size_t ks = S.numColumns;
+        DenseBlock<T> Xnew;
+        combine(S, C, 0, ks, Xnew);
+        combine(AS, C, 0, ks, AX);
+        // new search directions: the part of the update outside the old X, i.e. the
+        // new Ritz vectors with their component along the old X removed
+        const vector<T> overlap = block_inner_product(X, Xnew);
+        P = Xnew;
+        for (size_t i = 0; i < n; i++)
+        {
+            for (size_t c = 0; c < nev; c++)
+            {
+                T sum = 0;
+                for (size_t a = 0; a < nev; a++)
+                {
+                    sum += X(i, a) * overlap[a * nev + c];
+                }
+                P(i, c) -= sum;
+            }
+        }
+        X = std::move(Xnew);
+    }
+    result.iterations = it;
+    result.values = lambda;
+    result.residuals = norms;
+    result.vectors = ColumnMajorBlock<T>(n, nev);
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t c = 0; c < nev; c++)
+        {
+            result.vectors(i, c) = X(i, c);
+        }
+    }
+    std::cerr << "LOBPCG Iterations: " << it << std::endl;
+    return result;
+}
+
+} // namespace parallel
+
+#endif
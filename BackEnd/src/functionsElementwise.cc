@@ -0,0 +1,340 @@
+// functionsElementwise.cc
+// Elementwise and scalar kernels for the dense, CSR, CSC and COO formats: scale, shift,
+// abs, clamp, elementwise multiply and the fused a * X + b. Every operation comes in
+// place (*_in_place) and out of place (*_into), writing into a caller-owned output whose
+// storage is reused; the output may also be the input. On the sparse formats the kernels
+// act on the stored entries only, so shift and axpb leave the implicit zeros at zero, as
+// scalar_add_matrixCOO always has. All of them run over the contiguous value arrays,
+// which are SIMD vectorized.
+
+#ifndef FUNCTIONS_ELEMENTWISE_CC
+#define FUNCTIONS_ELEMENTWISE_CC
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include "functionsCSR.cc"
+#include "functionsCSC.cc"
+#include "functionsCOO.cc"
+#include "functionsSIMD.cc"
+
+using namespace std;
+
+/// @brief The scalar type of a matrix format; only the formats below have one, which
+/// keeps the generic kernels to them
+template <typename M>
+struct matrix_scalar;
+
+template <typename T>
+struct matrix_scalar<vector<vector<T>>>
+{
+    using type = T;
+};
+
+template <typename T>
+struct matrix_scalar<CSRMatrix<T>>
+{
+    using type = T;
+};
+
+template <typename T>
+struct matrix_scalar<CSCMatrix<T>>
+{
+    using type = T;
+};
+
+template <typename T>
+struct matrix_scalar<COO::COOMatrix<T>>
+{
+    using type = T;
+};
+
+template <typename M>
+using matrix_scalar_t = typename matrix_scalar<M>::type;
+
+/// @brief y[k] = op(x[k]) for k < n; y may be x
+template <typename T, typename Op>
+void transform_values(const T *x, T *y, size_t n, const Op &op)
+{
+    SIMD_LOOP
+    for (size_t k = 0; k < n; k++)
+    {
+        y[k] = op(x[k]);
+    }
+}
+
+/// @brief y[k] = op(x[k], w[k]) for k < n; y may be x or w
+template <typename T, typename Op>
+void transform_values(const T *x, const T *w, T *y, size_t n, const Op &op)
+{
+    SIMD_LOOP
+    for (size_t k = 0; k < n; k++)
+    {
+        y[k] = op(x[k], w[k]);
+    }
+}
+
+template <typename T>
+vector<T> &stored_values(CSRMatrix<T> &A) { return A.val; }
+
+template <typename T>
+const vector<T> &stored_values(const CSRMatrix<T> &A) { return A.val; }
+
+template <typename T>
+vector<T> &stored_values(CSCMatrix<T> &A) { return A.val; }
+
+template <typename T>
+const vector<T> &stored_values(const CSCMatrix<T> &A) { return A.val; }
+
+template <typename T>
+vector<T> &stored_values(COO::COOMatrix<T> &A) { return A.values; }
+
+template <typename T>
+const vector<T> &stored_values(const COO::COOMatrix<T> &A) { return A.values; }
+
+/// @brief Gives C the dimensions and sparsity pattern of A and sizes its values, reusing
+/// the storage of C; nothing to do when C is A
+template <typename T>
+void copy_pattern(CSRMatrix<T> &C, const CSRMatrix<T> &A)
+{
+    if (&C == &A)
+    {
+        return;
+    }
+    C.numRows = A.numRows;
+    C.numColumns = A.numColumns;
+    C.row_ptr = A.row_ptr;
+    C.col_ind = A.col_ind;
+    C.val.resize(A.val.size());
+}
+
+template <typename T>
+void copy_pattern(CSCMatrix<T> &C, const CSCMatrix<T> &A)
+{
+    if (&C == &A)
+    {
+        return;
+    }
+    C.numRows = A.numRows;
+    C.numColumns = A.numColumns;
+    C.col_ptr = A.col_ptr;
+    C.row_ind = A.row_ind;
+    C.val.resize(A.val.size());
+}
+
+template <typename T>
+void copy_pattern(COO::COOMatrix<T> &C, const COO::COOMatrix<T> &A)
+{
+    if (&C == &A)
+    {
+        return;
+    }
+    C.numRows = A.numRows;
+    C.numCols = A.numCols;
+    C.nnz = A.nnz;
+    C.rowCoord = A.rowCoord;
+    C.colCoord = A.colCoord;
+    C.values.resize(A.values.size());
+}
+
+template <typename T>
+void copy_pattern(vector<vector<T>> &C, const vector<vector<T>> &A)
+{
+    if (&C == &A)
+    {
+        return;
+    }
+    C.resize(A.size());
+    for (size_t i = 0; i < A.size(); i++)
+    {
+        C[i].resize(A[i].size());
+    }
+}
+
+/// @brief True if A and B have the same dimensions and store the same entries
+template <typename T>
+bool same_pattern(const CSRMatrix<T> &A, const CSRMatrix<T> &B)
+{
+    return A.numRows == B.numRows && A.numColumns == B.numColumns && A.row_ptr == B.row_ptr &&
+           A.col_ind == B.col_ind && A.val.size() == B.val.size();
+}
+
+template <typename T>
+bool same_pattern(const CSCMatrix<T> &A, const CSCMatrix<T> &B)
+{
+    return A.numRows == B.numRows && A.numColumns == B.numColumns && A.col_ptr == B.col_ptr &&
+           A.row_ind == B.row_ind && A.val.size() == B.val.size();
+}
+
+template <typename T>
+bool same_pattern(const COO::COOMatrix<T> &A, const COO::COOMatrix<T> &B)
+{
+    return A.numRows == B.numRows && A.numCols == B.numCols && A.rowCoord == B.rowCoord &&
+           A.colCoord == B.colCoord && A.values.size() == B.values.size();
+}
+
+template <typename T>
+bool same_pattern(const vector<vector<T>> &A, const vector<vector<T>> &B)
+{
+    if (A.size() != B.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < A.size(); i++)
+    {
+        if (A[i].size() != B[i].size())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// @brief C = op(A) entry by entry, C taking the pattern of A
+template <typename M, typename Op>
+void map_values(M &C, const M &A, const Op &op)
+{
+    copy_pattern(C, A);
+    const auto &x = stored_values(A);
+    transform_values(x.data(), stored_values(C).data(), x.size(), op);
+}
+
+template <typename T, typename Op>
+void map_values(vector<vector<T>> &C, const vector<vector<T>> &A, const Op &op)
+{
+    copy_pattern(C, A);
+    for (size_t i = 0; i < A.size(); i++)
+    {
+        transform_values(A[i].data(), C[i].data(), A[i].size(), op);
+    }
+}
+
+/// @brief C = op(A, B) entry by entry
+/// @exception A and B must have the same pattern
+template <typename M, typename Op>
+void zip_values(M &C, const M &A, const M &B, const Op &op)
+{
+    if (!same_pattern(A, B))
+    {
+        throw std::invalid_argument("The matrices must have the same dimensions and sparsity pattern.");
+    }
+    copy_pattern(C, A);
+    const auto &x = stored_values(A);
+    transform_values(x.data(), stored_values(B).data(), stored_values(C).data(), x.size(), op);
+}
+
+template <typename T, typename Op>
+void zip_values(vector<vector<T>> &C, const vector<vector<T>> &A, const vector<vector<T>> &B, const Op &op)
+{
+    if (!same_pattern(A, B))
+    {
+        throw std::invalid_argument("The matrices must have the same dimensions and sparsity pattern.");
+    }
+    copy_pattern(C, A);
+    for (size_t i = 0; i < A.size(); i++)
+    {
+        transform_values(A[i].data(), B[i].data(), C[i].data(), A[i].size(), op);
+    }
+}
+
+/// @brief C = a * A
+/// @tparam M dense (vector<vector<T>>), CSRMatrix<T>, CSCMatrix<T> or COO::COOMatrix<T>
+/// @param C The output, may be A
+/// @param A The matrix to scale
+/// @param a The scalar
+template <typename M>
+void scale_into(M &C, const M &A, const matrix_scalar_t<M> a)
+{
+    using T = matrix_scalar_t<M>;
+    map_values(C, A, [a](const T x) { return a * x; });
+}
+
+/// @brief C = A + b on every stored entry
+template <typename M>
+void shift_into(M &C, const M &A, const matrix_scalar_t<M> b)
+{
+    using T = matrix_scalar_t<M>;
+    map_values(C, A, [b](const T x) { return x + b; });
+}
+
+/// @brief C = |A|
+template <typename M>
+void abs_into(M &C, const M &A)
+{
+    using T = matrix_scalar_t<M>;
+    map_values(C, A, [](const T x) { return x < T(0) ? -x : x; });
+}
+
+/// @brief C = A with every stored entry clamped to [lo, hi]
+/// @exception lo must not be greater than hi
+template <typename M>
+void clamp_into(M &C, const M &A, const matrix_scalar_t<M> lo, const matrix_scalar_t<M> hi)
+{
+    using T = matrix_scalar_t<M>;
+    if (hi < lo)
+    {
+        throw std::invalid_argument("The lower bound of a clamp must not be greater than the upper bound.");
+    }
+    map_values(C, A, [lo, hi](const T x) { return x < lo ? lo : (hi < x ? hi : x); });
+}
+
+/// @brief C = A .* B, the elementwise (Hadamard) product
+/// @exception A and B must have the same dimensions and sparsity pattern
+template <typename M>
+void multiply_elementwise_into(M &C, const M &A, const M &B)
+{
+    using T = matrix_scalar_t<M>;
+    zip_values(C, A, B, [](const T x, const T y) { return x * y; });
+}
+
+/// @brief C = a * A + b on every stored entry, in one pass
+template <typename M>
+void axpb_into(M &C, const M &A, const matrix_scalar_t<M> a, const matrix_scalar_t<M> b)
+{
+    using T = matrix_scalar_t<M>;
+    map_values(C, A, [a, b](const T x) { return a * x + b; });
+}
+
+/// @brief A = a * A
+template <typename M>
+void scale_in_place(M &A, const matrix_scalar_t<M> a)
+{
+    scale_into(A, A, a);
+}
+
+/// @brief A = A + b on every stored entry
+template <typename M>
+void shift_in_place(M &A, const matrix_scalar_t<M> b)
+{
+    shift_into(A, A, b);
+}
+
+/// @brief A = |A|
+template <typename M>
+void abs_in_place(M &A)
+{
+    abs_into(A, A);
+}
+
+/// @brief Clamps every stored entry of A to [lo, hi]
+template <typename M>
+void clamp_in_place(M &A, const matrix_scalar_t<M> lo, const matrix_scalar_t<M> hi)
+{
+    clamp_into(A, A, lo, hi);
+}
+
+/// @brief A = A .* B
+template <typename M>
+void multiply_elementwise_in_place(M &A, const M &B)
+{
+    multiply_elementwise_into(A, A, B);
+}
+
+/// @brief A = a * A + b on every stored entry
+template <typename M>
+void axpb_in_place(M &A, const matrix_scalar_t<M> a, const matrix_scalar_t<M> b)
+{
+    axpb_into(A, A, a, b);
+}
+
+#endif
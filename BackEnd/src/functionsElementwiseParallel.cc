@@ -0,0 +1,194 @@
+// functionsElementwiseParallel.cc
+// Parallel versions of the elementwise kernels in functionsElementwise.cc. The value
+// arrays are split into blocks that run the serial SIMD loops concurrently (dense
+// matrices are split by rows), so the results are identical to the serial kernels.
+
+#ifndef FUNCTIONS_ELEMENTWISE_PARALLEL_CC
+#define FUNCTIONS_ELEMENTWISE_PARALLEL_CC
+
+#include <stdexcept>
+#include <vector>
+#include <tbb/tbb.h>
+#include "functionsElementwise.cc"
+
+namespace parallel {
+using namespace std;
+
+/// @brief Below this many values the serial kernels are used
+constexpr size_t ELEMENTWISE_PARALLEL_CUTOFF = 1 << 15;
+
+/// @brief Values per task, enough to amortize the scheduling over the SIMD loop
+constexpr size_t ELEMENTWISE_GRAIN = 1 << 13;
+
+/// @brief Parallel version of transform_values
+template <typename T, typename Op>
+void transform_values(const T *x, T *y, size_t n, const Op &op)
+{
+    if (n < ELEMENTWISE_PARALLEL_CUTOFF)
+    {
+        ::transform_values(x, y, n, op);
+        return;
+    }
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, n, ELEMENTWISE_GRAIN), [&](const tbb::blocked_range<size_t> &r) {
+        ::transform_values(x + r.begin(), y + r.begin(), r.size(), op);
+    });
+}
+
+/// @brief Parallel version of the two-input transform_values
+template <typename T, typename Op>
+void transform_values(const T *x, const T *w, T *y, size_t n, const Op &op)
+{
+    if (n < ELEMENTWISE_PARALLEL_CUTOFF)
+    {
+        ::transform_values(x, w, y, n, op);
+        return;
+    }
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, n, ELEMENTWISE_GRAIN), [&](const tbb::blocked_range<size_t> &r) {
+        ::transform_values(x + r.begin(), w + r.begin(), y + r.begin(), r.size(), op);
+    });
+}
+
+/// @brief Parallel version of map_values
+template <typename M, typename Op>
+void map_values(M &C, const M &A, const Op &op)
+{
+    copy_pattern(C, A);
+    const auto &x = stored_values(A);
+    parallel::transform_values(x.data(), stored_values(C).data(), x.size(), op);
+}
+
+template <typename T, typename Op>
+void map_values(vector<vector<T>> &C, const vector<vector<T>> &A, const Op &op)
+{
+    copy_pattern(C, A);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, A.size()), [&](const tbb::blocked_range<size_t> &r) {
+        for (size_t i = r.begin(); i < r.end(); i++)
+        {
+            ::transform_values(A[i].data(), C[i].data(), A[i].size(), op);
+        }
+    });
+}
+
+/// @brief Parallel version of zip_values
+/// @exception A and B must have the same pattern
+template <typename M, typename Op>
+void zip_values(M &C, const M &A, const M &B, const Op &op)
+{
+    if (!same_pattern(A, B))
+    {
+        throw std::invalid_argument("The matrices must have the same dimensions and sparsity pattern.");
+    }
+    copy_pattern(C, A);
+    const auto &x = stored_values(A);
+    parallel::transform_values(x.data(), stored_values(B).data(), stored_values(C).data(), x.size(), op);
+}
+
+template <typename T, typename Op>
+void zip_values(vector<vector<T>> &C, const vector<vector<T>> &A, const vector<vector<T>> &B, const Op &op)
+{
+    if (!same_pattern(A, B))
+    {
+        throw std::invalid_argument("The matrices must have the same dimensions and sparsity pattern.");
+    }
+    copy_pattern(C, A);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, A.size()), [&](const tbb::blocked_range<size_t> &r) {
+        for (size_t i = r.begin(); i < r.end(); i++)
+        {
+            ::transform_values(A[i].data(), B[i].data(), C[i].data(), A[i].size(), op);
+        }
+    });
+}
+
+/// @brief Parallel version of scale_into
+template <typename M>
+void scale_into(M &C, const M &A, const matrix_scalar_t<M> a)
+{
+    using T = matrix_scalar_t<M>;
+    parallel::map_values(C, A, [a](const T x) { return a * x; });
+}
+
+/// @brief Parallel version of shift_into
+template <typename M>
+void shift_into(M &C, const M &A, const matrix_scalar_t<M> b)
+{
+    using T = matrix_scalar_t<M>;
+    parallel::map_values(C, A, [b](const T x) { return x + b; });
+}
+
+/// @brief Parallel version of abs_into
+template <typename M>
+void abs_into(M &C, const M &A)
+{
+    using T = matrix_scalar_t<M>;
+    parallel::map_values(C, A, [](const T x) { return x < T(0) ? -x : x; });
+}
+
+/// @brief Parallel version of clamp_into
+/// @exception lo must not be greater than hi
+template <typename M>
+void clamp_into(M &C, const M &A, const matrix_scalar_t<M> lo, const matrix_scalar_t<M> hi)
+{
+    using T = matrix_scalar_t<M>;
+    if (hi < lo)
+    {
+        throw std::invalid_argument("The lower bound of a clamp must not be greater than the upper bound.");
+    }
+    parallel::map_values(C, A, [lo, hi](const T x) { return x < lo ? lo : (hi < x ? hi : x); });
+}
+
+/// @brief Parallel version of multiply_elementwise_into
+/// @exception A and B must have the same dimensions and sparsity pattern
+template <typename M>
+void multiply_elementwise_into(M &C, const M &A, const M &B)
+{
+    using T = matrix_scalar_t<M>;
+    parallel::zip_values(C, A, B, [](const T x, const T y) { return x * y; });
+}
+
+/// @brief Parallel version of axpb_into
+template <typename M>
+void axpb_into(M &C, const M &A, const matrix_scalar_t<M> a, const matrix_scalar_t<M> b)
+{
+    using T = matrix_scalar_t<M>;
+    parallel::map_values(C, A, [a, b](const T x) { return a * x + b; });
+}
+
+template <typename M>
+void scale_in_place(M &A, const matrix_scalar_t<M> a)
+{
+    parallel::scale_into(A, A, a);
+}
+
+template <typename M>
+void shift_in_place(M &A, const matrix_scalar_t<M> b)
+{
+    parallel::shift_into(A, A, b);
+}
+
+template <typename M>
+void abs_in_place(M &A)
+{
+    parallel::abs_into(A, A);
+}
+
+template <typename M>
+void clamp_in_place(M &A, const matrix_scalar_t<M> lo, const matrix_scalar_t<M> hi)
+{
+    parallel::clamp_into(A, A, lo, hi);
+}
+
+template <typename M>
+void multiply_elementwise_in_place(M &A, const M &B)
+{
+    parallel::multiply_elementwise_into(A, A, B);
+}
+
+template <typename M>
+void axpb_in_place(M &A, const matrix_scalar_t<M> a, const matrix_scalar_t<M> b)
+{
+    parallel::axpb_into(A, A, a, b);
+}
+
+} // namespace parallel
+
+#endif
@@ -0,0 +1,460 @@
+// functionsExpression.cc
+// Expression templates for the dense matrices (vector<vector<double>>) of functions.cc.
+// An expression such as 2.0 * term(A) + 3.0 * term(B) - term(C) is built lazily instead of
+// producing a temporary per operator, and assign evaluates it into the destination with
+// one fused, SIMD vectorized loop per row. Matrix products in the expression are
+// recognized and accumulated into the destination by a cache-blocked GEMM kernel, so
+// a * term(A) * term(B) + b * term(C) makes no temporaries at all.
+
+#ifndef FUNCTIONS_EXPRESSION_CC
+#define FUNCTIONS_EXPRESSION_CC
+
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "functionsSIMD.cc"
+
+namespace expr {
+
+using Matrix = std::vector<std::vector<double>>;
+
+/// @brief Columns of B and C per block of the GEMM kernel
+constexpr size_t GEMM_BLOCK_COLUMNS = 256;
+
+/// @brief Inner dimension per block of the GEMM kernel
+constexpr size_t GEMM_BLOCK_INNER = 128;
+
+/**
+ * @brief C[i] += alpha * A[i] * B for the rows first <= i < last. The loops are blocked
+ * so that a GEMM_BLOCK_INNER x GEMM_BLOCK_COLUMNS panel of B stays in cache while the
+ * rows of A and C stream past it; the innermost loop is a SIMD axpy on rows.
+ *
+ * @param C rows first ... last - 1 are updated, must not be A or B
+ * @param alpha
+ * @param A
+ * @param B A[0].size() x C[0].size()
+ */
+inline void gemm_accumulate_rows(Matrix &C, const double alpha, const Matrix &A, const Matrix &B, size_t first,
+                                 size_t last)
+{
+    const size_t inner = B.size(), cols = inner == 0 ? 0 : B[0].size();
+    for (size_t jj = 0; jj < cols; jj += GEMM_BLOCK_COLUMNS)
+    {
+        const size_t jEnd = std::min(cols, jj + GEMM_BLOCK_COLUMNS);
+        for (size_t kk = 0; kk < inner; kk += GEMM_BLOCK_INNER)
+        {
+            const size_t kEnd = std::min(inner, kk + GEMM_BLOCK_INNER);
+            for (size_t i = first; i < last; i++)
+            {
+                double *out = C[i].data();
+                const double *a = A[i].data();
+                for (size_t k = kk; k < kEnd; k++)
+                {
+                    const double aik = alpha * a[k];
+                    const double *b = B[k].data();
+                    SIMD_LOOP
+                    for (size_t j = jj; j < jEnd; j++)
+                    {
+                        out[j] += aik * b[j];
+                    }
+                }
+            }
+        }
+    }
+}
+
+/// @brief Base of every expression node, E being the node itself
+template <typename E>
+struct Expression
+{
+    const E &self() const { return static_cast<const E &>(*this); }
+};
+
+/*
+ * Every node provides
+ *   rows(), cols()
+ *   elementwise    true if it has a part that is evaluated entry by entry
+ *   products       true if it contains a matrix product
+ *   row(i)         the entries of row i of the elementwise part, indexable by column
+ *   prepare(eval)  evaluates the product operands that are not plain matrices
+ *   add_products(D, scale, first, last)
+ *                  D[i] += scale * (the products) for first <= i < last
+ *   refers_to(D)   true if D is one of the matrices read
+ */
+
+/// @brief A matrix operand, held by reference; it must outlive the expression
+class Ref : public Expression<Ref>
+{
+public:
+    static constexpr bool elementwise = true;
+    static constexpr bool products = false;
+
+    explicit Ref(const Matrix &m) : m(&m) {}
+
+    size_t rows() const { return m->size(); }
+    size_t cols() const { return m->empty() ? 0 : (*m)[0].size(); }
+    const double *row(size_t i) const { return (*m)[i].data(); }
+    template <typename F>
+    void prepare(const F &) const {}
+    void add_products(Matrix &, double, size_t, size_t) const {}
+    bool refers_to(const Matrix &D) const { return m == &D; }
+    const Matrix &matrix() const { return *m; }
+
+private:
+    const Matrix *m;
+};
+
+/// @brief Enters a dense matrix into an expression
+inline Ref term(const Matrix &m)
+{
+    return Ref(m);
+}
+
+template <typename Row>
+struct ScaledRow
+{
+    double s;
+    Row r;
+    double operator[](size_t j) const { return s * r[j]; }
+};
+
+template <typename RowL, typename RowR>
+struct SumRow
+{
+    RowL l;
+    RowR r;
+    double operator[](size_t j) const { return l[j] + r[j]; }
+};
+
+template <typename RowL, typename RowR>
+struct DifferenceRow
+{
+    RowL l;
+    RowR r;
+    double operator[](size_t j) const { return l[j] - r[j]; }
+};
+
+/// @brief s * e
+template <typename E>
+class Scaled : public Expression<Scaled<E>>
+{
+public:
+    static constexpr bool elementwise = E::elementwise;
+    static constexpr bool products = E::products;
+
+    Scaled(double s, const E &e) : s(s), e(e) {}
+
+    size_t rows() const { return e.rows(); }
+    size_t cols() const { return e.cols(); }
+    auto row(size_t i) const { return ScaledRow<decltype(e.row(i))>{s, e.row(i)}; }
+    template <typename F>
+    void prepare(const F &evaluate) const { e.prepare(evaluate); }
+    void add_products(Matrix &D, double scale, size_t first, size_t last) const
+    {
+        e.add_products(D, scale * s, first, last);
+    }
+    bool refers_to(const Matrix &D) const { return e.refers_to(D); }
+    double scale() const { return s; }
+    const E &operand() const { return e; }
+
+private:
+    double s;
+    E e;
+};
+
+/// @brief Throws unless l and r have the same dimensions
+template <typename L, typename R>
+void check_same_dimensions(const L &l, const R &r)
+{
+    if (l.rows() != r.rows() || l.cols() != r.cols())
+    {
+        throw std::invalid_argument("The matrices must have the same dimensions.");
+    }
+}
+
+/// @brief l + r
+template <typename L, typename R>
+class Sum : public Expression<Sum<L, R>>
+{
+public:
+    static constexpr bool elementwise = L::elementwise || R::elementwise;
+    static constexpr bool products = L::products || R::products;
+
+    Sum(const L &l, const R &r) : l(l), r(r) { check_same_dimensions(l, r); }
+
+    size_t rows() const { return l.rows(); }
+    size_t cols() const { return l.cols(); }
+    auto row(size_t i) const
+    {
+        if constexpr (!R::elementwise)
+        {
+            return l.row(i);
+        }
+        else if constexpr (!L::elementwise)
+        {
+            return r.row(i);
+        }
+        else
+        {
+            return SumRow<decltype(l.row(i)), decltype(r.row(i))>{l.row(i), r.row(i)};
+        }
+    }
+    template <typename F>
+    void prepare(const F &evaluate) const
+    {
+        l.prepare(evaluate);
+        r.prepare(evaluate);
+    }
+    void add_products(Matrix &D, double scale, size_t first, size_t last) const
+    {
+        l.add_products(D, scale, first, last);
+        r.add_products(D, scale, first, last);
+    }
+    bool refers_to(const Matrix &D) const { return l.refers_to(D) || r.refers_to(D); }
+
+private:
+    L l;
+    R r;
+};
+
+/// @brief l - r
+template <typename L, typename R>
+class Difference : public Expression<Difference<L, R>>
+{
+public:
+    static constexpr bool elementwise = L::elementwise || R::elementwise;
+    static constexpr bool products = L::products || R::products;
+
+    Difference(const L &l, const R &r) : l(l), r(r) { check_same_dimensions(l, r); }
+
+    size_t rows() const { return l.rows(); }
+    size_t cols() const { return l.cols(); }
+    auto row(size_t i) const
+    {
+        if constexpr (!R::elementwise)
+        {
+            return l.row(i);
+        }
+        else if constexpr (!L::elementwise)
+        {
+            return ScaledRow<decltype(r.row(i))>{-1.0, r.row(i)};
+        }
+        else
+        {
+            return DifferenceRow<decltype(l.row(i)), decltype(r.row(i))>{l.row(i), r.row(i)};
+        }
+    }
+    template <typename F>
+    void prepare(const F &evaluate) const
+    {
+        l.prepare(evaluate);
+        r.prepare(evaluate);
+    }
+    void add_products(Matrix &D, double scale, size_t first, size_t last) const
+    {
+        l.add_products(D, scale, first, last);
+        r.add_products(D, -scale, first, last);
+    }
+    bool refers_to(const Matrix &D) const { return l.refers_to(D) || r.refers_to(D); }
+
+private:
+    L l;
+    R r;
+};
+
+/// @brief A product operand that the GEMM kernel reads directly: a matrix, or a
+/// scaled matrix whose scale goes into alpha
+template <typename E>
+struct is_plain : std::false_type
+{
+};
+
+template <>
+struct is_plain<Ref> : std::true_type
+{
+};
+
+template <>
+struct is_plain<Scaled<Ref>> : std::true_type
+{
+};
+
+inline const Matrix &plain_matrix(const Ref &e) { return e.matrix(); }
+inline const Matrix &plain_matrix(const Scaled<Ref> &e) { return e.operand().matrix(); }
+inline double plain_scale(const Ref &) { return 1.0; }
+inline double plain_scale(const Scaled<Ref> &e) { return e.scale(); }
+
+/// @brief The matrix product l * r, never evaluated entry by entry: it is accumulated
+/// into the destination by the GEMM kernel. Operands other than (scaled) matrices are
+/// evaluated into temporaries first.
+template <typename L, typename R>
+class Product : public Expression<Product<L, R>>
+{
+public:
+    static constexpr bool elementwise = false;
+    static constexpr bool products = true;
+
+    Product(const L &l, const R &r) : l(l), r(r)
+    {
+        if (l.cols() != r.rows())
+        {
+            throw std::invalid_argument("The columns of the first matrix must match the rows of the second.");
+        }
+    }
+
+    size_t rows() const { return l.rows(); }
+    size_t cols() const { return r.cols(); }
+    template <typename F>
+    void prepare(const F &evaluate) const
+    {
+        if constexpr (!is_plain<L>::value)
+        {
+            evaluate(lValue, l);
+        }
+        if constexpr (!is_plain<R>::value)
+        {
+            evaluate(rValue, r);
+        }
+    }
+    void add_products(Matrix &D, double scale, size_t first, size_t last) const
+    {
+        gemm_accumulate_rows(D, scale * operand_scale(l) * operand_scale(r), operand(l, lValue), operand(r, rValue),
+                             first, last);
+    }
+    bool refers_to(const Matrix &D) const { return l.refers_to(D) || r.refers_to(D); }
+
+private:
+    template <typename E>
+    static const Matrix &operand(const E &e, const Matrix &value)
+    {
+        if constexpr (is_plain<E>::value)
+        {
+            return plain_matrix(e);
+        }
+        else
+        {
+            return value;
+        }
+    }
+    template <typename E>
+    static double operand_scale(const E &e)
+    {
+        if constexpr (is_plain<E>::value)
+        {
+            return plain_scale(e);
+        }
+        else
+        {
+            return 1.0;
+        }
+    }
+
+    L l;
+    R r;
+    // evaluated operands, filled in by prepare
+    mutable Matrix lValue, rValue;
+};
+
+template <typename L, typename R>
+Sum<L, R> operator+(const Expression<L> &l, const Expression<R> &r)
+{
+    return Sum<L, R>(l.self(), r.self());
+}
+
+template <typename L, typename R>
+Difference<L, R> operator-(const Expression<L> &l, const Expression<R> &r)
+{
+    return Difference<L, R>(l.self(), r.self());
+}
+
+template <typename E>
+Scaled<E> operator-(const Expression<E> &e)
+{
+    return Scaled<E>(-1.0, e.self());
+}
+
+template <typename E>
+Scaled<E> operator*(const double s, const Expression<E> &e)
+{
+    return Scaled<E>(s, e.self());
+}
+
+template <typename E>
+Scaled<E> operator*(const Expression<E> &e, const double s)
+{
+    return Scaled<E>(s, e.self());
+}
+
+template <typename L, typename R>
+Product<L, R> operator*(const Expression<L> &l, const Expression<R> &r)
+{
+    return Product<L, R>(l.self(), r.self());
+}
+
+/// @brief Writes the elementwise part of row i of e to out, zeros if there is none
+template <typename E>
+void evaluate_row(double *out, const E &e, size_t i, size_t cols)
+{
+    if constexpr (E::elementwise)
+    {
+        const auto row = e.row(i);
+        SIMD_LOOP
+        for (size_t j = 0; j < cols; j++)
+        {
+            out[j] = row[j];
+        }
+    }
+    else
+    {
+        std::fill(out, out + cols, 0.0);
+    }
+}
+
+/**
+ * @brief Evaluates an expression into D, reusing the rows of D. The elementwise part is
+ * written with one fused loop per row, then the products are accumulated with the
+ * blocked GEMM kernel. D may appear in the expression; if a product reads it, the
+ * expression is evaluated into a temporary first.
+ *
+ * @param D The destination
+ * @param expression
+ */
+template <typename E>
+void assign(Matrix &D, const Expression<E> &expression)
+{
+    const E &e = expression.self();
+    if (E::products && e.refers_to(D))
+    {
+        Matrix result;
+        assign(result, e);
+        D = std::move(result);
+        return;
+    }
+    e.prepare([](Matrix &value, const auto &operand) { assign(value, operand); });
+    const size_t rows = e.rows(), cols = e.cols();
+    D.resize(rows);
+    for (size_t i = 0; i < rows; i++)
+    {
+        D[i].resize(cols);
+        evaluate_row(D[i].data(), e, i, cols);
+    }
+    if constexpr (E::products)
+    {
+        e.add_products(D, 1.0, 0, rows);
+    }
+}
+
+/// @brief The value of an expression as a new matrix
+template <typename E>
+Matrix evaluate(const Expression<E> &expression)
+{
+    Matrix D;
+    assign(D, expression);
+    return D;
+}
+
+} // namespace expr
+
+#endif
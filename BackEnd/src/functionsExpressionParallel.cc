@@ -0,0 +1,65 @@
+// functionsExpressionParallel.cc
+// Parallel evaluation of the expression templates in functionsExpression.cc. The rows of
+// the destination are split into blocks; each task writes the fused elementwise part of
+// its rows and then accumulates the products into them with the blocked GEMM kernel, so
+// the tasks never write to the same row and the result equals the serial assign.
+
+#ifndef FUNCTIONS_EXPRESSION_PARALLEL_CC
+#define FUNCTIONS_EXPRESSION_PARALLEL_CC
+
+#include <utility>
+#include <tbb/tbb.h>
+#include "functionsExpression.cc"
+
+namespace parallel {
+
+/// @brief Below this many entries in the destination the serial assign is used
+constexpr size_t EXPRESSION_PARALLEL_CUTOFF = 1 << 15;
+
+/// @brief Parallel version of expr::assign
+template <typename E>
+void assign(expr::Matrix &D, const expr::Expression<E> &expression)
+{
+    const E &e = expression.self();
+    const size_t rows = e.rows(), cols = e.cols();
+    if (rows * cols < EXPRESSION_PARALLEL_CUTOFF && !E::products)
+    {
+        expr::assign(D, e);
+        return;
+    }
+    if (E::products && e.refers_to(D))
+    {
+        expr::Matrix result;
+        parallel::assign(result, e);
+        D = std::move(result);
+        return;
+    }
+    e.prepare([](expr::Matrix &value, const auto &operand) { parallel::assign(value, operand); });
+    D.resize(rows);
+    // a GEMM row costs a row of B per entry of A, so products get smaller blocks
+    const size_t grain = E::products ? 16 : std::max<size_t>(1, EXPRESSION_PARALLEL_CUTOFF / std::max<size_t>(cols, 1));
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, rows, grain), [&](const tbb::blocked_range<size_t> &r) {
+        for (size_t i = r.begin(); i < r.end(); i++)
+        {
+            D[i].resize(cols);
+            expr::evaluate_row(D[i].data(), e, i, cols);
+        }
+        if constexpr (E::products)
+        {
+            e.add_products(D, 1.0, r.begin(), r.end());
+        }
+    });
+}
+
+/// @brief Parallel version of expr::evaluate
+template <typename E>
+expr::Matrix evaluate(const expr::Expression<E> &expression)
+{
+    expr::Matrix D;
+    parallel::assign(D, expression);
+    return D;
+}
+
+} // namespace parallel
+
+#endif
@@ -0,0 +1,620 @@
+// functionsFixed.cc
+// Dense matrices whose dimensions are compile-time constants, for the many tiny systems
+// (2x2 to 16x16) that the vector<vector<double>> code spends more time allocating than
+// solving. A FixedMatrix lives on the stack in one row-major array; every loop has a
+// constexpr trip count and is unrolled, so multiply, LU, Cholesky, inverse and solve
+// compile to straight-line code. The load/store functions and the pointer kernels at the
+// end work on blocks stored contiguously inside a larger array, as the blocks of a
+// block sparse format or the matrices of a batch are. This file only depends on the
+// standard library so that every matrix format can include it.
+
+#ifndef FUNCTIONS_FIXED_CC
+#define FUNCTIONS_FIXED_CC
+
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Unrolls a loop whose trip count is a compile-time constant
+#if defined(__clang__)
+#define FIXED_UNROLL _Pragma("unroll")
+#elif defined(__GNUC__)
+#define FIXED_UNROLL _Pragma("GCC unroll 16")
+#else
+#define FIXED_UNROLL
+#endif
+
+/// @brief The largest dimension that dispatch_fixed_size hands to the fixed kernels
+constexpr size_t FIXED_MAX_DIMENSION = 16;
+
+/**
+ * @brief An R x C dense matrix stored on the stack, row major. It is an aggregate, so
+ * FixedMatrix<double, 2, 2> A = {{1, 2, 3, 4}}; lists the entries row by row.
+ *
+ * @tparam T
+ * @tparam R rows
+ * @tparam C columns
+ */
+template <typename T, size_t R, size_t C>
+struct FixedMatrix
+{
+    static_assert(R > 0 && C > 0, "A fixed matrix needs at least one row and column");
+    static constexpr size_t rows = R;
+    static constexpr size_t cols = C;
+
+    T a[R * C];
+
+    T &operator()(size_t i, size_t j) { return a[i * C + j]; }
+    const T &operator()(size_t i, size_t j) const { return a[i * C + j]; }
+    T *row(size_t i) { return a + i * C; }
+    const T *row(size_t i) const { return a + i * C; }
+
+    static FixedMatrix zero()
+    {
+        FixedMatrix m;
+        FIXED_UNROLL
+        for (size_t k = 0; k < R * C; k++)
+        {
+            m.a[k] = T(0);
+        }
+        return m;
+    }
+
+    static FixedMatrix identity()
+    {
+        FixedMatrix m = zero();
+        FIXED_UNROLL
+        for (size_t i = 0; i < (R < C ? R : C); i++)
+        {
+            m(i, i) = T(1);
+        }
+        return m;
+    }
+};
+
+template <typename T, size_t N>
+using FixedVector = std::array<T, N>;
+
+/// @brief Reads an R x C row-major block starting at p
+template <typename T, size_t R, size_t C>
+void load_fixed(FixedMatrix<T, R, C> &A, const T *p)
+{
+    FIXED_UNROLL
+    for (size_t k = 0; k < R * C; k++)
+    {
+        A.a[k] = p[k];
+    }
+}
+
+/// @brief Writes A as an R x C row-major block starting at p
+template <typename T, size_t R, size_t C>
+void store_fixed(const FixedMatrix<T, R, C> &A, T *p)
+{
+    FIXED_UNROLL
+    for (size_t k = 0; k < R * C; k++)
+    {
+        p[k] = A.a[k];
+    }
+}
+
+/// @brief The fixed matrix holding a dense matrix
+/// @exception m must be R x C
+template <typename T, size_t R, size_t C>
+FixedMatrix<T, R, C> to_fixed(const std::vector<std::vector<T>> &m)
+{
+    if (m.size() != R)
+    {
+        throw std::invalid_argument("The matrix does not have the dimensions of the fixed matrix.");
+    }
+    FixedMatrix<T, R, C> A;
+    for (size_t i = 0; i < R; i++)
+    {
+        if (m[i].size() != C)
+        {
+            throw std::invalid_argument("The matrix does not have the dimensions of the fixed matrix.");
+        }
+        for (size_t j = 0; j < C; j++)
+        {
+            A(i, j) = m[i][j];
+        }
+    }
+    return A;
+}
+
+/// @brief The dense matrix holding a fixed matrix
+template <typename T, size_t R, size_t C>
+std::vector<std::vector<T>> to_dense(const FixedMatrix<T, R, C> &A)
+{
+    std::vector<std::vector<T>> m(R);
+    for (size_t i = 0; i < R; i++)
+    {
+        m[i].assign(A.row(i), A.row(i) + C);
+    }
+    return m;
+}
+
+template <typename T, size_t R, size_t C>
+bool operator==(const FixedMatrix<T, R, C> &A, const FixedMatrix<T, R, C> &B)
+{
+    for (size_t k = 0; k < R * C; k++)
+    {
+        if (!(A.a[k] == B.a[k]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T, size_t R, size_t C>
+FixedMatrix<T, R, C> operator+(const FixedMatrix<T, R, C> &A, const FixedMatrix<T, R, C> &B)
+{
+    FixedMatrix<T, R, C> S;
+    FIXED_UNROLL
+    for (size_t k = 0; k < R * C; k++)
+    {
+        S.a[k] = A.a[k] + B.a[k];
+    }
+    return S;
+}
+
+template <typename T, size_t R, size_t C>
+FixedMatrix<T, R, C> operator-(const FixedMatrix<T, R, C> &A, const FixedMatrix<T, R, C> &B)
+{
+    FixedMatrix<T, R, C> S;
+    FIXED_UNROLL
+    for (size_t k = 0; k < R * C; k++)
+    {
+        S.a[k] = A.a[k] - B.a[k];
+    }
+    return S;
+}
+
+template <typename T, size_t R, size_t C>
+FixedMatrix<T, R, C> operator*(const T s, const FixedMatrix<T, R, C> &A)
+{
+    FixedMatrix<T, R, C> S;
+    FIXED_UNROLL
+    for (size_t k = 0; k < R * C; k++)
+    {
+        S.a[k] = s * A.a[k];
+    }
+    return S;
+}
+
+/// @brief C += A * B; the register-sized kernel the block formats accumulate with
+template <typename T, size_t R, size_t K, size_t C>
+void multiply_add_fixed(FixedMatrix<T, R, C> &D, const FixedMatrix<T, R, K> &A, const FixedMatrix<T, K, C> &B)
+{
+    FIXED_UNROLL
+    for (size_t i = 0; i < R; i++)
+    {
+        FIXED_UNROLL
+        for (size_t k = 0; k < K; k++)
+        {
+            const T aik = A(i, k);
+            FIXED_UNROLL
+            for (size_t j = 0; j < C; j++)
+            {
+                D(i, j) += aik * B(k, j);
+            }
+        }
+    }
+}
+
+/// @brief A * B
+template <typename T, size_t R, size_t K, size_t C>
+FixedMatrix<T, R, C> operator*(const FixedMatrix<T, R, K> &A, const FixedMatrix<T, K, C> &B)
+{
+    FixedMatrix<T, R, C> D = FixedMatrix<T, R, C>::zero();
+    multiply_add_fixed(D, A, B);
+    return D;
+}
+
+/// @brief y += A * x
+template <typename T, size_t R, size_t C>
+void multiply_add_fixed(FixedVector<T, R> &y, const FixedMatrix<T, R, C> &A, const FixedVector<T, C> &x)
+{
+    FIXED_UNROLL
+    for (size_t i = 0; i < R; i++)
+    {
+        T s = y[i];
+        FIXED_UNROLL
+        for (size_t j = 0; j < C; j++)
+        {
+            s += A(i, j) * x[j];
+        }
+        y[i] = s;
+    }
+}
+
+/// @brief A * x
+template <typename T, size_t R, size_t C>
+FixedVector<T, R> operator*(const FixedMatrix<T, R, C> &A, const FixedVector<T, C> &x)
+{
+    FixedVector<T, R> y{};
+    multiply_add_fixed(y, A, x);
+    return y;
+}
+
+template <typename T, size_t R, size_t C>
+FixedMatrix<T, C, R> transpose_fixed(const FixedMatrix<T, R, C> &A)
+{
+    FixedMatrix<T, C, R> B;
+    FIXED_UNROLL
+    for (size_t i = 0; i < R; i++)
+    {
+        FIXED_UNROLL
+        for (size_t j = 0; j < C; j++)
+        {
+            B(j, i) = A(i, j);
+        }
+    }
+    return B;
+}
+
+/**
+ * @brief y += A * x for an R x C row-major block stored at block, the kernel of a block
+ * sparse matrix-vector product
+ *
+ * @param block R * C entries
+ * @param x C entries
+ * @param y R entries, added to
+ */
+template <size_t R, size_t C, typename T>
+void block_multiply_add(const T *block, const T *x, T *y)
+{
+    FIXED_UNROLL
+    for (size_t i = 0; i < R; i++)
+    {
+        T s = y[i];
+        FIXED_UNROLL
+        for (size_t j = 0; j < C; j++)
+        {
+            s += block[i * C + j] * x[j];
+        }
+        y[i] = s;
+    }
+}
+
+/**
+ * @brief An LU factorization with partial pivoting, PA = LU. lu holds L below the
+ * diagonal (its unit diagonal is not stored) and U on and above it, as
+ * lu_factorization_inplace leaves them; row i of PA is row perm[i] of A.
+ */
+template <typename T, size_t N>
+struct FixedLU
+{
+    FixedMatrix<T, N, N> lu;
+    std::array<size_t, N> perm;
+};
+
+/**
+ * @brief LU factorization with partial pivoting
+ *
+ * @exception std::runtime_error the matrix is singular
+ */
+template <typename T, size_t N>
+FixedLU<T, N> lu_fixed(const FixedMatrix<T, N, N> &A)
+{
+    FixedLU<T, N> f{A, {}};
+    FixedMatrix<T, N, N> &m = f.lu;
+    FIXED_UNROLL
+    for (size_t i = 0; i < N; i++)
+    {
+        f.perm[i] = i;
+    }
+    FIXED_UNROLL
+    for (size_t k = 0; k < N; k++)
+    {
+        size_t pivot = k;
+        T pivotValue = std::abs(m(k, k));
+        for (size_t i = k + 1; i < N; i++)
+        {
+            if (std::abs(m(i, k)) > pivotValue)
+            {
+                pivotValue = std::abs(m(i, k));
+                pivot = i;
+            }
+        }
+        if (pivotValue == T(0))
+        {
+            throw std::runtime_error("Singular matrix");
+        }
+        if (pivot != k)
+        {
+            std::swap(f.perm[k], f.perm[pivot]);
+            FIXED_UNROLL
+            for (size_t j = 0; j < N; j++)
+            {
+                std::swap(m(k, j), m(pivot, j));
+            }
+        }
+        const T inverse = T(1) / m(k, k);
+        FIXED_UNROLL
+        for (size_t i = k + 1; i < N; i++)
+        {
+            const T factor = m(i, k) * inverse;
+            m(i, k) = factor;
+            FIXED_UNROLL
+            for (size_t j = k + 1; j < N; j++)
+            {
+                m(i, j) -= factor * m(k, j);
+            }
+        }
+    }
+    return f;
+}
+
+/// @brief Solves Ax = b from the LU factorization of A
+template <typename T, size_t N>
+FixedVector<T, N> lu_solve_fixed(const FixedLU<T, N> &f, const FixedVector<T, N> &b)
+{
+    FixedVector<T, N> x;
+    FIXED_UNROLL
+    for (size_t i = 0; i < N; i++)
+    {
+        T s = b[f.perm[i]];
+        FIXED_UNROLL
+        for (size_t j = 0; j < i; j++)
+        {
+            s -= f.lu(i, j) * x[j];
+        }
+        x[i] = s;
+    }
+    FIXED_UNROLL
+    for (size_t r = 0; r < N; r++)
+    {
+        const size_t i = N - 1 - r;
+        T s = x[i];
+        FIXED_UNROLL
+        for (size_t j = i + 1; j < N; j++)
+        {
+            s -= f.lu(i, j) * x[j];
+        }
+        x[i] = s / f.lu(i, i);
+    }
+    return x;
+}
+
+/// @brief Solves AX = B, column by column, from the LU factorization of A
+template <typename T, size_t N, size_t C>
+FixedMatrix<T, N, C> lu_solve_fixed(const FixedLU<T, N> &f, const FixedMatrix<T, N, C> &B)
+{
+    FixedMatrix<T, N, C> X;
+    FIXED_UNROLL
+    for (size_t i = 0; i < N; i++)
+    {
+        FIXED_UNROLL
+        for (size_t c = 0; c < C; c++)
+        {
+            X(i, c) = B(f.perm[i], c);
+        }
+        FIXED_UNROLL
+        for (size_t j = 0; j < i; j++)
+        {
+            FIXED_UNROLL
+            for (size_t c = 0; c < C; c++)
+            {
+                X(i, c) -= f.lu(i, j) * X(j, c);
+            }
+        }
+    }
+    FIXED_UNROLL
+    for (size_t r = 0; r < N; r++)
+    {
+        const size_t i = N - 1 - r;
+        FIXED_UNROLL
+        for (size_t j = i + 1; j < N; j++)
+        {
+            FIXED_UNROLL
+            for (size_t c = 0; c < C; c++)
+            {
+                X(i, c) -= f.lu(i, j) * X(j, c);
+            }
+        }
+        const T inverse = T(1) / f.lu(i, i);
+        FIXED_UNROLL
+        for (size_t c = 0; c < C; c++)
+        {
+            X(i, c) *= inverse;
+        }
+    }
+    return X;
+}
+
+/// @brief Solves Ax = b with partial pivoting
+/// @exception std::runtime_error A is singular
+template <typename T, size_t N>
+FixedVector<T, N> solve_fixed(const FixedMatrix<T, N, N> &A, const FixedVector<T, N> &b)
+{
+    return lu_solve_fixed(lu_fixed(A), b);
+}
+
+/// @brief The inverse of A
+/// @exception std::runtime_error A is singular
+template <typename T, size_t N>
+FixedMatrix<T, N, N> inverse_fixed(const FixedMatrix<T, N, N> &A)
+{
+    return lu_solve_fixed(lu_fixed(A), FixedMatrix<T, N, N>::identity());
+}
+
+/// @brief The determinant of A, 0 if A is singular
+template <typename T, size_t N>
+T determinant_fixed(const FixedMatrix<T, N, N> &A)
+{
+    FixedLU<T, N> f;
+    try
+    {
+        f = lu_fixed(A);
+    }
+    catch (const std::runtime_error &)
+    {
+        return T(0);
+    }
+    T det = T(1);
+    FIXED_UNROLL
+    for (size_t i = 0; i < N; i++)
+    {
+        det *= f.lu(i, i);
+        // every swap of the permutation flips the sign
+        for (size_t j = i + 1; j < N; j++)
+        {
+            if (f.perm[j] < f.perm[i])
+            {
+                det = -det;
+            }
+        }
+    }
+    return det;
+}
+
+/**
+ * @brief The Cholesky factor L of a symmetric positive definite matrix, A = L L^T, with
+ * zeros above the diagonal as cholesky_factorization returns it
+ *
+ * @exception std::invalid_argument A is not positive definite
+ */
+template <typename T, size_t N>
+FixedMatrix<T, N, N> cholesky_fixed(const FixedMatrix<T, N, N> &A)
+{
+    FixedMatrix<T, N, N> L = FixedMatrix<T, N, N>::zero();
+    FIXED_UNROLL
+    for (size_t j = 0; j < N; j++)
+    {
+        T d = A(j, j);
+        FIXED_UNROLL
+        for (size_t k = 0; k < j; k++)
+        {
+            d -= L(j, k) * L(j, k);
+        }
+        if (!(d > T(0)))
+        {
+            throw std::invalid_argument("Error: Matrix is not positive definite");
+        }
+        L(j, j) = std::sqrt(d);
+        const T inverse = T(1) / L(j, j);
+        FIXED_UNROLL
+        for (size_t i = j + 1; i < N; i++)
+        {
+            T s = A(i, j);
+            FIXED_UNROLL
+            for (size_t k = 0; k < j; k++)
+            {
+                s -= L(i, k) * L(j, k);
+            }
+            L(i, j) = s * inverse;
+        }
+    }
+    return L;
+}
+
+/// @brief Solves Ax = b from the Cholesky factor L of A
+template <typename T, size_t N>
+FixedVector<T, N> cholesky_solve_fixed(const FixedMatrix<T, N, N> &L, const FixedVector<T, N> &b)
+{
+    FixedVector<T, N> x;
+    FIXED_UNROLL
+    for (size_t i = 0; i < N; i++)
+    {
+        T s = b[i];
+        FIXED_UNROLL
+        for (size_t k = 0; k < i; k++)
+        {
+            s -= L(i, k) * x[k];
+        }
+        x[i] = s / L(i, i);
+    }
+    FIXED_UNROLL
+    for (size_t r = 0; r < N; r++)
+    {
+        const size_t i = N - 1 - r;
+        T s = x[i];
+        FIXED_UNROLL
+        for (size_t k = i + 1; k < N; k++)
+        {
+            s -= L(k, i) * x[k];
+        }
+        x[i] = s / L(i, i);
+    }
+    return x;
+}
+
+/**
+ * @brief gaussian_elimination on a fixed matrix, step for step: A is left as that
+ * function leaves it and b holds the solution
+ *
+ * @return false if a pivot is not larger than 1e-10 in magnitude
+ */
+template <typename T, size_t N>
+bool gaussian_elimination_fixed(FixedMatrix<T, N, N> &A, FixedVector<T, N> &b)
+{
+    FIXED_UNROLL
+    for (size_t i = 0; i < N; i++)
+    {
+        size_t max = i;
+        for (size_t k = i + 1; k < N; k++)
+        {
+            if (std::abs(A(k, i)) > std::abs(A(max, i)))
+            {
+                max = k;
+            }
+        }
+        FIXED_UNROLL
+        for (size_t j = 0; j < N; j++)
+        {
+            std::swap(A(i, j), A(max, j));
+        }
+        std::swap(b[i], b[max]);
+        if (std::abs(A(i, i)) <= 1e-10)
+        {
+            return false;
+        }
+        FIXED_UNROLL
+        for (size_t k = i + 1; k < N; k++)
+        {
+            const T t = A(k, i) / A(i, i);
+            FIXED_UNROLL
+            for (size_t j = i; j < N; j++)
+            {
+                A(k, j) -= A(i, j) * t;
+            }
+            b[k] -= b[i] * t;
+        }
+    }
+    FIXED_UNROLL
+    for (size_t r = 0; r < N; r++)
+    {
+        const size_t i = N - 1 - r;
+        FIXED_UNROLL
+        for (size_t j = i + 1; j < N; j++)
+        {
+            b[i] -= A(i, j) * b[j];
+        }
+        b[i] = b[i] / A(i, i);
+    }
+    return true;
+}
+
+/**
+ * @brief Calls f(std::integral_constant<size_t, N>()) for N = n, which turns a size
+ * known at run time into the template argument of the fixed kernels
+ *
+ * @return false, without calling f, if n is 0 or above FIXED_MAX_DIMENSION
+ */
+template <typename F, size_t... N>
+bool dispatch_fixed_size(size_t n, F &&f, std::index_sequence<N...>)
+{
+    return ((n == N + 1 ? (f(std::integral_constant<size_t, N + 1>()), true) : false) || ...);
+}
+
+template <typename F>
+bool dispatch_fixed_size(size_t n, F &&f)
+{
+    return dispatch_fixed_size(n, std::forward<F>(f), std::make_index_sequence<FIXED_MAX_DIMENSION>());
+}
+
+#endif
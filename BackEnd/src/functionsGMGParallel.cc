@@ -0,0 +1,585 @@
+// functionsGMGParallel.cc
+// Geometric multigrid for constant coefficient stencil problems on structured 1D, 2D
+// and 3D grids. Nothing is assembled: smoothing, residuals and the grid transfers
+// work directly on the stencil, and every grid sweep is a TBB parallel loop.
+
+#ifndef FUNCTIONS_GMG_PARALLEL_CC
+#define FUNCTIONS_GMG_PARALLEL_CC
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include <tbb/tbb.h>
+#include "functionsCSR.cc"
+
+namespace parallel {
+using namespace std;
+
+/// @brief A constant coefficient 3/5/7-point stencil on a grid of n[0] x n[1] x n[2]
+/// interior points with zero Dirichlet boundaries. Point (i, j, k) is stored at
+/// i + n[0] * (j + n[1] * k). lower[d] and upper[d] couple a point to its neighbours
+/// at -1 and +1 along dimension d; dimensions >= dims must have n[d] == 1.
+template <typename T>
+class StencilProblem
+{
+public:
+    size_t dims = 1;
+    size_t n[3] = {1, 1, 1};
+    T center = 0;
+    T lower[3] = {0, 0, 0};
+    T upper[3] = {0, 0, 0};
+
+    size_t size() const { return n[0] * n[1] * n[2]; }
+};
+
+/// @brief The standard second order Laplacian stencil (2 * dims, -1, ..., -1) with
+/// m points in every dimension
+template <typename T>
+StencilProblem<T> poisson_stencil(size_t dims, size_t m)
+{
+    if (dims < 1 || dims > 3)
+    {
+        throw std::invalid_argument("Stencil problems have 1, 2 or 3 dimensions.");
+    }
+    StencilProblem<T> p;
+    p.dims = dims;
+    p.center = 2.0 * dims;
+    for (size_t d = 0; d < dims; d++)
+    {
+        p.n[d] = m;
+        p.lower[d] = -1.0;
+        p.upper[d] = -1.0;
+    }
+    return p;
+}
+
+/// @brief Sum of the off-center stencil terms at point p = (i, j, k)
+template <typename T>
+inline T stencil_neighbours(const StencilProblem<T> &s, const T *x, size_t i, size_t j, size_t k, size_t p)
+{
+    const size_t sj = s.n[0];
+    const size_t sk = s.n[0] * s.n[1];
+    T sum = 0;
+    if (i > 0)
+        sum += s.lower[0] * x[p - 1];
+    if (i + 1 < s.n[0])
+        sum += s.upper[0] * x[p + 1];
+    if (j > 0)
+        sum += s.lower[1] * x[p - sj];
+    if (j + 1 < s.n[1])
+        sum += s.upper[1] * x[p + sj];
+    if (k > 0)
+        sum += s.lower[2] * x[p - sk];
+    if (k + 1 < s.n[2])
+        sum += s.upper[2] * x[p + sk];
+    return sum;
+}
+
+/// @brief Runs body(i, j, k, p) over every grid point in parallel. The 2D range covers
+/// (grid line, position in line) so 1D problems are split as well.
+template <typename T, typename Body>
+void stencil_for_each(const StencilProblem<T> &s, const Body &body)
+{
+    const size_t lines = s.n[1] * s.n[2];
+    tbb::parallel_for(tbb::blocked_range2d<size_t>(0, lines, 0, s.n[0]),
+                      [&](const tbb::blocked_range2d<size_t> &r)
+                      {
+                          for (size_t line = r.rows().begin(); line < r.rows().end(); line++)
+                          {
+                              const size_t j = line % s.n[1];
+                              const size_t k = line / s.n[1];
+                              for (size_t i = r.cols().begin(); i < r.cols().end(); i++)
+                              {
+                                  body(i, j, k, i + s.n[0] * line);
+                              }
+                          }
+                      });
+}
+
+/// @brief y = A x for the stencil operator A
+template <typename T>
+void stencil_apply(const StencilProblem<T> &s, const vector<T> &x, vector<T> &y)
+{
+    y.resize(s.size());
+    stencil_for_each(s, [&](size_t i, size_t j, size_t k, size_t p)
+                     { y[p] = s.center * x[p] + stencil_neighbours(s, x.data(), i, j, k, p); });
+}
+
+/// @brief Assembles the stencil operator as a CSR matrix, mainly for checking results
+/// and for handing the same problem to the algebraic solvers
+template <typename T>
+CSRMatrix<T> stencil_to_CSR(const StencilProblem<T> &s)
+{
+    CSRMatrix<T> A;
+    A.numRows = s.size();
+    A.numColumns = s.size();
+    A.row_ptr.push_back(0);
+    const size_t stride[3] = {1, s.n[0], s.n[0] * s.n[1]};
+    for (size_t k = 0; k < s.n[2]; k++)
+    {
+        for (size_t j = 0; j < s.n[1]; j++)
+        {
+            for (size_t i = 0; i < s.n[0]; i++)
+            {
+                const size_t p = i + s.n[0] * (j + s.n[1] * k);
+                const size_t idx[3] = {i, j, k};
+                for (int d = 2; d >= 0; d--)
+                {
+                    if (idx[d] > 0 && s.lower[d] != 0)
+                    {
+                        A.col_ind.push_back(p - stride[d]);
+                        A.val.push_back(s.lower[d]);
+                    }
+                }
+                A.col_ind.push_back(p);
+                A.val.push_back(s.center);
+                for (int d = 0; d < 3; d++)
+                {
+                    if (idx[d] + 1 < s.n[d] && s.upper[d] != 0)
+                    {
+                        A.col_ind.push_back(p + stride[d]);
+                        A.val.push_back(s.upper[d]);
+                    }
+                }
+                A.row_ptr.push_back(A.col_ind.size());
+            }
+        }
+    }
+    return A;
+}
+
+/**
+ * @brief Rediscretizes the stencil on the grid with twice the spacing. The stencil is
+ * read as a second order finite difference of -eps u'' + b u' + sigma u in each
+ * dimension: the diffusion part (lower + upper) / 2 scales with 1/h^2, the convection
+ * part (upper - lower) / 2 with 1/h and the reaction sigma does not change. Once the
+ * cell Peclet number exceeds 2 the central stencil would get positive off-diagonals,
+ * so coarse grids then get the artificial diffusion of first order upwinding.
+ */
+template <typename T>
+StencilProblem<T> stencil_coarsen(const StencilProblem<T> &s)
+{
+    StencilProblem<T> c;
+    c.dims = s.dims;
+    T sigma = s.center;
+    T coarseDiffusion = 0;
+    for (size_t d = 0; d < s.dims; d++)
+    {
+        const T diffusion = (s.lower[d] + s.upper[d]) / 2.0;
+        const T convection = (s.upper[d] - s.lower[d]) / 2.0;
+        sigma += 2.0 * diffusion;
+        T cDiffusion = diffusion / 4.0;
+        const T cConvection = convection / 2.0;
+        if (std::abs(cConvection) > std::abs(cDiffusion))
+        {
+            cDiffusion = -std::abs(cConvection);
+        }
+        c.n[d] = (s.n[d] - 1) / 2;
+        c.lower[d] = cDiffusion - cConvection;
+        c.upper[d] = cDiffusion + cConvection;
+        coarseDiffusion += cDiffusion;
+    }
+    c.center = sigma - 2.0 * coarseDiffusion;
+    return c;
+}
+
+/// @brief A grid can be coarsened when every dimension has an odd number >= 3 of points
+template <typename T>
+bool stencil_can_coarsen(const StencilProblem<T> &s)
+{
+    for (size_t d = 0; d < s.dims; d++)
+    {
+        if (s.n[d] < 3 || s.n[d] % 2 == 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+enum class GMGCycle
+{
+    V,
+    W,
+    F
+};
+
+enum class GMGSmoother
+{
+    RedBlackGaussSeidel,
+    Jacobi
+};
+
+/// @brief Parameters of the geometric multigrid cycle
+class GMGOptions
+{
+public:
+    GMGCycle cycle = GMGCycle::V;
+    GMGSmoother smoother = GMGSmoother::RedBlackGaussSeidel;
+    int preSweeps = 2;
+    int postSweeps = 2;
+    /// damping of the Jacobi smoother, 0 picks 4 / (3 * Gershgorin bound of D^-1 A)
+    double jacobiWeight = 0;
+    /// post smoothing visits the red-black colors in reverse order, which makes the
+    /// cycle a symmetric operator as conjugate gradients needs, at some cost in speed
+    bool symmetric = false;
+    size_t maxLevels = 30;
+    /// the coarsest grid is solved with dense LU and may have at most this many points
+    size_t maxCoarseSize = 4096;
+};
+
+template <typename T>
+class GMGLevel
+{
+public:
+    StencilProblem<T> op;
+    vector<T> x, b, r, work;
+};
+
+/// @brief Grid hierarchy, levels[0] is the fine grid. The coarsest grid is factored
+/// once into coarseLU/coarsePivot.
+template <typename T>
+class GMGHierarchy
+{
+public:
+    GMGOptions options;
+    vector<GMGLevel<T>> levels;
+    vector<T> coarseLU;
+    vector<size_t> coarsePivot;
+};
+
+/**
+ * @brief Builds the grid hierarchy for a stencil problem by halving every dimension
+ * until the grid cannot be coarsened further. Grids with m * 2^L - 1 points per
+ * dimension give L + 1 levels; the coarsest one is solved directly.
+ *
+ * @tparam T
+ * @param problem fine grid operator
+ * @param options
+ * @return GMGHierarchy<T>
+ */
+template <typename T>
+GMGHierarchy<T> gmg_setup(const StencilProblem<T> &problem, const GMGOptions &options = GMGOptions())
+{
+    if (problem.dims < 1 || problem.dims > 3)
+    {
+        throw std::invalid_argument("Stencil problems have 1, 2 or 3 dimensions.");
+    }
+    for (size_t d = problem.dims; d < 3; d++)
+    {
+        if (problem.n[d] != 1)
+        {
+            throw std::invalid_argument("Unused grid dimensions must have size 1.");
+        }
+    }
+    if (problem.center == 0)
+    {
+        throw std::invalid_argument("The stencil needs a nonzero center.");
+    }
+    GMGHierarchy<T> H;
+    H.options = options;
+    H.levels.emplace_back();
+    H.levels[0].op = problem;
+    while (H.levels.size() < options.maxLevels && stencil_can_coarsen(H.levels.back().op))
+    {
+        StencilProblem<T> coarse = stencil_coarsen(H.levels.back().op);
+        H.levels.emplace_back();
+        H.levels.back().op = coarse;
+    }
+    for (GMGLevel<T> &level : H.levels)
+    {
+        const size_t n = level.op.size();
+        level.x.resize(n);
+        level.b.resize(n);
+        level.r.resize(n);
+        level.work.resize(n);
+    }
+
+    const StencilProblem<T> &coarse = H.levels.back().op;
+    const size_t n = coarse.size();
+    if (n > options.maxCoarseSize)
+    {
+        throw std::invalid_argument("The grid cannot be coarsened far enough, use m * 2^L - 1 points per dimension.");
+    }
+    CSRMatrix<T> A = stencil_to_CSR(coarse);
+    H.coarseLU.assign(n * n, 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t k = A.row_ptr[i]; k < A.row_ptr[i + 1]; k++)
+        {
+            H.coarseLU[i * n + A.col_ind[k]] = A.val[k];
+        }
+    }
+    dense_lu_factor(H.coarseLU, H.coarsePivot, n);
+    return H;
+}
+
+/// @brief `sweeps` smoothing steps on level.x for the right hand side level.b, with the
+/// red-black colors in reverse order when `reverse` is set
+template <typename T>
+void gmg_smooth(GMGLevel<T> &level, const GMGOptions &options, int sweeps, bool reverse)
+{
+    const StencilProblem<T> &s = level.op;
+    vector<T> &x = level.x;
+    const vector<T> &b = level.b;
+    const T invCenter = 1.0 / s.center;
+    if (options.smoother == GMGSmoother::RedBlackGaussSeidel)
+    {
+        for (int sweep = 0; sweep < sweeps; sweep++)
+        {
+            for (size_t c = 0; c < 2; c++)
+            {
+                const size_t color = reverse ? 1 - c : c;
+                stencil_for_each(s, [&](size_t i, size_t j, size_t k, size_t p)
+                                 {
+                                     if ((i + j + k) % 2 == color)
+                                     {
+                                         x[p] = (b[p] - stencil_neighbours(s, x.data(), i, j, k, p)) * invCenter;
+                                     } });
+            }
+        }
+        return;
+    }
+    T weight = options.jacobiWeight;
+    if (weight == 0)
+    {
+        T bound = std::abs(s.center);
+        for (size_t d = 0; d < s.dims; d++)
+        {
+            bound += std::abs(s.lower[d]) + std::abs(s.upper[d]);
+        }
+        weight = 4.0 / 3.0 * std::abs(s.center) / bound;
+    }
+    vector<T> &xNew = level.work;
+    for (int sweep = 0; sweep < sweeps; sweep++)
+    {
+        stencil_for_each(s, [&](size_t i, size_t j, size_t k, size_t p)
+                         {
+                             const T r = b[p] - s.center * x[p] - stencil_neighbours(s, x.data(), i, j, k, p);
+                             xNew[p] = x[p] + weight * invCenter * r; });
+        x.swap(xNew);
+    }
+}
+
+/// @brief level.r = level.b - A level.x
+template <typename T>
+void gmg_residual(GMGLevel<T> &level)
+{
+    const StencilProblem<T> &s = level.op;
+    stencil_for_each(s, [&](size_t i, size_t j, size_t k, size_t p)
+                     { level.r[p] = level.b[p] - s.center * level.x[p] - stencil_neighbours(s, level.x.data(), i, j, k, p); });
+}
+
+/// @brief Full weighting restriction of fine.r into coarse.b, the tensor product of
+/// the 1D weights (1/4, 1/2, 1/4) over the coarsened dimensions
+template <typename T>
+void gmg_restrict(const GMGLevel<T> &fine, GMGLevel<T> &coarse)
+{
+    const StencilProblem<T> &f = fine.op;
+    const StencilProblem<T> &c = coarse.op;
+    const T weights[3] = {0.25, 0.5, 0.25};
+    stencil_for_each(c, [&](size_t I, size_t J, size_t K, size_t p)
+                     {
+                         const size_t idx[3] = {I, J, K};
+                         int lo[3], hi[3];
+                         for (size_t d = 0; d < 3; d++)
+                         {
+                             lo[d] = d < f.dims ? -1 : 0;
+                             hi[d] = d < f.dims ? 1 : 0;
+                         }
+                         T sum = 0;
+                         for (int dk = lo[2]; dk <= hi[2]; dk++)
+                         {
+                             const size_t k = f.dims > 2 ? 2 * idx[2] + 1 + dk : idx[2];
+                             const T wk = f.dims > 2 ? weights[dk + 1] : 1.0;
+                             for (int dj = lo[1]; dj <= hi[1]; dj++)
+                             {
+                                 const size_t j = f.dims > 1 ? 2 * idx[1] + 1 + dj : idx[1];
+                                 const T wj = f.dims > 1 ? weights[dj + 1] : 1.0;
+                                 const size_t row = f.n[0] * (j + f.n[1] * k);
+                                 const size_t i = 2 * idx[0] + 1;
+                                 sum += wk * wj * (0.25 * fine.r[row + i - 1] + 0.5 * fine.r[row + i] + 0.25 * fine.r[row + i + 1]);
+                             }
+                         }
+                         coarse.b[p] = sum; });
+}
+
+/// @brief Adds the (bi/tri)linear interpolation of coarse.x to fine.x
+template <typename T>
+void gmg_prolongate_add(const GMGLevel<T> &coarse, GMGLevel<T> &fine)
+{
+    const StencilProblem<T> &f = fine.op;
+    const StencilProblem<T> &c = coarse.op;
+    stencil_for_each(f, [&](size_t i, size_t j, size_t k, size_t p)
+                     {
+                         const size_t idx[3] = {i, j, k};
+                         // up to two coarse neighbours per dimension; fine point i sits at
+                         // coarse coordinate (i + 1) / 2 - 1
+                         size_t cidx[3][2];
+                         T w[3][2];
+                         int count[3];
+                         for (size_t d = 0; d < 3; d++)
+                         {
+                             if (d >= f.dims)
+                             {
+                                 cidx[d][0] = idx[d];
+                                 w[d][0] = 1.0;
+                                 count[d] = 1;
+                             }
+                             else if (idx[d] % 2 == 1)
+                             {
+                                 cidx[d][0] = idx[d] / 2;
+                                 w[d][0] = 1.0;
+                                 count[d] = 1;
+                             }
+                             else
+                             {
+                                 // between coarse points idx/2 - 1 and idx/2, either may be the boundary
+                                 count[d] = 0;
+                                 if (idx[d] > 0)
+                                 {
+                                     cidx[d][count[d]] = idx[d] / 2 - 1;
+                                     w[d][count[d]++] = 0.5;
+                                 }
+                                 if (idx[d] / 2 < c.n[d])
+                                 {
+                                     cidx[d][count[d]] = idx[d] / 2;
+                                     w[d][count[d]++] = 0.5;
+                                 }
+                             }
+                         }
+                         T sum = 0;
+                         for (int a = 0; a < count[2]; a++)
+                         {
+                             for (int b = 0; b < count[1]; b++)
+                             {
+                                 const size_t row = c.n[0] * (cidx[1][b] + c.n[1] * cidx[2][a]);
+                                 for (int e = 0; e < count[0]; e++)
+                                 {
+                                     sum += w[2][a] * w[1][b] * w[0][e] * coarse.x[row + cidx[0][e]];
+                                 }
+                             }
+                         }
+                         fine.x[p] += sum; });
+}
+
+/**
+ * @brief One multigrid cycle on level l, improving H.levels[l].x for the right hand
+ * side H.levels[l].b. A V-cycle visits the next level once, a W-cycle twice and an
+ * F-cycle recurses with an F-cycle followed by a V-cycle.
+ */
+template <typename T>
+void gmg_cycle(GMGHierarchy<T> &H, size_t l, GMGCycle cycle)
+{
+    GMGLevel<T> &level = H.levels[l];
+    if (l + 1 == H.levels.size())
+    {
+        level.x.assign(level.b.begin(), level.b.end());
+        dense_lu_solve(H.coarseLU, H.coarsePivot, level.x);
+        return;
+    }
+    gmg_smooth(level, H.options, H.options.preSweeps, false);
+    gmg_residual(level);
+    GMGLevel<T> &coarse = H.levels[l + 1];
+    gmg_restrict(level, coarse);
+    std::fill(coarse.x.begin(), coarse.x.end(), 0.0);
+    switch (cycle)
+    {
+    case GMGCycle::V:
+        gmg_cycle(H, l + 1, GMGCycle::V);
+        break;
+    case GMGCycle::W:
+        gmg_cycle(H, l + 1, GMGCycle::W);
+        gmg_cycle(H, l + 1, GMGCycle::W);
+        break;
+    case GMGCycle::F:
+        gmg_cycle(H, l + 1, GMGCycle::F);
+        gmg_cycle(H, l + 1, GMGCycle::V);
+        break;
+    }
+    gmg_prolongate_add(coarse, level);
+    gmg_smooth(level, H.options, H.options.postSweeps, H.options.symmetric);
+}
+
+/**
+ * @brief Solves the fine grid problem with repeated multigrid cycles. Each cycle costs
+ * O(n), and the number of cycles does not grow with the grid size.
+ *
+ * @tparam T
+ * @param H hierarchy from gmg_setup
+ * @param b right hand side on the fine grid
+ * @param tol tolerance on the 2-norm of the residual
+ * @param maxit maximum number of cycles
+ * @param info optional convergence report
+ * @return vector<T>
+ */
+template <typename T>
+vector<T> gmg_solve(GMGHierarchy<T> &H, const vector<T> &b, double tol, int maxit, SolverInfo *info = nullptr)
+{
+    GMGLevel<T> &fine = H.levels[0];
+    if (b.size() != fine.op.size())
+    {
+        throw std::invalid_argument("Right hand side does not match the grid size.");
+    }
+    std::fill(fine.x.begin(), fine.x.end(), 0.0);
+    fine.b.assign(b.begin(), b.end());
+    auto residualNorm = [&]()
+    {
+        gmg_residual(fine);
+        return std::sqrt(tbb::parallel_reduce(
+            tbb::blocked_range<size_t>(0, fine.r.size()), T(0),
+            [&](const tbb::blocked_range<size_t> &r, T sum)
+            {
+                for (size_t i = r.begin(); i < r.end(); i++)
+                    sum += fine.r[i] * fine.r[i];
+                return sum;
+            },
+            std::plus<T>()));
+    };
+    T normR = residualNorm();
+    if (info)
+    {
+        info->residuals.assign(1, normR);
+    }
+    int it = 0;
+    while (it < maxit && normR >= tol)
+    {
+        gmg_cycle(H, 0, H.options.cycle);
+        normR = residualNorm();
+        it++;
+        if (info)
+        {
+            info->residuals.push_back(normR);
+        }
+    }
+    if (info)
+    {
+        info->iterations = it;
+        info->converged = normR < tol;
+    }
+    return fine.x;
+}
+
+/**
+ * @brief One cycle with a zero initial guess as a preconditioner z = M^-1 r. With
+ * options.symmetric, a V or W cycle and equal pre and post sweeps this is symmetric
+ * for symmetric stencils and can be used with preconditioned_conjugate_gradient_CSR on
+ * stencil_to_CSR(problem). The hierarchy must outlive the preconditioner.
+ */
+template <typename T>
+PreconditionerCSR<T> make_gmg_preconditioner(GMGHierarchy<T> &H)
+{
+    return [&H](const vector<T> &r, vector<T> &z)
+    {
+        GMGLevel<T> &fine = H.levels[0];
+        fine.b.assign(r.begin(), r.end());
+        std::fill(fine.x.begin(), fine.x.end(), 0.0);
+        gmg_cycle(H, 0, H.options.cycle);
+        z.assign(fine.x.begin(), fine.x.end());
+    };
+}
+
+} // namespace parallel
+
+#endif
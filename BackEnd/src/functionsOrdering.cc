@@ -0,0 +1,520 @@
+// functionsOrdering.cc
+// Fill- and bandwidth-reducing orderings for CSR matrices: reverse Cuthill-McKee and
+// nested dissection on the adjacency graph of A + A^T, symmetric permutation of
+// matrices and vectors, and a wrapper that solves a reordered system.
+//
+// An ordering is a permutation perm with perm[new] = old: row and column i of the
+// reordered matrix are row and column perm[i] of the original.
+
+#ifndef FUNCTIONS_ORDERING_CC
+#define FUNCTIONS_ORDERING_CC
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+#include "functionsCSR.cc"
+
+using namespace std;
+
+/// @brief Undirected graph in compressed form: the neighbours of v are
+/// adj[ptr[v]] ... adj[ptr[v + 1] - 1], sorted, without v itself
+class AdjacencyGraph
+{
+public:
+    size_t numVertices = 0;
+    vector<size_t> ptr;
+    vector<size_t> adj;
+
+    size_t degree(size_t v) const { return ptr[v + 1] - ptr[v]; }
+};
+
+/// @brief The orderings understood by compute_ordering_CSR
+enum class Ordering
+{
+    Natural,
+    ReverseCuthillMcKee,
+    NestedDissection
+};
+
+/// @brief Bandwidth and profile of a matrix before and after reordering
+class OrderingReport
+{
+public:
+    size_t bandwidthBefore = 0;
+    size_t bandwidthAfter = 0;
+    size_t profileBefore = 0;
+    size_t profileAfter = 0;
+};
+
+/**
+ * @brief The adjacency graph of the pattern of A + A^T, without self loops. Used for
+ * the orderings, so unsymmetric patterns are symmetrized first.
+ *
+ * @tparam T
+ * @param A square matrix
+ * @return AdjacencyGraph
+ */
+template <typename T>
+AdjacencyGraph adjacency_graph_CSR(const CSRMatrix<T> &A)
+{
+    if (A.numRows != A.numColumns)
+    {
+        throw std::invalid_argument("Orderings need a square matrix.");
+    }
+    const size_t n = A.numRows;
+    AdjacencyGraph G;
+    G.numVertices = n;
+    G.ptr.assign(n + 1, 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t k = A.row_ptr[i]; k < A.row_ptr[i + 1]; k++)
+        {
+            if (A.col_ind[k] != i)
+            {
+                G.ptr[i + 1]++;
+                G.ptr[A.col_ind[k] + 1]++;
+            }
+        }
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        G.ptr[i + 1] += G.ptr[i];
+    }
+    vector<size_t> next(G.ptr.begin(), G.ptr.end() - 1);
+    G.adj.resize(G.ptr[n]);
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t k = A.row_ptr[i]; k < A.row_ptr[i + 1]; k++)
+        {
+            const size_t j = A.col_ind[k];
+            if (j != i)
+            {
+                G.adj[next[i]++] = j;
+                G.adj[next[j]++] = i;
+            }
+        }
+    }
+    // sort and drop the duplicates of entries stored in both triangles
+    size_t out = 0;
+    size_t begin = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        const size_t end = G.ptr[i + 1];
+        std::sort(G.adj.begin() + begin, G.adj.begin() + end);
+        const size_t rowStart = out;
+        for (size_t k = begin; k < end; k++)
+        {
+            if (out == rowStart || G.adj[out - 1] != G.adj[k])
+            {
+                G.adj[out++] = G.adj[k];
+            }
+        }
+        begin = end;
+        G.ptr[i + 1] = out;
+    }
+    G.adj.resize(out);
+    return G;
+}
+
+/**
+ * @brief Breadth-first level structure rooted at root, restricted to the vertices v
+ * with mark[v] == id.
+ *
+ * @param G
+ * @param root
+ * @param mark subgraph labels
+ * @param id label of the subgraph to search
+ * @param visited scratch, sized G.numVertices; entries equal to stamp count as visited
+ * @param stamp a value not used in visited before
+ * @param order output, the reached vertices level by level
+ * @param levelStart output, level l is order[levelStart[l]] ... order[levelStart[l + 1] - 1]
+ */
+inline void level_structure(const AdjacencyGraph &G, size_t root, const vector<size_t> &mark, size_t id,
+                            vector<size_t> &visited, size_t stamp, vector<size_t> &order, vector<size_t> &levelStart)
+{
+    order.clear();
+    levelStart.assign(1, 0);
+    order.push_back(root);
+    visited[root] = stamp;
+    size_t head = 0;
+    while (head < order.size())
+    {
+        const size_t levelEnd = order.size();
+        for (; head < levelEnd; head++)
+        {
+            const size_t v = order[head];
+            for (size_t k = G.ptr[v]; k < G.ptr[v + 1]; k++)
+            {
+                const size_t w = G.adj[k];
+                if (mark[w] == id && visited[w] != stamp)
+                {
+                    visited[w] = stamp;
+                    order.push_back(w);
+                }
+            }
+        }
+        levelStart.push_back(levelEnd);
+    }
+}
+
+/**
+ * @brief A pseudo-peripheral vertex (George and Liu) of the connected component of
+ * start inside the subgraph mark == id: repeatedly move to a minimum degree vertex of
+ * the last BFS level while that increases the eccentricity. The returned root gives a
+ * long, narrow level structure, which is what RCM and the separators want.
+ */
+inline size_t pseudo_peripheral_vertex(const AdjacencyGraph &G, size_t start, const vector<size_t> &mark, size_t id,
+                                       vector<size_t> &visited, size_t &stamp, vector<size_t> &order,
+                                       vector<size_t> &levelStart)
+{
+    size_t root = start;
+    level_structure(G, root, mark, id, visited, ++stamp, order, levelStart);
+    size_t eccentricity = levelStart.size();
+    while (true)
+    {
+        size_t candidate = order[levelStart[levelStart.size() - 2]];
+        for (size_t k = levelStart[levelStart.size() - 2]; k < order.size(); k++)
+        {
+            if (G.degree(order[k]) < G.degree(candidate))
+            {
+                candidate = order[k];
+            }
+        }
+        level_structure(G, candidate, mark, id, visited, ++stamp, order, levelStart);
+        if (levelStart.size() <= eccentricity)
+        {
+            level_structure(G, root, mark, id, visited, ++stamp, order, levelStart);
+            return root;
+        }
+        root = candidate;
+        eccentricity = levelStart.size();
+    }
+}
+
+/**
+ * @brief Reverse Cuthill-McKee ordering. Every connected component is numbered by a
+ * BFS from a pseudo-peripheral vertex, visiting the neighbours of each vertex in order
+ * of increasing degree; reversing the result reduces the profile further. Clusters
+ * the nonzeros near the diagonal, which helps SpMV cache reuse and ILU / banded
+ * factorizations.
+ *
+ * @tparam T
+ * @param A square matrix, the pattern of A + A^T is used
+ * @return vector<size_t> perm with perm[new] = old
+ */
+template <typename T>
+vector<size_t> reverse_cuthill_mckee_CSR(const CSRMatrix<T> &A)
+{
+    const AdjacencyGraph G = adjacency_graph_CSR(A);
+    const size_t n = G.numVertices;
+    vector<size_t> mark(n, 0), visited(n, 0), order, levelStart, perm;
+    perm.reserve(n);
+    vector<bool> numbered(n, false);
+    // components are started from their lowest degree vertex
+    vector<size_t> byDegree(n);
+    std::iota(byDegree.begin(), byDegree.end(), 0);
+    std::stable_sort(byDegree.begin(), byDegree.end(), [&](size_t a, size_t b)
+                     { return G.degree(a) < G.degree(b); });
+    size_t stamp = 0;
+    vector<size_t> neighbours;
+    for (size_t start : byDegree)
+    {
+        if (numbered[start])
+        {
+            continue;
+        }
+        const size_t root = pseudo_peripheral_vertex(G, start, mark, 0, visited, stamp, order, levelStart);
+        size_t head = perm.size();
+        perm.push_back(root);
+        numbered[root] = true;
+        for (; head < perm.size(); head++)
+        {
+            const size_t v = perm[head];
+            neighbours.clear();
+            for (size_t k = G.ptr[v]; k < G.ptr[v + 1]; k++)
+            {
+                if (!numbered[G.adj[k]])
+                {
+                    neighbours.push_back(G.adj[k]);
+                    numbered[G.adj[k]] = true;
+                }
+            }
+            std::stable_sort(neighbours.begin(), neighbours.end(), [&](size_t a, size_t b)
+                             { return G.degree(a) < G.degree(b); });
+            perm.insert(perm.end(), neighbours.begin(), neighbours.end());
+        }
+    }
+    std::reverse(perm.begin(), perm.end());
+    return perm;
+}
+
+/**
+ * @brief Nested dissection ordering. The graph is split recursively by level-set
+ * separators: a BFS from a pseudo-peripheral vertex, with its middle level as the
+ * separator. Each part is ordered before the separator that splits it, so a direct
+ * factorization fills in only inside the parts and the separator blocks. Parts with
+ * at most leafSize vertices, and parts too shallow to split, keep their order.
+ *
+ * @tparam T
+ * @param A square matrix, the pattern of A + A^T is used
+ * @param leafSize
+ * @return vector<size_t> perm with perm[new] = old
+ */
+template <typename T>
+vector<size_t> nested_dissection_CSR(const CSRMatrix<T> &A, size_t leafSize = 64)
+{
+    const AdjacencyGraph G = adjacency_graph_CSR(A);
+    const size_t n = G.numVertices;
+    vector<size_t> mark(n, 0), visited(n, 0), order, levelStart, perm;
+    perm.reserve(n);
+    size_t stamp = 0, nextId = 0;
+    leafSize = std::max<size_t>(leafSize, 1);
+
+    // explicit stack of parts still to be ordered; a part is pushed with its
+    // separator below it, so the separator is numbered after both halves
+    struct Task
+    {
+        vector<size_t> vertices;
+        bool separator;
+    };
+    vector<Task> stack;
+    vector<size_t> all(n);
+    std::iota(all.begin(), all.end(), 0);
+    stack.push_back({std::move(all), false});
+    while (!stack.empty())
+    {
+        Task task = std::move(stack.back());
+        stack.pop_back();
+        vector<size_t> &part = task.vertices;
+        if (task.separator || part.size() <= leafSize)
+        {
+            std::sort(part.begin(), part.end());
+            perm.insert(perm.end(), part.begin(), part.end());
+            continue;
+        }
+        const size_t id = ++nextId;
+        for (size_t v : part)
+        {
+            mark[v] = id;
+        }
+        pseudo_peripheral_vertex(G, part[0], mark, id, visited, stamp, order, levelStart);
+        if (order.size() < part.size())
+        {
+            // disconnected: split off the component that was reached
+            vector<size_t> rest;
+            for (size_t v : part)
+            {
+                if (visited[v] != stamp)
+                {
+                    rest.push_back(v);
+                }
+            }
+            stack.push_back({std::move(rest), false});
+            stack.push_back({order, false});
+            continue;
+        }
+        const size_t numLevels = levelStart.size() - 1;
+        if (numLevels < 3)
+        {
+            std::sort(part.begin(), part.end());
+            perm.insert(perm.end(), part.begin(), part.end());
+            continue;
+        }
+        // the separator is the level that contains the median vertex
+        size_t middle = 1;
+        while (middle + 2 < numLevels && levelStart[middle + 1] <= part.size() / 2)
+        {
+            middle++;
+        }
+        stack.push_back({vector<size_t>(order.begin() + levelStart[middle], order.begin() + levelStart[middle + 1]), true});
+        stack.push_back({vector<size_t>(order.begin() + levelStart[middle + 1], order.end()), false});
+        stack.push_back({vector<size_t>(order.begin(), order.begin() + levelStart[middle]), false});
+    }
+    return perm;
+}
+
+/// @brief The ordering of the given kind, the identity for Ordering::Natural
+template <typename T>
+vector<size_t> compute_ordering_CSR(const CSRMatrix<T> &A, Ordering ordering)
+{
+    switch (ordering)
+    {
+    case Ordering::ReverseCuthillMcKee:
+        return reverse_cuthill_mckee_CSR(A);
+    case Ordering::NestedDissection:
+        return nested_dissection_CSR(A);
+    default:
+        vector<size_t> perm(A.numRows);
+        std::iota(perm.begin(), perm.end(), 0);
+        return perm;
+    }
+}
+
+/// @brief The inverse permutation, inverse[perm[i]] = i; throws if perm is not a
+/// permutation
+inline vector<size_t> inverse_permutation(const vector<size_t> &perm)
+{
+    const size_t n = perm.size();
+    vector<size_t> inverse(n, n);
+    for (size_t i = 0; i < n; i++)
+    {
+        if (perm[i] >= n || inverse[perm[i]] != n)
+        {
+            throw std::invalid_argument("Not a permutation.");
+        }
+        inverse[perm[i]] = i;
+    }
+    return inverse;
+}
+
+/**
+ * @brief Symmetric permutation B = P A P^T, B(i, j) = A(perm[i], perm[j]), in O(nnz)
+ * plus the sort of every row.
+ *
+ * @tparam T
+ * @param A square matrix
+ * @param perm perm[new] = old
+ * @return CSRMatrix<T> with sorted rows
+ */
+template <typename T>
+CSRMatrix<T> permute_symmetric_CSR(const CSRMatrix<T> &A, const vector<size_t> &perm)
+{
+    if (A.numRows != A.numColumns || perm.size() != A.numRows)
+    {
+        throw std::invalid_argument("The permutation must match the size of the square matrix.");
+    }
+    const size_t n = A.numRows;
+    const vector<size_t> inverse = inverse_permutation(perm);
+    CSRMatrix<T> B;
+    B.numRows = n;
+    B.numColumns = n;
+    B.row_ptr.assign(n + 1, 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        B.row_ptr[i + 1] = B.row_ptr[i] + A.row_ptr[perm[i] + 1] - A.row_ptr[perm[i]];
+    }
+    B.col_ind.resize(B.row_ptr[n]);
+    B.val.resize(B.row_ptr[n]);
+    vector<std::pair<size_t, T>> row;
+    for (size_t i = 0; i < n; i++)
+    {
+        row.clear();
+        for (size_t k = A.row_ptr[perm[i]]; k < A.row_ptr[perm[i] + 1]; k++)
+        {
+            row.emplace_back(inverse[A.col_ind[k]], A.val[k]);
+        }
+        std::sort(row.begin(), row.end(), [](const std::pair<size_t, T> &a, const std::pair<size_t, T> &b)
+                  { return a.first < b.first; });
+        for (size_t k = 0; k < row.size(); k++)
+        {
+            B.col_ind[B.row_ptr[i] + k] = row[k].first;
+            B.val[B.row_ptr[i] + k] = row[k].second;
+        }
+    }
+    return B;
+}
+
+/// @brief y = P x, y[i] = x[perm[i]]
+template <typename T>
+vector<T> permute_vector(const vector<T> &x, const vector<size_t> &perm)
+{
+    vector<T> y(perm.size());
+    for (size_t i = 0; i < perm.size(); i++)
+    {
+        y[i] = x[perm[i]];
+    }
+    return y;
+}
+
+/// @brief x = P^T y, the inverse of permute_vector: x[perm[i]] = y[i]
+template <typename T>
+vector<T> unpermute_vector(const vector<T> &y, const vector<size_t> &perm)
+{
+    vector<T> x(perm.size());
+    for (size_t i = 0; i < perm.size(); i++)
+    {
+        x[perm[i]] = y[i];
+    }
+    return x;
+}
+
+/// @brief The bandwidth max |i - j| over the stored entries
+template <typename T>
+size_t bandwidth_CSR(const CSRMatrix<T> &A)
+{
+    size_t band = 0;
+    for (size_t i = 0; i < A.numRows; i++)
+    {
+        for (size_t k = A.row_ptr[i]; k < A.row_ptr[i + 1]; k++)
+        {
+            const size_t j = A.col_ind[k];
+            band = std::max(band, i > j ? i - j : j - i);
+        }
+    }
+    return band;
+}
+
+/// @brief The profile (envelope size) of the lower triangle: the sum over the rows of
+/// the distance from the first stored entry to the diagonal
+template <typename T>
+size_t profile_CSR(const CSRMatrix<T> &A)
+{
+    size_t profile = 0;
+    for (size_t i = 0; i < A.numRows; i++)
+    {
+        size_t first = i;
+        for (size_t k = A.row_ptr[i]; k < A.row_ptr[i + 1]; k++)
+        {
+            first = std::min(first, A.col_ind[k]);
+        }
+        profile += i - first;
+    }
+    return profile;
+}
+
+/**
+ * @brief Reorders Ax = b, solves the reordered system and returns the solution in the
+ * original numbering: solve(P A P^T, P b, P x0) is called and its result un-permuted.
+ * The solver sees only the reordered matrix, so preconditioners such as SSOR or AMG
+ * should be built inside it. Bandwidth and profile before and after are reported on
+ * stderr and, if requested, returned in report.
+ *
+ * @tparam T
+ * @param A square matrix
+ * @param b
+ * @param x0 initial guess
+ * @param perm perm[new] = old, e.g. from reverse_cuthill_mckee_CSR
+ * @param solve the iterative solver, e.g. a lambda around gmres_CSR
+ * @param report optional bandwidth and profile report
+ * @return vector<T> the solution of Ax = b
+ */
+template <typename T>
+vector<T> reordered_solve_CSR(const CSRMatrix<T> &A, const vector<T> &b, const vector<T> &x0,
+                              const vector<size_t> &perm,
+                              const std::function<vector<T>(const CSRMatrix<T> &, const vector<T> &, const vector<T> &)> &solve,
+                              OrderingReport *report = nullptr)
+{
+    if (b.size() != A.numRows || x0.size() != A.numRows)
+    {
+        throw std::invalid_argument("b and x0 must match the size of the matrix.");
+    }
+    const CSRMatrix<T> B = permute_symmetric_CSR(A, perm);
+    OrderingReport r;
+    r.bandwidthBefore = bandwidth_CSR(A);
+    r.bandwidthAfter = bandwidth_CSR(B);
+    r.profileBefore = profile_CSR(A);
+    r.profileAfter = profile_CSR(B);
+    std::cerr << "Bandwidth: " << r.bandwidthBefore << " -> " << r.bandwidthAfter
+              << ", Profile: " << r.profileBefore << " -> " << r.profileAfter << std::endl;
+    if (report)
+    {
+        *report = r;
+    }
+    const vector<T> y = solve(B, permute_vector(b, perm), permute_vector(x0, perm));
+    return unpermute_vector(y, perm);
+}
+
+#endif
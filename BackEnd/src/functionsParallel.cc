@@ -2,6 +2,7 @@
 #include <cstdlib>
 
 #include "tbb/tbb.h"
+#include "functionsStatistics.cc"
 
 using namespace std;
 
@@ -97,7 +98,7 @@ bool gaussian_elimination(std::vector<std::vector<double> > &A) {
  * @return true If is diagonally dominant
  * @return false Otherwise
  */
-bool diagonally_dominant(std::vector<std::vector<double>> denseMatrix) {
+bool diagonally_dominant(const std::vector<std::vector<double>> &denseMatrix) {
     for (size_t i = 0; i < denseMatrix.size(); ++i) {
         double sum = 0.0;
         for (size_t j = 0; j < denseMatrix[i].size(); ++j) {
@@ -113,6 +114,71 @@ bool diagonally_dominant(std::vector<std::vector<double>> denseMatrix) {
     return true;
 }
 
+/**
+ * @brief Parallel version of matrix_statistics: a parallel_reduce over blocks of rows joins
+ * the running totals, each row written by one task, and the column sums and nonzero counts go
+ * into per-thread copies that are added up at the end
+ * 
+ * @param denseMatrix 
+ * @return MatrixStatistics<double> 
+ */
+MatrixStatistics<double> matrix_statistics_parallel(const std::vector<std::vector<double>> &denseMatrix) {
+    const size_t rows = denseMatrix.size(), cols = rows ? denseMatrix[0].size() : 0;
+    for (const auto &row : denseMatrix) {
+        if (row.size() != cols) {
+            throw invalid_argument("The rows of the matrix must have the same length.");
+        }
+    }
+    struct ColumnSums {
+        std::vector<double> colOff;
+        size_t nonzeros = 0;
+    };
+    tbb::enumerable_thread_specific<ColumnSums> locals([&] { return ColumnSums{std::vector<double>(cols, 0.0), 0}; });
+    std::vector<double> rowOff(rows, 0.0), diag(std::min(rows, cols), 0.0);
+    StatisticsAccumulator<double> init;
+    init.symmetric = rows == cols;
+    const StatisticsAccumulator<double> acc = tbb::parallel_reduce(
+        tbb::blocked_range<size_t>(0, rows), init,
+        [&](const tbb::blocked_range<size_t> &range, StatisticsAccumulator<double> part) {
+            ColumnSums &local = locals.local();
+            for (size_t i = range.begin(); i < range.end(); ++i) {
+                const std::vector<double> &row = denseMatrix[i];
+                part.add_values(row.data(), cols);
+                double off = 0.0;
+                for (size_t j = 0; j < cols; ++j) {
+                    const double a = std::abs(row[j]);
+                    local.nonzeros += row[j] != 0.0;
+                    if (i == j) {
+                        diag[i] = a;
+                        continue;
+                    }
+                    off += a;
+                    local.colOff[j] += a;
+                    if (part.symmetric && (row[j] != 0.0) != (denseMatrix[j][i] != 0.0)) {
+                        part.symmetric = false;
+                    }
+                }
+                rowOff[i] = off;
+            }
+            return part;
+        },
+        [](StatisticsAccumulator<double> x, const StatisticsAccumulator<double> &y) {
+            x.join(y);
+            return x;
+        });
+    std::vector<double> colOff(cols, 0.0);
+    size_t nonzeros = 0;
+    for (const ColumnSums &local : locals) {
+        for (size_t j = 0; j < cols; ++j) {
+            colOff[j] += local.colOff[j];
+        }
+        nonzeros += local.nonzeros;
+    }
+    MatrixStatistics<double> stats = finish_statistics(acc, rowOff, colOff, diag);
+    stats.nnz = nonzeros;
+    return stats;
+}
+
 /**
  * @brief Jacobi Method parallel that uses a parallel for to map each thread to a row and reduces the summation and product
  * 
@@ -121,7 +187,7 @@ bool diagonally_dominant(std::vector<std::vector<double>> denseMatrix) {
  * @param maxIterations 
  * @return std::vector<double> 
  */
-std::vector<double> jacobi_method_parallel(vector<vector<double>> A, vector<double> B, const int maxIterations) {
+std::vector<double> jacobi_method_parallel(const vector<vector<double>> &A, const vector<double> &B, const int maxIterations) {
     if (diagonally_dominant(A) == false) {
         throw std::invalid_argument("Input matrix is not diagonally dominant");
     }
@@ -152,7 +218,7 @@ std::vector<double> jacobi_method_parallel(vector<vector<double>> A, vector<doub
 }
 
 vector<vector<double> > sum_matrix_parallel(vector<vector<double> > m1,
-                                   const vector<vector<double> > m2) {
+                                   const vector<vector<double> > &m2) {
   //   NB: in the future it may be important to use the compiler defined sizes
   //   for platform portability
   size_t d1 = static_cast<size_t>(m1.size()),
@@ -0,0 +1,23 @@
+// functionsSIMD.cc
+// Loop annotations shared by the vectorized kernels. The library is built with OpenMP,
+// where the marked loops are vectorized with omp simd; without it the macros expand to
+// nothing and the loops are left to the auto-vectorizer. No includes, so every file can
+// use it.
+
+#ifndef FUNCTIONS_SIMD_CC
+#define FUNCTIONS_SIMD_CC
+
+#define SIMD_PRAGMA(text) _Pragma(#text)
+
+#if defined(_OPENMP)
+/// @brief Marks the next loop as free of dependences between iterations
+#define SIMD_LOOP SIMD_PRAGMA(omp simd)
+/// @brief SIMD_LOOP for a loop that reduces into scalars, e.g.
+/// SIMD_LOOP_REDUCTION(reduction(+ : sum))
+#define SIMD_LOOP_REDUCTION(clauses) SIMD_PRAGMA(omp simd clauses)
+#else
+#define SIMD_LOOP
+#define SIMD_LOOP_REDUCTION(clauses)
+#endif
+
+#endif
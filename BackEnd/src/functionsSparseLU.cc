@@ -0,0 +1,498 @@
+// functionsSparseLU.cc
+// Sparse direct LU for CSC matrices: left-looking Gilbert-Peierls factorization with
+// threshold partial pivoting, P A Q = L U. The analysis (the column ordering) is done
+// once by sparse_lu_analyze_CSC; sparse_lu_factor_CSC then finds the pivots and the
+// patterns of L and U, and sparse_lu_refactor_CSC reuses both for a new matrix with
+// the same pattern, which costs only the floating point work.
+
+#ifndef FUNCTIONS_SPARSE_LU_CC
+#define FUNCTIONS_SPARSE_LU_CC
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <queue>
+#include <stdexcept>
+#include <vector>
+#include "functionsCSC.cc"
+
+using namespace std;
+
+/// @brief Fill-reducing column orderings for the sparse LU
+enum class ColumnOrdering
+{
+    Natural,
+    /// minimum degree on the pattern of A^T A, as COLAMD approximates
+    MinimumDegree
+};
+
+/// @brief Result of the symbolic analysis: the column permutation, column k of A Q is
+/// column colPerm[k] of A
+class SparseLUSymbolic
+{
+public:
+    size_t n = 0;
+    vector<size_t> colPerm;
+};
+
+/**
+ * @brief The factors P A Q = L U. L is unit lower triangular with the unit diagonal
+ * stored first in every column, U is upper triangular with the diagonal stored last;
+ * both use pivot numbering for their rows. The entries of column k of U are kept in
+ * the topological order found by the depth first search, which is the order a
+ * refactorization has to apply them in.
+ */
+template <typename T>
+class SparseLUNumeric
+{
+public:
+    size_t n = 0;
+    /// rowPerm[k] is the row of A chosen as pivot k, rowInverse its inverse
+    vector<size_t> rowPerm;
+    vector<size_t> rowInverse;
+    vector<size_t> colPerm;
+    CSCMatrix<T> L;
+    CSCMatrix<T> U;
+};
+
+/**
+ * @brief Column minimum degree ordering (COLAMD-style): greedy minimum degree on the
+ * graph of A^T A without forming the product. Every row of A is a clique of columns;
+ * rows with more than 10 sqrt(n) entries are left out, as COLAMD does, since they
+ * would make the graph dense without changing the ordering much. Eliminating a column
+ * joins its neighbours into a clique.
+ *
+ * @tparam T
+ * @param A
+ * @return vector<size_t> the column permutation
+ */
+template <typename T>
+vector<size_t> column_minimum_degree_CSC(const CSCMatrix<T> &A)
+{
+    const size_t n = A.numColumns, m = A.numRows;
+    const size_t dense = std::max<size_t>(16, (size_t)(10.0 * std::sqrt((double)n)));
+    vector<vector<size_t>> rows(m);
+    for (size_t j = 0; j < n; j++)
+    {
+        for (size_t p = A.col_ptr[j]; p < A.col_ptr[j + 1]; p++)
+        {
+            rows[A.row_ind[p]].push_back(j);
+        }
+    }
+    vector<vector<size_t>> adj(n);
+    for (const vector<size_t> &row : rows)
+    {
+        if (row.size() > dense)
+        {
+            continue;
+        }
+        for (size_t a : row)
+        {
+            for (size_t b : row)
+            {
+                if (a != b)
+                {
+                    adj[a].push_back(b);
+                }
+            }
+        }
+    }
+    for (vector<size_t> &list : adj)
+    {
+        std::sort(list.begin(), list.end());
+        list.erase(std::unique(list.begin(), list.end()), list.end());
+    }
+
+    typedef std::pair<size_t, size_t> Entry;
+    std::priority_queue<Entry, vector<Entry>, std::greater<Entry>> queue;
+    for (size_t j = 0; j < n; j++)
+    {
+        queue.push({adj[j].size(), j});
+    }
+    vector<bool> eliminated(n, false);
+    vector<size_t> perm, merged;
+    perm.reserve(n);
+    while (!queue.empty())
+    {
+        const Entry top = queue.top();
+        queue.pop();
+        const size_t v = top.second;
+        // skip stale queue entries
+        if (eliminated[v] || top.first != adj[v].size())
+        {
+            continue;
+        }
+        eliminated[v] = true;
+        perm.push_back(v);
+        const vector<size_t> clique = std::move(adj[v]);
+        for (size_t u : clique)
+        {
+            merged.clear();
+            std::set_union(adj[u].begin(), adj[u].end(), clique.begin(), clique.end(), std::back_inserter(merged));
+            adj[u].clear();
+            for (size_t w : merged)
+            {
+                if (w != u && w != v)
+                {
+                    adj[u].push_back(w);
+                }
+            }
+            queue.push({adj[u].size(), u});
+        }
+    }
+    return perm;
+}
+
+/**
+ * @brief Symbolic analysis for sparse_lu_factor_CSC: computes the column ordering.
+ *
+ * @tparam T
+ * @param A square matrix
+ * @param ordering
+ * @return SparseLUSymbolic
+ */
+template <typename T>
+SparseLUSymbolic sparse_lu_analyze_CSC(const CSCMatrix<T> &A, ColumnOrdering ordering = ColumnOrdering::MinimumDegree)
+{
+    if (A.numRows != A.numColumns)
+    {
+        throw std::invalid_argument("The sparse LU needs a square matrix.");
+    }
+    SparseLUSymbolic S;
+    S.n = A.numColumns;
+    if (ordering == ColumnOrdering::MinimumDegree)
+    {
+        S.colPerm = column_minimum_degree_CSC(A);
+    }
+    else
+    {
+        S.colPerm.resize(S.n);
+        std::iota(S.colPerm.begin(), S.colPerm.end(), 0);
+    }
+    return S;
+}
+
+/**
+ * @brief The nonzero pattern of x = L \ b for a sparse column b (Gilbert and Peierls):
+ * the nodes reachable from the pattern of b in the graph of the factored columns of
+ * L, returned in topological order in xi[top] ... xi[n - 1]. The depth first search
+ * keeps its own stack, so long dependency chains do not overflow the call stack.
+ *
+ * @param L the columns of L computed so far, rows in original numbering
+ * @param pinv pinv[i] is the pivot position of row i, or n if not yet pivotal
+ * @param bRows the bCount row indices of b
+ * @param xi output, size n
+ * @param stack scratch, size n
+ * @param progress scratch, size n: the next entry of L to visit for each stack frame
+ * @param mark scratch, a node is visited when mark[i] == stamp
+ * @return size_t top
+ */
+template <typename T>
+size_t sparse_lu_reach(const CSCMatrix<T> &L, const vector<size_t> &pinv, const size_t *bRows, size_t bCount,
+                       vector<size_t> &xi, vector<size_t> &stack, vector<size_t> &progress, vector<size_t> &mark,
+                       size_t stamp)
+{
+    const size_t n = pinv.size();
+    size_t top = n;
+    for (size_t b = 0; b < bCount; b++)
+    {
+        if (mark[bRows[b]] == stamp)
+        {
+            continue;
+        }
+        size_t head = 0;
+        stack[0] = bRows[b];
+        mark[bRows[b]] = stamp;
+        progress[0] = pinv[bRows[b]] < n ? L.col_ptr[pinv[bRows[b]]] + 1 : 0;
+        while (true)
+        {
+            const size_t j = stack[head];
+            const size_t column = pinv[j];
+            bool descended = false;
+            if (column < n)
+            {
+                // the first entry of a column of L is its pivot row, j itself
+                for (; progress[head] < L.col_ptr[column + 1]; progress[head]++)
+                {
+                    const size_t i = L.row_ind[progress[head]];
+                    if (mark[i] != stamp)
+                    {
+                        mark[i] = stamp;
+                        progress[head]++;
+                        stack[++head] = i;
+                        progress[head] = pinv[i] < n ? L.col_ptr[pinv[i]] + 1 : 0;
+                        descended = true;
+                        break;
+                    }
+                }
+            }
+            if (descended)
+            {
+                continue;
+            }
+            // all successors of j are done
+            xi[--top] = j;
+            if (head == 0)
+            {
+                break;
+            }
+            head--;
+        }
+    }
+    return top;
+}
+
+/**
+ * @brief Left-looking sparse LU (Gilbert-Peierls) with threshold partial pivoting,
+ * P A Q = L U. Column k of L and U is the solution of a sparse triangular system with
+ * the columns of L computed so far; its pattern is found by a depth first search, so
+ * the work is proportional to the floating point operations. The diagonal entry is
+ * kept as pivot when |a_kk| >= pivotTolerance * max |a_ik|, which preserves the
+ * fill-reducing ordering; pivotTolerance = 1 is plain partial pivoting.
+ *
+ * @tparam T
+ * @param A square matrix
+ * @param S analysis from sparse_lu_analyze_CSC
+ * @param pivotTolerance in (0, 1]
+ * @return SparseLUNumeric<T>
+ */
+template <typename T>
+SparseLUNumeric<T> sparse_lu_factor_CSC(const CSCMatrix<T> &A, const SparseLUSymbolic &S, double pivotTolerance = 0.1)
+{
+    const size_t n = A.numColumns;
+    if (A.numRows != n || S.n != n)
+    {
+        throw std::invalid_argument("The matrix does not match the sparse LU analysis.");
+    }
+    if (!(pivotTolerance > 0 && pivotTolerance <= 1))
+    {
+        throw std::invalid_argument("The pivot tolerance must be in (0, 1].");
+    }
+    SparseLUNumeric<T> F;
+    F.n = n;
+    F.colPerm = S.colPerm;
+    CSCMatrix<T> &L = F.L;
+    CSCMatrix<T> &U = F.U;
+    L.numRows = L.numColumns = U.numRows = U.numColumns = n;
+    L.col_ptr.assign(1, 0);
+    U.col_ptr.assign(1, 0);
+    const size_t guess = 4 * A.val.size() + n;
+    L.row_ind.reserve(guess);
+    L.val.reserve(guess);
+    U.row_ind.reserve(guess);
+    U.val.reserve(guess);
+
+    vector<size_t> pinv(n, n), xi(n), stack(n), progress(n), mark(n, 0);
+    vector<T> x(n, 0.0);
+    for (size_t k = 0; k < n; k++)
+    {
+        const size_t col = S.colPerm[k];
+        // x = L \ A(:, col) on the reach of A(:, col)
+        const size_t top = sparse_lu_reach(L, pinv, A.row_ind.data() + A.col_ptr[col], A.col_ptr[col + 1] - A.col_ptr[col],
+                                           xi, stack, progress, mark, k + 1);
+        for (size_t p = A.col_ptr[col]; p < A.col_ptr[col + 1]; p++)
+        {
+            x[A.row_ind[p]] = A.val[p];
+        }
+        for (size_t p = top; p < n; p++)
+        {
+            const size_t j = xi[p];
+            const size_t J = pinv[j];
+            if (J == n)
+            {
+                continue;
+            }
+            const T xj = x[j];
+            for (size_t q = L.col_ptr[J] + 1; q < L.col_ptr[J + 1]; q++)
+            {
+                x[L.row_ind[q]] -= L.val[q] * xj;
+            }
+        }
+
+        // the pivotal rows give column k of U, the largest remaining entry is the pivot
+        size_t ipiv = n;
+        T largest = -1;
+        for (size_t p = top; p < n; p++)
+        {
+            const size_t i = xi[p];
+            if (pinv[i] == n)
+            {
+                if (std::abs(x[i]) > largest)
+                {
+                    largest = std::abs(x[i]);
+                    ipiv = i;
+                }
+            }
+            else
+            {
+                U.row_ind.push_back(pinv[i]);
+                U.val.push_back(x[i]);
+            }
+        }
+        if (ipiv == n || largest <= 0)
+        {
+            throw std::runtime_error("The matrix is structurally or numerically singular.");
+        }
+        if (pinv[col] == n && std::abs(x[col]) >= pivotTolerance * largest)
+        {
+            ipiv = col;
+        }
+        const T pivot = x[ipiv];
+        U.row_ind.push_back(k);
+        U.val.push_back(pivot);
+        U.col_ptr.push_back(U.val.size());
+        pinv[ipiv] = k;
+        L.row_ind.push_back(ipiv);
+        L.val.push_back(1.0);
+        for (size_t p = top; p < n; p++)
+        {
+            const size_t i = xi[p];
+            if (pinv[i] == n)
+            {
+                L.row_ind.push_back(i);
+                L.val.push_back(x[i] / pivot);
+            }
+            x[i] = 0;
+        }
+        L.col_ptr.push_back(L.val.size());
+    }
+    // rows of L to pivot numbering
+    for (size_t &i : L.row_ind)
+    {
+        i = pinv[i];
+    }
+    F.rowInverse = pinv;
+    F.rowPerm.resize(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        F.rowPerm[pinv[i]] = i;
+    }
+    return F;
+}
+
+/**
+ * @brief Numeric refactorization of a matrix with the same pattern as the one given to
+ * sparse_lu_factor_CSC, reusing its pivot order and the patterns of L and U: no
+ * search, no pivoting, only the arithmetic. Throws if a pivot becomes zero, in which
+ * case a full sparse_lu_factor_CSC is needed.
+ *
+ * @tparam T
+ * @param A matrix with the pattern of the factored one
+ * @param F factors, overwritten
+ */
+template <typename T>
+void sparse_lu_refactor_CSC(const CSCMatrix<T> &A, SparseLUNumeric<T> &F)
+{
+    const size_t n = F.n;
+    if (A.numRows != n || A.numColumns != n)
+    {
+        throw std::invalid_argument("The matrix does not match the sparse LU factors.");
+    }
+    CSCMatrix<T> &L = F.L;
+    CSCMatrix<T> &U = F.U;
+    vector<T> x(n, 0.0);
+    vector<size_t> mark(n, 0);
+    for (size_t k = 0; k < n; k++)
+    {
+        const size_t col = F.colPerm[k];
+        for (size_t p = U.col_ptr[k]; p < U.col_ptr[k + 1]; p++)
+        {
+            mark[U.row_ind[p]] = k + 1;
+        }
+        for (size_t p = L.col_ptr[k]; p < L.col_ptr[k + 1]; p++)
+        {
+            mark[L.row_ind[p]] = k + 1;
+        }
+        for (size_t p = A.col_ptr[col]; p < A.col_ptr[col + 1]; p++)
+        {
+            const size_t i = F.rowInverse[A.row_ind[p]];
+            if (mark[i] != k + 1)
+            {
+                throw std::invalid_argument("The matrix pattern differs from the factored one.");
+            }
+            x[i] = A.val[p];
+        }
+        // U entries in topological order, the diagonal last
+        const size_t diag = U.col_ptr[k + 1] - 1;
+        for (size_t p = U.col_ptr[k]; p < diag; p++)
+        {
+            const size_t j = U.row_ind[p];
+            const T ujk = x[j];
+            U.val[p] = ujk;
+            x[j] = 0;
+            for (size_t q = L.col_ptr[j] + 1; q < L.col_ptr[j + 1]; q++)
+            {
+                x[L.row_ind[q]] -= L.val[q] * ujk;
+            }
+        }
+        const T pivot = x[k];
+        x[k] = 0;
+        if (pivot == 0)
+        {
+            throw std::runtime_error("Zero pivot in the sparse LU refactorization.");
+        }
+        U.val[diag] = pivot;
+        for (size_t p = L.col_ptr[k] + 1; p < L.col_ptr[k + 1]; p++)
+        {
+            L.val[p] = x[L.row_ind[p]] / pivot;
+            x[L.row_ind[p]] = 0;
+        }
+    }
+}
+
+/**
+ * @brief Solves A x = b with the factors P A Q = L U
+ *
+ * @tparam T
+ * @param F
+ * @param b
+ * @return vector<T> x
+ */
+template <typename T>
+vector<T> sparse_lu_solve_CSC(const SparseLUNumeric<T> &F, const vector<T> &b)
+{
+    const size_t n = F.n;
+    if (b.size() != n)
+    {
+        throw std::invalid_argument("The right hand side does not match the sparse LU factors.");
+    }
+    const CSCMatrix<T> &L = F.L;
+    const CSCMatrix<T> &U = F.U;
+    vector<T> y(n);
+    for (size_t k = 0; k < n; k++)
+    {
+        y[k] = b[F.rowPerm[k]];
+    }
+    for (size_t j = 0; j < n; j++)
+    {
+        const T yj = y[j];
+        for (size_t p = L.col_ptr[j] + 1; p < L.col_ptr[j + 1]; p++)
+        {
+            y[L.row_ind[p]] -= L.val[p] * yj;
+        }
+    }
+    for (size_t j = n; j-- > 0;)
+    {
+        y[j] /= U.val[U.col_ptr[j + 1] - 1];
+        const T yj = y[j];
+        for (size_t p = U.col_ptr[j]; p + 1 < U.col_ptr[j + 1]; p++)
+        {
+            y[U.row_ind[p]] -= U.val[p] * yj;
+        }
+    }
+    vector<T> x(n);
+    for (size_t k = 0; k < n; k++)
+    {
+        x[F.colPerm[k]] = y[k];
+    }
+    return x;
+}
+
+/// @brief One-shot sparse direct solve of A x = b: analysis, factorization and solve
+template <typename T>
+vector<T> sparse_lu_solve_CSC(const CSCMatrix<T> &A, const vector<T> &b)
+{
+    return sparse_lu_solve_CSC(sparse_lu_factor_CSC(A, sparse_lu_analyze_CSC(A)), b);
+}
+
+#endif
@@ -0,0 +1,211 @@
+// functionsStatistics.cc
+// Matrix statistics computed together in one pass: min, max, sum, the Frobenius, 1- and
+// inf-norms, the diagonal dominance ratio and pattern symmetry. Nothing is stored on the
+// matrices: code that needs several of these (solver setup, preconditioner selection)
+// calls statistics_CSR and friends once and keeps the returned object. This file only
+// depends on the standard library and functionsSIMD.cc so that every matrix format can
+// include it.
+
+#ifndef FUNCTIONS_STATISTICS_CC
+#define FUNCTIONS_STATISTICS_CC
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "functionsSIMD.cc"
+
+/**
+ * @brief Statistics of a matrix. nnz, min, max and sum are over the stored entries
+ * (for a dense matrix, min, max and sum are over every entry and nnz counts the
+ * nonzeros); min and max are 0 when there are no entries. The norms and the dominance
+ * ratio are accumulated in double.
+ *
+ * @tparam T
+ */
+template <typename T>
+struct MatrixStatistics
+{
+    size_t nnz = 0;
+    T min = T(0), max = T(0), sum = T(0);
+    double frobeniusNorm = 0;
+    /// @brief Largest absolute column sum
+    double oneNorm = 0;
+    /// @brief Largest absolute row sum
+    double infNorm = 0;
+    /// @brief Smallest |a_ii| / sum_{j != i} |a_ij| over the rows, infinity for rows
+    /// without off-diagonal entries
+    double dominanceRatio = std::numeric_limits<double>::infinity();
+    /// @brief |a_ii| >= sum_{j != i} |a_ij| in every row, as diagonally_dominant
+    bool diagonallyDominant = true;
+    /// @brief Square, with (j, i) stored whenever (i, j) is
+    bool patternSymmetric = true;
+};
+
+/**
+ * @brief Running totals of a statistics pass. Accumulators of disjoint parts of a
+ * matrix are joined, which is the reduction of the parallel passes.
+ *
+ * @tparam T
+ */
+template <typename T>
+struct StatisticsAccumulator
+{
+    size_t nnz = 0;
+    T min = T(0), max = T(0), sum = T(0);
+    double sumSquares = 0;
+    bool symmetric = true;
+
+    /// @brief Adds the values x[0] ... x[n - 1] with a SIMD reduction
+    void add_values(const T *x, size_t n)
+    {
+        if (n == 0)
+        {
+            return;
+        }
+        T lo = x[0], hi = x[0], s = T(0);
+        double squares = 0;
+        SIMD_LOOP_REDUCTION(reduction(min : lo) reduction(max : hi) reduction(+ : s, squares))
+        for (size_t k = 0; k < n; k++)
+        {
+            lo = x[k] < lo ? x[k] : lo;
+            hi = hi < x[k] ? x[k] : hi;
+            s += x[k];
+            squares += double(x[k]) * double(x[k]);
+        }
+        join_totals(n, lo, hi, s, squares);
+    }
+
+    void join(const StatisticsAccumulator &other)
+    {
+        if (other.nnz > 0)
+        {
+            join_totals(other.nnz, other.min, other.max, other.sum, other.sumSquares);
+        }
+        symmetric = symmetric && other.symmetric;
+    }
+
+private:
+    void join_totals(size_t n, T lo, T hi, T s, double squares)
+    {
+        min = nnz == 0 || lo < min ? lo : min;
+        max = nnz == 0 || max < hi ? hi : max;
+        nnz += n;
+        sum += s;
+        sumSquares += squares;
+    }
+};
+
+/// @brief |x| in double
+template <typename T>
+double abs_value(const T x)
+{
+    return x < T(0) ? -double(x) : double(x);
+}
+
+/**
+ * @brief Finishes a statistics pass from its totals and the absolute sums of every row
+ * and column, which are kept without the diagonal so that diagonal dominance is checked
+ * the way diagonally_dominant does.
+ *
+ * @tparam T
+ * @param acc the totals of the pass
+ * @param rowOff sum_{j != i} |a_ij| of every row i
+ * @param colOff sum_{i != j} |a_ij| of every column j
+ * @param diag |a_ii| for i < min(rows, columns)
+ * @return MatrixStatistics<T>
+ */
+template <typename T>
+MatrixStatistics<T> finish_statistics(const StatisticsAccumulator<T> &acc, const std::vector<double> &rowOff,
+                                      const std::vector<double> &colOff, const std::vector<double> &diag)
+{
+    MatrixStatistics<T> stats;
+    stats.nnz = acc.nnz;
+    stats.min = acc.min;
+    stats.max = acc.max;
+    stats.sum = acc.sum;
+    stats.frobeniusNorm = std::sqrt(acc.sumSquares);
+    stats.patternSymmetric = acc.symmetric && rowOff.size() == colOff.size();
+    for (size_t i = 0; i < rowOff.size(); i++)
+    {
+        const double d = i < diag.size() ? diag[i] : 0.0;
+        stats.infNorm = std::max(stats.infNorm, rowOff[i] + d);
+        if (d < rowOff[i])
+        {
+            stats.diagonallyDominant = false;
+        }
+        if (rowOff[i] > 0)
+        {
+            stats.dominanceRatio = std::min(stats.dominanceRatio, d / rowOff[i]);
+        }
+    }
+    for (size_t j = 0; j < colOff.size(); j++)
+    {
+        stats.oneNorm = std::max(stats.oneNorm, colOff[j] + (j < diag.size() ? diag[j] : 0.0));
+    }
+    return stats;
+}
+
+/**
+ * @brief Adds major slice i of compressed storage (a row of CSR, a column of CSC) to a
+ * statistics pass: the values go through the SIMD reduction, then one more sweep over
+ * the slice, still in cache, sorts the absolute values into the diagonal and the
+ * off-diagonal sums and checks that every entry has its transpose.
+ *
+ * @param majorOff off-diagonal sum of slice i, written here
+ * @param minorOff off-diagonal sums of the minor indices, added to
+ * @param diag |a_ii|, written here for i < diag.size()
+ */
+template <typename T>
+void accumulate_slice(StatisticsAccumulator<T> &acc, size_t i, const std::vector<size_t> &ptr,
+                      const std::vector<size_t> &ind, const std::vector<T> &val, double &majorOff,
+                      double *minorOff, std::vector<double> &diag)
+{
+    const size_t first = ptr[i], last = ptr[i + 1];
+    acc.add_values(val.data() + first, last - first);
+    double off = 0;
+    for (size_t p = first; p < last; p++)
+    {
+        const size_t j = ind[p];
+        const double a = abs_value(val[p]);
+        if (j == i)
+        {
+            diag[i] += a;
+            continue;
+        }
+        off += a;
+        minorOff[j] += a;
+        if (acc.symmetric)
+        {
+            // the pattern of a square matrix is symmetric if slice j holds i
+            const size_t *begin = ind.data() + ptr[j], *end = ind.data() + ptr[j + 1];
+            const size_t *found = std::lower_bound(begin, end, i);
+            acc.symmetric = found != end && *found == i;
+        }
+    }
+    majorOff = off;
+}
+
+/**
+ * @brief Statistics of compressed storage with sorted minor indices in every slice
+ *
+ * @tparam T
+ * @param numMajor rows of CSR, columns of CSC
+ * @param numMinor columns of CSR, rows of CSC
+ * @param rowMajor true for CSR
+ */
+template <typename T>
+MatrixStatistics<T> compressed_statistics(size_t numMajor, size_t numMinor, const std::vector<size_t> &ptr,
+                                          const std::vector<size_t> &ind, const std::vector<T> &val, bool rowMajor)
+{
+    StatisticsAccumulator<T> acc;
+    acc.symmetric = numMajor == numMinor;
+    std::vector<double> majorOff(numMajor, 0.0), minorOff(numMinor, 0.0), diag(std::min(numMajor, numMinor), 0.0);
+    for (size_t i = 0; i < numMajor; i++)
+    {
+        accumulate_slice(acc, i, ptr, ind, val, majorOff[i], minorOff.data(), diag);
+    }
+    return rowMajor ? finish_statistics(acc, majorOff, minorOff, diag) : finish_statistics(acc, minorOff, majorOff, diag);
+}
+
+#endif